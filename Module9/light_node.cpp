@@ -1,5 +1,10 @@
 #include "Module9/light_node.hpp"
 
+#include "geometry/profiler.hpp"
+#include "scene/render_queue.hpp"
+#include "scene/scene_bvh.hpp"
+#include "scene/scene_store.hpp"
+
 namespace cg
 {
 
@@ -33,6 +38,26 @@ LightNode::LightNode(uint32_t        light_index,
 
 void LightNode::draw(SceneState &scene_state)
 {
+    CG_PROFILE_ZONE("LightNode::draw");
+    apply_state(scene_state);
+
+    // Draw children (if any)
+    SceneNode::draw(scene_state);
+}
+
+void LightNode::apply_state(SceneState &scene_state)
+{
+    // Write the light to the frame block (uploaded before the next draw)
+    if(scene_state.frame_buffer != nullptr)
+    {
+        if(light_index_ < MAX_BLOCK_LIGHTS)
+        {
+            scene_state.frame_block.lights[light_index_] = make_light_block(get_scene_light());
+            scene_state.frame_block_changed = true;
+        }
+        return;
+    }
+
     // Set the uniform variables for this light source
     // Get the light uniforms for this light index from the scene state
     if(light_index_ < 3) // STEP 5: Now support up to 3 lights
@@ -40,30 +65,57 @@ void LightNode::draw(SceneState &scene_state)
         const LightUniforms &light_uniforms = scene_state.lights[light_index_];
 
         // Set enabled flag
-        glUniform1i(light_uniforms.enabled, enabled_ ? 1 : 0);
+        scene_state.gl_state.uniform1i(light_uniforms.enabled, enabled_ ? 1 : 0);
 
         // STEP 5: Set spotlight flag
-        glUniform1i(light_uniforms.spotlight, is_spotlight_ ? 1 : 0);
+        scene_state.gl_state.uniform1i(light_uniforms.spotlight, is_spotlight_ ? 1 : 0);
 
         // Set light position/direction
-        glUniform4fv(light_uniforms.position, 1, &position_.x);
+        scene_state.gl_state.uniform4fv(light_uniforms.position, &position_.x);
 
         // Set light colors
-        glUniform4fv(light_uniforms.ambient, 1, &ambient_.r);
-        glUniform4fv(light_uniforms.diffuse, 1, &diffuse_.r);
-        glUniform4fv(light_uniforms.specular, 1, &specular_.r);
+        scene_state.gl_state.uniform4fv(light_uniforms.ambient, &ambient_.r);
+        scene_state.gl_state.uniform4fv(light_uniforms.diffuse, &diffuse_.r);
+        scene_state.gl_state.uniform4fv(light_uniforms.specular, &specular_.r);
 
         if(is_spotlight_)
         {
-            glUniform3fv(light_uniforms.spot_direction, 1, &spot_direction_.x);
-            glUniform1f(light_uniforms.spot_cutoff, spot_cutoff_);
-            glUniform1f(light_uniforms.spot_exponent, spot_exponent_);
+            scene_state.gl_state.uniform3fv(light_uniforms.spot_direction, &spot_direction_.x);
+            scene_state.gl_state.uniform1f(light_uniforms.spot_cutoff, spot_cutoff_);
+            scene_state.gl_state.uniform1f(light_uniforms.spot_exponent, spot_exponent_);
 
         }
     }
+}
 
-    // Draw children (if any)
-    SceneNode::draw(scene_state);
+void LightNode::compile(RenderQueue &queue, SceneState &scene_state)
+{
+    queue.add_state_node(this);
+    SceneNode::compile(queue, scene_state);
+}
+
+void LightNode::flatten(SceneStore &store, uint32_t parent)
+{
+    flatten_children(store, store.add_state(parent, this));
+}
+
+void LightNode::gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix)
+{
+    gather.lights.push_back(get_scene_light());
+    SceneNode::gather_instances(gather, model_matrix);
+}
+
+SceneLight LightNode::get_scene_light() const
+{
+    return SceneLight{enabled_,
+                      is_spotlight_,
+                      position_,
+                      ambient_,
+                      diffuse_,
+                      specular_,
+                      spot_direction_,
+                      spot_cutoff_,
+                      spot_exponent_};
 }
 
 void LightNode::set_position(const HPoint3 &position) { position_ = position; }
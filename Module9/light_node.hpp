@@ -57,6 +57,35 @@ class LightNode : public SceneNode
      */
     void draw(SceneState &scene_state) override;
 
+    /**
+     * Sets the light in the frame block, or the light uniform variables if
+     * the shader has no frame block (does not draw children).
+     * @param  scene_state  Current scene state containing uniform locations.
+     */
+    void apply_state(SceneState &scene_state) override;
+
+    /**
+     * Compile - registers the light as a per-frame state node.
+     * @param  queue        Render queue.
+     * @param  scene_state  Current scene state.
+     */
+    void compile(RenderQueue &queue, SceneState &scene_state) override;
+
+    /**
+     * Flatten - adds the light to the scene store as a state node.
+     * @param  store   Scene store.
+     * @param  parent  Handle of the parent in the store.
+     */
+    void flatten(SceneStore &store, uint32_t parent) override;
+
+    /**
+     * Add this light (in world coordinates, as sent to the shader) to the
+     * light list and gather the children.
+     * @param  gather        Instance and light lists.
+     * @param  model_matrix  Composite modeling matrix of the parent.
+     */
+    void gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix) override;
+
     /**
      * Set the position/direction of the light.
      * @param  position  Position/direction (w=1 for point, w=0 for directional)
@@ -128,6 +157,9 @@ class LightNode : public SceneNode
     Vector3  spot_direction_;   // STEP 5: Spotlight direction
     float    spot_cutoff_;      // STEP 5: Spotlight cutoff angle (degrees)
     float    spot_exponent_;    // STEP 5: Spotlight exponent
+
+    // Light as sent to the shader
+    SceneLight get_scene_light() const;
 };
 
 } // namespace cg
@@ -1,6 +1,7 @@
 #include "Module9/lighting_shader_node.hpp"
 
-#include <cstdio>
+#include "geometry/profiler.hpp"
+
 #include <iostream>
 
 namespace cg
@@ -41,76 +42,65 @@ bool LightingShaderNode::get_locations()
       return false;
   }
   
-  // Populate camera position uniform location in scene state
-  camera_position_loc = glGetUniformLocation(shader_program_.get_program(), "camera_position");
-  
-
-  // Set the number of lights to 2 for now
+  // Set the number of lights to 3 (must not exceed MAX_BLOCK_LIGHTS)
   light_count_ = 3;
-  light_count_loc_ = glGetUniformLocation(shader_program_.get_program(), "num_lights");
-  if(light_count_loc_ < 0)
-  {
-      std::cout << "LightingShaderNode: Error getting num_lights location\n";
-  }
 
-  // Get light uniforms
-  char name[128];
-  for(int i = 0; i < light_count_; i++)
+  // Camera position, lights and global ambient are in the frame block and
+  // the material in the material block. Assign each block its binding point
+  // (GLSL 4.1 has no binding layout qualifier).
+  GLuint frame_block_index = glGetUniformBlockIndex(shader_program_.get_program(), "FrameBlock");
+  if(frame_block_index == GL_INVALID_INDEX)
   {
-      snprintf(name, 128, "lights[%d].enabled", i);
-      lights_[i].enabled = glGetUniformLocation(shader_program_.get_program(), name);
-
-      //Get spotlight flag location
-      snprintf(name, 128, "lights[%d].spotlight", i);
-      lights_[i].spotlight = glGetUniformLocation(shader_program_.get_program(), name);
-
-      snprintf(name, 128, "lights[%d].position", i);
-      lights_[i].position = glGetUniformLocation(shader_program_.get_program(), name);
-      snprintf(name, 128, "lights[%d].ambient", i);
-      lights_[i].ambient = glGetUniformLocation(shader_program_.get_program(), name);
-      snprintf(name, 128, "lights[%d].diffuse", i);
-      lights_[i].diffuse = glGetUniformLocation(shader_program_.get_program(), name);
-      snprintf(name, 128, "lights[%d].specular", i);
-      lights_[i].specular = glGetUniformLocation(shader_program_.get_program(), name);
-
-      // Get spotlight parameter locations
-      snprintf(name, 128, "lights[%d].spot_direction", i);
-      lights_[i].spot_direction = glGetUniformLocation(shader_program_.get_program(), name);
-      snprintf(name, 128, "lights[%d].spot_cutoff", i);
-      lights_[i].spot_cutoff = glGetUniformLocation(shader_program_.get_program(), name);
-      snprintf(name, 128, "lights[%d].spot_exponent", i);
-      lights_[i].spot_exponent = glGetUniformLocation(shader_program_.get_program(), name);
+      std::cout << "LightingShaderNode: Error getting FrameBlock index\n";
+      return false;
   }
-  global_ambient_loc_ =
-      glGetUniformLocation(shader_program_.get_program(), "global_light_ambient");
-  if(global_ambient_loc_ < 0)
+  glUniformBlockBinding(shader_program_.get_program(), frame_block_index, FRAME_BLOCK_BINDING);
+
+  GLuint material_block_index = glGetUniformBlockIndex(shader_program_.get_program(), "MaterialBlock");
+  if(material_block_index == GL_INVALID_INDEX)
   {
-      std::cout << "LightingShaderNode: Error getting global ambient location\n";
+      std::cout << "LightingShaderNode: Error getting MaterialBlock index\n";
+      return false;
   }
+  glUniformBlockBinding(shader_program_.get_program(), material_block_index, MATERIAL_BLOCK_BINDING);
+  frame_buffer_.create(FRAME_BLOCK_BINDING, sizeof(FrameBlock));
 
+  // Packed vertex format uniforms (TriSurface sets these per mesh)
+  vertex_format_loc_ = glGetUniformLocation(shader_program_.get_program(), "vertex_format");
+  position_scale_loc_ = glGetUniformLocation(shader_program_.get_program(), "position_scale");
+  position_offset_loc_ = glGetUniformLocation(shader_program_.get_program(), "position_offset");
 
-  // TODO - may want to check for errors - however any uniforms that are not yet
-  // used will be "optimized out" during the compile and can return loc < 0
-
-  // Populate material uniform locations in scene state
-  material_ambient_loc_ = glGetUniformLocation(shader_program_.get_program(), "material_ambient");
-  material_diffuse_loc_ = glGetUniformLocation(shader_program_.get_program(), "material_diffuse");
-  material_specular_loc_ =
-      glGetUniformLocation(shader_program_.get_program(), "material_specular");
-  material_emission_loc_ =
-      glGetUniformLocation(shader_program_.get_program(), "material_emission");
-  material_shininess_loc_ =
-      glGetUniformLocation(shader_program_.get_program(), "material_shininess");
+  // Instancing uniform and per instance attributes (used by instanced draws)
+  instanced_loc_ = glGetUniformLocation(shader_program_.get_program(), "instanced");
+  instance_model_loc_ = glGetAttribLocation(shader_program_.get_program(), "instance_model_matrix");
+  instance_normal_loc_ = glGetAttribLocation(shader_program_.get_program(), "instance_normal_matrix");
 
   return true;
 }
 
 void LightingShaderNode::draw(SceneState &scene_state)
 {
-    // Enable this program
-    shader_program_.use();
+    CG_PROFILE_ZONE("LightingShaderNode::draw");
+    apply_state(scene_state);
 
-    glUniform1i(light_count_loc_, light_count_);
+    // Draw all children
+    SceneNode::draw(scene_state);
+}
+
+void LightingShaderNode::apply_state(SceneState &scene_state)
+{
+    // Enable this program
+    ShaderNode::apply_state(scene_state);
+
+    // Make the uniform buffers current. Materials are streamed again each
+    // time the program is applied.
+    frame_buffer_.bind();
+    material_stream_.clear();
+    scene_state.frame_buffer = &frame_buffer_;
+    scene_state.material_stream = &material_stream_;
+    scene_state.frame_block.num_lights = light_count_;
+    scene_state.frame_block.global_ambient = global_ambient_;
+    scene_state.frame_block_changed = true;
 
     // Set scene state locations to ones needed for this program
     scene_state.position_loc = position_loc_;
@@ -118,30 +108,33 @@ void LightingShaderNode::draw(SceneState &scene_state)
     scene_state.pvm_matrix_loc = pvm_matrix_loc_;
     scene_state.model_matrix_loc = model_matrix_loc_;
     scene_state.normal_matrix_loc = normal_matrix_loc_;
-    scene_state.camera_position_loc = camera_position_loc;
-
-    // Set material uniform location
-    scene_state.material_ambient_loc = material_ambient_loc_;
-    scene_state.material_diffuse_loc = material_diffuse_loc_;
-    scene_state.material_specular_loc = material_specular_loc_;
-    scene_state.material_emission_loc = material_emission_loc_;
-    scene_state.material_shininess_loc = material_shininess_loc_; 
-   //Pass light uniform locations to scene state
-   // so LightNodes can access them
-   for(int i = 0; i < light_count_; i++)
-   {
-      scene_state.lights[i] = lights_[i];
-   }
 
-    // Draw all children
-    SceneNode::draw(scene_state);
+    // Camera position and material are set through the uniform blocks
+    scene_state.camera_position_loc = -1;
+    scene_state.material_ambient_loc = -1;
+    scene_state.material_diffuse_loc = -1;
+    scene_state.material_specular_loc = -1;
+    scene_state.material_emission_loc = -1;
+    scene_state.material_shininess_loc = -1;
+
+    // Set packed vertex format uniform locations. Default to the float vertex
+    // format for geometry that does not set them.
+    scene_state.vertex_format_loc = vertex_format_loc_;
+    scene_state.position_scale_loc = position_scale_loc_;
+    scene_state.position_offset_loc = position_offset_loc_;
+    scene_state.gl_state.uniform1i(vertex_format_loc_, 0);
+    scene_state.gl_state.uniform3f(position_scale_loc_, 1.0f, 1.0f, 1.0f);
+    scene_state.gl_state.uniform3f(position_offset_loc_, 0.0f, 0.0f, 0.0f);
+
+    // Set instancing locations. Draws are not instanced unless the geometry
+    // sets the instanced flag.
+    scene_state.instanced_loc = instanced_loc_;
+    scene_state.instance_model_loc = instance_model_loc_;
+    scene_state.instance_normal_loc = instance_normal_loc_;
+    scene_state.gl_state.uniform1i(instanced_loc_, 0);
 }
 
-void LightingShaderNode::set_global_ambient(const Color4 &global_ambient)
-{
-    shader_program_.use();
-    glUniform4fv(global_ambient_loc_, 1, &global_ambient.r);
-}
+void LightingShaderNode::set_global_ambient(const Color4 &global_ambient) { global_ambient_ = global_ambient; }
 
 int LightingShaderNode::get_position_loc() const { return position_loc_; }
 
@@ -14,12 +14,15 @@
 
 #include "scene/color4.hpp"
 #include "scene/shader_node.hpp"
+#include "scene/uniform_buffer.hpp"
 
 namespace cg
 {
 
 /**
- * Simple lighting shader node.
+ * Simple lighting shader node. The camera position, lights and global
+ * ambient are in the FrameBlock uniform block and materials in the
+ * MaterialBlock uniform block.
  */
 class LightingShaderNode : public ShaderNode
 {
@@ -37,8 +40,16 @@ class LightingShaderNode : public ShaderNode
     void draw(SceneState &scene_state) override;
 
     /**
-     * Set the global ambient lighting property. This sets uniforms in the
-     * shader directly.
+     * Enable the program, set the light count, copy uniform and attribute
+     * locations into the scene state and make the uniform buffers current
+     * (does not draw children).
+     * @param  scene_state   Current scene state.
+     */
+    void apply_state(SceneState &scene_state) override;
+
+    /**
+     * Set the global ambient lighting property (written to the frame block
+     * when the shader is applied).
      * @param  global_ambient  Color/intensity of global ambient lighting.
      */
     void set_global_ambient(const Color4 &global_ambient);
@@ -62,20 +73,22 @@ class LightingShaderNode : public ShaderNode
     GLint pvm_matrix_loc_;     // Composite projection, view, model matrix location
     GLint model_matrix_loc_;   // Modeling composite matrix location
     GLint normal_matrix_loc_;  // Normal transformation matrix location
-    GLint camera_position_loc; // Camera position uniform location
 
-    // Material uniform locations
-    GLint material_ambient_loc_;   // Material ambient location
-    GLint material_diffuse_loc_;   // Material diffuse location
-    GLint material_specular_loc_;  // Material specular location
-    GLint material_emission_loc_;  // Material emission location
-    GLint material_shininess_loc_; // Material shininess location
+    // Packed vertex format uniform locations
+    GLint vertex_format_loc_;   // Vertex format location
+    GLint position_scale_loc_;  // Position dequantization scale location
+    GLint position_offset_loc_; // Position dequantization offset location
+
+    // Instancing locations
+    GLint instanced_loc_;       // Instanced draw flag uniform location
+    GLint instance_model_loc_;  // Instance model matrix attribute location
+    GLint instance_normal_loc_; // Instance normal matrix attribute location
 
-    // Lighting uniforms
-    int32_t       light_count_;        // Number of lights
-    GLint         light_count_loc_;    // Light count uniform locations
-    GLint         global_ambient_loc_; // Global ambient uniform location
-    LightUniforms lights_[3];          // Light source uniform locations
+    // Uniform blocks
+    int32_t        light_count_;     // Number of lights
+    Color4         global_ambient_;  // Global ambient light
+    UniformBuffer  frame_buffer_;    // Frame block (camera position, lights)
+    MaterialBuffer material_stream_; // Materials set while drawing the scene graph
 };
 
 } // namespace cg
@@ -14,12 +14,16 @@
 
 #include "filesystem_support/file_locator.hpp"
 #include "geometry/geometry.hpp"
+#include "geometry/profiler.hpp"
 #include "scene/graphics.hpp"
 #include "scene/scene.hpp"
 
 #include "Module9/lighting_shader_node.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <thread>
 #include <vector>
@@ -50,19 +54,71 @@ void logmsg(const char *message, ...)
 SDL_Window       *g_sdl_window = nullptr;
 SDL_GLContext     g_gl_context;
 constexpr int32_t DRAWS_PER_SECOND = 72;
-constexpr int32_t DRAW_INTERVAL_MILLIS =
-    static_cast<int32_t>(1000.0 / static_cast<double>(DRAWS_PER_SECOND));
+
+// Frame scheduler (update thread) and whether to read input just before
+// the frame starts (late latching) rather than before waiting for it
+cg::FramePacer g_frame_pacer(DRAWS_PER_SECOND);
+bool           g_late_latch = true;
+
+// One-off work requested by keys, done by the render thread
+constexpr uint32_t REQUEST_RAY_TRACE = 1;    // Ray trace the view to raytrace.ppm
+constexpr uint32_t REQUEST_RASTERIZE = 2;    // Rasterize the view on the CPU to raster.ppm
+constexpr uint32_t REQUEST_REPORT_STATS = 4; // Report matrix, draw call, culling and state cache stats
+
+// Everything the render thread needs from the update thread for a frame
+struct FrameSnapshot
+{
+    cg::CameraView view;             // View of the input camera
+    int32_t        width;            // Viewport size
+    int32_t        height;
+    bool           use_render_queue; // Draw with the render queue (or traverse the graph)
+    bool           use_scene_store;  // Draw from the scene store (overrides use_render_queue)
+    bool           instancing;       // Render queue merges shared geometry into instanced draws
+    bool           frustum_culling;  // Skip nodes outside the view frustum
+    int32_t        swap_interval;    // Buffer swap interval (1 for vsync)
+    uint32_t       requests;         // REQUEST_* flags
+};
+
+// Snapshots handed from the update (event) thread to the render thread,
+// and whether the render thread is used at all
+cg::SnapshotBuffer<FrameSnapshot> g_snapshots;
+bool                              g_render_thread = true;
+
+// Scene nodes and their reference counts are allocated from the scene arena
+// (see make_node). Declared first so it is destroyed after the scene graph.
+cg::Arena g_scene_arena(256 * 1024);
 
 // Root of the scene graph and scene state
 std::shared_ptr<cg::SceneNode> g_scene_root;
 
-// Global camera node (so we can change view)
+// Camera node in the scene graph. Only the render thread uses it: input
+// moves g_input_camera and each frame copies its view here.
 std::shared_ptr<cg::CameraNode> g_camera;
+cg::CameraNode                  g_input_camera;
 
 cg::SceneState g_scene_state;
 
+// Compiled render queue (flattened scene graph)
+cg::RenderQueue g_render_queue;
+
+// Scene store (scene graph flattened into depth first arrays)
+cg::SceneStore g_scene_store;
+
+// Settings changed by keys on the update thread
+bool     g_use_render_queue = true;
+bool     g_use_scene_store = false;
+bool     g_instancing = true;
+bool     g_frustum_culling = true;
+uint32_t g_requests = 0;
+
+// Last snapshot applied by the render thread
+FrameSnapshot g_frame{};
+
 std::shared_ptr<cg::LightNode> g_spotlight;
 
+// Global ambient light (the shader uniform and the ray tracer use the same value)
+cg::Color4 g_global_ambient(0.4f, 0.4f, 0.4f, 1.0f);
+
 // While mouse button is down, the view will be updated
 bool    g_animate = false;
 bool    g_forward = true;
@@ -72,12 +128,9 @@ int32_t g_mouse_y = 0;
 int32_t g_render_width = 800;
 int32_t g_render_height = 600;
 
-// Sleep function to help run a reasonable timer
-void sleep(int32_t milliseconds)
-{
-    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
-}
-
+/**
+ * Moves the spotlight to the scene graph camera, pointing along the view.
+ */
 void update_spotlight()
 {
     if(g_spotlight)
@@ -95,23 +148,38 @@ void update_spotlight()
 }
 
 /**
- * Display callback. Clears the prior scene and draws a new one.
+ * Clears the framebuffer and draws the scene.
  */
-void display()
+void draw_scene()
 {
+    CG_PROFILE_ZONE("draw_scene");
+
     // Clear the framebuffer and the depth buffer
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // Init scene state and draw the scene graph
+    // Init scene state and draw the scene graph (using the scene store, the
+    // compiled render queue or by traversing the graph)
     g_scene_state.init();
-    g_scene_root->draw(g_scene_state);
+    if(g_frame.use_scene_store) g_scene_store.draw(*g_scene_root, g_scene_state);
+    else if(g_frame.use_render_queue) g_render_queue.draw(*g_scene_root, g_scene_state);
+    else g_scene_root->draw(g_scene_state);
+}
+
+/**
+ * Display callback. Clears the prior scene and draws a new one.
+ */
+void display()
+{
+    draw_scene();
 
     // Swap buffers
+    CG_PROFILE_ZONE("SDL_GL_SwapWindow");
     SDL_GL_SwapWindow(g_sdl_window);
 }
 
 /**
- * Reshape callback. Update projection to reflect new aspect ratio.
+ * Reshape callback. Update projection to reflect new aspect ratio. The
+ * render thread resets the viewport when it applies the next snapshot.
  * @param  width  Window width
  * @param  height Window height
  */
@@ -120,12 +188,145 @@ void reshape(int32_t width, int32_t height)
     g_render_width = width;
     g_render_height = height;
 
-    // Reset the viewport
-    glViewport(0, 0, width, height);
-
     // Reset the perspective projection to reflect the change of aspect ratio
     // Make sure we cast to float so we get a fractional aspect ratio.
-    g_camera->change_aspect_ratio(static_cast<float>(width) / static_cast<float>(height));
+    g_input_camera.change_aspect_ratio(static_cast<float>(width) / static_cast<float>(height));
+}
+
+/**
+ * Fill a snapshot with the input camera and settings for the next frame
+ * (update thread). Takes the pending requests.
+ * @param  snapshot  Snapshot to fill.
+ */
+void take_snapshot(FrameSnapshot &snapshot)
+{
+    snapshot.view = g_input_camera.get_view();
+    snapshot.width = g_render_width;
+    snapshot.height = g_render_height;
+    snapshot.use_render_queue = g_use_render_queue;
+    snapshot.use_scene_store = g_use_scene_store;
+    snapshot.instancing = g_instancing;
+    snapshot.frustum_culling = g_frustum_culling;
+    snapshot.swap_interval = (g_frame_pacer.get_mode() == cg::PacingMode::VSYNC) ? 1 : 0;
+    snapshot.requests = g_requests;
+    g_requests = 0;
+}
+
+/**
+ * Apply a snapshot to the scene graph and OpenGL state (render thread).
+ * Only what changed since the last snapshot is updated, so a still camera
+ * keeps its matrix versions (and the cached transforms stay valid).
+ * @param  snapshot  Snapshot.
+ */
+void apply_snapshot(const FrameSnapshot &snapshot)
+{
+    if(!(snapshot.view == g_frame.view))
+    {
+        g_camera->set_view(snapshot.view);
+        update_spotlight();
+    }
+    if(snapshot.width != g_frame.width || snapshot.height != g_frame.height)
+    {
+        glViewport(0, 0, snapshot.width, snapshot.height);
+    }
+    if(snapshot.swap_interval != g_frame.swap_interval) SDL_GL_SetSwapInterval(snapshot.swap_interval);
+    if(snapshot.instancing != g_render_queue.get_instancing()) g_render_queue.set_instancing(snapshot.instancing);
+    g_scene_state.frustum_culling = snapshot.frustum_culling;
+    g_frame = snapshot;
+}
+
+/**
+ * Do the one-off work requested for a frame (render thread).
+ * @param  requests  REQUEST_* flags.
+ */
+void run_requests(uint32_t requests)
+{
+    // Ray trace the current view (with shadows) to raytrace.ppm
+    if(requests & REQUEST_RAY_TRACE)
+    {
+        cg::RayTraceSettings settings;
+        settings.width = static_cast<uint32_t>(g_frame.width);
+        settings.height = static_cast<uint32_t>(g_frame.height);
+        settings.global_ambient = g_global_ambient;
+
+        cg::RayTracer tracer;
+        cg::Image     image;
+        tracer.set_settings(settings);
+        tracer.build(*g_scene_root);
+        tracer.render(*g_camera, image);
+        image.write_ppm("raytrace.ppm");
+        const cg::RayTraceStats &stats = tracer.get_stats();
+        std::cout << "Ray traced raytrace.ppm in " << stats.render_ms << " ms ("
+                  << stats.primary_rays + stats.shadow_rays << " rays, " << stats.threads << " threads)\n";
+    }
+
+    // Rasterize the current view on the CPU to raster.ppm
+    if(requests & REQUEST_RASTERIZE)
+    {
+        cg::RasterSettings settings;
+        settings.width = static_cast<uint32_t>(g_frame.width);
+        settings.height = static_cast<uint32_t>(g_frame.height);
+        settings.global_ambient = g_global_ambient;
+
+        cg::SoftwareRasterizer rasterizer;
+        cg::Image              image;
+        rasterizer.set_settings(settings);
+        rasterizer.build(*g_scene_root);
+        rasterizer.render(*g_camera, image);
+        image.write_ppm("raster.ppm");
+        const cg::RasterStats &stats = rasterizer.get_stats();
+        std::cout << "Rasterized raster.ppm in " << stats.render_ms << " ms (" << stats.triangles_binned
+                  << " triangles, " << stats.threads << " threads)\n";
+    }
+
+    // Report matrix recomputations, draw calls, culling and skipped state changes in the last frame
+    if(requests & REQUEST_REPORT_STATS)
+    {
+        std::cout << "Matrix updates - world: " << g_scene_state.transform_counters.world_updates
+                  << " normal: " << g_scene_state.transform_counters.normal_updates
+                  << " pvm: " << g_scene_state.transform_counters.pvm_updates << '\n';
+        std::cout << "Render queue - draw calls: " << g_render_queue.get_records().size()
+                  << " merged into instanced draws: " << g_render_queue.get_merged_count() << '\n';
+        std::cout << "Culling - nodes tested: " << g_scene_state.culling_counters.nodes_tested
+                  << " culled: " << g_scene_state.culling_counters.nodes_culled << '\n';
+        const cg::GLStateCounters &gl_counters = g_scene_state.gl_state.get_counters();
+        std::cout << "GL state cache - skipped/made programs: " << gl_counters.program_hits << "/"
+                  << gl_counters.program_misses << " vertex arrays: " << gl_counters.vertex_array_hits << "/"
+                  << gl_counters.vertex_array_misses << " uniforms: " << gl_counters.uniform_hits << "/"
+                  << gl_counters.uniform_misses << '\n';
+    }
+}
+
+/**
+ * Render the next published snapshot: apply it, release it so the update
+ * thread can publish the following one, then draw (render thread).
+ * @return  Returns false if the snapshot buffer was closed.
+ */
+bool render_frame()
+{
+    const FrameSnapshot *snapshot = g_snapshots.acquire();
+    if(snapshot == nullptr) return false;
+
+    CG_PROFILE_ZONE("render_frame");
+    apply_snapshot(*snapshot);
+    uint32_t requests = snapshot->requests;
+    g_snapshots.release();
+
+    run_requests(requests);
+    display();
+    return true;
+}
+
+/**
+ * Render thread. Owns the OpenGL context and draws each snapshot as it is
+ * published, while the update thread handles input for the next frame.
+ */
+void render_thread()
+{
+    cg::set_profile_thread_name("render");
+    SDL_GL_MakeCurrent(g_sdl_window, g_gl_context);
+    while(render_frame()) {}
+    SDL_GL_MakeCurrent(g_sdl_window, nullptr);
 }
 
 /**
@@ -143,9 +344,7 @@ void update_view(int32_t x, int32_t y, bool forward)
     float dy = 4.0f * (((static_cast<float>(g_render_height * 0.5f) - y)) /
                        static_cast<float>(g_render_height));
     float dz = (forward) ? g_velocity : -g_velocity;
-    g_camera->move_and_turn(dx * g_velocity, dy * g_velocity, dz);
-
-    update_spotlight();
+    g_input_camera.move_and_turn(dx * g_velocity, dy * g_velocity, dz);
 }
 
 /**
@@ -215,32 +414,27 @@ bool handle_key_event(const SDL_Event &event)
 
         // Reset the view
         case SDLK_I:
-            g_camera->set_position(cg::Point3(0.0f, -100.0f, 20.0f));
-            g_camera->set_look_at_pt(cg::Point3(0.0f, 0.0f, 20.0f));
-            g_camera->set_view_up(cg::Vector3(0.0f, 0.0f, 1.0f));
-            update_spotlight();
+            g_input_camera.set_position(cg::Point3(0.0f, -100.0f, 20.0f));
+            g_input_camera.set_look_at_pt(cg::Point3(0.0f, 0.0f, 20.0f));
+            g_input_camera.set_view_up(cg::Vector3(0.0f, 0.0f, 1.0f));
             break;
 
         // roll the camera by 5 degrees
         case SDLK_R:
-            if(upper_case) g_camera->roll(-5);
-            else g_camera->roll(5);
-            update_spotlight();
+            if(upper_case) g_input_camera.roll(-5);
+            else g_input_camera.roll(5);
             break;
 
         // Change the pitch of the camera by 5 degrees
         case SDLK_P:
-            if(upper_case) g_camera->pitch(-5);
-            else g_camera->pitch(5);
-            update_spotlight();
+            if(upper_case) g_input_camera.pitch(-5);
+            else g_input_camera.pitch(5);
             break;
 
         // Change the heading of the camera by 5 degrees
         case SDLK_H:
-            if(upper_case) g_camera->heading(-5);
-            else g_camera->heading(5);
-            update_spotlight();
-
+            if(upper_case) g_input_camera.heading(-5);
+            else g_input_camera.heading(5);
             break;
 
         // Go faster/slower
@@ -255,26 +449,112 @@ bool handle_key_event(const SDL_Event &event)
 
         // Slide right/left
         case SDLK_X:
-            if(upper_case) g_camera->slide(5.0f, 0.0f, 0.0f);
-            else g_camera->slide(-5.0f, 0.0f, 0.0f);
-            update_spotlight();
-
+            if(upper_case) g_input_camera.slide(5.0f, 0.0f, 0.0f);
+            else g_input_camera.slide(-5.0f, 0.0f, 0.0f);
             break;
 
         // Slide up/down
         case SDLK_Y:
-            if(upper_case) g_camera->slide(0.0f, 5.0f, 0.0f);
-            else g_camera->slide(0.0f, -5.0f, 0.0f);
-            update_spotlight();
-
+            if(upper_case) g_input_camera.slide(0.0f, 5.0f, 0.0f);
+            else g_input_camera.slide(0.0f, -5.0f, 0.0f);
             break;
 
         // Move forward/backward
         case SDLK_F:
-            if(upper_case) g_camera->slide(0.0f, 0.0f, -5.0f);
-            else g_camera->slide(0.0f, 0.0f, 5.0f);
-            update_spotlight();
+            if(upper_case) g_input_camera.slide(0.0f, 0.0f, -5.0f);
+            else g_input_camera.slide(0.0f, 0.0f, 5.0f);
+            break;
 
+        // Toggle between the compiled render queue and scene graph traversal
+        case SDLK_C:
+            if(event.type != SDL_EVENT_KEY_DOWN) break;
+            g_use_render_queue = upper_case;
+            std::cout << (g_use_render_queue ? "Render queue\n" : "Scene graph traversal\n");
+            break;
+
+        // Draw from the scene store (or as selected by C/c)
+        case SDLK_D:
+            if(event.type != SDL_EVENT_KEY_DOWN) break;
+            g_use_scene_store = upper_case;
+            std::cout << (upper_case ? "Scene store\n"
+                                     : (g_use_render_queue ? "Render queue\n" : "Scene graph traversal\n"));
+            break;
+
+        // Enable/disable merging shared geometry into instanced draws (render queue)
+        case SDLK_N:
+            if(event.type != SDL_EVENT_KEY_DOWN) break;
+            g_instancing = upper_case;
+            std::cout << (upper_case ? "Instancing enabled\n" : "Instancing disabled\n");
+            break;
+
+        // Enable/disable view frustum culling
+        case SDLK_U:
+            if(event.type != SDL_EVENT_KEY_DOWN) break;
+            g_frustum_culling = upper_case;
+            std::cout << (upper_case ? "Frustum culling enabled\n" : "Frustum culling disabled\n");
+            break;
+
+        // Report frame pacing since the last report, then (on the render
+        // thread) matrix recomputations, draw calls and culling
+        case SDLK_S:
+            if(event.type != SDL_EVENT_KEY_DOWN) break;
+            g_frame_pacer.get_frame_times().print("Frame interval");
+            g_frame_pacer.get_work_times().print("Frame work");
+            g_frame_pacer.clear_stats();
+            g_requests |= REQUEST_REPORT_STATS;
+            break;
+
+        // Cycle the frame pacing mode (the render thread sets the swap interval)
+        case SDLK_M:
+            if(event.type != SDL_EVENT_KEY_DOWN) break;
+            switch(g_frame_pacer.get_mode())
+            {
+                case cg::PacingMode::FIXED_RATE:
+                    g_frame_pacer.set_mode(cg::PacingMode::VSYNC);
+                    std::cout << "Frame pacing: vsync\n";
+                    break;
+                case cg::PacingMode::VSYNC:
+                    g_frame_pacer.set_mode(cg::PacingMode::UNLOCKED);
+                    std::cout << "Frame pacing: unlocked\n";
+                    break;
+                default:
+                    g_frame_pacer.set_mode(cg::PacingMode::FIXED_RATE);
+                    std::cout << "Frame pacing: " << DRAWS_PER_SECOND << " Hz\n";
+                    break;
+            }
+            g_frame_pacer.clear_stats();
+            break;
+
+        // Enable/disable late latching of input
+        case SDLK_L:
+            if(event.type != SDL_EVENT_KEY_DOWN) break;
+            g_late_latch = upper_case;
+            std::cout << (upper_case ? "Late latch enabled\n" : "Late latch disabled\n");
+            break;
+
+        // Ray trace the current view (with shadows) to raytrace.ppm, or
+        // rasterize it on the CPU to raster.ppm
+        case SDLK_T:
+            if(event.type != SDL_EVENT_KEY_DOWN) break;
+            g_requests |= (upper_case ? REQUEST_RAY_TRACE : REQUEST_RASTERIZE);
+            break;
+
+        // Start profiling, or stop and write the zones to profile.json
+        // (open in chrome://tracing or ui.perfetto.dev)
+        case SDLK_Z:
+            if(event.type != SDL_EVENT_KEY_DOWN) break;
+            if(upper_case)
+            {
+                cg::clear_profile();
+                cg::set_profiling(true);
+                std::cout << "Profiling started\n";
+            }
+            else if(cg::is_profiling())
+            {
+                cg::set_profiling(false);
+                cg::print_profile_summary();
+                if(cg::write_chrome_trace("profile.json")) std::cout << "Wrote profile.json\n";
+            }
             break;
         default: break;
     }
@@ -287,6 +567,7 @@ bool handle_key_event(const SDL_Event &event)
  */
 bool handle_events()
 {
+    CG_PROFILE_ZONE("handle_events");
     SDL_Event e;
     bool      cont_program = true;
     while(SDL_PollEvent(&e))
@@ -312,6 +593,16 @@ bool handle_events()
     return cont_program;
 }
 
+/**
+ * Construct a scene node in the scene arena.
+ * @param  args  Constructor arguments.
+ * @return  Returns the scene node.
+ */
+template <typename T, typename... Args> std::shared_ptr<T> make_node(Args &&...args)
+{
+    return cg::make_scene_node<T>(&g_scene_arena, std::forward<Args>(args)...);
+}
+
 /**
  * Convenience method to add a material, then a transform, then a
  * geometry node as a child to a specified parent node.
@@ -339,62 +630,62 @@ std::shared_ptr<cg::SceneNode> construct_room(std::shared_ptr<cg::UnitSquareSurf
 {
     // Contruct transform nodes for the walls. Perform rotations so the
     // walls face inwards
-    auto floor_transform = std::make_shared<cg::TransformNode>();
+    auto floor_transform = make_node<cg::TransformNode>();
     floor_transform->scale(200.0f, 200.0f, 1.0f);
 
     // Back wall is rotated +90 degrees about x: (y -> z)
-    auto backwall_transform = std::make_shared<cg::TransformNode>();
+    auto backwall_transform = make_node<cg::TransformNode>();
     backwall_transform->translate(0.0f, 100.0f, 40.0f);
     backwall_transform->rotate_x(90.0f);
     backwall_transform->scale(200.0f, 80.0f, 1.0f);
 
     // Front wall is rotated -90 degrees about x: (z -> y)
-    auto frontwall_transform = std::make_shared<cg::TransformNode>();
+    auto frontwall_transform = make_node<cg::TransformNode>();
     frontwall_transform->translate(0.0f, -100.0f, 40.0f);
     frontwall_transform->rotate_x(-90.0f);
     frontwall_transform->scale(200.0f, 80.0f, 1.0f);
 
     // Left wall is rotated 90 degrees about y: (z -> x)
-    auto leftwall_transform = std::make_shared<cg::TransformNode>();
+    auto leftwall_transform = make_node<cg::TransformNode>();
     leftwall_transform->translate(-100.0f, 0.0f, 40.0f);
     leftwall_transform->rotate_y(90.0f);
     leftwall_transform->scale(80.0f, 200.0f, 1.0f);
 
     // Right wall is rotated -90 about y: (z -> -x)
-    auto rightwall_transform = std::make_shared<cg::TransformNode>();
+    auto rightwall_transform = make_node<cg::TransformNode>();
     rightwall_transform->translate(100.0f, 0.0f, 40.0f);
     rightwall_transform->rotate_y(-90.0f);
     rightwall_transform->scale(80.0f, 200.0f, 1.0f);
 
     // Ceiling is rotated 180 about x so it faces inwards
-    auto ceiling_transform = std::make_shared<cg::TransformNode>();
+    auto ceiling_transform = make_node<cg::TransformNode>();
     ceiling_transform->translate(0.0f, 0.0f, 80.0f);
     ceiling_transform->rotate_x(180.0f);
     ceiling_transform->scale(200.0f, 200.0f, 1.0f);
 
     // Floor should be tan, mostly dull
-    auto floor_material = std::make_shared<cg::PresentationNode>(cg::Color4(0.15f, 0.22f, 0.05f),
+    auto floor_material = make_node<cg::PresentationNode>(cg::Color4(0.15f, 0.22f, 0.05f),
                                                                  cg::Color4(0.3f, 0.45f, 0.1f),
                                                                  cg::Color4(0.1f, 0.1f, 0.1f),
                                                                  cg::Color4(0.0f, 0.0f, 0.0f),
                                                                  5.0f);
 
     // Make the walls reddish, slightly shiny
-    auto wall_material = std::make_shared<cg::PresentationNode>(cg::Color4(0.35f, 0.225f, 0.275f),
+    auto wall_material = make_node<cg::PresentationNode>(cg::Color4(0.35f, 0.225f, 0.275f),
                                                                 cg::Color4(0.7f, 0.55f, 0.55f),
                                                                 cg::Color4(0.4f, 0.4f, 0.4f),
                                                                 cg::Color4(0.0f, 0.0f, 0.0f),
                                                                 16.0f);
 
     // Ceiling should be white, moderately shiny
-    auto ceiling_material = std::make_shared<cg::PresentationNode>(cg::Color4(0.75f, 0.75f, 0.75f),
+    auto ceiling_material = make_node<cg::PresentationNode>(cg::Color4(0.75f, 0.75f, 0.75f),
                                                                    cg::Color4(1.0f, 1.0f, 1.0f),
                                                                    cg::Color4(0.9f, 0.9f, 0.9f),
                                                                    cg::Color4(0.0f, 0.0f, 0.0f),
                                                                    64.0f);
 
     // Walls. We can group these all under a single presentation node.
-    auto room = std::make_shared<cg::SceneNode>();
+    auto room = make_node<cg::SceneNode>();
     room->add_child(wall_material);
     wall_material->add_child(backwall_transform);
     backwall_transform->add_child(unit_square);
@@ -423,26 +714,26 @@ std::shared_ptr<cg::SceneNode> construct_table(std::shared_ptr<cg::SceneNode>
                                                std::shared_ptr<cg::ConicSurface> leg)
 {
     // Table legs (relative to center of table)
-    auto lfleg_transform = std::make_shared<cg::TransformNode>();
+    auto lfleg_transform = make_node<cg::TransformNode>();
     lfleg_transform->translate(-20.0f, -10.0f, 10.0f);
     lfleg_transform->scale(6.0f, 6.0f, 20.0f);
-    auto lrleg_transform = std::make_shared<cg::TransformNode>();
+    auto lrleg_transform = make_node<cg::TransformNode>();
     lrleg_transform->translate(-20.0f, 10.0f, 10.0f);
     lrleg_transform->scale(6.0f, 6.0f, 20.0f);
-    auto rfleg_transform = std::make_shared<cg::TransformNode>();
+    auto rfleg_transform = make_node<cg::TransformNode>();
     rfleg_transform->translate(20.0f, -10.0f, 10.0f);
     rfleg_transform->scale(6.0f, 6.0f, 20.0f);
-    auto rrleg_transform = std::make_shared<cg::TransformNode>();
+    auto rrleg_transform = make_node<cg::TransformNode>();
     rrleg_transform->translate(20.0f, 10.0f, 10.0f);
     rrleg_transform->scale(6.0f, 6.0f, 20.0f);
 
     // Construct dimensions for the table top
-    auto top_transform = std::make_shared<cg::TransformNode>();
+    auto top_transform = make_node<cg::TransformNode>();
     top_transform->translate(0.0f, 0.0f, 23.0f);
     top_transform->scale(60.0f, 30.0f, 6.0f);
 
     // Create the tree
-    auto table = std::make_shared<cg::SceneNode>();
+    auto table = make_node<cg::SceneNode>();
     table->add_child(top_transform);
     top_transform->add_child(box);
     table->add_child(lfleg_transform);
@@ -468,36 +759,36 @@ std::shared_ptr<cg::SceneNode>
     // Perform rotations so the sides face outwards
 
     // Bottom is rotated 180 degrees so it faces outwards
-    auto bottom_transform = std::make_shared<cg::TransformNode>();
+    auto bottom_transform = make_node<cg::TransformNode>();
     bottom_transform->translate(0.0f, 0.0f, -0.5f);
     bottom_transform->rotate_x(180.0f);
 
     // Back is rotated -90 degrees about x: (z -> y)
-    auto back_transform = std::make_shared<cg::TransformNode>();
+    auto back_transform = make_node<cg::TransformNode>();
     back_transform->translate(0.0f, 0.5f, 0.0f);
     back_transform->rotate_x(-90.0f);
 
     // Front wall is rotated 90 degrees about x: (y -> z)
-    auto front_transform = std::make_shared<cg::TransformNode>();
+    auto front_transform = make_node<cg::TransformNode>();
     front_transform->translate(0.0f, -0.5f, 0.0f);
     front_transform->rotate_x(90.0f);
 
     // Left wall is rotated -90 about y: (z -> -x)
-    auto left_transform = std::make_shared<cg::TransformNode>();
+    auto left_transform = make_node<cg::TransformNode>();
     left_transform->translate(-0.5f, 0.0f, 00.0f);
     left_transform->rotate_y(-90.0f);
 
     // Right wall is rotated 90 degrees about y: (z -> x)
-    auto right_transform = std::make_shared<cg::TransformNode>();
+    auto right_transform = make_node<cg::TransformNode>();
     right_transform->translate(0.5f, 0.0f, 0.0f);
     right_transform->rotate_y(90.0f);
 
     // Top
-    auto top_transform = std::make_shared<cg::TransformNode>();
+    auto top_transform = make_node<cg::TransformNode>();
     top_transform->translate(0.0f, 0.0f, 0.50f);
 
     // Create a SceneNode and add the 6 sides of the box.
-    auto box = std::make_shared<cg::SceneNode>();
+    auto box = make_node<cg::SceneNode>();
     box->add_child(back_transform);
     back_transform->add_child(unit_square);
     box->add_child(left_transform);
@@ -537,21 +828,21 @@ std::shared_ptr<cg::SceneNode> construct_vase(const int position_loc, const int
                                  {0.65f, 0.0f, 0.5f},
                                  {0.0f, 0.0f, 0.5f}};
 
-    auto surf = std::make_shared<cg::SurfaceOfRevolution>(v, 36, position_loc, normal_loc);
+    auto surf = make_node<cg::SurfaceOfRevolution>(v, 36, position_loc, normal_loc);
 
     // Vase color and position
-    auto vase_material = std::make_shared<cg::PresentationNode>(cg::Color4(0.35f, 0.15f, 0.25f),
+    auto vase_material = make_node<cg::PresentationNode>(cg::Color4(0.35f, 0.15f, 0.25f),
                                                                 cg::Color4(0.95f, 0.35f, 0.65f),
                                                                 cg::Color4(0.4f, 0.4f, 0.4f),
                                                                 cg::Color4(0.0f, 0.0f, 0.0f),
                                                                 16.0f);
 
-    auto vase_transform = std::make_shared<cg::TransformNode>();
+    auto vase_transform = make_node<cg::TransformNode>();
     vase_transform->translate(0.0f, 75.0f, 10.0f);
     vase_transform->scale(10.0f, 10.0f, 20.0f);
 
     // Form scene graph
-    auto vase = std::make_shared<cg::SceneNode>();
+    auto vase = make_node<cg::SceneNode>();
     add_sub_tree(vase, vase_material, vase_transform, surf);
     return vase;
 }
@@ -561,23 +852,23 @@ std::shared_ptr<cg::SceneNode> construct_vase(const int position_loc, const int
  */
 std::shared_ptr<cg::SceneNode> construct_shiny_sphere(int32_t position_loc, int32_t normal_loc)
 {
-    auto sphere = std::make_shared<cg::SphereSection>(
+    auto sphere = make_node<cg::SphereSection>(
         -90.0f, 90.0f, 18, -180.0f, 180.0f, 36, 1.0f, position_loc, normal_loc);
 
     // Shiny blue
-    auto shiny_blue = std::make_shared<cg::PresentationNode>(cg::Color4(0.05f, 0.05f, 0.2f),
+    auto shiny_blue = make_node<cg::PresentationNode>(cg::Color4(0.05f, 0.05f, 0.2f),
                                                              cg::Color4(0.2f, 0.2f, 0.7f),
                                                              cg::Color4(1.0f, 1.0f, 1.0f),
                                                              cg::Color4(0.0f, 0.0f, 0.0f),
                                                              85.0f);
 
     // Sphere
-    auto sphere_transform = std::make_shared<cg::TransformNode>();
+    auto sphere_transform = make_node<cg::TransformNode>();
     sphere_transform->translate(80.0f, 20.0f, 10.0f);
     sphere_transform->scale(10.0f, 10.0f, 10.0f);
 
     // Form scene graph
-    auto shiny_sphere = std::make_shared<cg::SceneNode>();
+    auto shiny_sphere = make_node<cg::SceneNode>();
     add_sub_tree(shiny_sphere, shiny_blue, sphere_transform, sphere);
     return shiny_sphere;
 }
@@ -591,8 +882,7 @@ void construct_lighting(std::shared_ptr<cg::CameraNode> camera,
                         std::shared_ptr<cg::LightingShaderNode> shader)
 {
     // Set the global light ambient
-    cg::Color4 global_ambient(0.4f, 0.4f, 0.4f, 1.0f);
-    shader->set_global_ambient(global_ambient);
+    shader->set_global_ambient(g_global_ambient);
 
     // Light 0 - a point light source located at the back right corner
     // Note the w component is 1. This light is somewhat dim.
@@ -602,7 +892,7 @@ void construct_lighting(std::shared_ptr<cg::CameraNode> camera,
     cg::Color4  diffuse_0(0.5f, 0.5f, 0.5f, 1.0f);
     cg::Color4  specular_0(0.5f, 0.5f, 0.5f, 1.0f);
     
-    auto light0 = std::make_shared<cg::LightNode>(0, position_0, ambient_0, diffuse_0, specular_0);
+    auto light0 = make_node<cg::LightNode>(0, position_0, ambient_0, diffuse_0, specular_0);
     camera->add_child(light0);
 
     // Light 1 - a directional light from above
@@ -613,7 +903,7 @@ void construct_lighting(std::shared_ptr<cg::CameraNode> camera,
     cg::Color4  diffuse_1(0.7f, 0.7f, 0.7f, 1.0f);
     cg::Color4  specular_1(0.7f, 0.7f, 0.7f, 1.0f);
     
-    auto light1 = std::make_shared<cg::LightNode>(1, position_1, ambient_1, diffuse_1, specular_1);
+    auto light1 = make_node<cg::LightNode>(1, position_1, ambient_1, diffuse_1, specular_1);
     camera->add_child(light1);
     //Light 2 - a reddish spotlight at camera position
     // Aimed along view direction, cutoff 30 degrees, exponent 32
@@ -627,7 +917,7 @@ void construct_lighting(std::shared_ptr<cg::CameraNode> camera,
     float       spot_cutoff = 30.0f;
     float       spot_exponent = 32.0f;
     
-    g_spotlight = std::make_shared<cg::LightNode>(2, position_2, ambient_2, diffuse_2, specular_2,
+    g_spotlight = make_node<cg::LightNode>(2, position_2, ambient_2, diffuse_2, specular_2,
                                                    spot_dir, spot_cutoff, spot_exponent);
     camera->add_child(g_spotlight);
 
@@ -635,24 +925,31 @@ void construct_lighting(std::shared_ptr<cg::CameraNode> camera,
 
 /**
  * Construct the scene
+ * @param  use_opengl  Create the lighting shader. False when there is no
+ *                     OpenGL context (the scene is only drawn on the CPU).
  */
-void construct_scene()
+void construct_scene(bool use_opengl)
 {
-    // Shader node
-    auto shader = std::make_shared<cg::LightingShaderNode>();
-    if(!shader->create("Module9/vertex_lighting.vert", "Module9/vertex_lighting.frag") ||
-       !shader->get_locations())
+    // Shader node (the shader's attribute locations are used when
+    // constructing VAOs)
+    auto    shader = make_node<cg::LightingShaderNode>();
+    // Without OpenGL the surfaces create no buffers (negative locations)
+    int32_t position_loc = -1;
+    int32_t normal_loc = -1;
+    if(use_opengl)
     {
-        exit(-1);
+        if(!shader->create("Module9/vertex_lighting.vert", "Module9/vertex_lighting.frag") ||
+           !shader->get_locations())
+        {
+            exit(-1);
+        }
+        position_loc = shader->get_position_loc();
+        normal_loc = shader->get_normal_loc();
     }
 
-    // Get the position and normal locations to use when constructing VAOs
-    int32_t position_loc = shader->get_position_loc();
-    int32_t normal_loc = shader->get_normal_loc();
-
     // Add the camera to the scene
     // Initialize the view and set a perspective projection
-    g_camera = std::make_shared<cg::CameraNode>();
+    g_camera = make_node<cg::CameraNode>();
     g_camera->set_position(cg::Point3(0.0f, -100.0f, 20.0f));
     g_camera->set_look_at_pt(cg::Point3(0.0f, 0.0f, 20.0f));
     g_camera->set_view_up(cg::Vector3(0.0f, 0.0f, 1.0f));
@@ -662,13 +959,13 @@ void construct_scene()
    construct_lighting(g_camera, shader);
 
     // Construct subdivided square - subdivided 10x in both x and y
-    auto unit_square = std::make_shared<cg::UnitSquareSurface>(2, position_loc, normal_loc);
+    auto unit_square = make_node<cg::UnitSquareSurface>(2, position_loc, normal_loc);
 
     // Construct a unit cylinder surface
-    auto cylinder = std::make_shared<cg::ConicSurface>(0.5f, 0.5f, 18, 4, position_loc, normal_loc);
+    auto cylinder = make_node<cg::ConicSurface>(0.5f, 0.5f, 18, 4, position_loc, normal_loc);
 
     // Construct a unit cone
-    auto cone = std::make_shared<cg::ConicSurface>(0.5f, 0.0f, 18, 4, position_loc, normal_loc);
+    auto cone = make_node<cg::ConicSurface>(0.5f, 0.0f, 18, 4, position_loc, normal_loc);
 
     // Construct the room as a child of the root node
     auto room = construct_room(unit_square);
@@ -680,23 +977,31 @@ void construct_scene()
     auto table = construct_table(unit_box, cylinder);
 
     // Wood material for table
-    auto wood = std::make_shared<cg::PresentationNode>(cg::Color4(0.275f, 0.225f, 0.075f),
+    auto wood = make_node<cg::PresentationNode>(cg::Color4(0.275f, 0.225f, 0.075f),
                                                        cg::Color4(0.55f, 0.45f, 0.15f),
                                                        cg::Color4(0.3f, 0.3f, 0.3f),
                                                        cg::Color4(0.0f, 0.0f, 0.0f),
                                                        64.0f);
 
     // Position the table in the room
-    auto table_transform = std::make_shared<cg::TransformNode>();
+    auto table_transform = make_node<cg::TransformNode>();
     table_transform->translate(-50.0f, 50.0f, 0.0f);
     table_transform->rotate_z(30.0f);
 
     // Teapot
-    auto teapot = std::make_shared<cg::MeshTeapot>(4, position_loc, normal_loc);
+    auto teapot = make_node<cg::MeshTeapot>(4, position_loc, normal_loc);
+
+    // Use the packed (12 byte) vertex format for the teapot. The lighting
+    // shader dequantizes positions and decodes the normals.
+    if(use_opengl)
+    {
+        teapot->set_vertex_format(cg::VertexFormat::PACKED);
+        teapot->create_vertex_buffers(position_loc, normal_loc);
+    }
 
     // Silver material (for the teapot)
     auto teapot_material =
-        std::make_shared<cg::PresentationNode>(cg::Color4(0.19225f, 0.19225f, 0.19225f),
+        make_node<cg::PresentationNode>(cg::Color4(0.19225f, 0.19225f, 0.19225f),
                                                cg::Color4(0.50754f, 0.50754f, 0.50754f),
                                                cg::Color4(0.508273f, 0.508273f, 0.508273f),
                                                cg::Color4(0.0f, 0.0f, 0.0f),
@@ -706,33 +1011,33 @@ void construct_scene()
     // if you look from above the table intersects the bottom, but if you move
     // higher when you look from outside it looks like the teapot is above the
     // table. This is because we don't know the exact dimensions of the teapot.
-    auto teapot_transform = std::make_shared<cg::TransformNode>();
+    auto teapot_transform = make_node<cg::TransformNode>();
     teapot_transform->translate(0.0f, 0.0f, 26.0f);
     teapot_transform->scale(2.5f, 2.5f, 2.5f);
 
     // Add a box position transform (used as base transform for the box and
     // the cone on top of the box
-    auto box_position_transform = std::make_shared<cg::TransformNode>();
+    auto box_position_transform = make_node<cg::TransformNode>();
     box_position_transform->translate(80.0f, 80.0f, 7.5f);
 
     // Add a material and transform for box in the back right corner
-    auto box_material = std::make_shared<cg::PresentationNode>(cg::Color4(0.25f, 0.125f, 0.125f),
+    auto box_material = make_node<cg::PresentationNode>(cg::Color4(0.25f, 0.125f, 0.125f),
                                                                cg::Color4(0.5f, 0.25f, 0.25f),
                                                                cg::Color4(0.25f, 0.25f, 0.25f),
                                                                cg::Color4(0.0f, 0.0f, 0.0f),
                                                                32.0f);
-    auto box_transform = std::make_shared<cg::TransformNode>();
+    auto box_transform = make_node<cg::TransformNode>();
     box_transform->rotate_z(45.0f);
     box_transform->scale(20.0f, 20.0f, 15.0f);
 
     // Position a golden cone on top of the box
     auto cone_material =
-        std::make_shared<cg::PresentationNode>(cg::Color4(0.25f, 0.2f, 0.05f),
+        make_node<cg::PresentationNode>(cg::Color4(0.25f, 0.2f, 0.05f),
                                                cg::Color4(0.75164f, 0.60648f, 0.22648f),
                                                cg::Color4(0.75f, 0.75f, 0.75f),
                                                cg::Color4(0.0f, 0.0f, 0.0f),
                                                96.0f);
-    auto cone_transform = std::make_shared<cg::TransformNode>();
+    auto cone_transform = make_node<cg::TransformNode>();
     cone_transform->translate(0.0f, 0.0f, 15.0f);
     cone_transform->scale(8.0f, 8.0f, 15.0f);
 
@@ -744,10 +1049,10 @@ void construct_scene()
 
    // Construct a torus surface - ring radius 20, tube radius 5
    // Subdivide by 36 for ring, 18 for tube
-   auto torus = std::make_shared<cg::TorusSurface>(20.0f, 5.0f, 36, 18, position_loc, normal_loc);
+   auto torus = make_node<cg::TorusSurface>(20.0f, 5.0f, 36, 18, position_loc, normal_loc);
 
    // Shiny black material for torus (no ambient, very little diffuse, mostly specular)
-   auto torus_material = std::make_shared<cg::PresentationNode>(
+   auto torus_material = make_node<cg::PresentationNode>(
        cg::Color4(0.0f, 0.0f, 0.0f),      // Ambient: none
        cg::Color4(0.1f, 0.1f, 0.1f),      // Diffuse: very little
        cg::Color4(0.9f, 0.9f, 0.9f),      // Specular: mostly (shiny)
@@ -757,11 +1062,11 @@ void construct_scene()
    // Position torus along back wall (y=100), rotated to lay against the wall
    // The back wall is at y=100, centered at z=40
    // Rotate 90 degrees around X axis to make it lay flat against the wall
-   auto torus_transform = std::make_shared<cg::TransformNode>();
+   auto torus_transform = make_node<cg::TransformNode>();
    torus_transform->translate(0.0f, 95.0f, 40.0f);  // Slightly in front of back wall
    torus_transform->rotate_x(90.0f);                 // Rotate to lay against wall
 
-    g_scene_root = std::make_shared<cg::SceneNode>();
+    g_scene_root = make_node<cg::SceneNode>();
     g_scene_root->add_child(shader);
     shader->add_child(g_camera);
 
@@ -787,9 +1092,118 @@ void construct_scene()
     g_camera->add_child(vase);
     g_camera->add_child(shiny_sphere);
 
+    // Input moves a copy of the camera (see apply_snapshot)
+    g_input_camera.set_view(g_camera->get_view());
     update_spotlight();
 }
 
+/**
+ * Destroy the scene and free the scene arena. Call while the OpenGL context
+ * (if any) is current: surfaces, the render queue and the scene store delete
+ * their buffers.
+ */
+void destroy_scene()
+{
+    g_render_queue.release();
+    g_scene_store.release();
+    g_scene_root.reset();
+    g_camera.reset();
+    g_spotlight.reset();
+    g_scene_arena.release();
+}
+
+/**
+ * Render frames along a scripted camera path as fast as possible and report
+ * the frame times. OpenGL frames are drawn to a framebuffer object and
+ * include the GPU time (glFinish). CPU frames use the software rasterizer.
+ * @param  frames  Number of frames.
+ * @param  cpu     Render with the software rasterizer instead of OpenGL.
+ */
+void run_headless(uint32_t frames, bool cpu)
+{
+    // Circle the room looking at the table
+    cg::CameraPath path = cg::CameraPath::orbit(cg::Point3(0.0f, 0.0f, 20.0f), 70.0f, 15.0f, 8);
+    cg::FrameStats stats;
+
+    if(cpu)
+    {
+        cg::RasterSettings settings;
+        settings.width = static_cast<uint32_t>(g_render_width);
+        settings.height = static_cast<uint32_t>(g_render_height);
+        settings.global_ambient = g_global_ambient;
+
+        cg::SoftwareRasterizer rasterizer;
+        cg::Image              image;
+        rasterizer.set_settings(settings);
+        for(uint32_t i = 0; i < frames; i++)
+        {
+            path.apply(*g_camera, static_cast<float>(i) / static_cast<float>(frames));
+            update_spotlight();
+
+            // Gather each frame since the spotlight follows the camera
+            auto start = std::chrono::steady_clock::now();
+            rasterizer.build(*g_scene_root);
+            rasterizer.render(*g_camera, image);
+            stats.add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        image.write_ppm("headless.ppm");
+        stats.print("Headless (CPU rasterizer)");
+        return;
+    }
+
+    // Offscreen framebuffer with color and depth renderbuffers
+    GLuint fbo, color_rb, depth_rb;
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &color_rb);
+    glGenRenderbuffers(1, &depth_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, g_render_width, g_render_height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, g_render_width, g_render_height);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_rb);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_rb);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "Error creating the offscreen framebuffer\n";
+    }
+    else
+    {
+        for(uint32_t i = 0; i < frames; i++)
+        {
+            path.apply(g_input_camera, static_cast<float>(i) / static_cast<float>(frames));
+            take_snapshot(g_snapshots.get_back());
+            g_snapshots.publish();
+            apply_snapshot(*g_snapshots.acquire());
+            g_snapshots.release();
+
+            auto start = std::chrono::steady_clock::now();
+            draw_scene();
+            glFinish();
+            stats.add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        stats.print("Headless (OpenGL)");
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &depth_rb);
+    glDeleteRenderbuffers(1, &color_rb);
+    glDeleteFramebuffers(1, &fbo);
+}
+
+/**
+ * Stop profiling, print the zone summary and write the zones as a Chrome
+ * trace.
+ * @param  filename  Trace file (nothing is done if null).
+ */
+void write_profile(const char *filename)
+{
+    if(filename == nullptr) return;
+    cg::set_profiling(false);
+    cg::print_profile_summary();
+    if(cg::write_chrome_trace(filename)) std::cout << "Wrote " << filename << '\n';
+}
+
 /**
  * Main
  */
@@ -797,16 +1211,77 @@ int main(int argc, char **argv)
 {
     cg::set_root_paths(argv[0]);
 
+    // Headless benchmark mode: --headless <frames> renders frames offscreen
+    // and reports frame times, --cpu uses the software rasterizer (needs no
+    // display or GPU). --single-thread draws on the event thread. --profile
+    // records zones from startup to exit and writes them as a Chrome trace.
+    uint32_t    headless_frames = 0;
+    bool        headless_cpu = false;
+    const char *profile_filename = nullptr;
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--headless") == 0 && i + 1 < argc)
+        {
+            headless_frames = static_cast<uint32_t>(std::max(atoi(argv[++i]), 1));
+        }
+        else if(strcmp(argv[i], "--cpu") == 0)
+        {
+            headless_cpu = true;
+        }
+        else if(strcmp(argv[i], "--single-thread") == 0)
+        {
+            g_render_thread = false;
+        }
+        else if(strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            profile_filename = argv[++i];
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--single-thread] [--profile <trace.json>] [--headless <frames> [--cpu]]\n";
+            exit(1);
+        }
+    }
+    cg::set_profile_thread_name("update");
+    if(profile_filename != nullptr) cg::set_profiling(true);
+
+    if(headless_frames > 0 && headless_cpu)
+    {
+        g_render_width = 800;
+        g_render_height = 600;
+        construct_scene(false);
+        g_camera->change_aspect_ratio(static_cast<float>(g_render_width) / static_cast<float>(g_render_height));
+        run_headless(headless_frames, true);
+        write_profile(profile_filename);
+        destroy_scene();
+        return 0;
+    }
+
     // Print the keyboard commands
-    std::cout << "i - Reset to initial view\n";
-    std::cout << "R - Roll    5 degrees clockwise   r - Counter-clockwise\n";
-    std::cout << "P - Pitch   5 degrees clockwise   p - Counter-clockwise\n";
-    std::cout << "H - Heading 5 degrees clockwise   h - Counter-clockwise\n";
-    std::cout << "X - Slide camera right            x - Slide camera left\n";
-    std::cout << "Y - Slide camera up               y - Slide camera down\n";
-    std::cout << "F - Move camera forward           f - Move camera backwards\n";
-    std::cout << "V - Faster mouse movement         v - Slower mouse movement\n";
-    std::cout << "ESC - Exit Program\n";
+    if(headless_frames == 0)
+    {
+        std::cout << "i - Reset to initial view\n";
+        std::cout << "R - Roll    5 degrees clockwise   r - Counter-clockwise\n";
+        std::cout << "P - Pitch   5 degrees clockwise   p - Counter-clockwise\n";
+        std::cout << "H - Heading 5 degrees clockwise   h - Counter-clockwise\n";
+        std::cout << "X - Slide camera right            x - Slide camera left\n";
+        std::cout << "Y - Slide camera up               y - Slide camera down\n";
+        std::cout << "F - Move camera forward           f - Move camera backwards\n";
+        std::cout << "V - Faster mouse movement         v - Slower mouse movement\n";
+        std::cout << "C - Draw using render queue       c - Draw by traversing scene graph\n";
+        std::cout << "D - Draw from the scene store     d - Draw as selected by C/c\n";
+        std::cout << "N - Instance shared geometry      n - Draw shared geometry separately\n";
+        std::cout << "U - Enable frustum culling        u - Disable frustum culling\n";
+        std::cout << "s - Report matrix, draw call, culling and frame pacing stats\n";
+        std::cout << "T - Ray trace view to raytrace.ppm t - Rasterize view on the CPU to raster.ppm\n";
+        std::cout << "M - Cycle frame pacing (72 Hz, vsync, unlocked)\n";
+        std::cout << "L - Enable late input latching    l - Disable late input latching\n";
+        std::cout << "Z - Start profiling               z - Stop and write profile.json\n";
+        std::cout << "ESC - Exit Program\n";
+    }
+
+    // Headless OpenGL uses the offscreen video driver (EGL, no display)
+    if(headless_frames > 0) SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
 
     // Initialize SDL
     if(!SDL_Init(SDL_INIT_VIDEO))
@@ -833,6 +1308,7 @@ int main(int argc, char **argv)
         props, SDL_PROP_WINDOW_CREATE_TITLE_STRING, "Simple 3-D Scene by Brian Russin");
     SDL_SetBooleanProperty(props, SDL_PROP_WINDOW_CREATE_RESIZABLE_BOOLEAN, true);
     SDL_SetBooleanProperty(props, SDL_PROP_WINDOW_CREATE_OPENGL_BOOLEAN, true);
+    SDL_SetBooleanProperty(props, SDL_PROP_WINDOW_CREATE_HIDDEN_BOOLEAN, headless_frames > 0);
     SDL_SetNumberProperty(props, SDL_PROP_WINDOW_CREATE_WIDTH_NUMBER, 800);
     SDL_SetNumberProperty(props, SDL_PROP_WINDOW_CREATE_HEIGHT_NUMBER, 600);
     SDL_SetNumberProperty(props, SDL_PROP_WINDOW_CREATE_X_NUMBER, 100);
@@ -865,7 +1341,7 @@ int main(int argc, char **argv)
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
     // Construct scene.
-    construct_scene();
+    construct_scene(true);
 
     // Enable multi-sample anti-aliasing
     glEnable(GL_MULTISAMPLE);
@@ -882,14 +1358,59 @@ int main(int argc, char **argv)
 
     update_view(g_mouse_x, g_mouse_y, g_forward);
 
-    // Main loop
-    while(handle_events())
+    if(headless_frames > 0)
     {
-        if(g_animate) update_view(g_mouse_x, g_mouse_y, g_forward);
-        display();
-        sleep(DRAW_INTERVAL_MILLIS);
+        // Draw as fast as possible (no vsync or sleep)
+        SDL_GL_SetSwapInterval(0);
+        run_headless(headless_frames, false);
     }
 
+    // Main loop (update thread). The pacer waits only for the time left
+    // after each frame. With late latching, events are handled and the view
+    // updated after the wait, so the frame shows the latest input. Each
+    // frame's snapshot is drawn by the render thread, which owns the OpenGL
+    // context from here on, while this thread handles the next frame's input.
+    SDL_GL_SetSwapInterval(0);
+    bool        cont_program = (headless_frames == 0);
+    std::thread renderer;
+    if(cont_program && g_render_thread)
+    {
+        SDL_GL_MakeCurrent(g_sdl_window, nullptr);
+        renderer = std::thread(render_thread);
+    }
+    while(cont_program)
+    {
+        if(!g_late_latch)
+        {
+            cont_program = handle_events();
+            if(g_animate) update_view(g_mouse_x, g_mouse_y, g_forward);
+        }
+        g_frame_pacer.wait_for_next_frame();
+        if(g_late_latch)
+        {
+            cont_program = handle_events();
+            if(g_animate) update_view(g_mouse_x, g_mouse_y, g_forward);
+        }
+        if(!cont_program) break;
+
+        // Publishing waits until the render thread has applied the last snapshot
+        take_snapshot(g_snapshots.get_back());
+        g_snapshots.publish();
+        if(!g_render_thread) render_frame();
+        g_frame_pacer.end_frame();
+    }
+    if(renderer.joinable())
+    {
+        g_snapshots.close();
+        renderer.join();
+        SDL_GL_MakeCurrent(g_sdl_window, g_gl_context);
+    }
+
+    write_profile(profile_filename);
+
+    // Destroy the scene while the context is current
+    destroy_scene();
+
     // Destroy OpenGL Context, SDL Window and SDL
     SDL_GL_DestroyContext(g_gl_context);
     SDL_DestroyWindow(g_sdl_window);
@@ -1,6 +1,7 @@
 #include "torus.hpp"
 
 #include "geometry/geometry.hpp"
+#include "geometry/profiler.hpp"
 
 #include <cmath>
 
@@ -14,6 +15,7 @@ namespace cg
                               int32_t position_loc,
                               int32_t normal_loc)
    {
+      CG_PROFILE_ZONE("TorusSurface::TorusSurface");
       if(ring_radius <= 0.0f || tube_radius <= 0.0f) return;
       
       //basically rotate circle around the z axis
@@ -25,6 +27,7 @@ namespace cg
       float d_phi = (2.0f * PI) / static_cast<float>(num_tube_sides);    // Around the tube
 
       VertexAndNormal vtx;
+      vertices_.reserve(static_cast<size_t>(num_rows_) * num_cols_);
 
       // Generate vertices by iterating around the ring (theta) and tube (phi)
       for(uint32_t i = 0; i < num_ring_sides; i++)
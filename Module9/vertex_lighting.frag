@@ -7,21 +7,15 @@ layout (location = 1) smooth in vec3 frag_normal;    // World space normal
 // Output fragment color
 layout (location = 0) out vec4 frag_color;
 
-// Uniforms for material properties
-uniform vec4   material_ambient;
-uniform vec4   material_diffuse;
-uniform vec4   material_specular;
-uniform vec4   material_emission;
-uniform float  material_shininess;
-
-// Global lighting environment ambient intensity
-uniform vec4  global_light_ambient;
-
-// Global camera position
-uniform vec3  camera_position;
-
-// Uniform to constrain the number of lights the application uses
-uniform int num_lights;
+// Material properties (bound per draw from the material buffer)
+layout (std140) uniform MaterialBlock
+{
+  vec4   material_ambient;
+  vec4   material_diffuse;
+  vec4   material_specular;
+  vec4   material_emission;
+  float  material_shininess;
+};
 
 const int MAX_LIGHTS = 3;  // Increased from 2 to 3 for the spotlight
 struct LightSource
@@ -36,7 +30,16 @@ struct LightSource
   float spot_cutoff;       
   float spot_exponent;     
 };
-uniform LightSource lights[MAX_LIGHTS];
+
+// Per frame state: camera position, number of lights the application uses,
+// global lighting environment ambient intensity and the light sources
+layout (std140) uniform FrameBlock
+{
+  vec3        camera_position;
+  int         num_lights;
+  vec4        global_light_ambient;
+  LightSource lights[MAX_LIGHTS];
+};
 
 // Fragment shader for Phong (per-pixel) lighting with spotlight support
 void main()
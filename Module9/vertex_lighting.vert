@@ -3,9 +3,15 @@
 // Incoming vertex and normal attributes
 // Vertex position attribute
 layout (location = 0) in vec3 vtx_position;
-// Vertex normal attribute
+// Vertex normal attribute (xy holds the octahedral encoded normal for the
+// packed vertex format)
 layout (location = 1) in vec3 vtx_normal;
 
+// Per instance modeling and normal matrices (instanced draws only). Each
+// matrix uses 4 attribute locations.
+layout (location = 2) in mat4 instance_model_matrix;
+layout (location = 6) in mat4 instance_normal_matrix;
+
 // PHONG SHADING: Pass interpolated position and normal to fragment shader
 layout (location = 0) smooth out vec3 frag_position;  // World space position
 layout (location = 1) smooth out vec3 frag_normal;    // World space normal
@@ -15,16 +21,52 @@ uniform mat4 pvm_matrix;     // Composite projection, view, model matrix
 uniform mat4 model_matrix;   // Modeling matrix
 uniform mat4 normal_matrix;  // Normal transformation matrix
 
+// Packed vertex format: positions are 16 bit normalized within the mesh bounds
+// (position = position_offset + position_scale * vtx_position) and normals are
+// octahedral encoded. The float format uses scale 1 and offset 0.
+uniform int  vertex_format;    // 0 = float, 1 = packed
+uniform vec3 position_scale;   // Position dequantization scale
+uniform vec3 position_offset;  // Position dequantization offset
+
+// Instanced draws apply the per instance matrices before the matrix uniforms
+uniform int  instanced;        // 1 for instanced draws
+
+// Sign that treats 0 as positive
+vec2 sign_not_zero(vec2 v)
+{
+  return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Decode an octahedral encoded unit normal
+vec3 decode_octahedral(vec2 e)
+{
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if(n.z < 0.0)
+    n.xy = (1.0 - abs(n.yx)) * sign_not_zero(n.xy);
+  return normalize(n);
+}
+
 // Vertex shader for Phong (per-pixel) lighting
 // Transforms position and normal to world space and passes them to fragment shader
 void main()
 {
+  // Dequantize the position and decode the normal
+  vec3 position = position_offset + position_scale * vtx_position;
+  vec3 normal = (vertex_format == 1) ? decode_octahedral(vtx_normal.xy) : vtx_normal;
+
+  // Apply the instance transforms
+  if(instanced == 1)
+  {
+    position = vec3(instance_model_matrix * vec4(position, 1.0));
+    normal = vec3(instance_normal_matrix * vec4(normal, 0.0));
+  }
+
   // Transform normal to world coords and pass to fragment shader
-  frag_normal = normalize(vec3(normal_matrix * vec4(vtx_normal, 0.0)));
+  frag_normal = normalize(vec3(normal_matrix * vec4(normal, 0.0)));
   
   // Transform position to world coords and pass to fragment shader
-  frag_position = vec3(model_matrix * vec4(vtx_position, 1.0));
+  frag_position = vec3(model_matrix * vec4(position, 1.0));
 
   // Convert position to clip coordinates and pass along
-  gl_Position = pvm_matrix * vec4(vtx_position, 1.0);
+  gl_Position = pvm_matrix * vec4(position, 1.0);
 }
@@ -0,0 +1,116 @@
+#include "benchmark/benchmark.hpp"
+
+#include "geometry/arena.hpp"
+#include "scene/scene.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace cg
+{
+
+namespace
+{
+
+/**
+ * Construct a level of num_props props laid out on a grid, like the prop
+ * scene: 16 props to a group transform and material. Nodes are allocated
+ * from the arena, or with make_shared if arena is nullptr.
+ */
+std::shared_ptr<SceneNode> construct_level(uint32_t num_props, std::shared_ptr<SceneNode> surface, Arena *arena)
+{
+    auto                       root = make_scene_node<SceneNode>(arena);
+    std::shared_ptr<SceneNode> group;
+    for(uint32_t i = 0; i < num_props; i++)
+    {
+        if(i % 16 == 0)
+        {
+            auto material = make_scene_node<PresentationNode>(arena,
+                                                              Color4(0.2f, 0.2f, 0.2f),
+                                                              Color4(0.5f, 0.5f, 0.5f),
+                                                              Color4(0.1f, 0.1f, 0.1f),
+                                                              Color4(0.0f, 0.0f, 0.0f),
+                                                              16.0f);
+            auto group_transform = make_scene_node<TransformNode>(arena);
+            group_transform->translate(static_cast<float>(i % 1024), static_cast<float>(i / 1024), 0.0f);
+            root->add_child(material);
+            material->add_child(group_transform);
+            group = group_transform;
+        }
+
+        auto prop_transform = make_scene_node<TransformNode>(arena);
+        prop_transform->translate(static_cast<float>(i % 16), 0.0f, 0.5f);
+        prop_transform->rotate_z(static_cast<float>(i % 360));
+        prop_transform->add_child(surface);
+        group->add_child(prop_transform);
+    }
+    return root;
+}
+
+// Heap allocations made by f
+template <typename F> AllocationCounts count_allocations(F &&f)
+{
+    AllocationCounts before = get_allocation_counts();
+    f();
+    AllocationCounts after = get_allocation_counts();
+    return {after.count - before.count, after.bytes - before.bytes};
+}
+
+void report_allocations(const char *name, const AllocationCounts &counts)
+{
+    printf("  %-48s %12llu allocations %12llu bytes\n",
+           name,
+           static_cast<unsigned long long>(counts.count),
+           static_cast<unsigned long long>(counts.bytes));
+}
+
+} // namespace
+
+void arena_benchmark()
+{
+    // Scene construction and teardown with make_shared and with a scene arena
+    std::shared_ptr<SceneNode> surface = std::make_shared<UnitSquareSurface>(2, 0, 1);
+    Arena                      arena(1024 * 1024);
+    for(uint32_t num_props : {1000u, 100000u})
+    {
+        printf(" %u props\n", num_props);
+        for(bool use_arena : {false, true})
+        {
+            std::shared_ptr<SceneNode> level;
+            double                     construct_ms = 0.0;
+            AllocationCounts           counts = count_allocations([&]() {
+                construct_ms = time_ms(1, [&]() { level = construct_level(num_props, surface, use_arena ? &arena : nullptr); });
+            });
+            double teardown_ms = time_ms(1, [&]() {
+                level.reset();
+                arena.reset();
+            });
+
+            printf("  %s\n", use_arena ? "scene arena" : "make_shared");
+            report_allocations(" construct", counts);
+            report("  construct", construct_ms, "ms");
+            report("  teardown", teardown_ms, "ms");
+        }
+        report_count(" arena blocks (bytes)", arena.get_bytes_reserved());
+    }
+
+    // Surface (mesh) construction, including the vertex buffers and BVH
+    // inputs kept by each surface
+    printf(" mesh builders\n");
+    std::vector<Point3> profile = {Point3(0.0f, 0.0f, 12.0f),
+                                   Point3(2.5f, 0.0f, 10.0f),
+                                   Point3(4.0f, 0.0f, 6.0f),
+                                   Point3(3.0f, 0.0f, 2.0f),
+                                   Point3(2.0f, 0.0f, 0.0f)};
+    report_allocations(" UnitSquareSurface (32)", count_allocations([]() { UnitSquareSurface s(32, 0, 1); }));
+    report_allocations(" ConicSurface (36, 8)", count_allocations([]() { ConicSurface s(0.5f, 0.5f, 36, 8, 0, 1); }));
+    report_allocations(" SphereSection (36, 72)", count_allocations([]() {
+                           SphereSection s(-90.0f, 90.0f, 36, -180.0f, 180.0f, 72, 1.0f, 0, 1);
+                       }));
+    report_allocations(" SurfaceOfRevolution (5, 36)",
+                       count_allocations([&]() { SurfaceOfRevolution s(profile, 36, 0, 1); }));
+    report_allocations(" MeshTeapot (8)", count_allocations([]() { MeshTeapot s(8, 0, 1); }));
+    report(" MeshTeapot (8) construct", time_ms(1, []() { MeshTeapot s(8, 0, 1); }), "ms");
+}
+
+} // namespace cg
@@ -0,0 +1,186 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    benchmark/benchmark.hpp
+//	Purpose: Timing support and benchmark suite declarations. The benchmark
+//           driver does not create a window or OpenGL context. OpenGL calls
+//           go to the no-op dispatch table so only CPU-side costs are
+//           measured. Build with CMAKE_BUILD_TYPE=Release.
+//
+//============================================================================
+
+#ifndef __BENCHMARK_BENCHMARK_HPP__
+#define __BENCHMARK_BENCHMARK_HPP__
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+namespace cg
+{
+
+class CameraNode;
+class SceneNode;
+
+/**
+ * Run a function repeatedly and return the mean time per call.
+ * @param  iterations  Number of times to call f.
+ * @param  f           Function to time.
+ * @return  Returns the mean time per call in milliseconds.
+ */
+template <typename F> double time_ms(uint32_t iterations, F &&f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t i = 0; i < iterations; i++) f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() /
+           static_cast<double>(iterations);
+}
+
+/**
+ * Print a single benchmark result line.
+ * @param  name   Benchmark name.
+ * @param  value  Measured value.
+ * @param  units  Units of the measured value.
+ */
+inline void report(const char *name, double value, const char *units)
+{
+    printf("  %-48s %12.4f %s\n", name, value, units);
+}
+
+/**
+ * Print a single benchmark count line.
+ * @param  name   Counter name.
+ * @param  count  Counter value.
+ */
+inline void report_count(const char *name, uint64_t count)
+{
+    printf("  %-48s %12llu\n", name, static_cast<unsigned long long>(count));
+}
+
+// Heap allocations made through operator new (all threads) since the
+// benchmark started. The benchmark driver replaces the global operator new
+// to count them.
+struct AllocationCounts
+{
+    uint64_t count; // Number of allocations
+    uint64_t bytes; // Bytes requested
+};
+
+/**
+ * Get the heap allocations made so far. Subtract two counts to get the
+ * allocations made by the code run between them.
+ * @return  Returns the allocation counts.
+ */
+AllocationCounts get_allocation_counts();
+
+// OpenGL calls made (all threads) since the benchmark started, by kind.
+// The benchmark driver replaces the entry points a frame calls to count them.
+struct GLCallCounts
+{
+    uint64_t programs;       // glUseProgram
+    uint64_t vertex_arrays;  // glBindVertexArray
+    uint64_t uniforms;       // glUniform*
+    uint64_t buffer_binds;   // glBindBuffer, glBindBufferBase, glBindBufferRange
+    uint64_t buffer_updates; // glBufferData, glBufferSubData
+    uint64_t draws;          // glDrawElements, glDrawElementsInstanced
+
+    uint64_t total() const { return programs + vertex_arrays + uniforms + buffer_binds + buffer_updates + draws; }
+};
+
+/**
+ * Get the OpenGL calls made so far. Subtract two counts to get the calls
+ * made by the code run between them.
+ * @return  Returns the call counts.
+ */
+GLCallCounts get_gl_call_counts();
+
+/**
+ * Counts the last level cache misses of the calling thread using the
+ * hardware performance counters (Linux perf events). Not available on other
+ * platforms or where the counters are not exposed (many virtual machines).
+ */
+class CacheMissCounter
+{
+  public:
+    /**
+     * Constructor. Opens the counter.
+     */
+    CacheMissCounter();
+
+    /**
+     * Destructor. Closes the counter.
+     */
+    ~CacheMissCounter();
+
+    CacheMissCounter(const CacheMissCounter &) = delete;
+    CacheMissCounter &operator=(const CacheMissCounter &) = delete;
+
+    /**
+     * Check whether cache misses can be counted.
+     * @return  Returns true if the counter is available.
+     */
+    bool is_available() const;
+
+    /**
+     * Reset the count and start counting.
+     */
+    void start();
+
+    /**
+     * Stop counting.
+     * @return  Returns the cache misses since start (0 if not available).
+     */
+    uint64_t stop();
+
+  protected:
+    int fd_;
+};
+
+/**
+ * Construct the scene used by the CPU renderer benchmarks: a floor, a teapot
+ * and a row of spheres with their own materials, lit by a point light and a
+ * spotlight.
+ * @return  Returns the root of the scene.
+ */
+std::shared_ptr<SceneNode> construct_lit_scene();
+
+/**
+ * Set a camera to view the scene from construct_lit_scene (4:3 aspect).
+ * @param  camera  Camera.
+ */
+void set_lit_scene_camera(CameraNode &camera);
+
+// Benchmark suites
+void scene_traversal_benchmark();
+void transform_cache_benchmark();
+void matrix_kernel_benchmark();
+void normal_matrix_benchmark();
+void batch_transform_benchmark();
+void mesh_weld_benchmark();
+void index_format_benchmark();
+void vertex_normal_benchmark();
+void mesh_optimizer_benchmark();
+void vertex_packing_benchmark();
+void instancing_benchmark();
+void frustum_culling_benchmark();
+void bvh_benchmark();
+void triangle_kernel_benchmark();
+void ray_tracer_benchmark();
+void software_rasterizer_benchmark();
+void headless_frame_benchmark();
+void frame_pacing_benchmark();
+void snapshot_benchmark();
+void profiler_benchmark();
+void scene_store_benchmark();
+void arena_benchmark();
+void uniform_buffer_benchmark();
+void gl_state_cache_benchmark();
+
+} // namespace cg
+
+#endif
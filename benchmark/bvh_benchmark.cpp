@@ -0,0 +1,240 @@
+#include "benchmark/benchmark.hpp"
+
+#include "scene/scene.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace cg
+{
+
+namespace
+{
+
+// Rough terrain grid (2 n^2 triangles) with access to the mesh lists
+class TerrainSurface : public TriSurface
+{
+  public:
+    TerrainSurface(uint32_t n)
+    {
+        float spacing = 1.0f / static_cast<float>(n);
+        vertices_.reserve(static_cast<size_t>(n + 1) * (n + 1));
+        for(uint32_t row = 0; row <= n; row++)
+        {
+            for(uint32_t col = 0; col <= n; col++)
+            {
+                float x = static_cast<float>(col) * spacing;
+                float y = static_cast<float>(row) * spacing;
+                float z = 0.05f * std::sin(40.0f * x) * std::cos(30.0f * y) +
+                          0.01f * std::sin(311.0f * x + 173.0f * y);
+                vertices_.push_back(VertexAndNormal(Point3(x, y, z)));
+            }
+        }
+        construct_row_col_face_list(n + 1, n + 1);
+    }
+
+    std::vector<AABB> face_bounds() const
+    {
+        std::vector<AABB> bounds(faces_.size() / 3);
+        for(size_t f = 0; f < bounds.size(); f++)
+        {
+            for(uint32_t k = 0; k < 3; k++) bounds[f].add(vertices_[faces_[f * 3 + k]].vertex);
+        }
+        return bounds;
+    }
+
+    // Nearest hit by testing every triangle
+    float brute_force_intersect(const Ray3 &ray) const
+    {
+        float t = FLT_MAX;
+        for(size_t f = 0; f < faces_.size(); f += 3)
+        {
+            RayTriangleIntersectResult hit = ray.intersect(vertices_[faces_[f]].vertex,
+                                                           vertices_[faces_[f + 1]].vertex,
+                                                           vertices_[faces_[f + 2]].vertex);
+            if(hit.intersects && hit.distance < t) t = hit.distance;
+        }
+        return t;
+    }
+};
+
+// Rays from above the unit square towards random points on it
+std::vector<Ray3> random_terrain_rays(uint32_t count, uint32_t seed)
+{
+    std::mt19937                          gen(seed);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::vector<Ray3>                     rays;
+    rays.reserve(count);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        Point3 from(dist(gen), dist(gen), 1.0f);
+        Point3 to(dist(gen), dist(gen), 0.0f);
+        rays.push_back(Ray3(from, to, true));
+    }
+    return rays;
+}
+
+/**
+ * Construct a grid of spheres, each with its own transform, spread over a
+ * square. Returns the transforms so they can be moved.
+ */
+std::shared_ptr<SceneNode> construct_sphere_scene(uint32_t                                     num_spheres,
+                                                  std::vector<std::shared_ptr<TransformNode>> &transforms)
+{
+    auto root = std::make_shared<SceneNode>();
+    auto sphere = std::make_shared<SphereSection>(-90.0f, 90.0f, 9, -180.0f, 180.0f, 18, 0.4f, 0, 1);
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(num_spheres))));
+    transforms.clear();
+    for(uint32_t i = 0; i < num_spheres; i++)
+    {
+        auto transform = std::make_shared<TransformNode>();
+        transform->translate(static_cast<float>(i % side), static_cast<float>(i / side), 0.0f);
+        transform->add_child(sphere);
+        root->add_child(transform);
+        transforms.push_back(transform);
+    }
+    return root;
+}
+
+} // namespace
+
+void bvh_benchmark()
+{
+    // Triangle BVH over a single mesh
+    for(uint32_t n : {64u, 256u, 724u})
+    {
+        TerrainSurface    terrain(n);
+        std::vector<AABB> bounds = terrain.face_bounds();
+        printf(" mesh: %zu triangles\n", bounds.size());
+
+        BVH      bvh;
+        uint32_t builds = (n > 256) ? 2 : 10;
+        double   build_single = time_ms(builds, [&]() { bvh.build(bounds, false); });
+        double   build_threads = time_ms(builds, [&]() { bvh.build(bounds, true); });
+        double   refit = time_ms(builds, [&]() { bvh.refit(bounds); });
+        report("  build (1 thread)", build_single, "ms");
+        report("  build (all threads)", build_threads, "ms");
+        report("  refit", refit, "ms");
+        report_count("  nodes", bvh.get_nodes().size());
+        report_count("  depth", bvh.get_depth());
+        report("  SAH cost", bvh.get_sah_cost(), "");
+
+        // Ray queries: BVH against testing every triangle. The brute force
+        // test also checks the BVH finds the same nearest hits.
+        terrain.build_bvh();
+        std::vector<Ray3> rays = random_terrain_rays(100000, 7);
+        uint32_t          hits = 0;
+        double            bvh_ms = time_ms(1,
+                                [&]()
+                                {
+                                    for(const auto &ray : rays)
+                                    {
+                                        if(terrain.intersect(ray).intersects) hits++;
+                                    }
+                                });
+        size_t   brute_count = std::min<size_t>(rays.size(), 20000000 / bounds.size());
+        uint32_t mismatches = 0;
+        double   brute_ms = time_ms(1,
+                                  [&]()
+                                  {
+                                      for(size_t i = 0; i < brute_count; i++)
+                                      {
+                                          float t = terrain.brute_force_intersect(rays[i]);
+                                          RayMeshIntersectResult hit = terrain.intersect(rays[i]);
+                                          float bvh_t = hit.intersects ? hit.distance : FLT_MAX;
+                                          if(std::abs(t - bvh_t) > 1.0e-5f) mismatches++;
+                                      }
+                                  });
+        report("  rays/s (BVH)", rays.size() / bvh_ms * 1.0e-3, "Mrays/s");
+        report("  rays/s (every triangle)", brute_count / brute_ms, "Krays/s");
+        report_count("  rays that hit", hits);
+        report_count("  nearest hit mismatches", mismatches);
+    }
+
+    // Two level BVH over scene graph instances
+    for(uint32_t num_spheres : {10000u, 100000u})
+    {
+        std::vector<std::shared_ptr<TransformNode>> transforms;
+        auto                                        root = construct_sphere_scene(num_spheres, transforms);
+        printf(" scene: %u sphere instances\n", num_spheres);
+
+        SceneBVH scene_bvh;
+        double   build_single = time_ms(3, [&]() { scene_bvh.build(*root, false); });
+        double   build_threads = time_ms(3, [&]() { scene_bvh.build(*root, true); });
+
+        // Move every sphere a little, then refit
+        double move = time_ms(1,
+                              [&]()
+                              {
+                                  for(auto &t : transforms) t->translate(0.1f, 0.0f, 0.0f);
+                              });
+        double refit = time_ms(1, [&]() { scene_bvh.refit(*root); });
+        report("  build (1 thread, includes gathering instances)", build_single, "ms");
+        report("  build (all threads)", build_threads, "ms");
+        report("  refit after moving all transforms", refit, "ms");
+        report("  (move transforms)", move, "ms");
+        report_count("  depth", scene_bvh.get_bvh().get_depth());
+
+        // Pick rays from above the scene towards random instances
+        float                                 side = std::ceil(std::sqrt(static_cast<float>(num_spheres)));
+        std::mt19937                          gen(11);
+        std::uniform_real_distribution<float> dist(0.0f, side);
+        std::vector<Ray3>                     rays;
+        for(uint32_t i = 0; i < 100000; i++)
+        {
+            rays.push_back(Ray3(Point3(dist(gen), dist(gen), 10.0f), Point3(dist(gen), dist(gen), 0.0f), true));
+        }
+        uint32_t hits = 0;
+        double   pick_ms = time_ms(1,
+                                 [&]()
+                                 {
+                                     for(const auto &ray : rays)
+                                     {
+                                         if(scene_bvh.intersect(ray).intersects) hits++;
+                                     }
+                                 });
+        report("  pick rays/s", rays.size() / pick_ms * 1.0e-3, "Mrays/s");
+        report_count("  rays that hit", hits);
+
+        // Check some picks against intersecting every instance
+        uint32_t mismatches = 0;
+        for(uint32_t r = 0; r < 100; r++)
+        {
+            float t = FLT_MAX;
+            for(const auto &instance : scene_bvh.get_instances())
+            {
+                RayMeshIntersectResult hit = instance.surface->intersect(instance.inverse_matrix * rays[r], t);
+                if(hit.intersects) t = hit.distance;
+            }
+            ScenePickResult pick = scene_bvh.intersect(rays[r]);
+            if(std::abs((pick.intersects ? pick.distance : FLT_MAX) - t) > 1.0e-4f) mismatches++;
+        }
+        report_count("  nearest hit mismatches (100 rays)", mismatches);
+
+        // Frustum query against testing every instance bound. The frustum
+        // (orthographic) covers a quarter of the scene.
+        Matrix4x4 pv;
+        pv.scale(4.0f / side, 4.0f / side, 0.1f);
+        pv.translate(-0.25f * side, -0.25f * side, 0.0f);
+        Frustum               frustum(pv);
+        std::vector<uint32_t> visible;
+        double                query_ms = time_ms(10, [&]() { scene_bvh.query(frustum, visible); });
+        size_t                linear_visible = 0;
+        double                linear_ms = time_ms(10,
+                                   [&]()
+                                   {
+                                       linear_visible = 0;
+                                       for(const auto &instance : scene_bvh.get_instances())
+                                       {
+                                           if(!frustum.is_outside(instance.world_bound)) linear_visible++;
+                                       }
+                                   });
+        report("  frustum query (BVH)", query_ms, "ms");
+        report("  frustum query (every instance)", linear_ms, "ms");
+        report_count("  visible instances", visible.size());
+        report_count("  visible instances (every instance)", linear_visible);
+    }
+}
+
+} // namespace cg
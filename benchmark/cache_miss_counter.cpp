@@ -0,0 +1,66 @@
+#include "benchmark/benchmark.hpp"
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cg
+{
+
+#if defined(__linux__)
+
+CacheMissCounter::CacheMissCounter()
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+CacheMissCounter::~CacheMissCounter()
+{
+    if(fd_ >= 0) close(fd_);
+}
+
+bool CacheMissCounter::is_available() const { return fd_ >= 0; }
+
+void CacheMissCounter::start()
+{
+    if(fd_ < 0) return;
+    ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+uint64_t CacheMissCounter::stop()
+{
+    if(fd_ < 0) return 0;
+    ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t count = 0;
+    if(read(fd_, &count, sizeof(count)) != sizeof(count)) return 0;
+    return count;
+}
+
+#else
+
+CacheMissCounter::CacheMissCounter() : fd_(-1) {}
+
+CacheMissCounter::~CacheMissCounter() {}
+
+bool CacheMissCounter::is_available() const { return false; }
+
+void CacheMissCounter::start() {}
+
+uint64_t CacheMissCounter::stop() { return 0; }
+
+#endif
+
+} // namespace cg
@@ -0,0 +1,80 @@
+#include "benchmark/benchmark.hpp"
+
+#include "scene/scene.hpp"
+
+#include <chrono>
+
+namespace cg
+{
+
+namespace
+{
+
+double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report_frames(const FrameStats &stats)
+{
+    report_count("  frames", stats.get_count());
+    report("  min", stats.get_min(), "ms");
+    report("  avg", stats.get_mean(), "ms");
+    report("  p99", stats.get_percentile(99.0), "ms");
+    report("  max", stats.get_max(), "ms");
+}
+
+} // namespace
+
+void headless_frame_benchmark()
+{
+    // The camera is the parent of the scene so the draw path sets the view
+    auto camera = std::make_shared<CameraNode>();
+    set_lit_scene_camera(*camera);
+    camera->add_child(construct_lit_scene());
+    auto root = std::make_shared<SceneNode>();
+    root->add_child(camera);
+
+    // Frames along a scripted orbit, as Module9 --headless runs them
+    CameraPath path = CameraPath::orbit(Point3(0.0f, 0.0f, 5.0f), 70.0f, 40.0f, 8);
+
+    // Scene graph draw path through the render queue (OpenGL calls are
+    // no-ops here, so this is the CPU cost of a frame)
+    constexpr uint32_t DRAW_FRAMES = 500;
+    RenderQueue        queue;
+    SceneState         scene_state;
+    FrameStats         draw_stats;
+    for(uint32_t i = 0; i < DRAW_FRAMES; i++)
+    {
+        path.apply(*camera, static_cast<float>(i) / static_cast<float>(DRAW_FRAMES));
+        auto start = std::chrono::steady_clock::now();
+        scene_state.init();
+        queue.draw(*root, scene_state);
+        draw_stats.add(elapsed_ms(start));
+    }
+    printf(" render queue draw (%zu draw records)\n", queue.get_records().size());
+    report_frames(draw_stats);
+
+    // Software rasterizer frames (gathered each frame, as lights may move)
+    constexpr uint32_t RASTER_FRAMES = 24;
+    RasterSettings     settings;
+    settings.width = 320;
+    settings.height = 240;
+    SoftwareRasterizer rasterizer;
+    Image              image;
+    FrameStats         raster_stats;
+    rasterizer.set_settings(settings);
+    for(uint32_t i = 0; i < RASTER_FRAMES; i++)
+    {
+        path.apply(*camera, static_cast<float>(i) / static_cast<float>(RASTER_FRAMES));
+        auto start = std::chrono::steady_clock::now();
+        rasterizer.build(*root);
+        rasterizer.render(*camera, image);
+        raster_stats.add(elapsed_ms(start));
+    }
+    printf(" software rasterizer %ux%u, %u thread(s)\n", settings.width, settings.height,
+           rasterizer.get_stats().threads);
+    report_frames(raster_stats);
+}
+
+} // namespace cg
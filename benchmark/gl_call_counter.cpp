@@ -0,0 +1,67 @@
+#include "benchmark/benchmark.hpp"
+
+#include "scene/graphics.hpp"
+
+#include <atomic>
+
+namespace
+{
+
+std::atomic<uint64_t> g_programs{0};
+std::atomic<uint64_t> g_vertex_arrays{0};
+std::atomic<uint64_t> g_uniforms{0};
+std::atomic<uint64_t> g_buffer_binds{0};
+std::atomic<uint64_t> g_buffer_updates{0};
+std::atomic<uint64_t> g_draws{0};
+
+inline void count(std::atomic<uint64_t> &counter) { counter.fetch_add(1, std::memory_order_relaxed); }
+
+} // namespace
+
+// Counting replacements for the OpenGL entry points a frame calls. They are
+// defined in the executable, so the scene library's calls resolve to them
+// instead of the library's no-op dispatch (there is no context to call).
+void APIENTRY glUseProgram(GLuint) { count(g_programs); }
+
+void APIENTRY glBindVertexArray(GLuint) { count(g_vertex_arrays); }
+
+void APIENTRY glUniform1i(GLint, GLint) { count(g_uniforms); }
+
+void APIENTRY glUniform1f(GLint, GLfloat) { count(g_uniforms); }
+
+void APIENTRY glUniform3f(GLint, GLfloat, GLfloat, GLfloat) { count(g_uniforms); }
+
+void APIENTRY glUniform3fv(GLint, GLsizei, const GLfloat *) { count(g_uniforms); }
+
+void APIENTRY glUniform4fv(GLint, GLsizei, const GLfloat *) { count(g_uniforms); }
+
+void APIENTRY glUniformMatrix4fv(GLint, GLsizei, GLboolean, const GLfloat *) { count(g_uniforms); }
+
+void APIENTRY glBindBuffer(GLenum, GLuint) { count(g_buffer_binds); }
+
+void APIENTRY glBindBufferBase(GLenum, GLuint, GLuint) { count(g_buffer_binds); }
+
+void APIENTRY glBindBufferRange(GLenum, GLuint, GLuint, GLintptr, GLsizeiptr) { count(g_buffer_binds); }
+
+void APIENTRY glBufferData(GLenum, GLsizeiptr, const void *, GLenum) { count(g_buffer_updates); }
+
+void APIENTRY glBufferSubData(GLenum, GLintptr, GLsizeiptr, const void *) { count(g_buffer_updates); }
+
+void APIENTRY glDrawElements(GLenum, GLsizei, GLenum, const GLvoid *) { count(g_draws); }
+
+void APIENTRY glDrawElementsInstanced(GLenum, GLsizei, GLenum, const void *, GLsizei) { count(g_draws); }
+
+namespace cg
+{
+
+GLCallCounts get_gl_call_counts()
+{
+    return {g_programs.load(std::memory_order_relaxed),
+            g_vertex_arrays.load(std::memory_order_relaxed),
+            g_uniforms.load(std::memory_order_relaxed),
+            g_buffer_binds.load(std::memory_order_relaxed),
+            g_buffer_updates.load(std::memory_order_relaxed),
+            g_draws.load(std::memory_order_relaxed)};
+}
+
+} // namespace cg
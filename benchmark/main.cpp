@@ -0,0 +1,148 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    benchmark/main.cpp
+//	Purpose: Benchmark driver. Runs all benchmark suites, or the suites
+//           named on the command line.
+//
+//============================================================================
+
+#include "benchmark/benchmark.hpp"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+namespace
+{
+
+std::atomic<uint64_t> g_allocation_count{0};
+std::atomic<uint64_t> g_allocation_bytes{0};
+
+void *counted_allocate(std::size_t size, std::size_t alignment)
+{
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    g_allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    if(size == 0) size = 1;
+    void *p = (alignment <= alignof(std::max_align_t))
+                  ? malloc(size)
+                  : aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if(p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+} // namespace
+
+// Global operator new replacements that count heap allocations. The array
+// and nothrow forms call these. The sized deletes forward to the unsized ones.
+void *operator new(std::size_t size) { return counted_allocate(size, alignof(std::max_align_t)); }
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return counted_allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete(void *p, std::align_val_t) noexcept { free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { operator delete(p); }
+
+void operator delete[](void *p) noexcept { operator delete(p); }
+
+void operator delete[](void *p, std::size_t) noexcept { operator delete[](p); }
+
+namespace cg
+{
+
+// Simple logging function, should be defined in the cg namespace
+void logmsg(const char *message, ...)
+{
+    // Open file if not already opened
+    static FILE *lfile = NULL;
+    if(lfile == NULL) { lfile = fopen("Benchmark.log", "w"); }
+
+    va_list arg;
+    va_start(arg, message);
+    vfprintf(lfile, message, arg);
+    putc('\n', lfile);
+    fflush(lfile);
+    va_end(arg);
+}
+
+AllocationCounts get_allocation_counts()
+{
+    return {g_allocation_count.load(std::memory_order_relaxed), g_allocation_bytes.load(std::memory_order_relaxed)};
+}
+
+} // namespace cg
+
+struct BenchmarkSuite
+{
+    const char *name;
+    void (*run)();
+};
+
+// Add each benchmark suite to this list
+const BenchmarkSuite g_suites[] = {{"scene", cg::scene_traversal_benchmark},
+                                   {"transform", cg::transform_cache_benchmark},
+                                   {"matrix", cg::matrix_kernel_benchmark},
+                                   {"normal", cg::normal_matrix_benchmark},
+                                   {"batch", cg::batch_transform_benchmark},
+                                   {"weld", cg::mesh_weld_benchmark},
+                                   {"index", cg::index_format_benchmark},
+                                   {"normals", cg::vertex_normal_benchmark},
+                                   {"meshopt", cg::mesh_optimizer_benchmark},
+                                   {"packing", cg::vertex_packing_benchmark},
+                                   {"instancing", cg::instancing_benchmark},
+                                   {"culling", cg::frustum_culling_benchmark},
+                                   {"bvh", cg::bvh_benchmark},
+                                   {"triangle", cg::triangle_kernel_benchmark},
+                                   {"raytrace", cg::ray_tracer_benchmark},
+                                   {"raster", cg::software_rasterizer_benchmark},
+                                   {"frames", cg::headless_frame_benchmark},
+                                   {"pacing", cg::frame_pacing_benchmark},
+                                   {"snapshot", cg::snapshot_benchmark},
+                                   {"profiler", cg::profiler_benchmark},
+                                   {"store", cg::scene_store_benchmark},
+                                   {"arena", cg::arena_benchmark},
+                                   {"uniforms", cg::uniform_buffer_benchmark},
+                                   {"statecache", cg::gl_state_cache_benchmark}};
+
+/**
+ * Main
+ */
+int main(int argc, char **argv)
+{
+    bool ran = false;
+    for(const auto &suite : g_suites)
+    {
+        // Run all suites if none are named, otherwise only the named suites
+        bool selected = (argc < 2);
+        for(int i = 1; i < argc; i++)
+        {
+            if(strcmp(argv[i], suite.name) == 0) selected = true;
+        }
+        if(!selected) continue;
+
+        std::cout << "[" << suite.name << "]\n";
+        suite.run();
+        ran = true;
+    }
+
+    if(!ran)
+    {
+        std::cout << "Usage: " << argv[0] << " [suite ...]\nSuites:";
+        for(const auto &suite : g_suites) std::cout << " " << suite.name;
+        std::cout << '\n';
+        return 1;
+    }
+    return 0;
+}
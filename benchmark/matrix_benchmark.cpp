@@ -0,0 +1,228 @@
+#include "benchmark/benchmark.hpp"
+
+#include "geometry/geometry.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace cg
+{
+
+namespace
+{
+
+constexpr uint32_t MATRIX_COUNT = 4096;
+constexpr uint32_t PASSES = 200;
+
+// Random affine matrices (rotation, non-zero scale, translation), 16 floats each
+std::vector<float> random_matrices(uint32_t count, uint32_t seed)
+{
+    std::mt19937                          gen(seed);
+    std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+    std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+    std::vector<float>                    m(count * 16);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        Matrix4x4 a;
+        a.translate(pos(gen), pos(gen), pos(gen));
+        a.rotate(angle(gen), pos(gen), pos(gen), pos(gen));
+        a.scale(scale(gen), scale(gen), scale(gen));
+        std::copy(a.get(), a.get() + 16, &m[i * 16]);
+    }
+    return m;
+}
+
+// Largest element difference
+float max_error(const std::vector<float> &a, const std::vector<float> &b)
+{
+    float err = 0.0f;
+    for(size_t i = 0; i < a.size(); i++) err = std::max(err, std::abs(a[i] - b[i]));
+    return err;
+}
+
+// Print a maximum error line
+void report_error(const char *name, float err) { printf("  %-48s %12.3e\n", name, err); }
+
+// Operations per second (millions) given the mean time for one pass
+double mops(double pass_ms) { return static_cast<double>(MATRIX_COUNT) / (pass_ms * 1000.0); }
+
+// Random matrices of the given type built with translate/rotate/scale
+std::vector<Matrix4x4> random_typed_matrices(uint32_t count, MatrixType type, uint32_t seed)
+{
+    std::mt19937                          gen(seed);
+    std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+    std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+    std::vector<Matrix4x4>                m(count);
+    for(auto &a : m)
+    {
+        a.translate(pos(gen), pos(gen), pos(gen));
+        a.rotate(angle(gen), pos(gen), pos(gen), pos(gen));
+        if(type == MatrixType::UNIFORM_SCALE)
+        {
+            float s = scale(gen);
+            a.scale(s, s, s);
+        }
+        else if(type != MatrixType::RIGID) a.scale(scale(gen), scale(gen), scale(gen));
+
+        // A general matrix with the same values
+        if(type == MatrixType::GENERAL) a.set_type(MatrixType::GENERAL);
+    }
+    return m;
+}
+
+} // namespace
+
+void normal_matrix_benchmark()
+{
+    const char *names[] = {"rigid", "uniform scale", "affine", "general"};
+    printf(" %u matrices, single thread\n", MATRIX_COUNT);
+    for(MatrixType type : {MatrixType::RIGID, MatrixType::UNIFORM_SCALE, MatrixType::AFFINE})
+    {
+        auto                   m = random_typed_matrices(MATRIX_COUNT, type, 3);
+        std::vector<Matrix4x4> normal(MATRIX_COUNT);
+        std::vector<Matrix4x4> reference(MATRIX_COUNT);
+
+        // General 4x4 inverse transpose (the prior normal matrix computation)
+        double general = time_ms(PASSES,
+                                 [&]()
+                                 {
+                                     for(uint32_t i = 0; i < MATRIX_COUNT; i++)
+                                     {
+                                         Matrix4x4 g = m[i];
+                                         g.set_type(MatrixType::GENERAL);
+                                         reference[i] = g.get_inverse().transpose();
+                                     }
+                                 });
+
+        double specialized = time_ms(PASSES,
+                                     [&]()
+                                     {
+                                         for(uint32_t i = 0; i < MATRIX_COUNT; i++)
+                                         {
+                                             normal[i] = m[i].get_normal_matrix();
+                                         }
+                                     });
+
+        // Compare the upper 3x3 (the only part used to transform normals)
+        float err = 0.0f;
+        for(uint32_t i = 0; i < MATRIX_COUNT; i++)
+        {
+            for(uint32_t r = 0; r < 3; r++)
+            {
+                for(uint32_t c = 0; c < 3; c++)
+                {
+                    err = std::max(err, std::abs(normal[i].m(r, c) - reference[i].m(r, c)));
+                }
+            }
+        }
+
+        printf(" %s\n", names[static_cast<uint32_t>(type)]);
+        report("general inverse transpose", mops(general), "M/s");
+        report("normal matrix", mops(specialized), "M/s");
+        report("speedup", general / specialized, "x");
+        report_error("max error (vs general)", err);
+    }
+}
+
+void matrix_kernel_benchmark()
+{
+    auto a = random_matrices(MATRIX_COUNT, 1);
+    auto b = random_matrices(MATRIX_COUNT, 2);
+
+    std::vector<float> points(MATRIX_COUNT * 4);
+    for(uint32_t i = 0; i < MATRIX_COUNT; i++)
+    {
+        points[i * 4] = static_cast<float>(i);
+        points[i * 4 + 1] = 1.0f;
+        points[i * 4 + 2] = -static_cast<float>(i);
+        points[i * 4 + 3] = 1.0f;
+    }
+
+    // Scalar results are the reference
+    const MatrixKernels *scalar = get_matrix_kernels(SimdLevel::SCALAR);
+    std::vector<float>   ref_mul(MATRIX_COUNT * 16);
+    std::vector<float>   ref_inv(MATRIX_COUNT * 16);
+    for(uint32_t i = 0; i < MATRIX_COUNT * 16; i += 16)
+    {
+        scalar->mul(&a[i], &b[i], &ref_mul[i]);
+        scalar->inverse(&a[i], &ref_inv[i]);
+    }
+
+    printf(" %u matrices, single thread (best: %s)\n", MATRIX_COUNT,
+           get_matrix_kernels(get_best_simd_level())->name);
+
+    for(SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE, SimdLevel::AVX2, SimdLevel::NEON})
+    {
+        const MatrixKernels *k = get_matrix_kernels(level);
+        if(k == nullptr) continue;
+
+        std::vector<float> out(MATRIX_COUNT * 16);
+        std::vector<float> inv(MATRIX_COUNT * 16);
+        std::vector<float> affine_inv(MATRIX_COUNT * 16);
+        std::vector<float> out_points(MATRIX_COUNT * 4);
+
+        double mul = time_ms(PASSES,
+                             [&]()
+                             {
+                                 for(uint32_t i = 0; i < MATRIX_COUNT * 16; i += 16)
+                                 {
+                                     k->mul(&a[i], &b[i], &out[i]);
+                                 }
+                             });
+        float mul_err = max_error(out, ref_mul);
+
+        double inverse = time_ms(PASSES,
+                                 [&]()
+                                 {
+                                     for(uint32_t i = 0; i < MATRIX_COUNT * 16; i += 16)
+                                     {
+                                         k->inverse(&a[i], &inv[i]);
+                                     }
+                                 });
+        float inv_err = max_error(inv, ref_inv);
+
+        double affine = time_ms(PASSES,
+                                [&]()
+                                {
+                                    for(uint32_t i = 0; i < MATRIX_COUNT * 16; i += 16)
+                                    {
+                                        k->affine_inverse(&a[i], &affine_inv[i]);
+                                    }
+                                });
+        float affine_err = max_error(affine_inv, ref_inv);
+
+        double transform = time_ms(PASSES,
+                                   [&]()
+                                   {
+                                       for(uint32_t i = 0; i < MATRIX_COUNT; i++)
+                                       {
+                                           k->transform(&a[i * 16], &points[i * 4], &out_points[i * 4]);
+                                       }
+                                   });
+
+        double transpose = time_ms(PASSES,
+                                   [&]()
+                                   {
+                                       for(uint32_t i = 0; i < MATRIX_COUNT * 16; i += 16)
+                                       {
+                                           k->transpose(&a[i], &out[i]);
+                                       }
+                                   });
+
+        printf(" %s\n", k->name);
+        report("multiply", mops(mul), "M/s");
+        report("inverse", mops(inverse), "M/s");
+        report("affine inverse", mops(affine), "M/s");
+        report("point transform", mops(transform), "M/s");
+        report("transpose", mops(transpose), "M/s");
+        report_error("max error multiply (vs scalar)", mul_err);
+        report_error("max error inverse (vs scalar)", inv_err);
+        report_error("max error affine inverse (vs scalar)", affine_err);
+    }
+}
+
+} // namespace cg
@@ -0,0 +1,344 @@
+#include "benchmark/benchmark.hpp"
+
+#include "geometry/parallel.hpp"
+#include "scene/scene.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace cg
+{
+
+namespace
+{
+
+// Teapot with access to the mesh lists
+class BenchmarkTeapot : public MeshTeapot
+{
+  public:
+    BenchmarkTeapot(uint16_t level) : MeshTeapot(level, 0, 1) {}
+
+    using MeshTeapot::create_vertex_buffers;
+    using MeshTeapot::faces_;
+    using MeshTeapot::vertices_;
+};
+
+// Surface that welds triangles added one at a time
+class WeldSurface : public TriSurface
+{
+  public:
+    using TriSurface::add_vertex;
+    using TriSurface::vertices_;
+};
+
+// Wavy grid surface (2 n^2 triangles)
+class GridSurface : public TriSurface
+{
+  public:
+    GridSurface(uint32_t n)
+    {
+        float spacing = 1.0f / static_cast<float>(n);
+        vertices_.reserve(static_cast<size_t>(n + 1) * (n + 1));
+        for(uint32_t row = 0; row <= n; row++)
+        {
+            for(uint32_t col = 0; col <= n; col++)
+            {
+                float x = static_cast<float>(col) * spacing;
+                float y = static_cast<float>(row) * spacing;
+                vertices_.push_back(VertexAndNormal(
+                    Point3(x, y, 0.05f * std::sin(40.0f * x) * std::cos(30.0f * y))));
+            }
+        }
+        construct_row_col_face_list(n + 1, n + 1);
+    }
+
+    void clear_normals()
+    {
+        for(auto &v : vertices_) v.normal = Vector3(0.0f, 0.0f, 0.0f);
+    }
+
+    using TriSurface::compute_vertex_normals;
+    using TriSurface::faces_;
+    using TriSurface::vertices_;
+};
+
+// Linear search welding (the prior add_vertex implementation)
+size_t linear_weld(const std::vector<Point3> &soup)
+{
+    std::vector<Point3> vertices;
+    for(const auto &p : soup)
+    {
+        bool found = false;
+        for(const auto &v : vertices)
+        {
+            if(p == v)
+            {
+                found = true;
+                break;
+            }
+        }
+        if(!found) vertices.push_back(p);
+    }
+    return vertices.size();
+}
+
+// Size of a type in bytes
+size_t index_size(GLenum type) { return (type == GL_UNSIGNED_INT) ? sizeof(uint32_t) : sizeof(uint16_t); }
+
+} // namespace
+
+void mesh_optimizer_benchmark()
+{
+    // Report ACMR and ATVR for a FIFO cache of 16 and 32 vertices
+    auto report_cache = [](const char *name, const std::vector<uint32_t> &faces, size_t vertex_count)
+    {
+        VertexCacheStats s16 = analyze_vertex_cache(faces, vertex_count, 16);
+        VertexCacheStats s32 = analyze_vertex_cache(faces, vertex_count, 32);
+        printf("  %-36s ACMR %6.3f %6.3f   ATVR %6.3f %6.3f\n", name, s16.acmr, s32.acmr, s16.atvr,
+               s32.atvr);
+    };
+
+    // Optimize a mesh one pass at a time
+    auto optimize = [&](std::vector<uint32_t> &faces, std::vector<VertexAndNormal> &vertices)
+    {
+        printf("  %-36s      (FIFO 16, FIFO 32)\n", "");
+        report_cache("original order", faces, vertices.size());
+        double cache = time_ms(1, [&]() { optimize_vertex_cache(faces, vertices.size()); });
+        report_cache("vertex cache order", faces, vertices.size());
+        double overdraw = time_ms(1, [&]() { optimize_overdraw(faces, vertices); });
+        report_cache("overdraw order", faces, vertices.size());
+        double fetch = time_ms(1, [&]() { optimize_vertex_fetch(faces, vertices); });
+        report_cache("vertex fetch order", faces, vertices.size());
+        report("vertex cache optimization", cache, "ms");
+        report("overdraw optimization", overdraw, "ms");
+        report("vertex fetch optimization", fetch, "ms");
+    };
+
+    // Construct the teapots without optimizing them
+    bool enabled = TriSurface::get_mesh_optimization();
+    TriSurface::set_mesh_optimization(false);
+    for(uint16_t level : {3, 5, 7})
+    {
+        BenchmarkTeapot t(level);
+        printf(" teapot level %u (%zu triangles)\n", level, t.faces_.size() / 3);
+        optimize(t.faces_, t.vertices_);
+    }
+    TriSurface::set_mesh_optimization(enabled);
+
+    for(uint32_t n : {64u, 512u})
+    {
+        GridSurface grid(n);
+        printf(" grid %u x %u (%zu triangles)\n", n, n, grid.faces_.size() / 3);
+        optimize(grid.faces_, grid.vertices_);
+    }
+}
+
+void vertex_normal_benchmark()
+{
+    printf(" %u threads available\n", get_thread_count());
+    for(uint32_t n : {224u, 707u, 2236u})
+    {
+        GridSurface grid(n);
+        printf(" %zu triangles, %zu vertices\n", grid.faces_.size() / 3, grid.vertices_.size());
+
+        double serial = time_ms(1,
+                                [&]()
+                                {
+                                    grid.clear_normals();
+                                    grid.compute_vertex_normals(false);
+                                });
+        std::vector<Vector3> reference;
+        for(const auto &v : grid.vertices_) reference.push_back(v.normal);
+
+        double parallel = time_ms(1,
+                                  [&]()
+                                  {
+                                      grid.clear_normals();
+                                      grid.compute_vertex_normals(true);
+                                  });
+        std::vector<Vector3> threaded;
+        float                max_error = 0.0f;
+        for(size_t i = 0; i < reference.size(); i++)
+        {
+            threaded.push_back(grid.vertices_[i].normal);
+            max_error = std::max(max_error, (grid.vertices_[i].normal - reference[i]).norm());
+        }
+
+        // Threaded results are the same on every run
+        grid.clear_normals();
+        grid.compute_vertex_normals(true);
+        size_t mismatches = 0;
+        for(size_t i = 0; i < threaded.size(); i++)
+        {
+            if(!(grid.vertices_[i].normal == threaded[i])) mismatches++;
+        }
+
+        report("uniform, single thread", serial, "ms");
+        report("uniform, threaded", parallel, "ms");
+        report("speedup", serial / parallel, "x");
+        printf("  %-48s %12.3e\n", "max error (vs single thread)", max_error);
+        report_count("vertices differing between threaded runs", mismatches);
+
+        grid.set_normal_weighting(NormalWeighting::AREA);
+        report("area weighted, threaded", time_ms(1,
+                                                  [&]()
+                                                  {
+                                                      grid.clear_normals();
+                                                      grid.compute_vertex_normals(true);
+                                                  }),
+               "ms");
+        grid.set_normal_weighting(NormalWeighting::ANGLE);
+        report("angle weighted, threaded", time_ms(1,
+                                                   [&]()
+                                                   {
+                                                       grid.clear_normals();
+                                                       grid.compute_vertex_normals(true);
+                                                   }),
+               "ms");
+    }
+}
+
+void index_format_benchmark()
+{
+    for(uint16_t level = 4; level <= 8; level++)
+    {
+        BenchmarkTeapot t(level);
+        size_t          index_count = t.faces_.size();
+        printf(" teapot level %u (%zu triangles, %zu vertices)\n", level, index_count / 3,
+               t.vertices_.size());
+
+        printf("  %-48s %12s\n", "auto index type",
+               (t.get_index_type() == GL_UNSIGNED_INT) ? "uint32" : "uint16");
+        report("auto index buffer", index_count * index_size(t.get_index_type()) / 1024.0, "KB");
+        report("uint32 index buffer", index_count * sizeof(uint32_t) / 1024.0, "KB");
+
+        // uint16 only: split into submeshes
+        t.set_index_format(IndexFormat::UINT16);
+        double split = time_ms(1, [&]() { t.create_vertex_buffers(0, 1); });
+        report("uint16 index buffer (split)", index_count * sizeof(uint16_t) / 1024.0, "KB");
+        report_count("uint16 submeshes", t.get_submesh_count());
+        report("create buffers (uint16 split)", split, "ms");
+    }
+}
+
+void vertex_packing_benchmark()
+{
+    // Memory use of the float and packed vertex buffers and the error of the packed vertices
+    auto report_packing = [](TriSurface &surface, const std::vector<VertexAndNormal> &vertices)
+    {
+        surface.set_vertex_format(VertexFormat::FLOAT);
+        surface.create_vertex_buffers(0, 1);
+        size_t float_size = surface.get_vertex_buffer_size();
+        surface.set_vertex_format(VertexFormat::PACKED);
+        double create = time_ms(1, [&]() { surface.create_vertex_buffers(0, 1); });
+        size_t packed_size = surface.get_vertex_buffer_size();
+
+        // Same quantization as the vertex buffer (single submesh)
+        std::vector<PackedVertexAndNormal> packed;
+        pack_vertices(vertices, surface.get_vertex_quantization(), packed);
+        PackingError   error = get_packing_error(vertices, surface.get_vertex_quantization(), packed);
+        const Vector3 &scale = surface.get_vertex_quantization().scale;
+        float          extent = std::max(scale.x, std::max(scale.y, scale.z));
+
+        report("float vertex buffer", float_size / 1024.0, "KB");
+        report("packed vertex buffer", packed_size / 1024.0, "KB");
+        report("index buffer", surface.get_index_buffer_size() / 1024.0, "KB");
+        report("total (float)", (float_size + surface.get_index_buffer_size()) / 1024.0, "KB");
+        report("total (packed)", (packed_size + surface.get_index_buffer_size()) / 1024.0, "KB");
+        report("max position error", 1.0e6 * error.max_position_error / extent, "ppm of extent");
+        report("max normal error", error.max_normal_error, "deg");
+        report("create buffers (packed)", create, "ms");
+    };
+
+    for(uint16_t level : {4, 6, 7})
+    {
+        BenchmarkTeapot t(level);
+        printf(" teapot level %u (%zu triangles, %zu vertices)\n", level, t.faces_.size() / 3,
+               t.vertices_.size());
+        report_packing(t, t.vertices_);
+    }
+
+    GridSurface grid(255);
+    grid.compute_vertex_normals();
+    printf(" grid 255 x 255 (%zu triangles, %zu vertices)\n", grid.faces_.size() / 3,
+           grid.vertices_.size());
+    report_packing(grid, grid.vertices_);
+}
+
+void mesh_weld_benchmark()
+{
+    for(uint16_t level = 1; level <= 5; level++)
+    {
+        size_t vertex_count = 0;
+        size_t face_count = 0;
+        double teapot = time_ms(5,
+                                [&]()
+                                {
+                                    BenchmarkTeapot t(level);
+                                    vertex_count = t.vertices_.size();
+                                    face_count = t.faces_.size() / 3;
+                                });
+
+        // Unindexed triangle list of the teapot (3 vertices per triangle)
+        std::vector<Point3> soup;
+        {
+            BenchmarkTeapot t(level);
+            for(uint32_t i : t.faces_) soup.push_back(t.vertices_[i].vertex);
+        }
+
+        size_t hashed_count = 0;
+        double hashed = time_ms(5,
+                                [&]()
+                                {
+                                    WeldSurface s;
+                                    for(const auto &p : soup) s.add_vertex(p);
+                                    hashed_count = s.vertices_.size();
+                                });
+
+        size_t linear_count = 0;
+        double linear = time_ms(1, [&]() { linear_count = linear_weld(soup); });
+
+        printf(" teapot level %u (%zu triangles)\n", level, face_count);
+        report("teapot construction", teapot, "ms");
+        report_count("teapot vertices", vertex_count);
+        report("weld triangle list (hash)", hashed, "ms");
+        report("weld triangle list (linear search)", linear, "ms");
+        report("speedup", linear / hashed, "x");
+        report_count("welded vertices (hash)", hashed_count);
+        report_count("welded vertices (linear search)", linear_count);
+    }
+
+    // Welding with a tolerance merges vertices that differ by round-off
+    std::vector<Point3> jittered;
+    {
+        BenchmarkTeapot t(5);
+        uint32_t        n = 0;
+        for(uint32_t i : t.faces_)
+        {
+            Point3 p = t.vertices_[i].vertex;
+            float  jitter = static_cast<float>(n++ % 7) * 1.0e-6f;
+            jittered.push_back(Point3(p.x + jitter, p.y - jitter, p.z + jitter));
+        }
+    }
+    size_t exact_count = 0;
+    size_t tolerance_count = 0;
+    double tolerance = time_ms(5,
+                               [&]()
+                               {
+                                   WeldSurface exact;
+                                   for(const auto &p : jittered) exact.add_vertex(p);
+                                   exact_count = exact.vertices_.size();
+
+                                   WeldSurface s;
+                                   s.set_weld_tolerance(1.0e-4f);
+                                   for(const auto &p : jittered) s.add_vertex(p);
+                                   tolerance_count = s.vertices_.size();
+                               });
+    printf(" teapot level 5, jittered positions\n");
+    report("weld exact + weld with tolerance 1e-4", tolerance, "ms");
+    report_count("welded vertices (exact)", exact_count);
+    report_count("welded vertices (tolerance 1e-4)", tolerance_count);
+}
+
+} // namespace cg
@@ -0,0 +1,74 @@
+#include "benchmark/benchmark.hpp"
+
+#include "scene/scene.hpp"
+
+#include <chrono>
+#include <thread>
+
+namespace cg
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Busy work standing in for drawing a frame
+void simulate_work(double ms)
+{
+    auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+    while(Clock::now() < end) {}
+}
+
+// Frame work that varies between frames (0.5 to 1.5 times the mean)
+double work_ms(uint32_t frame, double mean) { return mean * (0.5 + static_cast<double>((frame * 7) % 11) / 10.0); }
+
+void report_pacing(const FrameStats &intervals)
+{
+    report("  achieved rate", 1000.0 / intervals.get_mean(), "Hz");
+    report("  mean interval", intervals.get_mean(), "ms");
+    report("  p99 interval", intervals.get_percentile(99.0), "ms");
+    report("  max interval", intervals.get_max(), "ms");
+}
+
+} // namespace
+
+void frame_pacing_benchmark()
+{
+    constexpr double   RATE = 72.0;
+    constexpr uint32_t FRAMES = 144;
+    constexpr double   WORK_MS = 4.0;
+    printf(" %.0f Hz target, %u frames of %.1f ms mean work\n", RATE, FRAMES, WORK_MS);
+
+    // Old main loop: a fixed sleep after every frame, whatever the frame took
+    const int32_t interval_ms = static_cast<int32_t>(1000.0 / RATE);
+    FrameStats    sleep_intervals;
+    auto          last = Clock::now();
+    for(uint32_t i = 0; i < FRAMES; i++)
+    {
+        simulate_work(work_ms(i, WORK_MS));
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        auto now = Clock::now();
+        sleep_intervals.add(std::chrono::duration<double, std::milli>(now - last).count());
+        last = now;
+    }
+    printf(" fixed sleep after each frame\n");
+    report_pacing(sleep_intervals);
+
+    // Frame pacer: sleep for the remainder of the interval, then spin
+    for(double spin_ms : {0.0, 1.0})
+    {
+        FramePacer pacer(RATE);
+        pacer.set_spin_time(spin_ms);
+        for(uint32_t i = 0; i < FRAMES; i++)
+        {
+            pacer.wait_for_next_frame();
+            simulate_work(work_ms(i, WORK_MS));
+            pacer.end_frame();
+        }
+        printf(" frame pacer, %.1f ms spin\n", spin_ms);
+        report_pacing(pacer.get_frame_times());
+    }
+}
+
+} // namespace cg
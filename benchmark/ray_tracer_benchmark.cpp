@@ -0,0 +1,140 @@
+#include "benchmark/benchmark.hpp"
+
+#include "scene/scene.hpp"
+
+#include <memory>
+
+namespace cg
+{
+
+namespace
+{
+
+// Light that adds itself to the gathered scene (like Module9's LightNode)
+class GatherLight : public SceneNode
+{
+  public:
+    GatherLight(const SceneLight &light) : light_(light) {}
+
+    void gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix) override
+    {
+        gather.lights.push_back(light_);
+        SceneNode::gather_instances(gather, model_matrix);
+    }
+
+  protected:
+    SceneLight light_;
+};
+
+std::shared_ptr<PresentationNode> material(const Color4 &diffuse, float shininess)
+{
+    auto node = std::make_shared<PresentationNode>();
+    node->set_material_ambient_and_diffuse(diffuse);
+    node->set_material_specular(Color4(0.5f, 0.5f, 0.5f, 1.0f));
+    node->set_material_shininess(shininess);
+    return node;
+}
+
+} // namespace
+
+std::shared_ptr<SceneNode> construct_lit_scene()
+{
+    SceneLight point = {true,
+                        false,
+                        HPoint3(-20.0f, -30.0f, 60.0f, 1.0f),
+                        Color4(0.0f, 0.0f, 0.0f, 1.0f),
+                        Color4(0.8f, 0.8f, 0.8f, 1.0f),
+                        Color4(0.8f, 0.8f, 0.8f, 1.0f),
+                        Vector3(0.0f, 0.0f, -1.0f),
+                        180.0f,
+                        0.0f};
+    SceneLight spot = {true,
+                       true,
+                       HPoint3(30.0f, 0.0f, 40.0f, 1.0f),
+                       Color4(0.0f, 0.0f, 0.0f, 1.0f),
+                       Color4(0.6f, 0.6f, 0.4f, 1.0f),
+                       Color4(0.6f, 0.6f, 0.4f, 1.0f),
+                       Vector3(-0.6f, 0.0f, -0.8f),
+                       30.0f,
+                       8.0f};
+    auto root = std::make_shared<GatherLight>(point);
+    auto spot_node = std::make_shared<GatherLight>(spot);
+    root->add_child(spot_node);
+
+    // Floor
+    auto floor_material = material(Color4(0.6f, 0.6f, 0.6f, 1.0f), 10.0f);
+    auto floor_transform = std::make_shared<TransformNode>();
+    floor_transform->scale(100.0f, 100.0f, 1.0f);
+    floor_transform->add_child(std::make_shared<UnitSquareSurface>(8, 0, 1));
+    floor_material->add_child(floor_transform);
+    spot_node->add_child(floor_material);
+
+    // Teapot
+    auto teapot_material = material(Color4(0.7f, 0.3f, 0.1f, 1.0f), 40.0f);
+    auto teapot_transform = std::make_shared<TransformNode>();
+    teapot_transform->scale(8.0f, 8.0f, 8.0f);
+    teapot_transform->add_child(std::make_shared<MeshTeapot>(4, 0, 1));
+    teapot_material->add_child(teapot_transform);
+    spot_node->add_child(teapot_material);
+
+    // Spheres (one shared surface)
+    auto sphere = std::make_shared<SphereSection>(-90.0f, 90.0f, 36, -180.0f, 180.0f, 72, 1.0f, 0, 1);
+    auto sphere_material = material(Color4(0.2f, 0.3f, 0.8f, 1.0f), 80.0f);
+    for(int32_t i = 0; i < 5; i++)
+    {
+        auto transform = std::make_shared<TransformNode>();
+        transform->translate(-30.0f + 15.0f * static_cast<float>(i), 25.0f, 5.0f);
+        transform->scale(5.0f, 5.0f, 5.0f);
+        transform->add_child(sphere);
+        sphere_material->add_child(transform);
+    }
+    spot_node->add_child(sphere_material);
+    return root;
+}
+
+void set_lit_scene_camera(CameraNode &camera)
+{
+    camera.set_position(Point3(0.0f, -80.0f, 50.0f));
+    camera.set_look_at_pt(Point3(0.0f, 0.0f, 5.0f));
+    camera.set_view_up(Vector3(0.0f, 0.0f, 1.0f));
+    camera.set_perspective(50.0f, 4.0f / 3.0f, 1.0f, 500.0f);
+}
+
+void ray_tracer_benchmark()
+{
+    auto       root = construct_lit_scene();
+    CameraNode camera;
+    set_lit_scene_camera(camera);
+
+    RayTraceSettings settings;
+    settings.width = 320;
+    settings.height = 240;
+
+    RayTracer tracer;
+    Image     image;
+    tracer.set_settings(settings);
+    double build_ms = time_ms(1, [&]() { tracer.build(*root); });
+    printf(" %zu instances, %zu lights, %ux%u pixels\n", tracer.get_scene().get_instances().size(),
+           tracer.get_scene().get_lights().size(), settings.width, settings.height);
+    report("  build (gather and BVHs)", build_ms, "ms");
+
+    // One thread against all hardware threads, with and without shadows
+    for(bool shadows : {false, true})
+    {
+        for(uint32_t max_threads : {1u, 0u})
+        {
+            settings.shadows = shadows;
+            settings.max_threads = max_threads;
+            tracer.set_settings(settings);
+            tracer.render(camera, image);
+            const RayTraceStats &stats = tracer.get_stats();
+            printf(" %s, %u thread(s)\n", shadows ? "shadows" : "no shadows", stats.threads);
+            report("  render", stats.render_ms, "ms");
+            report("  rays/s", (stats.primary_rays + stats.shadow_rays) / stats.render_ms * 1.0e-3, "Mrays/s");
+            report_count("  shadow rays", stats.shadow_rays);
+            report_count("  tiles", stats.tiles);
+        }
+    }
+}
+
+} // namespace cg
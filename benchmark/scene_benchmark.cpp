@@ -0,0 +1,429 @@
+#include "benchmark/benchmark.hpp"
+
+#include "geometry/geometry.hpp"
+#include "geometry/profiler.hpp"
+#include "scene/scene.hpp"
+
+#include <memory>
+
+namespace cg
+{
+
+namespace
+{
+
+// Shader node that does not load a program (no OpenGL context). Optionally
+// reports instancing support (placeholder locations).
+class BenchmarkShaderNode : public ShaderNode
+{
+  public:
+    BenchmarkShaderNode(bool instancing = false) : instancing_(instancing) {}
+
+    bool get_locations() override { return true; }
+
+    void draw(SceneState &scene_state) override
+    {
+        apply_state(scene_state);
+        SceneNode::draw(scene_state);
+    }
+
+    void apply_state(SceneState &scene_state) override
+    {
+        ShaderNode::apply_state(scene_state);
+        if(instancing_)
+        {
+            scene_state.instanced_loc = 0;
+            scene_state.instance_model_loc = 2;
+            scene_state.instance_normal_loc = 6;
+        }
+    }
+
+  private:
+    bool instancing_;
+};
+
+/**
+ * Construct a scene with num_props props laid out on a grid. Props are grouped
+ * 16 to a group transform, and each group shares one material.
+ */
+std::shared_ptr<SceneNode> construct_prop_scene(uint32_t                    num_props,
+                                                std::shared_ptr<CameraNode> camera,
+                                                bool                        instancing = false)
+{
+    auto shader = std::make_shared<BenchmarkShaderNode>(instancing);
+    camera->set_position(Point3(0.0f, -100.0f, 20.0f));
+    camera->set_look_at_pt(Point3(0.0f, 0.0f, 20.0f));
+    camera->set_view_up(Vector3(0.0f, 0.0f, 1.0f));
+    camera->set_perspective(50.0f, 1.0f, 1.0f, 300.0f);
+    shader->add_child(camera);
+
+    auto unit_square = std::make_shared<UnitSquareSurface>(2, 0, 1);
+
+    std::shared_ptr<SceneNode> group;
+    for(uint32_t i = 0; i < num_props; i++)
+    {
+        if(i % 16 == 0)
+        {
+            auto group_transform = std::make_shared<TransformNode>();
+            group_transform->translate(static_cast<float>(i % 1024), static_cast<float>(i / 1024), 0.0f);
+            auto material = std::make_shared<PresentationNode>(Color4(0.2f, 0.2f, 0.2f),
+                                                               Color4(0.5f, 0.5f, 0.5f),
+                                                               Color4(0.1f, 0.1f, 0.1f),
+                                                               Color4(0.0f, 0.0f, 0.0f),
+                                                               16.0f);
+            camera->add_child(material);
+            material->add_child(group_transform);
+            group = group_transform;
+        }
+
+        auto prop_transform = std::make_shared<TransformNode>();
+        prop_transform->translate(static_cast<float>(i % 16), 0.0f, 0.5f);
+        prop_transform->rotate_z(static_cast<float>(i % 360));
+        prop_transform->scale(0.5f, 0.5f, 1.0f);
+        prop_transform->add_child(unit_square);
+        group->add_child(prop_transform);
+    }
+    return shader;
+}
+
+/**
+ * Construct the prop scene using one instanced geometry node for all props.
+ */
+std::shared_ptr<SceneNode> construct_instanced_prop_scene(uint32_t num_props, std::shared_ptr<CameraNode> camera)
+{
+    auto shader = std::make_shared<BenchmarkShaderNode>(true);
+    camera->set_position(Point3(0.0f, -100.0f, 20.0f));
+    camera->set_look_at_pt(Point3(0.0f, 0.0f, 20.0f));
+    camera->set_view_up(Vector3(0.0f, 0.0f, 1.0f));
+    camera->set_perspective(50.0f, 1.0f, 1.0f, 300.0f);
+    shader->add_child(camera);
+
+    auto material = std::make_shared<PresentationNode>(Color4(0.2f, 0.2f, 0.2f),
+                                                       Color4(0.5f, 0.5f, 0.5f),
+                                                       Color4(0.1f, 0.1f, 0.1f),
+                                                       Color4(0.0f, 0.0f, 0.0f),
+                                                       16.0f);
+    auto props = std::make_shared<InstancedGeometryNode>(std::make_shared<UnitSquareSurface>(2, 0, 1));
+    camera->add_child(material);
+    material->add_child(props);
+    for(uint32_t i = 0; i < num_props; i++)
+    {
+        Matrix4x4 m;
+        m.translate(static_cast<float>(i % 1024 + i % 16), static_cast<float>(i / 1024), 0.5f);
+        m.rotate_z(static_cast<float>(i % 360));
+        m.scale(0.5f, 0.5f, 1.0f);
+        props->add_instance(m);
+    }
+    return shader;
+}
+
+void report_counters(const TransformCounters &counters)
+{
+    report_count("  world matrix updates", counters.world_updates);
+    report_count("  normal matrix updates", counters.normal_updates);
+    report_count("  pvm matrix updates", counters.pvm_updates);
+}
+
+} // namespace
+
+void scene_traversal_benchmark()
+{
+    for(uint32_t num_props : {1000u, 10000u, 100000u})
+    {
+        auto        root = construct_prop_scene(num_props, std::make_shared<CameraNode>());
+        SceneState  scene_state;
+        RenderQueue queue;
+        uint32_t    frames = (num_props >= 100000) ? 10 : 100;
+
+        double compile = time_ms(1, [&]() { queue.compile(*root, scene_state); });
+        printf(" %u props\n", num_props);
+        report("render queue compile", compile, "ms");
+
+        for(bool culling : {false, true})
+        {
+            scene_state.frustum_culling = culling;
+            double traverse = time_ms(frames,
+                                      [&]()
+                                      {
+                                          scene_state.init();
+                                          root->draw(scene_state);
+                                      });
+            double queued = time_ms(frames,
+                                    [&]()
+                                    {
+                                        scene_state.init();
+                                        queue.draw(*root, scene_state);
+                                    });
+
+            // Heap allocations once the timed frames have warmed up the scene
+            // state (should be none)
+            AllocationCounts before = get_allocation_counts();
+            scene_state.init();
+            root->draw(scene_state);
+            AllocationCounts after_traverse = get_allocation_counts();
+            scene_state.init();
+            queue.draw(*root, scene_state);
+            AllocationCounts after_queued = get_allocation_counts();
+
+            printf("  %s\n", culling ? "frustum culling" : "no culling");
+            report("   scene graph traversal (per frame)", traverse, "ms");
+            report("   render queue draw (per frame)", queued, "ms");
+            report("   speedup", traverse / queued, "x");
+            report_count("   traversal heap allocations (per frame)", after_traverse.count - before.count);
+            report_count("   render queue heap allocations (per frame)", after_queued.count - after_traverse.count);
+        }
+    }
+}
+
+void instancing_benchmark()
+{
+    for(uint32_t num_props : {1000u, 10000u, 100000u})
+    {
+        uint32_t frames = (num_props >= 100000) ? 10 : 100;
+        printf(" %u props\n", num_props);
+
+        // Render queue draw of a scene graph with a shared leaf, with and
+        // without merging the shared leaf into instanced draws
+        for(bool merge : {false, true})
+        {
+            auto        root = construct_prop_scene(num_props, std::make_shared<CameraNode>(), true);
+            SceneState  scene_state;
+            RenderQueue queue;
+            queue.set_instancing(merge);
+            double compile = time_ms(1, [&]() { queue.compile(*root, scene_state); });
+            double draw = time_ms(frames,
+                                  [&]()
+                                  {
+                                      scene_state.init();
+                                      queue.draw(*root, scene_state);
+                                  });
+            printf("  %s\n", merge ? "shared leaf, merged into instanced draws" : "shared leaf, one draw per prop");
+            report_count("   draw calls", queue.get_records().size());
+            report("   render queue compile", compile, "ms");
+            report("   render queue draw (per frame)", draw, "ms");
+        }
+
+        // Instanced geometry node holding all props
+        auto        root = construct_instanced_prop_scene(num_props, std::make_shared<CameraNode>());
+        SceneState  scene_state;
+        RenderQueue queue;
+        double      traverse = time_ms(frames,
+                                  [&]()
+                                  {
+                                      scene_state.init();
+                                      root->draw(scene_state);
+                                  });
+        double      compile = time_ms(1, [&]() { queue.compile(*root, scene_state); });
+        double      draw = time_ms(frames,
+                              [&]()
+                              {
+                                  scene_state.init();
+                                  queue.draw(*root, scene_state);
+                              });
+        printf("  instanced geometry node\n");
+        report_count("   draw calls", queue.get_records().size());
+        report("   scene graph traversal (per frame)", traverse, "ms");
+        report("   render queue compile", compile, "ms");
+        report("   render queue draw (per frame)", draw, "ms");
+    }
+}
+
+void frustum_culling_benchmark()
+{
+    for(uint32_t num_props : {1000u, 10000u, 100000u})
+    {
+        auto        root = construct_prop_scene(num_props, std::make_shared<CameraNode>());
+        SceneState  scene_state;
+        RenderQueue queue;
+        uint32_t    frames = (num_props >= 100000) ? 10 : 100;
+        printf(" %u props\n", num_props);
+
+        for(bool culling : {false, true})
+        {
+            scene_state.frustum_culling = culling;
+            double traverse = time_ms(frames,
+                                      [&]()
+                                      {
+                                          scene_state.init();
+                                          root->draw(scene_state);
+                                      });
+            CullingCounters traverse_counters = scene_state.culling_counters;
+
+            double queued = time_ms(frames,
+                                    [&]()
+                                    {
+                                        scene_state.init();
+                                        queue.draw(*root, scene_state);
+                                    });
+            CullingCounters queue_counters = scene_state.culling_counters;
+
+            printf("  %s\n", culling ? "frustum culling" : "no culling");
+            report("   scene graph traversal (per frame)", traverse, "ms");
+            report_count("   nodes tested", traverse_counters.nodes_tested);
+            report_count("   nodes culled", traverse_counters.nodes_culled);
+            report("   render queue draw (per frame)", queued, "ms");
+            report_count("   ranges and records tested", queue_counters.nodes_tested);
+            report_count("   ranges and records culled", queue_counters.nodes_culled);
+        }
+    }
+}
+
+void transform_cache_benchmark()
+{
+    for(uint32_t num_props : {1000u, 10000u, 100000u})
+    {
+        auto       camera = std::make_shared<CameraNode>();
+        auto       root = construct_prop_scene(num_props, camera);
+        SceneState scene_state;
+        uint32_t   frames = (num_props >= 100000) ? 10 : 100;
+
+        // First frame computes every matrix
+        double first = time_ms(1,
+                               [&]()
+                               {
+                                   scene_state.init();
+                                   root->draw(scene_state);
+                               });
+        TransformCounters first_counters = scene_state.transform_counters;
+
+        // Static scene: nothing is recomputed
+        double still = time_ms(frames,
+                               [&]()
+                               {
+                                   scene_state.init();
+                                   root->draw(scene_state);
+                               });
+        TransformCounters still_counters = scene_state.transform_counters;
+
+        // Moving camera: only the composite PVM matrices are recomputed
+        double moving = time_ms(frames,
+                                [&]()
+                                {
+                                    camera->heading(0.1f);
+                                    scene_state.init();
+                                    root->draw(scene_state);
+                                });
+        TransformCounters moving_counters = scene_state.transform_counters;
+
+        printf(" %u props\n", num_props);
+        report("first frame", first, "ms");
+        report_counters(first_counters);
+        report("static frame", still, "ms");
+        report_counters(still_counters);
+        report("moving camera frame", moving, "ms");
+        report_counters(moving_counters);
+    }
+}
+
+void profiler_benchmark()
+{
+    // Cost of an empty zone (two nested zones per iteration)
+    constexpr uint32_t ZONES = 1000000;
+    for(bool enable : {false, true})
+    {
+        set_profiling(enable);
+        clear_profile();
+        double ms = time_ms(1,
+                            [&]()
+                            {
+                                for(uint32_t i = 0; i < ZONES / 2; i++)
+                                {
+                                    CG_PROFILE_ZONE("outer");
+                                    CG_PROFILE_ZONE("inner");
+                                }
+                            });
+        report(enable ? "empty zone, profiling on" : "empty zone, profiling off", ms / ZONES * 1.0e6, "ns");
+    }
+    set_profiling(false);
+#if !CG_PROFILER
+    printf(" zones compiled out (CG_PROFILER=OFF)\n");
+#endif
+
+    // Scene graph traversal (zones in each node's draw)
+    for(uint32_t num_props : {1000u, 10000u})
+    {
+        auto       root = construct_prop_scene(num_props, std::make_shared<CameraNode>());
+        SceneState scene_state;
+        uint32_t   frames = 50;
+        auto       frame = [&]()
+        {
+            scene_state.init();
+            scene_state.frustum_culling = false;
+            root->draw(scene_state);
+        };
+
+        frame();
+        double off = time_ms(frames, frame);
+        set_profiling(true);
+        double on = time_ms(frames, frame);
+
+        // Zones in one frame
+        std::vector<std::vector<ProfileEvent>> events;
+        clear_profile();
+        frame();
+        size_t zones = copy_profile(events);
+        set_profiling(false);
+
+        printf(" %u props\n", num_props);
+        report("  traversal, profiling off", off, "ms");
+        report("  traversal, profiling on", on, "ms");
+        report_count("  zones per frame", zones);
+        if(zones > 0) report("  overhead per zone", (on - off) / static_cast<double>(zones) * 1.0e6, "ns");
+    }
+    clear_profile();
+}
+
+void scene_store_benchmark()
+{
+    CacheMissCounter misses;
+    if(!misses.is_available()) printf(" cache misses not counted (no hardware performance counters)\n");
+
+    // About 2 nodes per prop: 10K to 1M nodes
+    for(uint32_t num_props : {5000u, 50000u, 500000u})
+    {
+        auto       root = construct_prop_scene(num_props, std::make_shared<CameraNode>());
+        SceneState scene_state;
+        SceneStore store;
+        uint32_t   frames = (num_props >= 500000) ? 5 : ((num_props >= 50000) ? 20 : 100);
+
+        double build = time_ms(1, [&]() { store.build(*root); });
+        printf(" %u nodes (%u props)\n", store.size(), num_props);
+        report("scene store build", build, "ms");
+
+        for(bool culling : {false, true})
+        {
+            auto graph_frame = [&]()
+            {
+                scene_state.init();
+                scene_state.frustum_culling = culling;
+                root->draw(scene_state);
+            };
+            auto store_frame = [&]()
+            {
+                scene_state.init();
+                scene_state.frustum_culling = culling;
+                store.draw(scene_state);
+            };
+
+            // First frames fill the matrix caches
+            graph_frame();
+            store_frame();
+
+            misses.start();
+            double   graph = time_ms(frames, graph_frame);
+            uint64_t graph_misses = misses.stop() / frames;
+            misses.start();
+            double   stored = time_ms(frames, store_frame);
+            uint64_t store_misses = misses.stop() / frames;
+
+            printf("  %s\n", culling ? "frustum culling" : "no culling");
+            report("   scene graph traversal (per frame)", graph, "ms");
+            if(misses.is_available()) report_count("   cache misses (per frame)", graph_misses);
+            report("   scene store draw (per frame)", stored, "ms");
+            if(misses.is_available()) report_count("   cache misses (per frame)", store_misses);
+            report("   speedup", graph / stored, "x");
+        }
+    }
+}
+
+} // namespace cg
@@ -0,0 +1,145 @@
+#include "benchmark/benchmark.hpp"
+
+#include "geometry/parallel.hpp"
+#include "scene/scene.hpp"
+
+#include <chrono>
+#include <thread>
+
+namespace cg
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Stand-in for the snapshot Module9 hands to its render thread
+struct Snapshot
+{
+    CameraView view;
+    int32_t    width;
+    int32_t    height;
+    uint32_t   frame;
+};
+
+// Busy (CPU) work
+void spin_ms(double ms)
+{
+    auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+    while(Clock::now() < end) {}
+}
+
+// Waiting (for example on the GPU or a buffer swap)
+void wait_ms(double ms) { std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms)); }
+
+// Update step: move the camera along a path and fill a snapshot
+void update(CameraNode &camera, const CameraPath &path, uint32_t frame, uint32_t frames, double ms, Snapshot &snapshot)
+{
+    path.apply(camera, static_cast<float>(frame) / static_cast<float>(frames));
+    spin_ms(ms);
+    snapshot.view = camera.get_view();
+    snapshot.width = 800;
+    snapshot.height = 600;
+    snapshot.frame = frame;
+}
+
+// Render step: apply the snapshot to the scene camera, then draw
+void render(CameraNode &camera, const Snapshot &snapshot, double cpu_ms, double wait)
+{
+    camera.set_view(snapshot.view);
+    spin_ms(cpu_ms);
+    wait_ms(wait);
+}
+
+// Frame time (ms) of update then render on one thread
+double serial_frames(uint32_t frames, double update_ms, double render_cpu_ms, double render_wait_ms)
+{
+    CameraPath path = CameraPath::orbit(Point3(0.0f, 0.0f, 20.0f), 70.0f, 15.0f, 8);
+    CameraNode input_camera;
+    CameraNode scene_camera;
+    Snapshot   snapshot;
+    return time_ms(1, [&]() {
+               for(uint32_t i = 0; i < frames; i++)
+               {
+                   update(input_camera, path, i, frames, update_ms, snapshot);
+                   render(scene_camera, snapshot, render_cpu_ms, render_wait_ms);
+               }
+           }) /
+           frames;
+}
+
+// Frame time (ms) with the update of frame N + 1 overlapping the render of
+// frame N (update thread and render thread sharing a SnapshotBuffer)
+double pipelined_frames(uint32_t frames, double update_ms, double render_cpu_ms, double render_wait_ms)
+{
+    CameraPath               path = CameraPath::orbit(Point3(0.0f, 0.0f, 20.0f), 70.0f, 15.0f, 8);
+    CameraNode               input_camera;
+    CameraNode               scene_camera;
+    SnapshotBuffer<Snapshot> snapshots;
+    return time_ms(1, [&]() {
+               std::thread renderer([&]() {
+                   while(const Snapshot *snapshot = snapshots.acquire())
+                   {
+                       Snapshot copy = *snapshot;
+                       snapshots.release();
+                       render(scene_camera, copy, render_cpu_ms, render_wait_ms);
+                       if(copy.frame + 1 == frames) break;
+                   }
+               });
+               for(uint32_t i = 0; i < frames; i++)
+               {
+                   update(input_camera, path, i, frames, update_ms, snapshots.get_back());
+                   snapshots.publish();
+               }
+               renderer.join();
+           }) /
+           frames;
+}
+
+} // namespace
+
+void snapshot_benchmark()
+{
+    // Cost of handing a snapshot to another thread and back (no work)
+    constexpr uint32_t HANDOFFS = 20000;
+    SnapshotBuffer<Snapshot> snapshots;
+    double                   handoff_ms = time_ms(1, [&]() {
+        std::thread consumer([&]() {
+            while(const Snapshot *snapshot = snapshots.acquire())
+            {
+                uint32_t frame = snapshot->frame;
+                snapshots.release();
+                if(frame + 1 == HANDOFFS) break;
+            }
+        });
+        for(uint32_t i = 0; i < HANDOFFS; i++)
+        {
+            snapshots.get_back().frame = i;
+            snapshots.publish();
+        }
+        consumer.join();
+    });
+    printf(" %u hardware threads\n", get_thread_count());
+    report("  publish and acquire", handoff_ms / HANDOFFS * 1.0e6, "ns");
+
+    // Update (input and animation) against render work that is mostly
+    // waiting on the GPU, then mostly CPU. Overlap helps the first on any
+    // machine and the second only with a core free for each thread.
+    constexpr uint32_t FRAMES = 60;
+    constexpr double   UPDATE_MS = 2.0;
+    struct
+    {
+        const char *name;
+        double      cpu_ms;
+        double      wait_ms;
+    } cases[] = {{"render waits 4 ms", 0.5, 3.5}, {"render busy 4 ms", 4.0, 0.0}};
+    for(const auto &c : cases)
+    {
+        printf(" %.1f ms update, %s\n", UPDATE_MS, c.name);
+        report("  serial frame", serial_frames(FRAMES, UPDATE_MS, c.cpu_ms, c.wait_ms), "ms");
+        report("  pipelined frame", pipelined_frames(FRAMES, UPDATE_MS, c.cpu_ms, c.wait_ms), "ms");
+    }
+}
+
+} // namespace cg
@@ -0,0 +1,119 @@
+#include "benchmark/benchmark.hpp"
+
+#include "scene/scene.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace cg
+{
+
+namespace
+{
+
+// Number of pixels where any channel differs by more than tolerance
+uint32_t count_differences(const Image &a, const Image &b, int32_t tolerance)
+{
+    const std::vector<uint8_t> &da = a.get_data();
+    const std::vector<uint8_t> &db = b.get_data();
+    uint32_t                    count = 0;
+    for(size_t i = 0; i < da.size(); i += 3)
+    {
+        for(size_t c = 0; c < 3; c++)
+        {
+            if(std::abs(static_cast<int32_t>(da[i + c]) - static_cast<int32_t>(db[i + c])) > tolerance)
+            {
+                count++;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+} // namespace
+
+void software_rasterizer_benchmark()
+{
+    auto       root = construct_lit_scene();
+    CameraNode camera;
+    set_lit_scene_camera(camera);
+
+    RasterSettings settings;
+    settings.width = 640;
+    settings.height = 480;
+
+    SoftwareRasterizer rasterizer;
+    Image              image;
+    rasterizer.set_settings(settings);
+    rasterizer.build(*root);
+    printf(" %zu instances, %zu lights, %ux%u pixels\n", rasterizer.get_scene().instances.size(),
+           rasterizer.get_scene().lights.size(), settings.width, settings.height);
+
+    // Each kernel with one thread, then the best kernel with all threads
+    const RasterKernels &best = get_raster_kernels();
+    for(SimdLevel level : {SimdLevel::SCALAR, SimdLevel::AVX2})
+    {
+        if(!set_raster_simd_level(level)) continue;
+
+        for(uint32_t max_threads : {1u, 0u})
+        {
+            if(max_threads == 0 && level != best.level) continue;
+
+            settings.max_threads = max_threads;
+            rasterizer.set_settings(settings);
+            double               ms = time_ms(5, [&]() { rasterizer.render(camera, image); });
+            const RasterStats &stats = rasterizer.get_stats();
+            printf(" %s, %u thread(s)\n", get_raster_kernels().name, stats.threads);
+            report("  frame", ms, "ms");
+            report("  setup (transform, clip, bin)", stats.setup_ms, "ms");
+            report("  raster and shade", stats.raster_ms, "ms");
+        }
+    }
+    set_raster_simd_level(best.level);
+
+    // Tiles draw triangles in submission order, so the threads used do not
+    // change the image (depth ties resolve the same way)
+    Image single;
+    settings.max_threads = 1;
+    rasterizer.set_settings(settings);
+    rasterizer.render(camera, single);
+    settings.max_threads = 0;
+    rasterizer.set_settings(settings);
+    rasterizer.render(camera, image);
+    report_count("  pixels differing from one thread", count_differences(image, single, 0));
+
+    const RasterStats &stats = rasterizer.get_stats();
+    report_count("  triangles", stats.triangles);
+    report_count("  triangles culled", stats.triangles_culled);
+    report_count("  triangles clipped", stats.triangles_clipped);
+    report_count("  triangles rasterized", stats.triangles_binned);
+    report_count("  fragments shaded", stats.fragments);
+    report_count("  instances outside the frustum", stats.instances_culled);
+
+    // The ray tracer without shadows shades the same visible surfaces, so the
+    // images should only differ along silhouettes
+    RayTraceSettings trace_settings;
+    trace_settings.width = settings.width;
+    trace_settings.height = settings.height;
+    trace_settings.global_ambient = settings.global_ambient;
+    trace_settings.shadows = false;
+    RayTracer tracer;
+    Image     traced;
+    tracer.set_settings(trace_settings);
+    tracer.build(*root);
+    tracer.render(camera, traced);
+    report_count("  pixels differing from the ray tracer", count_differences(image, traced, 8));
+
+    // Low view next to the teapot, so the floor crosses the near plane
+    camera.set_position(Point3(-12.0f, -25.0f, 3.0f));
+    camera.set_look_at_pt(Point3(0.0f, 0.0f, 4.0f));
+    rasterizer.render(camera, image);
+    tracer.render(camera, traced);
+    printf(" close view\n");
+    report("  frame", rasterizer.get_stats().render_ms, "ms");
+    report_count("  triangles clipped", rasterizer.get_stats().triangles_clipped);
+    report_count("  pixels differing from the ray tracer", count_differences(image, traced, 8));
+}
+
+} // namespace cg
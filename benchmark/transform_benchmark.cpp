@@ -0,0 +1,83 @@
+#include "benchmark/benchmark.hpp"
+
+#include "geometry/geometry.hpp"
+#include "geometry/parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace cg
+{
+
+void batch_transform_benchmark()
+{
+    Matrix4x4 m;
+    m.translate(1.0f, 2.0f, 3.0f);
+    m.rotate(30.0f, 1.0f, 2.0f, 3.0f);
+    m.scale(1.0f, 2.0f, 0.5f);
+
+    printf(" %u threads available\n", get_thread_count());
+    for(size_t count : {size_t(1000), size_t(100000), size_t(10000000)})
+    {
+        std::vector<Point3>  points(count);
+        std::vector<Vector3> vectors(count);
+        std::vector<HPoint3> hpoints(count);
+        std::vector<float>   x(count), y(count), z(count);
+        for(size_t i = 0; i < count; i++)
+        {
+            float f = static_cast<float>(i % 1000);
+            points[i] = Point3(f, -f, 0.5f * f);
+            vectors[i] = Vector3(1.0f, f, -f);
+            hpoints[i] = HPoint3(f, -f, 0.5f * f, 1.0f);
+            x[i] = f;
+            y[i] = -f;
+            z[i] = 0.5f * f;
+        }
+        std::vector<Point3>  out_points(count);
+        std::vector<Point3>  ref_points(count);
+        std::vector<Vector3> out_vectors(count);
+        std::vector<HPoint3> out_hpoints(count);
+        std::vector<float>   ox(count), oy(count), oz(count);
+
+        uint32_t iterations = static_cast<uint32_t>(std::max<size_t>(1, 10000000 / count));
+
+        // One point at a time (the prior approach)
+        double single = time_ms(iterations,
+                                [&]()
+                                {
+                                    for(size_t i = 0; i < count; i++) ref_points[i] = Point3(m * points[i]);
+                                });
+        double batch = time_ms(iterations, [&]() { m.transform_points(points.data(), out_points.data(), count, false); });
+        double threaded = time_ms(iterations, [&]() { m.transform_points(points.data(), out_points.data(), count); });
+        double soa = time_ms(iterations,
+                             [&]()
+                             {
+                                 m.transform_points(x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(),
+                                                    count);
+                             });
+        double vec = time_ms(iterations, [&]() { m.transform_vectors(vectors.data(), out_vectors.data(), count); });
+        double hpt = time_ms(iterations, [&]() { m.transform_hpoints(hpoints.data(), out_hpoints.data(), count); });
+
+        float err = 0.0f;
+        for(size_t i = 0; i < count; i++)
+        {
+            err = std::max(err, std::abs(out_points[i].x - ref_points[i].x));
+            err = std::max(err, std::abs(ox[i] - ref_points[i].x));
+        }
+
+        // Millions of elements per second
+        auto rate = [count](double ms) { return static_cast<double>(count) / (ms * 1000.0); };
+        printf(" %zu elements\n", count);
+        report("points, one at a time", rate(single), "M/s");
+        report("points, batched (1 thread)", rate(batch), "M/s");
+        report("points, batched (threaded)", rate(threaded), "M/s");
+        report("points, batched SoA (threaded)", rate(soa), "M/s");
+        report("vectors, batched (threaded)", rate(vec), "M/s");
+        report("homogeneous points, batched (threaded)", rate(hpt), "M/s");
+        report("speedup (threaded vs one at a time)", single / threaded, "x");
+        printf("  %-48s %12.3e\n", "max error (vs one at a time)", err);
+    }
+}
+
+} // namespace cg
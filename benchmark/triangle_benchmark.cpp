@@ -0,0 +1,196 @@
+#include "benchmark/benchmark.hpp"
+
+#include "scene/scene.hpp"
+
+#include <bitset>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace cg
+{
+
+namespace
+{
+
+constexpr uint32_t TRIANGLE_COUNT = 4096;
+constexpr uint32_t RAY_COUNT = 1024;
+
+// Small random triangles in the unit cube
+void random_triangles(uint32_t count, uint32_t seed, std::vector<Point3> &vertices, std::vector<uint32_t> &faces)
+{
+    std::mt19937                          gen(seed);
+    std::uniform_real_distribution<float> pos(0.0f, 1.0f);
+    std::uniform_real_distribution<float> offset(-0.05f, 0.05f);
+    vertices.clear();
+    faces.clear();
+    for(uint32_t i = 0; i < count; i++)
+    {
+        Point3 c(pos(gen), pos(gen), pos(gen));
+        for(uint32_t k = 0; k < 3; k++)
+        {
+            faces.push_back(static_cast<uint32_t>(vertices.size()));
+            vertices.push_back(Point3(c.x + offset(gen), c.y + offset(gen), c.z + offset(gen)));
+        }
+    }
+}
+
+// Rays from outside the unit cube through random points in it
+std::vector<Ray3> random_cube_rays(uint32_t count, uint32_t seed)
+{
+    std::mt19937                          gen(seed);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::vector<Ray3>                     rays;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        Point3 from(dist(gen) * 4.0f - 1.5f, dist(gen) * 4.0f - 1.5f, -2.0f);
+        Point3 to(dist(gen), dist(gen), dist(gen));
+        rays.push_back(Ray3(from, to, true));
+    }
+    return rays;
+}
+
+} // namespace
+
+void triangle_kernel_benchmark()
+{
+    std::vector<Point3>   vertices;
+    std::vector<uint32_t> faces;
+    random_triangles(TRIANGLE_COUNT, 3, vertices, faces);
+    std::vector<Ray3> rays = random_cube_rays(RAY_COUNT, 5);
+
+    TriangleSoA tris;
+    tris.resize(TRIANGLE_COUNT);
+    for(uint32_t i = 0; i < TRIANGLE_COUNT; i++)
+    {
+        tris.set(i, vertices[faces[i * 3]], vertices[faces[i * 3 + 1]], vertices[faces[i * 3 + 2]]);
+    }
+
+    std::vector<RayPacket8> packets(RAY_COUNT / 8);
+    for(uint32_t i = 0; i < RAY_COUNT; i++) packets[i / 8].set(i % 8, rays[i], FLT_MAX);
+
+    const TriangleKernels &best = get_triangle_kernels();
+    printf(" %u rays against %u triangles, single thread (best: %s)\n", RAY_COUNT, TRIANGLE_COUNT, best.name);
+
+    // Each ray against every triangle: one ray / 8 triangles, 8 rays / one
+    // triangle, and through the Ray3 mesh intersection. Hit counts must match.
+    double tests = static_cast<double>(RAY_COUNT) * TRIANGLE_COUNT;
+    for(SimdLevel level : {SimdLevel::SCALAR, SimdLevel::AVX2})
+    {
+        const TriangleKernels *k = get_triangle_kernels(level);
+        if(k == nullptr) continue;
+
+        float    t[8], u[8], v[8];
+        uint64_t hits_1x8 = 0;
+        double   ms_1x8 = time_ms(1,
+                                [&]()
+                                {
+                                    for(const auto &ray : rays)
+                                    {
+                                        const float o[3] = {ray.o.x, ray.o.y, ray.o.z};
+                                        const float d[3] = {ray.d.x, ray.d.y, ray.d.z};
+                                        for(uint32_t i = 0; i < TRIANGLE_COUNT; i += 8)
+                                        {
+                                            uint32_t mask = k->intersect_1x8(o, d, FLT_MAX, tris.get_data(i),
+                                                                             tris.get_stride(), 8, t, u, v);
+                                            hits_1x8 += std::bitset<8>(mask).count();
+                                        }
+                                    }
+                                });
+
+        uint64_t hits_8x1 = 0;
+        double   ms_8x1 = time_ms(1,
+                                [&]()
+                                {
+                                    for(const auto &packet : packets)
+                                    {
+                                        for(uint32_t i = 0; i < TRIANGLE_COUNT; i++)
+                                        {
+                                            uint32_t mask = k->intersect_8x1(packet, tris.get_data(i),
+                                                                             tris.get_stride(), t, u, v);
+                                            hits_8x1 += std::bitset<8>(mask).count();
+                                        }
+                                    }
+                                });
+
+        set_triangle_simd_level(level);
+        uint32_t nearest_hits = 0;
+        double   ms_mesh = time_ms(1,
+                                 [&]()
+                                 {
+                                     for(const auto &ray : rays)
+                                     {
+                                         if(ray.intersect(vertices, faces, FLT_MAX).intersects) nearest_hits++;
+                                     }
+                                 });
+
+        printf(" %s\n", k->name);
+        report("  1 ray x 8 triangles", tests / ms_1x8 * 1.0e-3, "Mtests/s");
+        report("  8 rays x 1 triangle", tests / ms_8x1 * 1.0e-3, "Mtests/s");
+        report("  Ray3 mesh intersect", tests / ms_mesh * 1.0e-3, "Mtests/s");
+        report_count("  hits (1x8)", hits_1x8);
+        report_count("  hits (8x1)", hits_8x1);
+        report_count("  rays that hit", nearest_hits);
+    }
+    set_triangle_simd_level(best.level);
+
+    // Coherent rays (an orthographic grid) against a fine sphere: single rays
+    // against 8 ray packets through the triangle BVH
+    SphereSection sphere(-90.0f, 90.0f, 90, -180.0f, 180.0f, 180, 1.0f, 0, 1);
+    sphere.build_bvh();
+    constexpr uint32_t GRID = 512;
+    std::vector<Ray3>  grid_rays;
+    for(uint32_t y = 0; y < GRID; y++)
+    {
+        for(uint32_t x = 0; x < GRID; x += 8)
+        {
+            // Packets are 8 x 1 spans of pixels
+            for(uint32_t i = 0; i < 8; i++)
+            {
+                float px = (static_cast<float>(x + i) + 0.5f) / GRID * 2.4f - 1.2f;
+                float py = (static_cast<float>(y) + 0.5f) / GRID * 2.4f - 1.2f;
+                grid_rays.push_back(Ray3(Point3(px, py, 5.0f), Vector3(0.0f, 0.0f, -1.0f)));
+            }
+        }
+    }
+    printf(" sphere: %zu triangles, %zu coherent rays\n", sphere.get_bvh().get_primitives().size(), grid_rays.size());
+
+    std::vector<RayMeshIntersectResult> single(grid_rays.size());
+    double                              single_ms = time_ms(1,
+                                       [&]()
+                                       {
+                                           for(size_t i = 0; i < grid_rays.size(); i++)
+                                           {
+                                               single[i] = sphere.intersect(grid_rays[i]);
+                                           }
+                                       });
+    std::vector<RayMeshIntersectResult> packet(grid_rays.size());
+    double                              packet_ms = time_ms(1,
+                                       [&]()
+                                       {
+                                           for(size_t i = 0; i < grid_rays.size(); i += 8)
+                                           {
+                                               RayPacket8 rays8;
+                                               for(uint32_t j = 0; j < 8; j++) rays8.set(j, grid_rays[i + j], FLT_MAX);
+                                               sphere.intersect(rays8, &packet[i]);
+                                           }
+                                       });
+
+    uint32_t hits = 0;
+    uint32_t mismatches = 0;
+    for(size_t i = 0; i < grid_rays.size(); i++)
+    {
+        if(single[i].intersects) hits++;
+        if(single[i].intersects != packet[i].intersects ||
+           (single[i].intersects && std::abs(single[i].distance - packet[i].distance) > 1.0e-5f))
+        {
+            mismatches++;
+        }
+    }
+    report("  single rays", grid_rays.size() / single_ms * 1.0e-3, "Mrays/s");
+    report("  8 ray packets", grid_rays.size() / packet_ms * 1.0e-3, "Mrays/s");
+    report_count("  rays that hit", hits);
+    report_count("  packet / single ray mismatches", mismatches);
+}
+
+} // namespace cg
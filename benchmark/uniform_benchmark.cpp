@@ -0,0 +1,350 @@
+#include "benchmark/benchmark.hpp"
+
+#include "scene/scene.hpp"
+
+#include <cmath>
+#include <memory>
+
+namespace cg
+{
+
+namespace
+{
+
+// Shader node that does not load a program (no OpenGL context). Assigns
+// distinct uniform locations like a linked program. With uniform blocks it
+// makes its frame and material buffers current like Module9's
+// LightingShaderNode, otherwise the camera, lights and materials set uniforms.
+class BlockShaderNode : public ShaderNode
+{
+  public:
+    BlockShaderNode(bool uniform_blocks) : uniform_blocks_(uniform_blocks)
+    {
+        if(uniform_blocks_) frame_buffer_.create(FRAME_BLOCK_BINDING, sizeof(FrameBlock));
+    }
+
+    bool get_locations() override { return true; }
+
+    void draw(SceneState &scene_state) override
+    {
+        apply_state(scene_state);
+        SceneNode::draw(scene_state);
+    }
+
+    void apply_state(SceneState &scene_state) override
+    {
+        ShaderNode::apply_state(scene_state);
+        GLint location = 0;
+        scene_state.pvm_matrix_loc = location++;
+        scene_state.model_matrix_loc = location++;
+        scene_state.normal_matrix_loc = location++;
+        scene_state.camera_position_loc = location++;
+        scene_state.material_ambient_loc = location++;
+        scene_state.material_diffuse_loc = location++;
+        scene_state.material_specular_loc = location++;
+        scene_state.material_emission_loc = location++;
+        scene_state.material_shininess_loc = location++;
+        for(LightUniforms &light : scene_state.lights)
+        {
+            light = LightUniforms{location,
+                                  location + 1,
+                                  location + 2,
+                                  location + 3,
+                                  location + 4,
+                                  location + 5,
+                                  location + 6,
+                                  location + 7,
+                                  location + 8};
+            location += 9;
+        }
+        if(!uniform_blocks_)
+        {
+            scene_state.gl_state.uniform1i(location, MAX_BLOCK_LIGHTS);
+            return;
+        }
+        frame_buffer_.bind();
+        material_stream_.clear();
+        scene_state.frame_buffer = &frame_buffer_;
+        scene_state.material_stream = &material_stream_;
+        scene_state.frame_block.num_lights = MAX_BLOCK_LIGHTS;
+        scene_state.frame_block_changed = true;
+    }
+
+  private:
+    bool           uniform_blocks_;
+    UniformBuffer  frame_buffer_;
+    MaterialBuffer material_stream_;
+};
+
+// Light set each frame like Module9's LightNode
+class BlockLightNode : public SceneNode
+{
+  public:
+    BlockLightNode(uint32_t index, const SceneLight &light) : index_(index), light_(light) {}
+
+    void draw(SceneState &scene_state) override
+    {
+        apply_state(scene_state);
+        SceneNode::draw(scene_state);
+    }
+
+    void apply_state(SceneState &scene_state) override
+    {
+        if(scene_state.frame_buffer != nullptr)
+        {
+            scene_state.frame_block.lights[index_] = make_light_block(light_);
+            scene_state.frame_block_changed = true;
+            return;
+        }
+        const LightUniforms &u = scene_state.lights[index_];
+        GLStateCache        &gl = scene_state.gl_state;
+        gl.uniform1i(u.enabled, light_.enabled ? 1 : 0);
+        gl.uniform1i(u.spotlight, light_.spotlight ? 1 : 0);
+        gl.uniform4fv(u.position, &light_.position.x);
+        gl.uniform4fv(u.ambient, &light_.ambient.r);
+        gl.uniform4fv(u.diffuse, &light_.diffuse.r);
+        gl.uniform4fv(u.specular, &light_.specular.r);
+        if(light_.spotlight)
+        {
+            gl.uniform3fv(u.spot_direction, &light_.spot_direction.x);
+            gl.uniform1f(u.spot_cutoff, light_.spot_cutoff);
+            gl.uniform1f(u.spot_exponent, light_.spot_exponent);
+        }
+    }
+
+    void compile(RenderQueue &queue, SceneState &scene_state) override
+    {
+        queue.add_state_node(this);
+        SceneNode::compile(queue, scene_state);
+    }
+
+    void flatten(SceneStore &store, uint32_t parent) override
+    {
+        flatten_children(store, store.add_state(parent, this));
+    }
+
+  private:
+    uint32_t   index_;
+    SceneLight light_;
+};
+
+/**
+ * Construct the prop scene (16 props to a group transform and material) lit
+ * by two point lights and a spotlight.
+ */
+std::shared_ptr<SceneNode> construct_lit_prop_scene(uint32_t                    num_props,
+                                                    bool                        uniform_blocks,
+                                                    std::shared_ptr<CameraNode> camera)
+{
+    auto shader = std::make_shared<BlockShaderNode>(uniform_blocks);
+    camera->set_position(Point3(0.0f, -100.0f, 20.0f));
+    camera->set_look_at_pt(Point3(0.0f, 0.0f, 20.0f));
+    camera->set_view_up(Vector3(0.0f, 0.0f, 1.0f));
+    camera->set_perspective(50.0f, 1.0f, 1.0f, 300.0f);
+    shader->add_child(camera);
+
+    for(uint32_t i = 0; i < MAX_BLOCK_LIGHTS; i++)
+    {
+        SceneLight light{true,
+                         i == 2,
+                         HPoint3(static_cast<float>(i) * 10.0f, -50.0f, 50.0f, 1.0f),
+                         Color4(0.1f, 0.1f, 0.1f),
+                         Color4(0.6f, 0.6f, 0.6f),
+                         Color4(0.4f, 0.4f, 0.4f),
+                         Vector3(0.0f, 0.5f, -1.0f),
+                         30.0f,
+                         4.0f};
+        camera->add_child(std::make_shared<BlockLightNode>(i, light));
+    }
+
+    auto                       unit_square = std::make_shared<UnitSquareSurface>(2, 0, 1);
+    std::shared_ptr<SceneNode> group;
+    for(uint32_t i = 0; i < num_props; i++)
+    {
+        if(i % 16 == 0)
+        {
+            float shade = static_cast<float>(i % 64) / 64.0f;
+            auto  material = std::make_shared<PresentationNode>(Color4(0.2f, 0.2f, 0.2f),
+                                                               Color4(shade, 0.5f, 0.5f),
+                                                               Color4(0.1f, 0.1f, 0.1f),
+                                                               Color4(0.0f, 0.0f, 0.0f),
+                                                               16.0f);
+            auto  group_transform = std::make_shared<TransformNode>();
+            group_transform->translate(static_cast<float>(i % 1024), static_cast<float>(i / 1024), 0.0f);
+            camera->add_child(material);
+            material->add_child(group_transform);
+            group = group_transform;
+        }
+
+        auto prop_transform = std::make_shared<TransformNode>();
+        prop_transform->translate(static_cast<float>(i % 16), 0.0f, 0.5f);
+        prop_transform->rotate_z(static_cast<float>(i % 360));
+        prop_transform->scale(0.5f, 0.5f, 1.0f);
+        prop_transform->add_child(unit_square);
+        group->add_child(prop_transform);
+    }
+    return shader;
+}
+
+// OpenGL calls made by one call of f
+template <typename F> GLCallCounts count_gl_calls(F &&f)
+{
+    GLCallCounts before = get_gl_call_counts();
+    f();
+    GLCallCounts after = get_gl_call_counts();
+    return {after.programs - before.programs,
+            after.vertex_arrays - before.vertex_arrays,
+            after.uniforms - before.uniforms,
+            after.buffer_binds - before.buffer_binds,
+            after.buffer_updates - before.buffer_updates,
+            after.draws - before.draws};
+}
+
+void report_gl_calls(const GLCallCounts &calls)
+{
+    report_count("   uniform calls", calls.uniforms);
+    report_count("   buffer binds", calls.buffer_binds);
+    report_count("   buffer updates", calls.buffer_updates);
+    report_count("   program and vertex array binds", calls.programs + calls.vertex_arrays);
+    report_count("   draws", calls.draws);
+    report_count("   total", calls.total());
+}
+
+uint32_t get_hits(const GLStateCounters &counters)
+{
+    return counters.program_hits + counters.vertex_array_hits + counters.uniform_hits;
+}
+
+} // namespace
+
+void uniform_buffer_benchmark()
+{
+    // OpenGL calls per frame with camera, light and material uniforms vs.
+    // the frame and material uniform blocks
+    for(uint32_t num_props : {1000u, 10000u})
+    {
+        printf(" %u props (%u materials, %u lights)\n", num_props, num_props / 16, MAX_BLOCK_LIGHTS);
+        uint32_t frames = (num_props >= 10000) ? 20 : 100;
+        for(bool uniform_blocks : {false, true})
+        {
+            auto        root = construct_lit_prop_scene(num_props, uniform_blocks, std::make_shared<CameraNode>());
+            SceneState  scene_state;
+            RenderQueue queue;
+            SceneStore  store;
+            scene_state.gl_state.set_enabled(false); // Every call made (see gl_state_cache_benchmark)
+            queue.compile(*root, scene_state);
+            store.build(*root);
+
+            auto graph_frame = [&]()
+            {
+                scene_state.init();
+                root->draw(scene_state);
+            };
+            auto queue_frame = [&]()
+            {
+                scene_state.init();
+                queue.draw(*root, scene_state);
+            };
+            auto store_frame = [&]()
+            {
+                scene_state.init();
+                store.draw(scene_state);
+            };
+
+            // First frames fill the matrix caches and the material buffers
+            graph_frame();
+            queue_frame();
+            store_frame();
+
+            printf("  %s\n", uniform_blocks ? "uniform blocks" : "uniforms");
+            report("  scene graph traversal (per frame)", time_ms(frames, graph_frame), "ms");
+            report_gl_calls(count_gl_calls(graph_frame));
+            report("  render queue draw (per frame)", time_ms(frames, queue_frame), "ms");
+            report_gl_calls(count_gl_calls(queue_frame));
+            report("  scene store draw (per frame)", time_ms(frames, store_frame), "ms");
+            report_gl_calls(count_gl_calls(store_frame));
+        }
+    }
+}
+
+void gl_state_cache_benchmark()
+{
+    // OpenGL calls per frame with and without the state cache, for a camera
+    // that stays put (camera and lights are the same every frame) and one
+    // that orbits the scene. Without a context the calls themselves cost
+    // almost nothing here; the timings show the cost of the cache.
+    for(uint32_t num_props : {1000u, 10000u})
+    {
+        uint32_t frames = (num_props >= 10000) ? 20 : 100;
+        for(bool uniform_blocks : {false, true})
+        {
+            for(bool moving : {false, true})
+            {
+                printf(" %u props, %s, %s camera\n",
+                       num_props,
+                       uniform_blocks ? "uniform blocks" : "uniforms",
+                       moving ? "orbiting" : "static");
+
+                auto        camera = std::make_shared<CameraNode>();
+                auto        root = construct_lit_prop_scene(num_props, uniform_blocks, camera);
+                SceneState  scene_state;
+                RenderQueue queue;
+                SceneStore  store;
+                queue.compile(*root, scene_state);
+                store.build(*root);
+
+                uint32_t frame = 0;
+                auto     move_camera = [&]()
+                {
+                    if(!moving) return;
+                    float angle = static_cast<float>(frame++ % 360) * 0.0174533f;
+                    camera->set_position(Point3(100.0f * std::sin(angle), -100.0f * std::cos(angle), 20.0f));
+                };
+                auto graph_frame = [&]()
+                {
+                    move_camera();
+                    scene_state.init();
+                    root->draw(scene_state);
+                };
+                auto queue_frame = [&]()
+                {
+                    move_camera();
+                    scene_state.init();
+                    queue.draw(*root, scene_state);
+                };
+                auto store_frame = [&]()
+                {
+                    move_camera();
+                    scene_state.init();
+                    store.draw(scene_state);
+                };
+                auto report_frame = [&](const char *name, auto &&draw_frame)
+                {
+                    // First frame fills the matrix caches and the state cache. Each
+                    // measurement sees the same camera positions.
+                    frame = 0;
+                    draw_frame();
+                    double       ms = time_ms(frames, draw_frame);
+                    GLCallCounts calls = count_gl_calls(draw_frame);
+                    report(name, ms, "ms");
+                    report_count("    GL calls", calls.total());
+                    if(scene_state.gl_state.is_enabled())
+                    {
+                        report_count("    calls skipped", get_hits(scene_state.gl_state.get_counters()));
+                    }
+                };
+
+                for(bool cache : {false, true})
+                {
+                    scene_state.gl_state.set_enabled(cache);
+                    printf("  state cache %s\n", cache ? "on" : "off");
+                    report_frame("   scene graph traversal (per frame)", graph_frame);
+                    report_frame("   render queue draw (per frame)", queue_frame);
+                    report_frame("   scene store draw (per frame)", store_frame);
+                }
+            }
+        }
+    }
+}
+
+} // namespace cg
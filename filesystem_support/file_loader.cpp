@@ -2,6 +2,8 @@
 
 #include "filesystem_support/file_loader.hpp"
 
+#include "geometry/profiler.hpp"
+
 #include <fstream>
 
 namespace cg
@@ -24,6 +26,7 @@ void FileContents::destroy()
 
 bool load_file_contents(const std::string &path, FileContents &file_contents)
 {
+    CG_PROFILE_ZONE("load_file_contents");
     std::ifstream ifs;
     ifs.open(path);
     if(!ifs.is_open()) return false;
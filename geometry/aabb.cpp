@@ -2,56 +2,117 @@
 
 #include "geometry/geometry.hpp"
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
 namespace cg
 {
 
-// NOTE - this is not required until 605.767!
-
-AABB::AABB()
+AABB::AABB() :
+    min_point(FLT_MAX, FLT_MAX, FLT_MAX),
+    max_point(-FLT_MAX, -FLT_MAX, -FLT_MAX),
+    center(0.0f, 0.0f, 0.0f),
+    half_diagonal(0.0f, 0.0f, 0.0f)
 {
-    // Complete in 605.767
 }
 
-AABB::AABB(const Point3 &min, const Point3 &max)
+AABB::AABB(const Point3 &min, const Point3 &max) { update(min, max); }
+
+AABB::AABB(const std::vector<Point3> &vertex_list) { create(vertex_list); }
+
+void AABB::create(const std::vector<Point3> &vertex_list)
 {
-    // Complete in 605.767
+    *this = AABB();
+    for(const auto &p : vertex_list)
+    {
+        min_point.set(std::min(min_point.x, p.x), std::min(min_point.y, p.y), std::min(min_point.z, p.z));
+        max_point.set(std::max(max_point.x, p.x), std::max(max_point.y, p.y), std::max(max_point.z, p.z));
+    }
+    compute_center();
 }
 
-AABB::AABB(const std::vector<Point3> &vertex_list)
+void AABB::update(const Point3 &min, const Point3 &max)
 {
-    // Complete in 605.767
+    min_point = min;
+    max_point = max;
+    compute_center();
 }
 
-void AABB::create(const std::vector<Point3> &vertex_list)
+void AABB::merge(const AABB &box)
 {
-    // Complete in 605.767
+    if(box.is_empty()) return;
+    min_point.set(std::min(min_point.x, box.min_point.x),
+                  std::min(min_point.y, box.min_point.y),
+                  std::min(min_point.z, box.min_point.z));
+    max_point.set(std::max(max_point.x, box.max_point.x),
+                  std::max(max_point.y, box.max_point.y),
+                  std::max(max_point.z, box.max_point.z));
+    compute_center();
 }
 
-void AABB::update(const Point3 &min, const Point3 &max)
+void AABB::add(const Point3 &p)
 {
-    // Complete in 605.767
+    min_point.set(std::min(min_point.x, p.x), std::min(min_point.y, p.y), std::min(min_point.z, p.z));
+    max_point.set(std::max(max_point.x, p.x), std::max(max_point.y, p.y), std::max(max_point.z, p.z));
+    compute_center();
 }
 
-void AABB::merge(const AABB &box)
+bool AABB::contains(const AABB &box) const
 {
-    // Complete in 605.767
+    if(box.is_empty()) return true;
+    return box.min_point.x >= min_point.x && box.min_point.y >= min_point.y &&
+           box.min_point.z >= min_point.z && box.max_point.x <= max_point.x &&
+           box.max_point.y <= max_point.y && box.max_point.z <= max_point.z;
 }
 
-Point3 AABB::min_pt() const
+bool AABB::is_empty() const
 {
-    // Complete in 605.767
-    return Point3();
+    return min_point.x > max_point.x || min_point.y > max_point.y || min_point.z > max_point.z;
 }
 
-Point3 AABB::max_pt() const
+Point3 AABB::min_pt() const { return min_point; }
+
+Point3 AABB::max_pt() const { return max_point; }
+
+AABB AABB::transform(const Matrix4x4 &m) const
 {
-    // Complete in 605.767
-    return Point3();
+    if(is_empty()) return AABB();
+
+    // Transform the center, then find the extent of the transformed half
+    // diagonal along each axis using the absolute values of the matrix
+    Point3 c(m.m00() * center.x + m.m01() * center.y + m.m02() * center.z + m.m03(),
+             m.m10() * center.x + m.m11() * center.y + m.m12() * center.z + m.m13(),
+             m.m20() * center.x + m.m21() * center.y + m.m22() * center.z + m.m23());
+    Vector3 h(std::abs(m.m00()) * half_diagonal.x + std::abs(m.m01()) * half_diagonal.y +
+                  std::abs(m.m02()) * half_diagonal.z,
+              std::abs(m.m10()) * half_diagonal.x + std::abs(m.m11()) * half_diagonal.y +
+                  std::abs(m.m12()) * half_diagonal.z,
+              std::abs(m.m20()) * half_diagonal.x + std::abs(m.m21()) * half_diagonal.y +
+                  std::abs(m.m22()) * half_diagonal.z);
+
+    AABB box;
+    box.min_point.set(c.x - h.x, c.y - h.y, c.z - h.z);
+    box.max_point.set(c.x + h.x, c.y + h.y, c.z + h.z);
+    box.center = c;
+    box.half_diagonal = h;
+    return box;
 }
 
-void compute_center()
+void AABB::compute_center()
 {
-    // Complete in 605.767
+    if(is_empty())
+    {
+        center.set(0.0f, 0.0f, 0.0f);
+        half_diagonal.set(0.0f, 0.0f, 0.0f);
+        return;
+    }
+    center.set(0.5f * (min_point.x + max_point.x),
+               0.5f * (min_point.y + max_point.y),
+               0.5f * (min_point.z + max_point.z));
+    half_diagonal.set(0.5f * (max_point.x - min_point.x),
+                      0.5f * (max_point.y - min_point.y),
+                      0.5f * (max_point.z - min_point.z));
 }
 
 } // namespace cg
@@ -12,19 +12,27 @@
 #define __GEOMETRY_AABB_HPP__
 
 #include "geometry/point3.hpp"
+#include "geometry/vector3.hpp"
 
 #include <vector>
 
 namespace cg
 {
 
+class Matrix4x4;
+
 /**
  * Axis Aligned Bounding Box.
  */
 struct AABB
 {
+    Point3  min_point;     // Minimum x,y,z
+    Point3  max_point;     // Maximum x,y,z
+    Point3  center;        // Center (see compute_center)
+    Vector3 half_diagonal; // Half the diagonal from min to max (see compute_center)
+
     /**
-     * Default constructor.
+     * Default constructor. Constructs an empty box.
      */
     AABB();
 
@@ -60,6 +68,34 @@ struct AABB
      */
     void merge(const AABB &box);
 
+    /**
+     * Expand this box to contain a point.
+     * @param  p  Point.
+     */
+    void add(const Point3 &p);
+
+    /**
+     * Check whether this box contains another box.
+     * @param  box  Other box.
+     * @return  Returns true if box is inside this box (an empty box is inside any box).
+     */
+    bool contains(const AABB &box) const;
+
+    /**
+     * Check whether the box is empty (contains no points).
+     * @return  Returns true if the box is empty.
+     */
+    bool is_empty() const;
+
+    /**
+     * Transform the box and find the axis aligned box containing the result
+     * (Arvo, "Transforming Axis-Aligned Bounding Boxes"). The matrix is
+     * treated as affine.
+     * @param  m  Transformation matrix.
+     * @return  Returns the box containing the transformed box.
+     */
+    AABB transform(const Matrix4x4 &m) const;
+
     /**
      * Get the point at the minimum x,y,z.
      * @return  Returns the min. point.
@@ -73,7 +109,8 @@ struct AABB
     Point3 max_pt() const;
 
     /**
-     * Compute center and half diagonal
+     * Compute center and half diagonal. Called whenever the min or max point
+     * changes.
      */
     void compute_center();
 };
@@ -0,0 +1,70 @@
+#include "geometry/arena.hpp"
+
+#include <algorithm>
+
+namespace cg
+{
+
+Arena::Arena(size_t block_size) :
+    block_size_(block_size),
+    current_(0),
+    ptr_(nullptr),
+    end_(nullptr),
+    bytes_allocated_(0),
+    allocation_count_(0)
+{
+}
+
+Arena::~Arena() { release(); }
+
+void Arena::reset()
+{
+    current_ = 0;
+    ptr_ = blocks_.empty() ? nullptr : blocks_[0].data;
+    end_ = blocks_.empty() ? nullptr : blocks_[0].data + blocks_[0].size;
+    bytes_allocated_ = 0;
+    allocation_count_ = 0;
+}
+
+void Arena::release()
+{
+    for(const Block &block : blocks_) ::operator delete(block.data);
+    blocks_.clear();
+    reset();
+}
+
+size_t Arena::get_bytes_allocated() const { return bytes_allocated_; }
+
+size_t Arena::get_bytes_reserved() const
+{
+    size_t bytes = 0;
+    for(const Block &block : blocks_) bytes += block.size;
+    return bytes;
+}
+
+uint64_t Arena::get_allocation_count() const { return allocation_count_; }
+
+void *Arena::allocate_block(size_t size, size_t alignment)
+{
+    // Use the next kept block that fits (after a reset), otherwise add one.
+    // The space left in the current block is skipped.
+    size_t needed = size + alignment - 1;
+    size_t next = (ptr_ == nullptr) ? 0 : current_ + 1;
+    while(next < blocks_.size() && blocks_[next].size < needed) next++;
+    if(next >= blocks_.size())
+    {
+        Block block;
+        block.size = std::max(block_size_, needed);
+        block.data = static_cast<char *>(::operator new(block.size));
+        next = blocks_.size();
+        blocks_.push_back(block);
+    }
+
+    // Blocks skipped as too small are not used again until the next reset
+    current_ = next;
+    ptr_ = blocks_[current_].data;
+    end_ = ptr_ + blocks_[current_].size;
+    return allocate(size, alignment);
+}
+
+} // namespace cg
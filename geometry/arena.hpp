@@ -0,0 +1,242 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    arena.hpp
+//	Purpose: Arena (bump) allocator, a standard allocator that allocates
+//           from an arena, and a typed object pool.
+//
+//============================================================================
+
+#ifndef __GEOMETRY_ARENA_HPP__
+#define __GEOMETRY_ARENA_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace cg
+{
+
+/**
+ * Arena allocator. Allocations are carved in order from large blocks and
+ * are not freed individually: reset releases everything at once and keeps
+ * the blocks, so an arena reset every frame (or every level load) stops
+ * allocating once it has grown to its working size. Not thread safe.
+ */
+class Arena
+{
+  public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    /**
+     * Constructor. Blocks are allocated on first use.
+     * @param  block_size  Size of each block (larger allocations get a
+     *                     block of their own).
+     */
+    explicit Arena(size_t block_size = DEFAULT_BLOCK_SIZE);
+
+    /**
+     * Destructor. Frees the blocks (does not call destructors).
+     */
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /**
+     * Allocate memory.
+     * @param  size       Bytes to allocate.
+     * @param  alignment  Alignment (a power of 2).
+     * @return  Returns the memory. Valid until reset or release.
+     */
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(ptr_) + alignment - 1) & ~(alignment - 1);
+        if(ptr_ == nullptr || p + size > reinterpret_cast<uintptr_t>(end_)) return allocate_block(size, alignment);
+        ptr_ = reinterpret_cast<char *>(p + size);
+        bytes_allocated_ += size;
+        allocation_count_++;
+        return reinterpret_cast<void *>(p);
+    }
+
+    /**
+     * Release all allocations, keeping the blocks for reuse. Objects in the
+     * arena are not destroyed: destroy them first.
+     */
+    void reset();
+
+    /**
+     * Release all allocations and free the blocks.
+     */
+    void release();
+
+    /**
+     * Get the bytes allocated since the last reset.
+     * @return  Returns the bytes allocated.
+     */
+    size_t get_bytes_allocated() const;
+
+    /**
+     * Get the total size of the blocks.
+     * @return  Returns the bytes reserved.
+     */
+    size_t get_bytes_reserved() const;
+
+    /**
+     * Get the number of allocations since the last reset.
+     * @return  Returns the allocation count.
+     */
+    uint64_t get_allocation_count() const;
+
+  protected:
+    struct Block
+    {
+        char  *data;
+        size_t size;
+    };
+
+    size_t             block_size_;
+    std::vector<Block> blocks_;
+    size_t             current_; // Block being filled
+    char              *ptr_;     // Next free byte of the current block
+    char              *end_;     // End of the current block
+    size_t             bytes_allocated_;
+    uint64_t           allocation_count_;
+
+    // Move to the next block with room (allocating one if needed) and allocate from it
+    void *allocate_block(size_t size, size_t alignment);
+};
+
+/**
+ * Standard allocator that allocates from an arena (for containers and
+ * std::allocate_shared). Deallocation does nothing; the memory is reclaimed
+ * when the arena is reset.
+ */
+template <typename T>
+class ArenaAllocator
+{
+  public:
+    using value_type = T;
+
+    /**
+     * Constructor.
+     * @param  arena  Arena to allocate from.
+     */
+    explicit ArenaAllocator(Arena &arena) : arena_(&arena) {}
+
+    /**
+     * Copy an allocator of another type (rebinding).
+     * @param  other  Allocator.
+     */
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena_(&other.get_arena())
+    {
+    }
+
+    /**
+     * Allocate memory for n objects.
+     * @param  n  Number of objects.
+     * @return  Returns the memory.
+     */
+    T *allocate(size_t n) { return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T))); }
+
+    /**
+     * Deallocate memory (does nothing).
+     */
+    void deallocate(T *, size_t) {}
+
+    /**
+     * Get the arena.
+     * @return  Returns the arena this allocator allocates from.
+     */
+    Arena &get_arena() const { return *arena_; }
+
+  protected:
+    Arena *arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{
+    return &a.get_arena() == &b.get_arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{
+    return !(a == b);
+}
+
+/**
+ * Pool of objects of one type, allocated from an arena. Destroyed objects
+ * are kept on a free list and their memory reused by the next create, so
+ * objects that come and go (spawned props, particles) do not grow the
+ * arena. Not thread safe.
+ */
+template <typename T>
+class ObjectPool
+{
+  public:
+    /**
+     * Constructor.
+     * @param  arena  Arena to allocate from. Must outlive the pool's objects.
+     */
+    explicit ObjectPool(Arena &arena) : arena_(arena), free_(nullptr), live_count_(0) {}
+
+    /**
+     * Construct an object.
+     * @param  args  Constructor arguments.
+     * @return  Returns the object.
+     */
+    template <typename... Args>
+    T *create(Args &&...args)
+    {
+        void *slot = free_;
+        if(free_ != nullptr) free_ = free_->next;
+        else slot = arena_.allocate(SLOT_SIZE, SLOT_ALIGNMENT);
+        live_count_++;
+        return new(slot) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Destroy an object created by this pool and put its memory on the
+     * free list.
+     * @param  object  Object.
+     */
+    void destroy(T *object)
+    {
+        object->~T();
+        FreeSlot *slot = reinterpret_cast<FreeSlot *>(object);
+        slot->next = free_;
+        free_ = slot;
+        live_count_--;
+    }
+
+    /**
+     * Get the number of objects created and not yet destroyed.
+     * @return  Returns the number of live objects.
+     */
+    uint32_t get_live_count() const { return live_count_; }
+
+  protected:
+    struct FreeSlot
+    {
+        FreeSlot *next;
+    };
+
+    static constexpr size_t SLOT_SIZE = (sizeof(T) > sizeof(FreeSlot)) ? sizeof(T) : sizeof(FreeSlot);
+    static constexpr size_t SLOT_ALIGNMENT = (alignof(T) > alignof(FreeSlot)) ? alignof(T) : alignof(FreeSlot);
+
+    Arena    &arena_;
+    FreeSlot *free_;
+    uint32_t  live_count_;
+};
+
+} // namespace cg
+
+#endif
@@ -2,6 +2,8 @@
 
 #include "geometry/geometry.hpp"
 
+#include <cmath>
+
 namespace cg
 {
 
@@ -11,14 +13,76 @@ BoundingSphere::BoundingSphere(const BoundingSphere &s) : center(s.center), radi
 
 BoundingSphere::BoundingSphere(const Point3 &c, float r) : center(c), radius(r) {}
 
-BoundingSphere::BoundingSphere(std::vector<Point3> &vertex_list)
+BoundingSphere::BoundingSphere(std::vector<Point3> &vertex_list) : center{0.0f, 0.0f, 0.0f}, radius(0.0f)
 {
-    // Complete in 605.767
+    if(vertex_list.empty()) return;
+
+    // Find the points with minimum and maximum x, y and z
+    const Point3 *min_pts[3] = {&vertex_list[0], &vertex_list[0], &vertex_list[0]};
+    const Point3 *max_pts[3] = {&vertex_list[0], &vertex_list[0], &vertex_list[0]};
+    for(const auto &p : vertex_list)
+    {
+        if(p.x < min_pts[0]->x) min_pts[0] = &p;
+        if(p.x > max_pts[0]->x) max_pts[0] = &p;
+        if(p.y < min_pts[1]->y) min_pts[1] = &p;
+        if(p.y > max_pts[1]->y) max_pts[1] = &p;
+        if(p.z < min_pts[2]->z) min_pts[2] = &p;
+        if(p.z > max_pts[2]->z) max_pts[2] = &p;
+    }
+
+    // Start with the sphere through the most separated pair
+    uint32_t axis = 0;
+    float    max_span = -1.0f;
+    for(uint32_t i = 0; i < 3; i++)
+    {
+        float span = Vector3(*min_pts[i], *max_pts[i]).norm_squared();
+        if(span > max_span)
+        {
+            max_span = span;
+            axis = i;
+        }
+    }
+    const Point3 &p0 = *min_pts[axis];
+    const Point3 &p1 = *max_pts[axis];
+    center.set(0.5f * (p0.x + p1.x), 0.5f * (p0.y + p1.y), 0.5f * (p0.z + p1.z));
+    radius = 0.5f * std::sqrt(max_span);
+
+    // Grow the sphere to include any point outside it. The new sphere passes
+    // through the point and the far side of the old sphere.
+    for(const auto &p : vertex_list)
+    {
+        Vector3 d(center, p);
+        float   dist2 = d.norm_squared();
+        if(dist2 > radius * radius)
+        {
+            float dist = std::sqrt(dist2);
+            float new_radius = 0.5f * (radius + dist);
+            float k = (new_radius - radius) / dist;
+            center.set(center.x + d.x * k, center.y + d.y * k, center.z + d.z * k);
+            radius = new_radius;
+        }
+    }
 }
 
 BoundingSphere &BoundingSphere::merge_with(const BoundingSphere &s2)
 {
-    // Complete in 605.767
+    Vector3 d(center, s2.center);
+    float   dist = d.norm();
+
+    // One sphere contains the other
+    if(dist + s2.radius <= radius) return *this;
+    if(dist + radius <= s2.radius)
+    {
+        center = s2.center;
+        radius = s2.radius;
+        return *this;
+    }
+
+    // The new sphere spans from the far side of this sphere to the far side of s2
+    float new_radius = 0.5f * (dist + radius + s2.radius);
+    float k = (new_radius - radius) / dist;
+    center.set(center.x + d.x * k, center.y + d.y * k, center.z + d.z * k);
+    radius = new_radius;
     return *this;
 }
 
@@ -0,0 +1,484 @@
+#include "geometry/bvh.hpp"
+
+#include "geometry/parallel.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <thread>
+
+namespace cg
+{
+
+namespace
+{
+
+// Subtrees with at least this many primitives may be built on another thread
+constexpr uint32_t PARALLEL_MIN_PRIMITIVES = 4096;
+
+// Below this depth nodes are split at the median so the depth stays within
+// the traversal stack (MAX_DEPTH) regardless of the SAH splits above
+constexpr uint32_t MEDIAN_SPLIT_DEPTH = BVH::MAX_DEPTH - 32;
+
+// Nodes with more primitives are binned along the largest axis only
+constexpr uint32_t ALL_AXES_MAX_PRIMITIVES = 1024;
+
+// Cost of visiting a node relative to testing a primitive
+constexpr float TRAVERSAL_COST = 1.0f;
+
+struct Box
+{
+    float min[3];
+    float max[3];
+};
+
+void set_empty(Box &box)
+{
+    for(uint32_t i = 0; i < 3; i++)
+    {
+        box.min[i] = FLT_MAX;
+        box.max[i] = -FLT_MAX;
+    }
+}
+
+void grow(Box &box, const Box &b)
+{
+    for(uint32_t i = 0; i < 3; i++)
+    {
+        box.min[i] = std::min(box.min[i], b.min[i]);
+        box.max[i] = std::max(box.max[i], b.max[i]);
+    }
+}
+
+void grow(Box &box, const float *p)
+{
+    for(uint32_t i = 0; i < 3; i++)
+    {
+        box.min[i] = std::min(box.min[i], p[i]);
+        box.max[i] = std::max(box.max[i], p[i]);
+    }
+}
+
+// Half the surface area (the SAH only uses ratios of areas)
+float half_area(const Box &box)
+{
+    float dx = box.max[0] - box.min[0];
+    float dy = box.max[1] - box.min[1];
+    float dz = box.max[2] - box.min[2];
+    if(dx < 0.0f || dy < 0.0f || dz < 0.0f) return 0.0f;
+    return dx * dy + dy * dz + dz * dx;
+}
+
+float half_area(const BVHNode &node)
+{
+    Box box = {{node.min[0], node.min[1], node.min[2]}, {node.max[0], node.max[1], node.max[2]}};
+    return half_area(box);
+}
+
+void set_node_bound(BVHNode &node, const Box &box)
+{
+    for(uint32_t i = 0; i < 3; i++)
+    {
+        node.min[i] = box.min[i];
+        node.max[i] = box.max[i];
+    }
+}
+
+/**
+ * Primitive bound, centroid and index. The builder partitions an array of
+ * these in place so each pass over a node reads contiguous memory.
+ */
+struct BuildPrimitive
+{
+    Box      box;
+    float    centroid[3];
+    uint32_t index;
+};
+
+/**
+ * Bound of a range of primitives and of their centroids.
+ */
+struct RangeBounds
+{
+    Box bound;
+    Box centroid_bound;
+};
+
+/**
+ * SAH bin: primitives whose centroids fall in a slice of the centroid bound.
+ */
+struct Bin
+{
+    Box      bound;
+    uint32_t count;
+};
+
+/**
+ * Recursive binned SAH builder. Partitions a range of the primitive list in
+ * place and appends the nodes of the subtree to a node list in depth
+ * first order. Subtrees built on other threads use their own node list and
+ * are appended when the thread finishes.
+ */
+class BVHBuilder
+{
+  public:
+    BVHBuilder(BuildPrimitive *primitives) : primitives_(primitives), parallel_depth_(0)
+    {
+    }
+
+    void set_parallel_depth(uint32_t depth) { parallel_depth_ = depth; }
+
+    /**
+     * Compute the bounds of primitives [begin, end).
+     */
+    RangeBounds compute_bounds(uint32_t begin, uint32_t end) const
+    {
+        RangeBounds bounds;
+        set_empty(bounds.bound);
+        set_empty(bounds.centroid_bound);
+        for(uint32_t i = begin; i < end; i++)
+        {
+            grow(bounds.bound, primitives_[i].box);
+            grow(bounds.centroid_bound, primitives_[i].centroid);
+        }
+        return bounds;
+    }
+
+    /**
+     * Build the subtree for primitives [begin, end).
+     * @param  nodes      Node list to append to.
+     * @param  begin      First primitive (index into the primitive list).
+     * @param  end        One past the last primitive.
+     * @param  bounds     Bounds of the primitives.
+     * @param  depth      Depth of the subtree root (the root has depth 1).
+     * @param  max_depth  Set to the depth of the deepest leaf.
+     */
+    void build(std::vector<BVHNode> &nodes,
+               uint32_t              begin,
+               uint32_t              end,
+               const RangeBounds    &bounds,
+               uint32_t              depth,
+               uint32_t             &max_depth)
+    {
+        uint32_t node_index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(BVHNode());
+        set_node_bound(nodes[node_index], bounds.bound);
+
+        // The split also gives the bounds of both children
+        uint32_t    count = end - begin;
+        RangeBounds left_bounds, right_bounds;
+        uint32_t    mid = (count > 1) ? split(begin, end, bounds, depth, left_bounds, right_bounds) : begin;
+        if(mid == begin)
+        {
+            nodes[node_index].offset = begin;
+            nodes[node_index].count = count;
+            max_depth = depth;
+            return;
+        }
+
+        uint32_t left_depth, right_depth, second;
+        if(depth <= parallel_depth_ && count >= PARALLEL_MIN_PRIMITIVES)
+        {
+            // Build the second child on another thread, then append its nodes
+            std::vector<BVHNode> right_nodes;
+            std::thread          worker([&]() { build(right_nodes, mid, end, right_bounds, depth + 1, right_depth); });
+            build(nodes, begin, mid, left_bounds, depth + 1, left_depth);
+            worker.join();
+
+            second = static_cast<uint32_t>(nodes.size());
+            for(auto &node : right_nodes)
+            {
+                if(!node.is_leaf()) node.offset += second;
+            }
+            nodes.insert(nodes.end(), right_nodes.begin(), right_nodes.end());
+        }
+        else
+        {
+            build(nodes, begin, mid, left_bounds, depth + 1, left_depth);
+            second = static_cast<uint32_t>(nodes.size());
+            build(nodes, mid, end, right_bounds, depth + 1, right_depth);
+        }
+        nodes[node_index].offset = second;
+        nodes[node_index].count = 0;
+        max_depth = std::max(left_depth, right_depth);
+    }
+
+  protected:
+    BuildPrimitive *primitives_;
+    uint32_t        parallel_depth_;
+
+    /**
+     * Choose how to split primitives [begin, end) and partition them.
+     * @return  Returns the first primitive of the second child, or begin if
+     *          the node should be a leaf.
+     */
+    uint32_t split(uint32_t           begin,
+                   uint32_t           end,
+                   const RangeBounds &bounds,
+                   uint32_t           depth,
+                   RangeBounds       &left_bounds,
+                   RangeBounds       &right_bounds)
+    {
+        const Box &centroid_bound = bounds.centroid_bound;
+        uint32_t   count = end - begin;
+        uint32_t   largest_axis = 0;
+        for(uint32_t a = 1; a < 3; a++)
+        {
+            if(centroid_bound.max[a] - centroid_bound.min[a] >
+               centroid_bound.max[largest_axis] - centroid_bound.min[largest_axis])
+            {
+                largest_axis = a;
+            }
+        }
+
+        uint32_t mid = begin;
+        if(centroid_bound.max[largest_axis] <= centroid_bound.min[largest_axis])
+        {
+            // All centroids coincide: no split separates them
+            if(count <= BVH::MAX_LEAF_SIZE) return begin;
+            mid = begin + count / 2;
+        }
+        else if(depth >= MEDIAN_SPLIT_DEPTH)
+        {
+            mid = begin + count / 2;
+            std::nth_element(primitives_ + begin,
+                             primitives_ + mid,
+                             primitives_ + end,
+                             [&](const BuildPrimitive &a, const BuildPrimitive &b)
+                             { return a.centroid[largest_axis] < b.centroid[largest_axis]; });
+        }
+        if(mid != begin)
+        {
+            left_bounds = compute_bounds(begin, mid);
+            right_bounds = compute_bounds(mid, end);
+            return mid;
+        }
+
+        // Bin the centroids in one pass over the primitives. Large nodes are
+        // binned along the largest axis only (binning dominates the build
+        // time); nodes small enough to stay in cache try all 3 axes. Small
+        // nodes use fewer bins - the sweeps would otherwise dominate.
+        uint32_t bin_count = std::min(BVH::BIN_COUNT, count);
+        uint32_t first_axis = (count > ALL_AXES_MAX_PRIMITIVES) ? largest_axis : 0;
+        uint32_t last_axis = (count > ALL_AXES_MAX_PRIMITIVES) ? largest_axis : 2;
+        Bin      bins[3][BVH::BIN_COUNT];
+        float    scale[3] = {0.0f, 0.0f, 0.0f};
+        for(uint32_t axis = first_axis; axis <= last_axis; axis++)
+        {
+            float extent = centroid_bound.max[axis] - centroid_bound.min[axis];
+            scale[axis] = (extent > 0.0f) ? static_cast<float>(bin_count) / extent : 0.0f;
+            for(uint32_t b = 0; b < bin_count; b++)
+            {
+                set_empty(bins[axis][b].bound);
+                bins[axis][b].count = 0;
+            }
+        }
+        for(uint32_t i = begin; i < end; i++)
+        {
+            const Box   &box = primitives_[i].box;
+            const float *c = primitives_[i].centroid;
+            for(uint32_t axis = first_axis; axis <= last_axis; axis++)
+            {
+                Bin &bin = bins[axis][bin_index(c[axis], centroid_bound.min[axis], scale[axis], bin_count)];
+                bin.count++;
+                grow(bin.bound, box);
+            }
+        }
+
+        // Evaluate the SAH at each bin boundary:
+        // cost = area(left) * count(left) + area(right) * count(right)
+        float    best_cost = FLT_MAX;
+        uint32_t best_axis = largest_axis;
+        uint32_t best_bin = 0;
+        for(uint32_t axis = first_axis; axis <= last_axis; axis++)
+        {
+            if(scale[axis] == 0.0f) continue;
+
+            // Sweep from the right to get the cost of each right side, then
+            // from the left
+            float    right_cost[BVH::BIN_COUNT];
+            Box      right;
+            uint32_t right_count = 0;
+            set_empty(right);
+            for(uint32_t b = bin_count - 1; b > 0; b--)
+            {
+                grow(right, bins[axis][b].bound);
+                right_count += bins[axis][b].count;
+                right_cost[b] = half_area(right) * static_cast<float>(right_count);
+            }
+            Box      left;
+            uint32_t left_count = 0;
+            set_empty(left);
+            for(uint32_t b = 1; b < bin_count; b++)
+            {
+                grow(left, bins[axis][b - 1].bound);
+                left_count += bins[axis][b - 1].count;
+                if(left_count == 0 || left_count == count) continue;
+                float cost = half_area(left) * static_cast<float>(left_count) + right_cost[b];
+                if(cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+
+        // Make a leaf if it is cheaper than the best split and small enough
+        float area = half_area(bounds.bound);
+        float split_cost = (area > 0.0f) ? TRAVERSAL_COST + best_cost / area : TRAVERSAL_COST;
+        if(count <= BVH::MAX_LEAF_SIZE && split_cost >= static_cast<float>(count)) return begin;
+
+        // Partition, computing the bounds of both children on the way
+        float axis_min = centroid_bound.min[best_axis];
+        float axis_scale = scale[best_axis];
+        for(auto *child : {&left_bounds, &right_bounds})
+        {
+            set_empty(child->bound);
+            set_empty(child->centroid_bound);
+        }
+        uint32_t i = begin;
+        uint32_t j = end;
+        while(i < j)
+        {
+            if(bin_index(primitives_[i].centroid[best_axis], axis_min, axis_scale, bin_count) < best_bin)
+            {
+                grow(left_bounds.bound, primitives_[i].box);
+                grow(left_bounds.centroid_bound, primitives_[i].centroid);
+                i++;
+            }
+            else
+            {
+                j--;
+                std::swap(primitives_[i], primitives_[j]);
+                grow(right_bounds.bound, primitives_[j].box);
+                grow(right_bounds.centroid_bound, primitives_[j].centroid);
+            }
+        }
+        return i;
+    }
+
+    static uint32_t bin_index(float c, float axis_min, float scale, uint32_t bin_count)
+    {
+        uint32_t b = static_cast<uint32_t>((c - axis_min) * scale);
+        return std::min(b, bin_count - 1);
+    }
+};
+
+} // namespace
+
+BVH::BVH() : depth_(0) {}
+
+void BVH::build(const std::vector<AABB> &bounds, bool allow_threads)
+{
+    clear();
+    if(bounds.empty()) return;
+
+    // Copy the bounds and centroids to the build array. Empty boxes become
+    // a point at the origin so they cannot corrupt bins.
+    uint32_t                    count = static_cast<uint32_t>(bounds.size());
+    std::vector<BuildPrimitive> build_primitives(count);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const AABB     &b = bounds[i];
+        BuildPrimitive &p = build_primitives[i];
+        if(b.is_empty())
+        {
+            p.box = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}};
+        }
+        else
+        {
+            p.box = {{b.min_point.x, b.min_point.y, b.min_point.z}, {b.max_point.x, b.max_point.y, b.max_point.z}};
+        }
+        for(uint32_t a = 0; a < 3; a++) p.centroid[a] = 0.5f * (p.box.min[a] + p.box.max[a]);
+        p.index = i;
+    }
+
+    // Split into separate threads until there is a subtree per hardware thread
+    BVHBuilder builder(build_primitives.data());
+    if(allow_threads)
+    {
+        uint32_t parallel_depth = 0;
+        while((1u << parallel_depth) < get_thread_count()) parallel_depth++;
+        builder.set_parallel_depth(parallel_depth);
+    }
+    nodes_.reserve(2 * count - 1);
+    builder.build(nodes_, 0, count, builder.compute_bounds(0, count), 1, depth_);
+
+    // Leaves refer to ranges of the partitioned primitive order
+    primitives_.resize(count);
+    for(uint32_t i = 0; i < count; i++) primitives_[i] = build_primitives[i].index;
+}
+
+bool BVH::refit(const std::vector<AABB> &bounds)
+{
+    if(bounds.size() != primitives_.size()) return false;
+
+    // Children follow their parent, so a reverse pass visits children first
+    for(size_t n = nodes_.size(); n-- > 0;)
+    {
+        BVHNode &node = nodes_[n];
+        Box      box;
+        set_empty(box);
+        if(node.is_leaf())
+        {
+            for(uint32_t i = 0; i < node.count; i++)
+            {
+                const AABB &b = bounds[primitives_[node.offset + i]];
+                if(b.is_empty()) continue;
+                Box primitive_box = {{b.min_point.x, b.min_point.y, b.min_point.z},
+                                     {b.max_point.x, b.max_point.y, b.max_point.z}};
+                grow(box, primitive_box);
+            }
+        }
+        else
+        {
+            for(uint32_t child : {static_cast<uint32_t>(n + 1), node.offset})
+            {
+                const BVHNode &c = nodes_[child];
+                Box            child_box = {{c.min[0], c.min[1], c.min[2]}, {c.max[0], c.max[1], c.max[2]}};
+                grow(box, child_box);
+            }
+        }
+        set_node_bound(node, box);
+    }
+    return true;
+}
+
+void BVH::clear()
+{
+    nodes_.clear();
+    primitives_.clear();
+    depth_ = 0;
+}
+
+bool BVH::is_empty() const { return nodes_.empty(); }
+
+AABB BVH::get_bound() const
+{
+    if(nodes_.empty()) return AABB();
+    const BVHNode &root = nodes_[0];
+    return AABB(Point3(root.min[0], root.min[1], root.min[2]), Point3(root.max[0], root.max[1], root.max[2]));
+}
+
+const std::vector<BVHNode> &BVH::get_nodes() const { return nodes_; }
+
+const std::vector<uint32_t> &BVH::get_primitives() const { return primitives_; }
+
+uint32_t BVH::get_depth() const { return depth_; }
+
+float BVH::get_sah_cost() const
+{
+    if(nodes_.empty()) return 0.0f;
+    float root_area = half_area(nodes_[0]);
+    if(root_area <= 0.0f) return 0.0f;
+
+    float cost = 0.0f;
+    for(const auto &node : nodes_)
+    {
+        float p = half_area(node) / root_area;
+        cost += node.is_leaf() ? p * static_cast<float>(node.count) : p * TRAVERSAL_COST;
+    }
+    return cost;
+}
+
+} // namespace cg
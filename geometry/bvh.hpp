@@ -0,0 +1,461 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    bvh.hpp
+//	Purpose: Bounding volume hierarchy over a list of primitive bounding
+//           boxes. Built with the binned surface area heuristic and stored
+//           as a flat, depth first array of nodes.
+//============================================================================
+
+#ifndef __GEOMETRY_BVH_HPP__
+#define __GEOMETRY_BVH_HPP__
+
+#include "geometry/aabb.hpp"
+#include "geometry/frustum.hpp"
+#include "geometry/ray3.hpp"
+#include "geometry/triangle_kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace cg
+{
+
+/**
+ * BVH node (32 bytes, two nodes per cache line). The first child of an
+ * interior node immediately follows it in the node array; offset is the
+ * index of the second child. A leaf refers to count primitives starting at
+ * offset in the primitive index list.
+ */
+struct BVHNode
+{
+    float    min[3]; // Minimum x,y,z of the node bound
+    uint32_t offset; // Second child (interior) or first primitive (leaf)
+    float    max[3]; // Maximum x,y,z of the node bound
+    uint32_t count;  // Number of primitives (0 for interior nodes)
+
+    /**
+     * Check whether this is a leaf node.
+     * @return  Returns true if the node is a leaf.
+     */
+    bool is_leaf() const { return count > 0; }
+};
+
+/**
+ * Bounding volume hierarchy. Primitives are identified by their index in the
+ * bound list passed to build(). Queries call a function for each primitive
+ * in the leaves they reach, so the BVH can index triangles, scene instances
+ * or any other primitive with a bounding box.
+ */
+class BVH
+{
+  public:
+    static constexpr uint32_t MAX_LEAF_SIZE = 8;  // Largest leaf the SAH may choose
+    static constexpr uint32_t BIN_COUNT = 16;     // SAH bins per axis
+    static constexpr uint32_t MAX_DEPTH = 64;     // Traversal stack size
+
+    /**
+     * Constructor. Constructs an empty BVH.
+     */
+    BVH();
+
+    /**
+     * Build the hierarchy. Each node is split by the binned surface area
+     * heuristic; large subtrees are built on separate threads.
+     * @param  bounds         Bounding box of each primitive.
+     * @param  allow_threads  Allow multiple threads for large builds.
+     */
+    void build(const std::vector<AABB> &bounds, bool allow_threads = true);
+
+    /**
+     * Recompute the node bounds bottom up without changing the tree (for
+     * primitives that moved). Query performance degrades as primitives move
+     * away from where they were when built; rebuild after large changes.
+     * @param  bounds  Bounding box of each primitive (same count as build).
+     * @return  Returns false (and does nothing) if the count differs.
+     */
+    bool refit(const std::vector<AABB> &bounds);
+
+    /**
+     * Remove all nodes.
+     */
+    void clear();
+
+    /**
+     * Check whether the hierarchy is empty.
+     * @return  Returns true if there are no nodes.
+     */
+    bool is_empty() const;
+
+    /**
+     * Get the bounding box of all primitives.
+     * @return  Returns the bound of the root node (empty if there are no nodes).
+     */
+    AABB get_bound() const;
+
+    /**
+     * Get the node array. The root is node 0.
+     * @return  Returns the nodes.
+     */
+    const std::vector<BVHNode> &get_nodes() const;
+
+    /**
+     * Get the primitive indexes in leaf order.
+     * @return  Returns the primitive index list.
+     */
+    const std::vector<uint32_t> &get_primitives() const;
+
+    /**
+     * Get the depth of the deepest leaf (the root has depth 1).
+     * @return  Returns the depth of the tree.
+     */
+    uint32_t get_depth() const;
+
+    /**
+     * Get the surface area heuristic cost of the tree: the expected number of
+     * node visits plus primitive tests of a random ray that hits the root.
+     * @return  Returns the SAH cost.
+     */
+    float get_sah_cost() const;
+
+    /**
+     * Find the nearest primitive along a ray. Nodes are visited front to
+     * back and skipped when they lie beyond the nearest hit found so far.
+     * @param  ray     Ray to intersect.
+     * @param  t_max   Maximum distance along the ray. Updated to the nearest hit.
+     * @param  intersect_primitive  Called as f(primitive, t_max) for each
+     *                 primitive in a leaf the ray reaches. Returns true and
+     *                 reduces t_max if the primitive is hit closer than t_max.
+     * @return  Returns true if any primitive was hit.
+     */
+    template <typename F> bool intersect(const Ray3 &ray, float &t_max, F &&intersect_primitive) const;
+
+    /**
+     * Find the nearest primitive along a ray, testing a leaf at a time (so
+     * leaves can be tested with the 8 wide triangle kernels). Nodes are
+     * visited in the same order as intersect.
+     * @param  ray     Ray to intersect.
+     * @param  t_max   Maximum distance along the ray. Updated to the nearest hit.
+     * @param  intersect_leaf  Called as f(first, count, t_max) for each leaf
+     *                 the ray reaches, where first is the index of the leaf's
+     *                 first primitive in get_primitives(). Returns true and
+     *                 reduces t_max if a primitive is hit closer than t_max.
+     * @return  Returns true if any primitive was hit.
+     */
+    template <typename F> bool intersect_leaves(const Ray3 &ray, float &t_max, F &&intersect_leaf) const;
+
+    /**
+     * Find the nearest primitives along a packet of 8 rays. A node is visited
+     * if any ray of the packet reaches it, so the packet should hold coherent
+     * rays (for example neighbouring pixels or rays towards a light). Rays
+     * with t_max <= 0 are not used.
+     * @param  rays    Ray packet. t_max of each ray is updated to its nearest hit.
+     * @param  intersect_leaf  Called as f(first, count, rays) for each leaf
+     *                 reached by a ray of the packet (first as above). Reduces
+     *                 t_max of the rays that hit a primitive closer.
+     */
+    template <typename F> void intersect_leaves(RayPacket8 &rays, F &&intersect_leaf) const;
+
+    /**
+     * Call a function for the primitives in every leaf whose bound overlaps a
+     * box. Conservative: leaves hold several primitives, so f may be called
+     * for primitives that do not overlap the box.
+     * @param  box  Query box.
+     * @param  f    Called as f(primitive) for each candidate primitive.
+     */
+    template <typename F> void query(const AABB &box, F &&f) const;
+
+    /**
+     * Call a function for the primitives in every leaf whose bound is not
+     * outside a frustum. Planes a node is entirely inside are not tested for
+     * its children. Conservative in the same way as the box query; the
+     * planes the leaf crosses are passed so f can test the primitive against
+     * just those.
+     * @param  frustum  View frustum.
+     * @param  f        Called as f(primitive, plane_mask) for each candidate
+     *                  primitive. The plane mask is 0 if the leaf is inside.
+     */
+    template <typename F> void query(const Frustum &frustum, F &&f) const;
+
+  protected:
+    std::vector<BVHNode>  nodes_;
+    std::vector<uint32_t> primitives_;
+    uint32_t              depth_;
+
+    /**
+     * Intersect a ray (with precomputed reciprocal direction) with a node bound.
+     * @param  node     Node.
+     * @param  o        Ray origin.
+     * @param  inv_d    Reciprocal of the ray direction.
+     * @param  t_max    Maximum distance along the ray.
+     * @param  t_enter  Distance along the ray where it enters the bound.
+     * @return  Returns true if the ray enters the bound before t_max.
+     */
+    static bool intersect_node(const BVHNode &node,
+                               const float   *o,
+                               const float   *inv_d,
+                               float          t_max,
+                               float         &t_enter);
+
+    /**
+     * Intersect a ray packet (with precomputed reciprocal directions) with a
+     * node bound.
+     * @param  node   Node.
+     * @param  rays   Ray packet.
+     * @param  inv_d  Reciprocal of the ray directions (x, y, z arrays).
+     * @return  Returns true if any ray of the packet enters the bound.
+     */
+    static bool intersect_node(const BVHNode &node, const RayPacket8 &rays, const float (*inv_d)[8]);
+};
+
+inline bool BVH::intersect_node(const BVHNode &node,
+                                const float   *o,
+                                const float   *inv_d,
+                                float          t_max,
+                                float         &t_enter)
+{
+    // Slab test: intersect the parameter ranges where the ray is between
+    // each pair of axis planes
+    float t0 = 0.0f;
+    float t1 = t_max;
+    for(uint32_t i = 0; i < 3; i++)
+    {
+        float ta = (node.min[i] - o[i]) * inv_d[i];
+        float tb = (node.max[i] - o[i]) * inv_d[i];
+        t0 = std::max(t0, std::min(ta, tb));
+        t1 = std::min(t1, std::max(ta, tb));
+    }
+    t_enter = t0;
+    return t0 <= t1;
+}
+
+inline bool BVH::intersect_node(const BVHNode &node, const RayPacket8 &rays, const float (*inv_d)[8])
+{
+    // Slab test of all rays an axis at a time (the inner loops vectorize)
+    float t0[8], t1[8];
+    for(uint32_t i = 0; i < 8; i++)
+    {
+        t0[i] = 0.0f;
+        t1[i] = rays.t_max[i];
+    }
+    for(uint32_t k = 0; k < 3; k++)
+    {
+        for(uint32_t i = 0; i < 8; i++)
+        {
+            float ta = (node.min[k] - rays.o[k][i]) * inv_d[k][i];
+            float tb = (node.max[k] - rays.o[k][i]) * inv_d[k][i];
+            t0[i] = std::max(t0[i], std::min(ta, tb));
+            t1[i] = std::min(t1[i], std::max(ta, tb));
+        }
+    }
+
+    // Unused rays have t_max = 0
+    uint32_t hit = 0;
+    for(uint32_t i = 0; i < 8; i++) hit |= static_cast<uint32_t>(t0[i] <= t1[i] && t1[i] > 0.0f);
+    return hit != 0;
+}
+
+template <typename F> bool BVH::intersect(const Ray3 &ray, float &t_max, F &&intersect_primitive) const
+{
+    return intersect_leaves(ray,
+                            t_max,
+                            [&](uint32_t first, uint32_t count, float &t)
+                            {
+                                bool hit = false;
+                                for(uint32_t i = 0; i < count; i++)
+                                {
+                                    if(intersect_primitive(primitives_[first + i], t)) hit = true;
+                                }
+                                return hit;
+                            });
+}
+
+template <typename F> bool BVH::intersect_leaves(const Ray3 &ray, float &t_max, F &&intersect_leaf) const
+{
+    if(nodes_.empty()) return false;
+
+    const float o[3] = {ray.o.x, ray.o.y, ray.o.z};
+    const float inv_d[3] = {1.0f / ray.d.x, 1.0f / ray.d.y, 1.0f / ray.d.z};
+
+    float t_enter;
+    if(!intersect_node(nodes_[0], o, inv_d, t_max, t_enter)) return false;
+
+    // Each stack entry keeps the distance where the ray enters the node so
+    // nodes beyond a hit found after they were pushed are skipped
+    bool     hit = false;
+    uint32_t stack[MAX_DEPTH];
+    float    stack_t[MAX_DEPTH];
+    uint32_t stack_size = 0;
+    uint32_t index = 0;
+    while(true)
+    {
+        const BVHNode &node = nodes_[index];
+        if(node.is_leaf())
+        {
+            if(intersect_leaf(node.offset, node.count, t_max)) hit = true;
+        }
+        else
+        {
+            // Visit the nearer child first and push the other
+            uint32_t first = index + 1;
+            uint32_t second = node.offset;
+            float    t_first, t_second;
+            bool     hit_first = intersect_node(nodes_[first], o, inv_d, t_max, t_first);
+            bool     hit_second = intersect_node(nodes_[second], o, inv_d, t_max, t_second);
+            if(hit_first && hit_second)
+            {
+                if(t_second < t_first)
+                {
+                    std::swap(first, second);
+                    std::swap(t_first, t_second);
+                }
+                stack[stack_size] = second;
+                stack_t[stack_size++] = t_second;
+                index = first;
+                continue;
+            }
+            if(hit_first || hit_second)
+            {
+                index = hit_first ? first : second;
+                continue;
+            }
+        }
+
+        // Pop the next node the ray enters before the nearest hit
+        do
+        {
+            if(stack_size == 0) return hit;
+            stack_size--;
+        } while(stack_t[stack_size] > t_max);
+        index = stack[stack_size];
+    }
+}
+
+template <typename F> void BVH::intersect_leaves(RayPacket8 &rays, F &&intersect_leaf) const
+{
+    if(nodes_.empty()) return;
+
+    // Children are visited in the order the packet (on average) reaches them
+    float inv_d[3][8];
+    float dir_sum[3] = {0.0f, 0.0f, 0.0f};
+    for(uint32_t k = 0; k < 3; k++)
+    {
+        for(uint32_t i = 0; i < 8; i++)
+        {
+            inv_d[k][i] = 1.0f / rays.d[k][i];
+            if(rays.t_max[i] > 0.0f) dir_sum[k] += rays.d[k][i];
+        }
+    }
+
+    // Nodes are tested when popped so they are tested against the nearest
+    // hits found so far
+    uint32_t stack[MAX_DEPTH];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+    while(stack_size > 0)
+    {
+        const uint32_t index = stack[--stack_size];
+        const BVHNode &node = nodes_[index];
+        if(!intersect_node(node, rays, inv_d)) continue;
+
+        if(node.is_leaf())
+        {
+            intersect_leaf(node.offset, node.count, rays);
+            continue;
+        }
+
+        // Order the children along the axis that separates them the most
+        uint32_t       first = index + 1;
+        uint32_t       second = node.offset;
+        const BVHNode &a = nodes_[first];
+        const BVHNode &b = nodes_[second];
+        float          separation = 0.0f;
+        uint32_t       axis = 0;
+        for(uint32_t k = 0; k < 3; k++)
+        {
+            float diff = (b.min[k] + b.max[k]) - (a.min[k] + a.max[k]);
+            if(std::abs(diff) > std::abs(separation))
+            {
+                separation = diff;
+                axis = k;
+            }
+        }
+        if(separation * dir_sum[axis] < 0.0f) std::swap(first, second);
+        stack[stack_size++] = second;
+        stack[stack_size++] = first;
+    }
+}
+
+template <typename F> void BVH::query(const AABB &box, F &&f) const
+{
+    if(nodes_.empty() || box.is_empty()) return;
+
+    uint32_t stack[MAX_DEPTH];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+    while(stack_size > 0)
+    {
+        const uint32_t index = stack[--stack_size];
+        const BVHNode &node = nodes_[index];
+        if(node.min[0] > box.max_point.x || node.max[0] < box.min_point.x ||
+           node.min[1] > box.max_point.y || node.max[1] < box.min_point.y ||
+           node.min[2] > box.max_point.z || node.max[2] < box.min_point.z)
+        {
+            continue;
+        }
+        if(node.is_leaf())
+        {
+            for(uint32_t i = 0; i < node.count; i++) f(primitives_[node.offset + i]);
+        }
+        else
+        {
+            stack[stack_size++] = node.offset;
+            stack[stack_size++] = index + 1;
+        }
+    }
+}
+
+template <typename F> void BVH::query(const Frustum &frustum, F &&f) const
+{
+    if(nodes_.empty()) return;
+
+    uint32_t stack[MAX_DEPTH];
+    uint32_t masks[MAX_DEPTH];
+    uint32_t stack_size = 0;
+    stack[stack_size] = 0;
+    masks[stack_size++] = Frustum::ALL_PLANES;
+    while(stack_size > 0)
+    {
+        stack_size--;
+        const uint32_t index = stack[stack_size];
+        uint32_t       plane_mask = masks[stack_size];
+        const BVHNode &node = nodes_[index];
+        if(plane_mask != 0)
+        {
+            AABB bound(Point3(node.min[0], node.min[1], node.min[2]),
+                       Point3(node.max[0], node.max[1], node.max[2]));
+            if(frustum.test(bound, plane_mask) == FrustumTest::OUTSIDE) continue;
+        }
+        if(node.is_leaf())
+        {
+            for(uint32_t i = 0; i < node.count; i++) f(primitives_[node.offset + i], plane_mask);
+        }
+        else
+        {
+            stack[stack_size] = node.offset;
+            masks[stack_size++] = plane_mask;
+            stack[stack_size] = index + 1;
+            masks[stack_size++] = plane_mask;
+        }
+    }
+}
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,79 @@
+#include "geometry/frustum.hpp"
+
+#include "geometry/geometry.hpp"
+
+#include <cmath>
+
+namespace cg
+{
+
+Frustum::Frustum()
+{
+    // solve() returns 1 for every point
+    for(auto &plane : planes)
+    {
+        plane.a = 0.0f;
+        plane.b = 0.0f;
+        plane.c = 0.0f;
+        plane.d = -1.0f;
+    }
+}
+
+Frustum::Frustum(const Matrix4x4 &pv) { set(pv); }
+
+void Frustum::set(const Matrix4x4 &pv)
+{
+    // A point is inside the clip volume if -w <= x, y, z <= w. In terms of the
+    // rows of PV each inequality is a plane: row 3 + row i >= 0 and
+    // row 3 - row i >= 0. Plane::solve subtracts d so d is negated.
+    for(uint32_t i = 0; i < 3; i++)
+    {
+        for(uint32_t side = 0; side < 2; side++)
+        {
+            float  s = (side == 0) ? 1.0f : -1.0f;
+            Plane &plane = planes[i * 2 + side];
+            plane.a = pv.m(3, 0) + s * pv.m(i, 0);
+            plane.b = pv.m(3, 1) + s * pv.m(i, 1);
+            plane.c = pv.m(3, 2) + s * pv.m(i, 2);
+            plane.d = -(pv.m(3, 3) + s * pv.m(i, 3));
+            plane.normalize();
+        }
+    }
+}
+
+FrustumTest Frustum::test(const AABB &box, uint32_t &plane_mask) const
+{
+    if(box.is_empty()) return FrustumTest::OUTSIDE;
+
+    for(uint32_t i = 0; i < 6; i++)
+    {
+        if((plane_mask & (1u << i)) == 0) continue;
+
+        // Signed distance of the center and the projected radius of the box
+        const Plane &plane = planes[i];
+        float        s = plane.solve(box.center);
+        float        r = std::abs(plane.a) * box.half_diagonal.x +
+                  std::abs(plane.b) * box.half_diagonal.y +
+                  std::abs(plane.c) * box.half_diagonal.z;
+        if(s + r < 0.0f) return FrustumTest::OUTSIDE;
+        if(s - r >= 0.0f) plane_mask &= ~(1u << i);
+    }
+    return (plane_mask == 0) ? FrustumTest::INSIDE : FrustumTest::INTERSECTS;
+}
+
+bool Frustum::is_outside(const AABB &box) const
+{
+    uint32_t plane_mask = ALL_PLANES;
+    return test(box, plane_mask) == FrustumTest::OUTSIDE;
+}
+
+bool Frustum::is_outside(const BoundingSphere &sphere) const
+{
+    for(const auto &plane : planes)
+    {
+        if(plane.solve(sphere.center) < -sphere.radius) return true;
+    }
+    return false;
+}
+
+} // namespace cg
@@ -0,0 +1,90 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    frustum.hpp
+//	Purpose: View frustum (6 planes) used to cull bounding volumes.
+//============================================================================
+
+#ifndef __GEOMETRY_FRUSTUM_HPP__
+#define __GEOMETRY_FRUSTUM_HPP__
+
+#include "geometry/aabb.hpp"
+#include "geometry/bounding_sphere.hpp"
+#include "geometry/plane.hpp"
+
+#include <cstdint>
+
+namespace cg
+{
+
+class Matrix4x4;
+
+/**
+ * Result of testing a bounding volume against the frustum.
+ */
+enum class FrustumTest
+{
+    OUTSIDE = 0, // Entirely outside at least one plane
+    INTERSECTS,  // Crosses one or more planes
+    INSIDE       // Entirely inside all planes
+};
+
+/**
+ * View frustum: left, right, bottom, top, near and far planes with normals
+ * pointing into the frustum. The default frustum contains everything.
+ */
+struct Frustum
+{
+    static constexpr uint32_t ALL_PLANES = 0x3F; // Bit mask of all 6 planes
+
+    Plane planes[6];
+
+    /**
+     * Default constructor. Every point is inside.
+     */
+    Frustum();
+
+    /**
+     * Construct the frustum from a projection and view matrix.
+     * @param  pv  Composite projection and view matrix.
+     */
+    Frustum(const Matrix4x4 &pv);
+
+    /**
+     * Extract the planes from a composite projection and view matrix (Gribb
+     * and Hartmann). Planes are in world coordinates and normalized.
+     * @param  pv  Composite projection and view matrix.
+     */
+    void set(const Matrix4x4 &pv);
+
+    /**
+     * Test a box against the planes in a plane mask. Planes the box is
+     * entirely inside are removed from the mask so children of the box need
+     * not test them (hierarchical culling).
+     * @param  box         Box (world coordinates).
+     * @param  plane_mask  Planes to test (bit i is plane i). Updated.
+     * @return  Returns OUTSIDE, INTERSECTS or INSIDE.
+     */
+    FrustumTest test(const AABB &box, uint32_t &plane_mask) const;
+
+    /**
+     * Check whether a box is entirely outside the frustum.
+     * @param  box  Box (world coordinates).
+     * @return  Returns true if the box is outside.
+     */
+    bool is_outside(const AABB &box) const;
+
+    /**
+     * Check whether a sphere is entirely outside the frustum.
+     * @param  sphere  Sphere (world coordinates).
+     * @return  Returns true if the sphere is outside.
+     */
+    bool is_outside(const BoundingSphere &sphere) const;
+};
+
+} // namespace cg
+
+#endif
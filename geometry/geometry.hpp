@@ -72,10 +72,16 @@ float fast_inv_sqrt(float x);
 #include "geometry/plane.hpp"
 #include "geometry/aabb.hpp"
 #include "geometry/bounding_sphere.hpp"
+#include "geometry/frustum.hpp"
 #include "geometry/ray3.hpp"
+#include "geometry/bvh.hpp"
 #include "geometry/noise.hpp"
 #include "geometry/matrix.hpp"
+#include "geometry/matrix_kernels.hpp"
+#include "geometry/triangle_kernels.hpp"
 #include "geometry/types.hpp"
+#include "geometry/mesh_optimizer.hpp"
+#include "geometry/vertex_packing.hpp"
 // clang-format on
 
 #endif
@@ -1,7 +1,10 @@
 #include "geometry/matrix.hpp"
 
 #include "geometry/geometry.hpp"
+#include "geometry/matrix_kernels.hpp"
+#include "geometry/parallel.hpp"
 
+#include <algorithm>
 #include <cmath>
 
 namespace cg
@@ -10,67 +13,21 @@ namespace cg
 // Forward declare logging function
 void logmsg(const char *message, ...);
 
-Matrix4x4::Matrix4x4() { set_identity(); }
+// Batched transforms treat arrays of points and vectors as packed floats
+static_assert(sizeof(Point3) == 3 * sizeof(float), "Point3 must be 3 packed floats");
+static_assert(sizeof(Vector3) == 3 * sizeof(float), "Vector3 must be 3 packed floats");
+static_assert(sizeof(HPoint3) == 4 * sizeof(float), "HPoint3 must be 4 packed floats");
 
-void Matrix4x4::set_identity()
-{
-    a_[0] = 1.0f;
-    a_[4] = 0.0f;
-    a_[8] = 0.0f;
-    a_[12] = 0.0f;
-    a_[1] = 0.0f;
-    a_[5] = 1.0f;
-    a_[9] = 0.0f;
-    a_[13] = 0.0f;
-    a_[2] = 0.0f;
-    a_[6] = 0.0f;
-    a_[10] = 1.0f;
-    a_[14] = 0.0f;
-    a_[3] = 0.0f;
-    a_[7] = 0.0f;
-    a_[11] = 0.0f;
-    a_[15] = 1.0f;
-}
+// Minimum number of elements per thread for batched transforms
+static constexpr size_t TRANSFORM_MIN_BLOCK = 32768;
 
-Matrix4x4::Matrix4x4(const Matrix4x4 &n)
-{
-    m00() = n.m00();
-    m01() = n.m01();
-    m02() = n.m02();
-    m03() = n.m03();
-    m10() = n.m10();
-    m11() = n.m11();
-    m12() = n.m12();
-    m13() = n.m13();
-    m20() = n.m20();
-    m21() = n.m21();
-    m22() = n.m22();
-    m23() = n.m23();
-    m30() = n.m30();
-    m31() = n.m31();
-    m32() = n.m32();
-    m33() = n.m33();
-}
+Matrix4x4::Matrix4x4() { set_identity(); }
 
-Matrix4x4 &Matrix4x4::operator=(const Matrix4x4 &n)
+void Matrix4x4::set_identity()
 {
-    m00() = n.m00();
-    m01() = n.m01();
-    m02() = n.m02();
-    m03() = n.m03();
-    m10() = n.m10();
-    m11() = n.m11();
-    m12() = n.m12();
-    m13() = n.m13();
-    m20() = n.m20();
-    m21() = n.m21();
-    m22() = n.m22();
-    m23() = n.m23();
-    m30() = n.m30();
-    m31() = n.m31();
-    m32() = n.m32();
-    m33() = n.m33();
-    return *this;
+    // Assign whole columns (vector stores) rather than single elements
+    a_ = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    type_ = MatrixType::RIGID;
 }
 
 bool Matrix4x4::operator==(const Matrix4x4 &n) const
@@ -84,121 +41,47 @@ bool Matrix4x4::operator==(const Matrix4x4 &n) const
 void Matrix4x4::set(const float *m)
 {
     for(size_t i = 0; i < 16; i++) a_[i] = m[i];
-}
 
-const float *Matrix4x4::get() const { return a_.data(); }
-
-// Read-only access functions
-float Matrix4x4::m00() const { return a_[0]; }
-float Matrix4x4::m01() const { return a_[4]; }
-float Matrix4x4::m02() const { return a_[8]; }
-float Matrix4x4::m03() const { return a_[12]; }
-float Matrix4x4::m10() const { return a_[1]; }
-float Matrix4x4::m11() const { return a_[5]; }
-float Matrix4x4::m12() const { return a_[9]; }
-float Matrix4x4::m13() const { return a_[13]; }
-float Matrix4x4::m20() const { return a_[2]; }
-float Matrix4x4::m21() const { return a_[6]; }
-float Matrix4x4::m22() const { return a_[10]; }
-float Matrix4x4::m23() const { return a_[14]; }
-float Matrix4x4::m30() const { return a_[3]; }
-float Matrix4x4::m31() const { return a_[7]; }
-float Matrix4x4::m32() const { return a_[11]; }
-float Matrix4x4::m33() const { return a_[15]; }
-
-// Read-write access functions
-float &Matrix4x4::m00() { return a_[0]; }
-float &Matrix4x4::m01() { return a_[4]; }
-float &Matrix4x4::m02() { return a_[8]; }
-float &Matrix4x4::m03() { return a_[12]; }
-float &Matrix4x4::m10() { return a_[1]; }
-float &Matrix4x4::m11() { return a_[5]; }
-float &Matrix4x4::m12() { return a_[9]; }
-float &Matrix4x4::m13() { return a_[13]; }
-float &Matrix4x4::m20() { return a_[2]; }
-float &Matrix4x4::m21() { return a_[6]; }
-float &Matrix4x4::m22() { return a_[10]; }
-float &Matrix4x4::m23() { return a_[14]; }
-float &Matrix4x4::m30() { return a_[3]; }
-float &Matrix4x4::m31() { return a_[7]; }
-float &Matrix4x4::m32() { return a_[11]; }
-float &Matrix4x4::m33() { return a_[15]; }
-
-float Matrix4x4::m(uint32_t row, uint32_t col) const
-{
-    return (row < 4 && col < 4) ? a_[col * 4 + row] : 0.0f;
-}
-
-float &Matrix4x4::m(uint32_t row, uint32_t col)
-{
-    return (row < 4 && col < 4) ? a_[col * 4 + row] : a_[0];
+    // Affine if the bottom row is 0 0 0 1, otherwise the type is unknown
+    type_ = (a_[3] == 0.0f && a_[7] == 0.0f && a_[11] == 0.0f && a_[15] == 1.0f) ? MatrixType::AFFINE
+                                                                                   : MatrixType::GENERAL;
 }
 
 Matrix4x4 Matrix4x4::operator*(const Matrix4x4 &n) const
 {
-    // Unroll the loop, do 1 row at a time.
     Matrix4x4 t;
-    float     a0 = m00();
-    float     a1 = m01();
-    float     a2 = m02();
-    float     a3 = m03();
-    t.m00() = a0 * n.m00() + a1 * n.m10() + a2 * n.m20() + a3 * n.m30();
-    t.m01() = a0 * n.m01() + a1 * n.m11() + a2 * n.m21() + a3 * n.m31();
-    t.m02() = a0 * n.m02() + a1 * n.m12() + a2 * n.m22() + a3 * n.m32();
-    t.m03() = a0 * n.m03() + a1 * n.m13() + a2 * n.m23() + a3 * n.m33();
-    a0 = m10();
-    a1 = m11();
-    a2 = m12();
-    a3 = m13();
-    t.m10() = a0 * n.m00() + a1 * n.m10() + a2 * n.m20() + a3 * n.m30();
-    t.m11() = a0 * n.m01() + a1 * n.m11() + a2 * n.m21() + a3 * n.m31();
-    t.m12() = a0 * n.m02() + a1 * n.m12() + a2 * n.m22() + a3 * n.m32();
-    t.m13() = a0 * n.m03() + a1 * n.m13() + a2 * n.m23() + a3 * n.m33();
-    a0 = m20();
-    a1 = m21();
-    a2 = m22();
-    a3 = m23();
-    t.m20() = a0 * n.m00() + a1 * n.m10() + a2 * n.m20() + a3 * n.m30();
-    t.m21() = a0 * n.m01() + a1 * n.m11() + a2 * n.m21() + a3 * n.m31();
-    t.m22() = a0 * n.m02() + a1 * n.m12() + a2 * n.m22() + a3 * n.m32();
-    t.m23() = a0 * n.m03() + a1 * n.m13() + a2 * n.m23() + a3 * n.m33();
-    a0 = m30();
-    a1 = m31();
-    a2 = m32();
-    a3 = m33();
-    t.m30() = a0 * n.m00() + a1 * n.m10() + a2 * n.m20() + a3 * n.m30();
-    t.m31() = a0 * n.m01() + a1 * n.m11() + a2 * n.m21() + a3 * n.m31();
-    t.m32() = a0 * n.m02() + a1 * n.m12() + a2 * n.m22() + a3 * n.m32();
-    t.m33() = a0 * n.m03() + a1 * n.m13() + a2 * n.m23() + a3 * n.m33();
+    get_matrix_kernels().mul(a_.data(), n.a_.data(), t.a_.data());
+    t.type_ = std::max(type_, n.type_);
     return t;
 }
 
 Matrix4x4 &Matrix4x4::operator*=(const Matrix4x4 &n)
 {
-    *this = *this * n;
+    get_matrix_kernels().mul(a_.data(), n.a_.data(), a_.data());
+    type_ = std::max(type_, n.type_);
     return *this;
 }
 
 Matrix4x4 &Matrix4x4::operator*=(float s)
 {
     for(size_t r = 0; r < 16; r++) a_[r] *= s;
+    type_ = MatrixType::GENERAL;
     return *this;
 }
 
 HPoint3 Matrix4x4::operator*(const HPoint3 &v) const
 {
-    return HPoint3((a_[0] * v.x + a_[4] * v.y + a_[8] * v.z + a_[12] * v.w),
-                   (a_[1] * v.x + a_[5] * v.y + a_[9] * v.z + a_[13] * v.w),
-                   (a_[2] * v.x + a_[6] * v.y + a_[10] * v.z + a_[14] * v.w),
-                   (a_[3] * v.x + a_[7] * v.y + a_[11] * v.z + a_[15] * v.w));
+    HPoint3 t;
+    get_matrix_kernels().transform(a_.data(), &v.x, &t.x);
+    return t;
 }
 
 HPoint3 Matrix4x4::operator*(const Point3 &v) const
 {
-    return HPoint3((a_[0] * v.x + a_[4] * v.y + a_[8] * v.z + a_[12]),
-                   (a_[1] * v.x + a_[5] * v.y + a_[9] * v.z + a_[13]),
-                   (a_[2] * v.x + a_[6] * v.y + a_[10] * v.z + a_[14]),
-                   (a_[3] * v.x + a_[7] * v.y + a_[11] * v.z + a_[15]));
+    float   p[4] = {v.x, v.y, v.z, 1.0f};
+    HPoint3 t;
+    get_matrix_kernels().transform(a_.data(), p, &t.x);
+    return t;
 }
 
 Vector3 Matrix4x4::operator*(const Vector3 &v) const
@@ -208,33 +91,94 @@ Vector3 Matrix4x4::operator*(const Vector3 &v) const
                    (a_[2] * v.x + a_[6] * v.y + a_[10] * v.z));
 }
 
+void Matrix4x4::transform_points(const Point3 *in, Point3 *out, size_t count, bool allow_threads) const
+{
+    const float *src = reinterpret_cast<const float *>(in);
+    float       *dst = reinterpret_cast<float *>(out);
+    parallel_for(count, allow_threads ? TRANSFORM_MIN_BLOCK : count,
+                 [&](size_t begin, size_t end)
+                 {
+                     if(type_ != MatrixType::GENERAL)
+                     {
+                         get_matrix_kernels().transform_points(a_.data(), src + begin * 3, dst + begin * 3,
+                                                               end - begin);
+                         return;
+                     }
+
+                     // Projective: divide by w
+                     for(size_t i = begin; i < end; i++) out[i] = Point3(*this * in[i]);
+                 });
+}
+
+void Matrix4x4::transform_points(const float *x,
+                                 const float *y,
+                                 const float *z,
+                                 float       *out_x,
+                                 float       *out_y,
+                                 float       *out_z,
+                                 size_t       count,
+                                 bool         allow_threads) const
+{
+    parallel_for(count, allow_threads ? TRANSFORM_MIN_BLOCK : count,
+                 [&](size_t begin, size_t end)
+                 {
+                     if(type_ != MatrixType::GENERAL)
+                     {
+                         get_matrix_kernels().transform_points_soa(a_.data(), x + begin, y + begin, z + begin,
+                                                                   out_x + begin, out_y + begin, out_z + begin,
+                                                                   end - begin);
+                         return;
+                     }
+
+                     // Projective: divide by w
+                     for(size_t i = begin; i < end; i++)
+                     {
+                         Point3 p(*this * Point3(x[i], y[i], z[i]));
+                         out_x[i] = p.x;
+                         out_y[i] = p.y;
+                         out_z[i] = p.z;
+                     }
+                 });
+}
+
+void Matrix4x4::transform_vectors(const Vector3 *in, Vector3 *out, size_t count, bool allow_threads) const
+{
+    const float *src = reinterpret_cast<const float *>(in);
+    float       *dst = reinterpret_cast<float *>(out);
+    parallel_for(count, allow_threads ? TRANSFORM_MIN_BLOCK : count,
+                 [&](size_t begin, size_t end)
+                 {
+                     get_matrix_kernels().transform_vectors(a_.data(), src + begin * 3, dst + begin * 3,
+                                                            end - begin);
+                 });
+}
+
+void Matrix4x4::transform_hpoints(const HPoint3 *in, HPoint3 *out, size_t count, bool allow_threads) const
+{
+    const float *src = reinterpret_cast<const float *>(in);
+    float       *dst = reinterpret_cast<float *>(out);
+    parallel_for(count, allow_threads ? TRANSFORM_MIN_BLOCK : count,
+                 [&](size_t begin, size_t end)
+                 {
+                     get_matrix_kernels().transform_hpoints(a_.data(), src + begin * 4, dst + begin * 4,
+                                                            end - begin);
+                 });
+}
+
 Ray3 Matrix4x4::operator*(const Ray3 &ray) const { return Ray3(*this * ray.o, *this * ray.d); }
 
 Matrix4x4 &Matrix4x4::transpose()
 {
-    *this = get_transpose();
+    get_matrix_kernels().transpose(a_.data(), a_.data());
+    type_ = MatrixType::GENERAL;
     return *this;
 }
 
 Matrix4x4 Matrix4x4::get_transpose() const
 {
     Matrix4x4 t;
-    t.m00() = m00();
-    t.m01() = m10();
-    t.m02() = m20();
-    t.m03() = m30();
-    t.m10() = m01();
-    t.m11() = m11();
-    t.m12() = m21();
-    t.m13() = m31();
-    t.m20() = m02();
-    t.m21() = m12();
-    t.m22() = m22();
-    t.m23() = m32();
-    t.m30() = m03();
-    t.m31() = m13();
-    t.m32() = m23();
-    t.m33() = m33();
+    get_matrix_kernels().transpose(a_.data(), t.a_.data());
+    t.type_ = MatrixType::GENERAL;
     return t;
 }
 
@@ -245,6 +189,7 @@ void Matrix4x4::translate(float x, float y, float z)
     t.m03() = x;
     t.m13() = y;
     t.m23() = z;
+    t.type_ = MatrixType::RIGID;
 
     // Right-multiply the current matrix
     *this *= t;
@@ -257,6 +202,7 @@ void Matrix4x4::scale(float x, float y, float z)
     s.m00() = x;
     s.m11() = y;
     s.m22() = z;
+    s.type_ = (x == y && y == z) ? MatrixType::UNIFORM_SCALE : MatrixType::AFFINE;
 
     // Right-multiply the current matrix
     *this *= s;
@@ -306,6 +252,7 @@ void Matrix4x4::rotate(float angle, float x, float y, float z)
     r.m21() = 2.0f * b * c + 2.0f * s * a;
     r.m22() = 1.0f - 2.0f * a * a - 2.0f * b * b;
     r.m33() = 1.0f;
+    r.type_ = MatrixType::RIGID;
 
     // Right-multiply the current matrix
     *this *= r;
@@ -322,6 +269,7 @@ void Matrix4x4::rotate_x(float angle)
     r.m12() = -sina;
     r.m21() = sina;
     r.m22() = cosa;
+    r.type_ = MatrixType::RIGID;
 
     // Right-multiply the current matrix
     *this *= r;
@@ -338,6 +286,7 @@ void Matrix4x4::rotate_y(float angle)
     r.m02() = sina;
     r.m20() = -sina;
     r.m22() = cosa;
+    r.type_ = MatrixType::RIGID;
 
     // Right-multiply the current matrix
     *this *= r;
@@ -354,6 +303,7 @@ void Matrix4x4::rotate_z(float angle)
     r.m01() = -sina;
     r.m10() = sina;
     r.m11() = cosa;
+    r.type_ = MatrixType::RIGID;
 
     // Right-multiply the current matrix
     *this *= r;
@@ -361,68 +311,78 @@ void Matrix4x4::rotate_z(float angle)
 
 Matrix4x4 Matrix4x4::get_inverse() const
 {
-    int32_t   j, k;
-    int32_t   ind;
-    float     v1, v2;
-    Matrix4x4 t = *this;
+    // Rigid: the inverse rotation is the transpose, and the inverse
+    // translation is the inverse rotation applied to the negated translation
     Matrix4x4 b;
-    for(int32_t i = 0; i < 4; i++)
+    if(type_ == MatrixType::RIGID)
     {
-        // Find pivot
-        v1 = t.m(i, i);
-        ind = i;
-        for(j = i + 1; j < 4; j++)
+        for(uint32_t r = 0; r < 3; r++)
         {
-            if(std::abs(t.m(j, i)) > std::abs(v1))
-            {
-                ind = j;
-                v1 = t.m(j, i);
-            }
+            for(uint32_t c = 0; c < 3; c++) b.a_[c * 4 + r] = a_[r * 4 + c];
         }
+        b.a_[12] = -(b.a_[0] * a_[12] + b.a_[4] * a_[13] + b.a_[8] * a_[14]);
+        b.a_[13] = -(b.a_[1] * a_[12] + b.a_[5] * a_[13] + b.a_[9] * a_[14]);
+        b.a_[14] = -(b.a_[2] * a_[12] + b.a_[6] * a_[13] + b.a_[10] * a_[14]);
+        return b;
+    }
 
-        // Swap columns
-        if(ind != i)
-        {
-            for(j = 0; j < 4; j++)
-            {
-                v2 = b.m(i, j);
-                b.m(i, j) = b.m(ind, j);
-                b.m(ind, j) = v2;
-                v2 = t.m(i, j);
-                t.m(i, j) = t.m(ind, j);
-                t.m(ind, j) = v2;
-            }
-        }
+    if(type_ != MatrixType::GENERAL) return get_affine_inverse();
 
-        // The matrix is singular (has no inverse), set the inverse
-        // to the identity matrix.
-        if(v1 == 0.0f)
-        {
-            logmsg("InvertMatrix: Singular matrix");
-            b.set_identity();
-            return b;
-        }
+    // If the matrix is singular (has no inverse) the kernel leaves the
+    // inverse set to the identity matrix.
+    if(!get_matrix_kernels().inverse(a_.data(), b.a_.data()))
+    {
+        logmsg("InvertMatrix: Singular matrix");
+    }
+    b.type_ = MatrixType::GENERAL;
+    return b;
+}
+
+Matrix4x4 Matrix4x4::get_affine_inverse() const
+{
+    Matrix4x4 b;
+    if(!get_matrix_kernels().affine_inverse(a_.data(), b.a_.data()))
+    {
+        logmsg("InvertMatrix: Singular matrix");
+        return b;
+    }
+    b.type_ = (type_ == MatrixType::GENERAL) ? MatrixType::AFFINE : type_;
+    return b;
+}
+
+Matrix4x4 Matrix4x4::get_normal_matrix() const
+{
+    if(type_ == MatrixType::GENERAL) return get_inverse().transpose();
 
-        for(j = 0; j < 4; j++)
+    Matrix4x4 n;
+    if(type_ == MatrixType::AFFINE)
+    {
+        if(!get_matrix_kernels().normal_matrix(a_.data(), n.a_.data()))
         {
-            t.m(i, j) /= v1;
-            b.m(i, j) /= v1;
+            logmsg("InvertMatrix: Singular matrix");
+            return n;
         }
+        n.type_ = MatrixType::AFFINE;
+        return n;
+    }
 
-        // Eliminate column
-        for(j = 0; j < 4; j++)
+    // Rigid: the rotation is its own inverse transpose. Uniform scale s: the
+    // inverse transpose of sR is R / s, which is (sR) / s^2. The bottom row
+    // of an affine matrix is 0 0 0 1 so whole columns can be scaled.
+    float f = 1.0f;
+    if(type_ == MatrixType::UNIFORM_SCALE)
+    {
+        float s2 = a_[0] * a_[0] + a_[1] * a_[1] + a_[2] * a_[2];
+        if(s2 == 0.0f)
         {
-            if(j == i) continue;
-
-            v1 = t.m(j, i);
-            for(k = 0; k < 4; k++)
-            {
-                t.m(j, k) -= t.m(i, k) * v1;
-                b.m(j, k) -= b.m(i, k) * v1;
-            }
+            logmsg("InvertMatrix: Singular matrix");
+            return n;
         }
+        f = 1.0f / s2;
     }
-    return b;
+    for(uint32_t i = 0; i < 12; i++) n.a_[i] = a_[i] * f;
+    n.type_ = type_;
+    return n;
 }
 
 void Matrix4x4::log(const char *str) const
@@ -17,15 +17,41 @@
 #include "vector3.hpp"
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 
+// Alignment of matrix storage in bytes (16 for SSE/NEON, 32 for AVX)
+#ifndef CG_MATRIX_ALIGNMENT
+#define CG_MATRIX_ALIGNMENT 16
+#endif
+
 namespace cg
 {
 
+/**
+ * Kind of transformation a matrix is known to represent. Types are ordered so
+ * the type of a product is the larger of the types of its factors.
+ */
+enum class MatrixType : uint8_t
+{
+    RIGID = 0,     // Rotation and translation only
+    UNIFORM_SCALE, // Rotation, translation and uniform scaling
+    AFFINE,        // Bottom row is 0 0 0 1
+    GENERAL        // Unknown (for example a projection)
+};
+
 /**
  * 4x4 matrix. All matrix elements (row, col) are indexed base 0.
+ * Multiplication, inversion, transposition and transformation of
+ * homogeneous points use the SIMD kernels selected at startup
+ * (see matrix_kernels.hpp).
+ *
+ * The matrix tracks its MatrixType. Matrices built with set_identity,
+ * translate, rotate and scale are known to be affine, so inverses and normal
+ * matrices can use 3x3 methods. Writing elements directly (the read-write
+ * access functions or set) makes the type GENERAL unless set_type is called.
  */
-class Matrix4x4
+class alignas(CG_MATRIX_ALIGNMENT) Matrix4x4
 {
   public:
     /**
@@ -65,6 +91,20 @@ class Matrix4x4
      */
     void set(const float *m);
 
+    /**
+     * Gets the type of transformation this matrix is known to represent.
+     * @return  Returns the matrix type.
+     */
+    MatrixType get_type() const;
+
+    /**
+     * Sets the type of transformation this matrix represents. Use after
+     * setting elements directly when the type is known (for example a view
+     * matrix is rigid).
+     * @param  type  Matrix type.
+     */
+    void set_type(MatrixType type);
+
     /**
      * Gets the matrix (can be passed to OpenGL - GLSL mat4)
      * @return   Returns the elements of this matrix in column order.
@@ -170,6 +210,58 @@ class Matrix4x4
      */
     Vector3 operator*(const Vector3 &v) const;
 
+    /**
+     * Transforms an array of points. Each result equals Point3(m * in[i]): if
+     * the matrix is not affine the result is divided by w. Uses the SIMD
+     * kernels and, for large arrays, multiple threads.
+     * @param  in             Points to transform.
+     * @param  out            Transformed points (may be the same array as in).
+     * @param  count          Number of points.
+     * @param  allow_threads  Allow multiple threads for large arrays.
+     */
+    void transform_points(const Point3 *in, Point3 *out, size_t count, bool allow_threads = true) const;
+
+    /**
+     * Transforms an array of points stored as separate x, y, z arrays (SoA).
+     * Each result equals Point3(m * p): if the matrix is not affine the
+     * result is divided by w.
+     * @param  x              x coordinates to transform.
+     * @param  y              y coordinates to transform.
+     * @param  z              z coordinates to transform.
+     * @param  out_x          Transformed x coordinates (may be the same array as x).
+     * @param  out_y          Transformed y coordinates (may be the same array as y).
+     * @param  out_z          Transformed z coordinates (may be the same array as z).
+     * @param  count          Number of points.
+     * @param  allow_threads  Allow multiple threads for large arrays.
+     */
+    void transform_points(const float *x,
+                          const float *y,
+                          const float *z,
+                          float       *out_x,
+                          float       *out_y,
+                          float       *out_z,
+                          size_t       count,
+                          bool         allow_threads = true) const;
+
+    /**
+     * Transforms an array of vectors (normals or directions). Only the upper
+     * 3x3 portion of the matrix is used (no translation).
+     * @param  in             Vectors to transform.
+     * @param  out            Transformed vectors (may be the same array as in).
+     * @param  count          Number of vectors.
+     * @param  allow_threads  Allow multiple threads for large arrays.
+     */
+    void transform_vectors(const Vector3 *in, Vector3 *out, size_t count, bool allow_threads = true) const;
+
+    /**
+     * Transforms an array of homogeneous points.
+     * @param  in             Points to transform.
+     * @param  out            Transformed points (may be the same array as in).
+     * @param  count          Number of points.
+     * @param  allow_threads  Allow multiple threads for large arrays.
+     */
+    void transform_hpoints(const HPoint3 *in, HPoint3 *out, size_t count, bool allow_threads = true) const;
+
     /**
      * Transforms a ray by the matrix.  Transforms the ray origin and
      * ray direction.
@@ -251,6 +343,23 @@ class Matrix4x4
      */
     Matrix4x4 get_inverse() const;
 
+    /**
+     * Calculates the inverse of the current matrix assuming it is affine
+     * (the bottom row is 0 0 0 1). Faster than get_inverse.
+     * @return  Returns the inverse of the current matrix.
+     */
+    Matrix4x4 get_affine_inverse() const;
+
+    /**
+     * Calculates the normal matrix: the transpose of the inverse of the upper
+     * 3x3 portion (the 4th row and column are those of the identity). Rigid
+     * matrices use the rotation directly, uniform scale matrices the rotation
+     * divided by the square of the scale and other affine matrices a 3x3
+     * inverse transpose. Only general matrices require a 4x4 inverse.
+     * @return  Returns the normal matrix.
+     */
+    Matrix4x4 get_normal_matrix() const;
+
     /**
      * Logs a message followed by the matrix.
      * @param   str   String to print to log file
@@ -259,9 +368,83 @@ class Matrix4x4
 
   private:
     // Elements of the matrix. Column order.
-    std::array<float, 16> a_;
+    alignas(CG_MATRIX_ALIGNMENT) std::array<float, 16> a_;
+
+    MatrixType type_;
+
+    // Writable element (column order). The matrix type is no longer known.
+    float &general_element(uint32_t index);
 };
 
+// Copying and element access are inlined - they are used in every matrix operation
+
+inline Matrix4x4::Matrix4x4(const Matrix4x4 &n) : a_(n.a_), type_(n.type_) {}
+
+inline Matrix4x4 &Matrix4x4::operator=(const Matrix4x4 &n)
+{
+    a_ = n.a_;
+    type_ = n.type_;
+    return *this;
+}
+
+inline MatrixType Matrix4x4::get_type() const { return type_; }
+
+inline void Matrix4x4::set_type(MatrixType type) { type_ = type; }
+
+inline const float *Matrix4x4::get() const { return a_.data(); }
+
+// Read-only access functions
+inline float Matrix4x4::m00() const { return a_[0]; }
+inline float Matrix4x4::m01() const { return a_[4]; }
+inline float Matrix4x4::m02() const { return a_[8]; }
+inline float Matrix4x4::m03() const { return a_[12]; }
+inline float Matrix4x4::m10() const { return a_[1]; }
+inline float Matrix4x4::m11() const { return a_[5]; }
+inline float Matrix4x4::m12() const { return a_[9]; }
+inline float Matrix4x4::m13() const { return a_[13]; }
+inline float Matrix4x4::m20() const { return a_[2]; }
+inline float Matrix4x4::m21() const { return a_[6]; }
+inline float Matrix4x4::m22() const { return a_[10]; }
+inline float Matrix4x4::m23() const { return a_[14]; }
+inline float Matrix4x4::m30() const { return a_[3]; }
+inline float Matrix4x4::m31() const { return a_[7]; }
+inline float Matrix4x4::m32() const { return a_[11]; }
+inline float Matrix4x4::m33() const { return a_[15]; }
+
+inline float &Matrix4x4::general_element(uint32_t index)
+{
+    type_ = MatrixType::GENERAL;
+    return a_[index];
+}
+
+// Read-write access functions. The matrix type is no longer known.
+inline float &Matrix4x4::m00() { return general_element(0); }
+inline float &Matrix4x4::m01() { return general_element(4); }
+inline float &Matrix4x4::m02() { return general_element(8); }
+inline float &Matrix4x4::m03() { return general_element(12); }
+inline float &Matrix4x4::m10() { return general_element(1); }
+inline float &Matrix4x4::m11() { return general_element(5); }
+inline float &Matrix4x4::m12() { return general_element(9); }
+inline float &Matrix4x4::m13() { return general_element(13); }
+inline float &Matrix4x4::m20() { return general_element(2); }
+inline float &Matrix4x4::m21() { return general_element(6); }
+inline float &Matrix4x4::m22() { return general_element(10); }
+inline float &Matrix4x4::m23() { return general_element(14); }
+inline float &Matrix4x4::m30() { return general_element(3); }
+inline float &Matrix4x4::m31() { return general_element(7); }
+inline float &Matrix4x4::m32() { return general_element(11); }
+inline float &Matrix4x4::m33() { return general_element(15); }
+
+inline float Matrix4x4::m(uint32_t row, uint32_t col) const
+{
+    return (row < 4 && col < 4) ? a_[col * 4 + row] : 0.0f;
+}
+
+inline float &Matrix4x4::m(uint32_t row, uint32_t col)
+{
+    return general_element((row < 4 && col < 4) ? col * 4 + row : 0);
+}
+
 } // namespace cg
 
 #endif
@@ -0,0 +1,273 @@
+#include "geometry/matrix_kernels.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace cg
+{
+
+// Instruction set specific kernels. Each returns nullptr if the instruction
+// set is not available in this build or on this CPU.
+const MatrixKernels *get_sse_kernels();
+const MatrixKernels *get_avx2_kernels();
+const MatrixKernels *get_neon_kernels();
+
+namespace
+{
+
+void mul_scalar(const float *a, const float *b, float *out)
+{
+    // Column j of the product is a times column j of b
+    float t[16];
+    for(uint32_t j = 0; j < 16; j += 4)
+    {
+        float b0 = b[j];
+        float b1 = b[j + 1];
+        float b2 = b[j + 2];
+        float b3 = b[j + 3];
+        t[j] = a[0] * b0 + a[4] * b1 + a[8] * b2 + a[12] * b3;
+        t[j + 1] = a[1] * b0 + a[5] * b1 + a[9] * b2 + a[13] * b3;
+        t[j + 2] = a[2] * b0 + a[6] * b1 + a[10] * b2 + a[14] * b3;
+        t[j + 3] = a[3] * b0 + a[7] * b1 + a[11] * b2 + a[15] * b3;
+    }
+    std::memcpy(out, t, sizeof(t));
+}
+
+void transpose_scalar(const float *a, float *out)
+{
+    float t[16];
+    for(uint32_t r = 0; r < 4; r++)
+    {
+        for(uint32_t c = 0; c < 4; c++) t[c * 4 + r] = a[r * 4 + c];
+    }
+    std::memcpy(out, t, sizeof(t));
+}
+
+bool inverse_scalar(const float *a, float *out)
+{
+    // Gauss-Jordan elimination with partial pivoting. Element (row, col) is
+    // at [col * 4 + row].
+    float t[16];
+    float b[16] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+                   0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    std::memcpy(t, a, sizeof(t));
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        // Find pivot
+        float    v1 = t[i * 4 + i];
+        uint32_t ind = i;
+        for(uint32_t j = i + 1; j < 4; j++)
+        {
+            if(std::abs(t[i * 4 + j]) > std::abs(v1))
+            {
+                ind = j;
+                v1 = t[i * 4 + j];
+            }
+        }
+
+        // Swap rows
+        if(ind != i)
+        {
+            for(uint32_t j = 0; j < 4; j++)
+            {
+                std::swap(b[j * 4 + i], b[j * 4 + ind]);
+                std::swap(t[j * 4 + i], t[j * 4 + ind]);
+            }
+        }
+
+        // The matrix is singular
+        if(v1 == 0.0f) return false;
+
+        for(uint32_t j = 0; j < 4; j++)
+        {
+            t[j * 4 + i] /= v1;
+            b[j * 4 + i] /= v1;
+        }
+
+        // Eliminate column
+        for(uint32_t j = 0; j < 4; j++)
+        {
+            if(j == i) continue;
+
+            v1 = t[i * 4 + j];
+            for(uint32_t k = 0; k < 4; k++)
+            {
+                t[k * 4 + j] -= t[k * 4 + i] * v1;
+                b[k * 4 + j] -= b[k * 4 + i] * v1;
+            }
+        }
+    }
+    std::memcpy(out, b, sizeof(b));
+    return true;
+}
+
+bool affine_inverse_scalar(const float *a, float *out)
+{
+    // The rows of the inverse of the upper 3x3 (columns c0, c1, c2) are the
+    // cross products c1 x c2, c2 x c0, c0 x c1 divided by the determinant.
+    const float *c0 = a;
+    const float *c1 = a + 4;
+    const float *c2 = a + 8;
+    const float *t = a + 12;
+    float        r0[3] = {c1[1] * c2[2] - c1[2] * c2[1], c1[2] * c2[0] - c1[0] * c2[2],
+                          c1[0] * c2[1] - c1[1] * c2[0]};
+    float        r1[3] = {c2[1] * c0[2] - c2[2] * c0[1], c2[2] * c0[0] - c2[0] * c0[2],
+                          c2[0] * c0[1] - c2[1] * c0[0]};
+    float        r2[3] = {c0[1] * c1[2] - c0[2] * c1[1], c0[2] * c1[0] - c0[0] * c1[2],
+                          c0[0] * c1[1] - c0[1] * c1[0]};
+    float        det = c0[0] * r0[0] + c0[1] * r0[1] + c0[2] * r0[2];
+    if(det == 0.0f) return false;
+
+    float inv_det = 1.0f / det;
+    float m[16];
+    for(uint32_t c = 0; c < 3; c++)
+    {
+        m[c * 4] = r0[c] * inv_det;
+        m[c * 4 + 1] = r1[c] * inv_det;
+        m[c * 4 + 2] = r2[c] * inv_det;
+        m[c * 4 + 3] = 0.0f;
+    }
+
+    // Translation is the inverse 3x3 applied to the negated translation
+    m[12] = -(m[0] * t[0] + m[4] * t[1] + m[8] * t[2]);
+    m[13] = -(m[1] * t[0] + m[5] * t[1] + m[9] * t[2]);
+    m[14] = -(m[2] * t[0] + m[6] * t[1] + m[10] * t[2]);
+    m[15] = 1.0f;
+    std::memcpy(out, m, sizeof(m));
+    return true;
+}
+
+bool normal_matrix_scalar(const float *a, float *out)
+{
+    // The columns of the inverse transpose of the upper 3x3 (columns c0, c1,
+    // c2) are the cross products c1 x c2, c2 x c0, c0 x c1 divided by the
+    // determinant.
+    const float *c0 = a;
+    const float *c1 = a + 4;
+    const float *c2 = a + 8;
+    float        r0[3] = {c1[1] * c2[2] - c1[2] * c2[1], c1[2] * c2[0] - c1[0] * c2[2],
+                          c1[0] * c2[1] - c1[1] * c2[0]};
+    float        r1[3] = {c2[1] * c0[2] - c2[2] * c0[1], c2[2] * c0[0] - c2[0] * c0[2],
+                          c2[0] * c0[1] - c2[1] * c0[0]};
+    float        r2[3] = {c0[1] * c1[2] - c0[2] * c1[1], c0[2] * c1[0] - c0[0] * c1[2],
+                          c0[0] * c1[1] - c0[1] * c1[0]};
+    float        det = c0[0] * r0[0] + c0[1] * r0[1] + c0[2] * r0[2];
+    if(det == 0.0f) return false;
+
+    float inv_det = 1.0f / det;
+    float m[16] = {r0[0] * inv_det, r0[1] * inv_det, r0[2] * inv_det, 0.0f,
+                   r1[0] * inv_det, r1[1] * inv_det, r1[2] * inv_det, 0.0f,
+                   r2[0] * inv_det, r2[1] * inv_det, r2[2] * inv_det, 0.0f,
+                   0.0f,            0.0f,            0.0f,            1.0f};
+    std::memcpy(out, m, sizeof(m));
+    return true;
+}
+
+void transform_scalar(const float *m, const float *v, float *out)
+{
+    float x = v[0];
+    float y = v[1];
+    float z = v[2];
+    float w = v[3];
+    out[0] = m[0] * x + m[4] * y + m[8] * z + m[12] * w;
+    out[1] = m[1] * x + m[5] * y + m[9] * z + m[13] * w;
+    out[2] = m[2] * x + m[6] * y + m[10] * z + m[14] * w;
+    out[3] = m[3] * x + m[7] * y + m[11] * z + m[15] * w;
+}
+
+void transform_points_scalar(const float *m, const float *in, float *out, size_t count)
+{
+    for(size_t i = 0; i < count * 3; i += 3)
+    {
+        float x = in[i];
+        float y = in[i + 1];
+        float z = in[i + 2];
+        out[i] = m[0] * x + m[4] * y + m[8] * z + m[12];
+        out[i + 1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+        out[i + 2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+    }
+}
+
+void transform_vectors_scalar(const float *m, const float *in, float *out, size_t count)
+{
+    for(size_t i = 0; i < count * 3; i += 3)
+    {
+        float x = in[i];
+        float y = in[i + 1];
+        float z = in[i + 2];
+        out[i] = m[0] * x + m[4] * y + m[8] * z;
+        out[i + 1] = m[1] * x + m[5] * y + m[9] * z;
+        out[i + 2] = m[2] * x + m[6] * y + m[10] * z;
+    }
+}
+
+void transform_hpoints_scalar(const float *m, const float *in, float *out, size_t count)
+{
+    for(size_t i = 0; i < count * 4; i += 4) transform_scalar(m, in + i, out + i);
+}
+
+void transform_points_soa_scalar(const float *m,
+                                 const float *x,
+                                 const float *y,
+                                 const float *z,
+                                 float       *out_x,
+                                 float       *out_y,
+                                 float       *out_z,
+                                 size_t       count)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        float px = x[i];
+        float py = y[i];
+        float pz = z[i];
+        out_x[i] = m[0] * px + m[4] * py + m[8] * pz + m[12];
+        out_y[i] = m[1] * px + m[5] * py + m[9] * pz + m[13];
+        out_z[i] = m[2] * px + m[6] * py + m[10] * pz + m[14];
+    }
+}
+
+const MatrixKernels SCALAR_KERNELS = {SimdLevel::SCALAR,    "scalar",          mul_scalar,
+                                      transpose_scalar,     inverse_scalar,    affine_inverse_scalar,
+                                      normal_matrix_scalar, transform_scalar,
+                                      transform_points_scalar, transform_vectors_scalar,
+                                      transform_hpoints_scalar, transform_points_soa_scalar};
+
+// Select the best kernels when the library is loaded. Until then (during
+// static initialization of other translation units) the scalar kernels are used.
+const bool g_kernels_selected = set_simd_level(get_best_simd_level());
+
+} // namespace
+
+const MatrixKernels *g_matrix_kernels = &SCALAR_KERNELS;
+
+const MatrixKernels *get_matrix_kernels(SimdLevel level)
+{
+    switch(level)
+    {
+        case SimdLevel::SCALAR: return &SCALAR_KERNELS;
+        case SimdLevel::SSE: return get_sse_kernels();
+        case SimdLevel::AVX2: return get_avx2_kernels();
+        case SimdLevel::NEON: return get_neon_kernels();
+        default: return nullptr;
+    }
+}
+
+bool set_simd_level(SimdLevel level)
+{
+    const MatrixKernels *kernels = get_matrix_kernels(level);
+    if(kernels == nullptr) return false;
+
+    g_matrix_kernels = kernels;
+    return true;
+}
+
+SimdLevel get_best_simd_level()
+{
+    if(get_avx2_kernels() != nullptr) return SimdLevel::AVX2;
+    if(get_sse_kernels() != nullptr) return SimdLevel::SSE;
+    if(get_neon_kernels() != nullptr) return SimdLevel::NEON;
+    return SimdLevel::SCALAR;
+}
+
+} // namespace cg
@@ -0,0 +1,119 @@
+//============================================================================
+//	Johns Hopkins University Engineering for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    matrix_kernels.hpp
+//	Purpose: 4x4 matrix kernels (scalar, SSE, AVX2, NEON) selected at
+//           startup based on the instruction sets the CPU supports.
+//
+//============================================================================
+
+#ifndef __GEOMETRY_MATRIX_KERNELS_HPP__
+#define __GEOMETRY_MATRIX_KERNELS_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cg
+{
+
+/**
+ * Instruction set used by a set of matrix kernels.
+ */
+enum class SimdLevel
+{
+    SCALAR = 0,
+    SSE,
+    AVX2,
+    NEON
+};
+
+/**
+ * Table of matrix kernels. All matrices are 16 floats in column order (as
+ * stored by Matrix4x4). Pointers need not be aligned, and the output may
+ * alias any of the inputs.
+ */
+struct MatrixKernels
+{
+    SimdLevel   level;
+    const char *name;
+
+    // out = a b
+    void (*mul)(const float *a, const float *b, float *out);
+
+    // out = transpose of a
+    void (*transpose)(const float *a, float *out);
+
+    // out = inverse of a. Returns false (out unchanged) if a is singular.
+    bool (*inverse)(const float *a, float *out);
+
+    // out = inverse of a, where a is affine (bottom row is 0 0 0 1).
+    // Returns false (out unchanged) if a is singular.
+    bool (*affine_inverse)(const float *a, float *out);
+
+    // out = transpose of the inverse of the upper 3x3 of a, with the 4th row
+    // and column of the identity. Returns false (out unchanged) if singular.
+    bool (*normal_matrix)(const float *a, float *out);
+
+    // out = m v, where v and out are homogeneous coordinates (4 floats)
+    void (*transform)(const float *m, const float *v, float *out);
+
+    // Batched transforms of count elements. in and out may be the same
+    // array but must not otherwise overlap.
+
+    // Points (x, y, z packed, w = 1). m is treated as affine.
+    void (*transform_points)(const float *m, const float *in, float *out, size_t count);
+
+    // Vectors (x, y, z packed, w = 0). Only the upper 3x3 of m is used.
+    void (*transform_vectors)(const float *m, const float *in, float *out, size_t count);
+
+    // Homogeneous points (x, y, z, w packed).
+    void (*transform_hpoints)(const float *m, const float *in, float *out, size_t count);
+
+    // Points stored as separate x, y, z arrays (w = 1). m is treated as affine.
+    void (*transform_points_soa)(const float *m,
+                                 const float *x,
+                                 const float *y,
+                                 const float *z,
+                                 float       *out_x,
+                                 float       *out_y,
+                                 float       *out_z,
+                                 size_t       count);
+};
+
+// Kernels currently in use (do not access directly, use get_matrix_kernels)
+extern const MatrixKernels *g_matrix_kernels;
+
+/**
+ * Get the matrix kernels currently in use. The best kernels supported by the
+ * CPU are selected at startup.
+ * @return  Returns the current matrix kernels.
+ */
+inline const MatrixKernels &get_matrix_kernels() { return *g_matrix_kernels; }
+
+/**
+ * Get the matrix kernels for an instruction set.
+ * @param  level  Instruction set.
+ * @return  Returns the kernels, or nullptr if the instruction set is not
+ *          supported by this build or by the CPU.
+ */
+const MatrixKernels *get_matrix_kernels(SimdLevel level);
+
+/**
+ * Select the matrix kernels to use (for example to compare implementations).
+ * @param  level  Instruction set.
+ * @return  Returns true if the kernels are supported and now in use.
+ */
+bool set_simd_level(SimdLevel level);
+
+/**
+ * Get the best instruction set supported by the CPU (and this build).
+ * @return  Returns the best supported instruction set.
+ */
+SimdLevel get_best_simd_level();
+
+} // namespace cg
+
+#endif
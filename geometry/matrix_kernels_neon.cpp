@@ -0,0 +1,81 @@
+#include "geometry/matrix_kernels.hpp"
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define CG_MATRIX_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace cg
+{
+
+#if defined(CG_MATRIX_NEON)
+
+namespace
+{
+
+void mul_neon(const float *a, const float *b, float *out)
+{
+    float32x4_t a0 = vld1q_f32(a);
+    float32x4_t a1 = vld1q_f32(a + 4);
+    float32x4_t a2 = vld1q_f32(a + 8);
+    float32x4_t a3 = vld1q_f32(a + 12);
+
+    // Column j of the product is a times column j of b
+    for(uint32_t j = 0; j < 16; j += 4)
+    {
+        float32x4_t bj = vld1q_f32(b + j);
+        float32x4_t r = vmulq_laneq_f32(a0, bj, 0);
+        r = vfmaq_laneq_f32(r, a1, bj, 1);
+        r = vfmaq_laneq_f32(r, a2, bj, 2);
+        r = vfmaq_laneq_f32(r, a3, bj, 3);
+        vst1q_f32(out + j, r);
+    }
+}
+
+void transpose_neon(const float *a, float *out)
+{
+    // De-interleaving load gathers the rows
+    float32x4x4_t rows = vld4q_f32(a);
+    vst1q_f32(out, rows.val[0]);
+    vst1q_f32(out + 4, rows.val[1]);
+    vst1q_f32(out + 8, rows.val[2]);
+    vst1q_f32(out + 12, rows.val[3]);
+}
+
+void transform_neon(const float *m, const float *v, float *out)
+{
+    float32x4_t p = vld1q_f32(v);
+    float32x4_t r = vmulq_laneq_f32(vld1q_f32(m), p, 0);
+    r = vfmaq_laneq_f32(r, vld1q_f32(m + 4), p, 1);
+    r = vfmaq_laneq_f32(r, vld1q_f32(m + 8), p, 2);
+    r = vfmaq_laneq_f32(r, vld1q_f32(m + 12), p, 3);
+    vst1q_f32(out, r);
+}
+
+} // namespace
+
+const MatrixKernels *get_neon_kernels()
+{
+    // Inverses, normal matrices and batched transforms use the scalar kernels
+    static const MatrixKernels kernels = {SimdLevel::NEON,
+                                          "neon",
+                                          mul_neon,
+                                          transpose_neon,
+                                          get_matrix_kernels(SimdLevel::SCALAR)->inverse,
+                                          get_matrix_kernels(SimdLevel::SCALAR)->affine_inverse,
+                                          get_matrix_kernels(SimdLevel::SCALAR)->normal_matrix,
+                                          transform_neon,
+                                          get_matrix_kernels(SimdLevel::SCALAR)->transform_points,
+                                          get_matrix_kernels(SimdLevel::SCALAR)->transform_vectors,
+                                          get_matrix_kernels(SimdLevel::SCALAR)->transform_hpoints,
+                                          get_matrix_kernels(SimdLevel::SCALAR)->transform_points_soa};
+    return &kernels;
+}
+
+#else
+
+const MatrixKernels *get_neon_kernels() { return nullptr; }
+
+#endif
+
+} // namespace cg
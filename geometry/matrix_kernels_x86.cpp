@@ -0,0 +1,588 @@
+#include "geometry/matrix_kernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CG_MATRIX_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// SSE2 is part of the x86-64 baseline. AVX2 functions are compiled for AVX2
+// and FMA individually so the rest of the library runs on any x86-64 CPU.
+#if defined(CG_MATRIX_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CG_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define CG_TARGET_AVX2
+#endif
+
+namespace cg
+{
+
+#if defined(CG_MATRIX_X86)
+
+namespace
+{
+
+// Shuffle helpers (lanes are numbered 0-3 from the low lane)
+#define CG_SHUFFLE_MASK(x, y, z, w) ((x) | ((y) << 2) | ((z) << 4) | ((w) << 6))
+#define CG_SWIZZLE(v, x, y, z, w) _mm_shuffle_ps(v, v, CG_SHUFFLE_MASK(x, y, z, w))
+#define CG_SHUFFLE(v1, v2, x, y, z, w) _mm_shuffle_ps(v1, v2, CG_SHUFFLE_MASK(x, y, z, w))
+
+//----------------------------------------------------------------------------
+// SSE kernels
+//----------------------------------------------------------------------------
+
+void mul_sse(const float *a, const float *b, float *out)
+{
+    __m128 a0 = _mm_loadu_ps(a);
+    __m128 a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8);
+    __m128 a3 = _mm_loadu_ps(a + 12);
+
+    // Column j of the product is a times column j of b
+    for(uint32_t j = 0; j < 16; j += 4)
+    {
+        __m128 bj = _mm_loadu_ps(b + j);
+        __m128 r = _mm_mul_ps(a0, CG_SWIZZLE(bj, 0, 0, 0, 0));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, CG_SWIZZLE(bj, 1, 1, 1, 1)));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, CG_SWIZZLE(bj, 2, 2, 2, 2)));
+        r = _mm_add_ps(r, _mm_mul_ps(a3, CG_SWIZZLE(bj, 3, 3, 3, 3)));
+        _mm_storeu_ps(out + j, r);
+    }
+}
+
+void transpose_sse(const float *a, float *out)
+{
+    __m128 c0 = _mm_loadu_ps(a);
+    __m128 c1 = _mm_loadu_ps(a + 4);
+    __m128 c2 = _mm_loadu_ps(a + 8);
+    __m128 c3 = _mm_loadu_ps(a + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_storeu_ps(out, c0);
+    _mm_storeu_ps(out + 4, c1);
+    _mm_storeu_ps(out + 8, c2);
+    _mm_storeu_ps(out + 12, c3);
+}
+
+// 2x2 matrix products used by the block inverse. A 2x2 matrix is stored in
+// one register as (m00, m01, m10, m11).
+
+// a b
+inline __m128 mat2_mul(__m128 a, __m128 b)
+{
+    return _mm_add_ps(_mm_mul_ps(a, CG_SWIZZLE(b, 0, 3, 0, 3)),
+                      _mm_mul_ps(CG_SWIZZLE(a, 1, 0, 3, 2), CG_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// adj(a) b
+inline __m128 mat2_adj_mul(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(CG_SWIZZLE(a, 3, 3, 0, 0), b),
+                      _mm_mul_ps(CG_SWIZZLE(a, 1, 1, 2, 2), CG_SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+// a adj(b)
+inline __m128 mat2_mul_adj(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(a, CG_SWIZZLE(b, 3, 0, 3, 0)),
+                      _mm_mul_ps(CG_SWIZZLE(a, 1, 0, 3, 2), CG_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+bool inverse_sse(const float *a, float *out)
+{
+    // Block inverse of the 2x2 blocks A B / C D. The column order storage is
+    // treated as the rows of the transpose: inverse(transpose(M)) is the
+    // transpose of inverse(M), so the result is stored the same way.
+    __m128 v0 = _mm_loadu_ps(a);
+    __m128 v1 = _mm_loadu_ps(a + 4);
+    __m128 v2 = _mm_loadu_ps(a + 8);
+    __m128 v3 = _mm_loadu_ps(a + 12);
+
+    __m128 ba = _mm_movelh_ps(v0, v1);
+    __m128 bb = _mm_movehl_ps(v1, v0);
+    __m128 bc = _mm_movelh_ps(v2, v3);
+    __m128 bd = _mm_movehl_ps(v3, v2);
+
+    // Determinants of the blocks as (|A|, |B|, |C|, |D|)
+    __m128 det_sub = _mm_sub_ps(_mm_mul_ps(CG_SHUFFLE(v0, v2, 0, 2, 0, 2), CG_SHUFFLE(v1, v3, 1, 3, 1, 3)),
+                                _mm_mul_ps(CG_SHUFFLE(v0, v2, 1, 3, 1, 3), CG_SHUFFLE(v1, v3, 0, 2, 0, 2)));
+    __m128 det_a = CG_SWIZZLE(det_sub, 0, 0, 0, 0);
+    __m128 det_b = CG_SWIZZLE(det_sub, 1, 1, 1, 1);
+    __m128 det_c = CG_SWIZZLE(det_sub, 2, 2, 2, 2);
+    __m128 det_d = CG_SWIZZLE(det_sub, 3, 3, 3, 3);
+
+    __m128 d_c = mat2_adj_mul(bd, bc);
+    __m128 a_b = mat2_adj_mul(ba, bb);
+    __m128 x = _mm_sub_ps(_mm_mul_ps(det_d, ba), mat2_mul(bb, d_c));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(det_a, bd), mat2_mul(bc, a_b));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(det_b, bc), mat2_mul_adj(bd, a_b));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(det_c, bb), mat2_mul_adj(ba, d_c));
+
+    // Determinant of the 4x4 matrix: |A||D| + |B||C| - tr((adj(A) B)(adj(D) C))
+    __m128 det = _mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c));
+    __m128 tr = _mm_mul_ps(a_b, CG_SWIZZLE(d_c, 0, 2, 1, 3));
+    tr = _mm_add_ps(tr, CG_SWIZZLE(tr, 2, 3, 0, 1));
+    tr = _mm_add_ps(tr, CG_SWIZZLE(tr, 1, 0, 3, 2));
+    det = _mm_sub_ps(det, tr);
+    if(_mm_cvtss_f32(det) == 0.0f) return false;
+
+    __m128 inv_det = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+    x = _mm_mul_ps(x, inv_det);
+    y = _mm_mul_ps(y, inv_det);
+    z = _mm_mul_ps(z, inv_det);
+    w = _mm_mul_ps(w, inv_det);
+
+    _mm_storeu_ps(out, CG_SHUFFLE(x, y, 3, 1, 3, 1));
+    _mm_storeu_ps(out + 4, CG_SHUFFLE(x, y, 2, 0, 2, 0));
+    _mm_storeu_ps(out + 8, CG_SHUFFLE(z, w, 3, 1, 3, 1));
+    _mm_storeu_ps(out + 12, CG_SHUFFLE(z, w, 2, 0, 2, 0));
+    return true;
+}
+
+// Cross product of the xyz lanes (w lane is 0)
+inline __m128 cross_sse(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(CG_SWIZZLE(a, 1, 2, 0, 3), CG_SWIZZLE(b, 2, 0, 1, 3)),
+                      _mm_mul_ps(CG_SWIZZLE(a, 2, 0, 1, 3), CG_SWIZZLE(b, 1, 2, 0, 3)));
+}
+
+bool affine_inverse_sse(const float *a, float *out)
+{
+    // The rows of the inverse of the upper 3x3 (columns c0, c1, c2) are the
+    // cross products c1 x c2, c2 x c0, c0 x c1 divided by the determinant.
+    __m128 c0 = _mm_loadu_ps(a);
+    __m128 c1 = _mm_loadu_ps(a + 4);
+    __m128 c2 = _mm_loadu_ps(a + 8);
+    __m128 t = _mm_loadu_ps(a + 12);
+
+    __m128 r0 = cross_sse(c1, c2);
+    __m128 r1 = cross_sse(c2, c0);
+    __m128 r2 = cross_sse(c0, c1);
+
+    __m128 d = _mm_mul_ps(c0, r0);
+    d = _mm_add_ps(d, CG_SWIZZLE(d, 1, 0, 3, 2));
+    d = _mm_add_ps(d, CG_SWIZZLE(d, 2, 3, 0, 1));
+    if(_mm_cvtss_f32(d) == 0.0f) return false;
+
+    __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), d);
+    r0 = _mm_mul_ps(r0, inv_det);
+    r1 = _mm_mul_ps(r1, inv_det);
+    r2 = _mm_mul_ps(r2, inv_det);
+    __m128 r3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    // Translation is the inverse 3x3 applied to the negated translation
+    __m128 it = _mm_mul_ps(r0, CG_SWIZZLE(t, 0, 0, 0, 0));
+    it = _mm_add_ps(it, _mm_mul_ps(r1, CG_SWIZZLE(t, 1, 1, 1, 1)));
+    it = _mm_add_ps(it, _mm_mul_ps(r2, CG_SWIZZLE(t, 2, 2, 2, 2)));
+    it = _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), it);
+
+    _mm_storeu_ps(out, r0);
+    _mm_storeu_ps(out + 4, r1);
+    _mm_storeu_ps(out + 8, r2);
+    _mm_storeu_ps(out + 12, it);
+    return true;
+}
+
+bool normal_matrix_sse(const float *a, float *out)
+{
+    // The columns of the inverse transpose of the upper 3x3 are the cross
+    // products c1 x c2, c2 x c0, c0 x c1 divided by the determinant
+    __m128 c0 = _mm_loadu_ps(a);
+    __m128 c1 = _mm_loadu_ps(a + 4);
+    __m128 c2 = _mm_loadu_ps(a + 8);
+
+    __m128 r0 = cross_sse(c1, c2);
+    __m128 r1 = cross_sse(c2, c0);
+    __m128 r2 = cross_sse(c0, c1);
+
+    __m128 d = _mm_mul_ps(c0, r0);
+    d = _mm_add_ps(d, CG_SWIZZLE(d, 1, 0, 3, 2));
+    d = _mm_add_ps(d, CG_SWIZZLE(d, 2, 3, 0, 1));
+    if(_mm_cvtss_f32(d) == 0.0f) return false;
+
+    __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), d);
+    _mm_storeu_ps(out, _mm_mul_ps(r0, inv_det));
+    _mm_storeu_ps(out + 4, _mm_mul_ps(r1, inv_det));
+    _mm_storeu_ps(out + 8, _mm_mul_ps(r2, inv_det));
+    _mm_storeu_ps(out + 12, _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+    return true;
+}
+
+void transform_sse(const float *m, const float *v, float *out)
+{
+    __m128 p = _mm_loadu_ps(v);
+    __m128 r = _mm_mul_ps(_mm_loadu_ps(m), CG_SWIZZLE(p, 0, 0, 0, 0));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 4), CG_SWIZZLE(p, 1, 1, 1, 1)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 8), CG_SWIZZLE(p, 2, 2, 2, 2)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 12), CG_SWIZZLE(p, 3, 3, 3, 3)));
+    _mm_storeu_ps(out, r);
+}
+
+//----------------------------------------------------------------------------
+// AVX2 / FMA kernels
+//----------------------------------------------------------------------------
+
+CG_TARGET_AVX2 void mul_avx2(const float *a, const float *b, float *out)
+{
+    // Each column of a is duplicated into both 128-bit halves, so two
+    // columns of the product are formed at a time
+    __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a));
+    __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a + 4));
+    __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a + 8));
+    __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(a + 12));
+
+    __m256 b01 = _mm256_loadu_ps(b);
+    __m256 b23 = _mm256_loadu_ps(b + 8);
+
+    __m256 r01 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, 0x00));
+    __m256 r23 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b23, b23, 0x00));
+    r01 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b01, b01, 0x55), r01);
+    r23 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b23, b23, 0x55), r23);
+    r01 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b01, b01, 0xAA), r01);
+    r23 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b23, b23, 0xAA), r23);
+    r01 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b01, b01, 0xFF), r01);
+    r23 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b23, b23, 0xFF), r23);
+
+    _mm256_storeu_ps(out, r01);
+    _mm256_storeu_ps(out + 8, r23);
+}
+
+CG_TARGET_AVX2 void transform_avx2(const float *m, const float *v, float *out)
+{
+    __m128 p = _mm_loadu_ps(v);
+    __m128 r = _mm_mul_ps(_mm_loadu_ps(m), _mm_broadcast_ss(v));
+    r = _mm_fmadd_ps(_mm_loadu_ps(m + 4), _mm_broadcast_ss(v + 1), r);
+    r = _mm_fmadd_ps(_mm_loadu_ps(m + 8), _mm_broadcast_ss(v + 2), r);
+    r = _mm_fmadd_ps(_mm_loadu_ps(m + 12), CG_SWIZZLE(p, 3, 3, 3, 3), r);
+    _mm_storeu_ps(out, r);
+}
+
+//----------------------------------------------------------------------------
+// Batched transforms. Packed x, y, z streams are converted 4 points at a time
+// between AoS (x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3) and SoA (x | y | z).
+// The AVX2 versions process 8 points, 4 in each 128-bit half.
+//----------------------------------------------------------------------------
+
+// Scalar tail of a packed x, y, z stream starting at element i
+template <bool POINTS> void transform_xyz_tail(const float *m, const float *in, float *out, size_t i, size_t count)
+{
+    for(i *= 3; i < count * 3; i += 3)
+    {
+        float x = in[i];
+        float y = in[i + 1];
+        float z = in[i + 2];
+        out[i] = m[0] * x + m[4] * y + m[8] * z + (POINTS ? m[12] : 0.0f);
+        out[i + 1] = m[1] * x + m[5] * y + m[9] * z + (POINTS ? m[13] : 0.0f);
+        out[i + 2] = m[2] * x + m[6] * y + m[10] * z + (POINTS ? m[14] : 0.0f);
+    }
+}
+
+inline void deinterleave_xyz_sse(__m128 a, __m128 b, __m128 c, __m128 &x, __m128 &y, __m128 &z)
+{
+    __m128 x2y2x3y3 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+    __m128 y0z0y1z1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+    x = _mm_shuffle_ps(a, x2y2x3y3, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm_shuffle_ps(y0z0y1z1, x2y2x3y3, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm_shuffle_ps(y0z0y1z1, c, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+inline void interleave_xyz_sse(__m128 x, __m128 y, __m128 z, __m128 &a, __m128 &b, __m128 &c)
+{
+    __m128 x0x2y0y2 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 y1y3z1z3 = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+    __m128 z0z2x1x3 = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+    a = _mm_shuffle_ps(x0x2y0y2, z0z2x1x3, _MM_SHUFFLE(2, 0, 2, 0));
+    b = _mm_shuffle_ps(y1y3z1z3, x0x2y0y2, _MM_SHUFFLE(3, 1, 2, 0));
+    c = _mm_shuffle_ps(z0z2x1x3, y1y3z1z3, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+template <bool POINTS> void transform_xyz_sse(const float *m, const float *in, float *out, size_t count)
+{
+    __m128 m0 = _mm_set1_ps(m[0]);
+    __m128 m1 = _mm_set1_ps(m[1]);
+    __m128 m2 = _mm_set1_ps(m[2]);
+    __m128 m4 = _mm_set1_ps(m[4]);
+    __m128 m5 = _mm_set1_ps(m[5]);
+    __m128 m6 = _mm_set1_ps(m[6]);
+    __m128 m8 = _mm_set1_ps(m[8]);
+    __m128 m9 = _mm_set1_ps(m[9]);
+    __m128 m10 = _mm_set1_ps(m[10]);
+    __m128 m12 = _mm_set1_ps(POINTS ? m[12] : 0.0f);
+    __m128 m13 = _mm_set1_ps(POINTS ? m[13] : 0.0f);
+    __m128 m14 = _mm_set1_ps(POINTS ? m[14] : 0.0f);
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        const float *p = in + i * 3;
+        __m128       x, y, z;
+        deinterleave_xyz_sse(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _mm_loadu_ps(p + 8), x, y, z);
+
+        __m128 ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m0), _mm_mul_ps(y, m4)), _mm_add_ps(_mm_mul_ps(z, m8), m12));
+        __m128 oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m1), _mm_mul_ps(y, m5)), _mm_add_ps(_mm_mul_ps(z, m9), m13));
+        __m128 oz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m2), _mm_mul_ps(y, m6)), _mm_add_ps(_mm_mul_ps(z, m10), m14));
+
+        __m128 a, b, c;
+        interleave_xyz_sse(ox, oy, oz, a, b, c);
+        float *q = out + i * 3;
+        _mm_storeu_ps(q, a);
+        _mm_storeu_ps(q + 4, b);
+        _mm_storeu_ps(q + 8, c);
+    }
+    transform_xyz_tail<POINTS>(m, in, out, i, count);
+}
+
+void transform_points_sse(const float *m, const float *in, float *out, size_t count)
+{
+    transform_xyz_sse<true>(m, in, out, count);
+}
+
+void transform_vectors_sse(const float *m, const float *in, float *out, size_t count)
+{
+    transform_xyz_sse<false>(m, in, out, count);
+}
+
+void transform_hpoints_sse(const float *m, const float *in, float *out, size_t count)
+{
+    __m128 c0 = _mm_loadu_ps(m);
+    __m128 c1 = _mm_loadu_ps(m + 4);
+    __m128 c2 = _mm_loadu_ps(m + 8);
+    __m128 c3 = _mm_loadu_ps(m + 12);
+    for(size_t i = 0; i < count * 4; i += 4)
+    {
+        __m128 p = _mm_loadu_ps(in + i);
+        __m128 r = _mm_add_ps(_mm_mul_ps(c0, CG_SWIZZLE(p, 0, 0, 0, 0)), _mm_mul_ps(c1, CG_SWIZZLE(p, 1, 1, 1, 1)));
+        r = _mm_add_ps(r, _mm_add_ps(_mm_mul_ps(c2, CG_SWIZZLE(p, 2, 2, 2, 2)), _mm_mul_ps(c3, CG_SWIZZLE(p, 3, 3, 3, 3))));
+        _mm_storeu_ps(out + i, r);
+    }
+}
+
+void transform_points_soa_sse(const float *m,
+                              const float *x,
+                              const float *y,
+                              const float *z,
+                              float       *out_x,
+                              float       *out_y,
+                              float       *out_z,
+                              size_t       count)
+{
+    __m128 m0 = _mm_set1_ps(m[0]);
+    __m128 m1 = _mm_set1_ps(m[1]);
+    __m128 m2 = _mm_set1_ps(m[2]);
+    __m128 m4 = _mm_set1_ps(m[4]);
+    __m128 m5 = _mm_set1_ps(m[5]);
+    __m128 m6 = _mm_set1_ps(m[6]);
+    __m128 m8 = _mm_set1_ps(m[8]);
+    __m128 m9 = _mm_set1_ps(m[9]);
+    __m128 m10 = _mm_set1_ps(m[10]);
+    __m128 m12 = _mm_set1_ps(m[12]);
+    __m128 m13 = _mm_set1_ps(m[13]);
+    __m128 m14 = _mm_set1_ps(m[14]);
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pz = _mm_loadu_ps(z + i);
+        _mm_storeu_ps(out_x + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, m0), _mm_mul_ps(py, m4)),
+                                            _mm_add_ps(_mm_mul_ps(pz, m8), m12)));
+        _mm_storeu_ps(out_y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, m1), _mm_mul_ps(py, m5)),
+                                            _mm_add_ps(_mm_mul_ps(pz, m9), m13)));
+        _mm_storeu_ps(out_z + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, m2), _mm_mul_ps(py, m6)),
+                                            _mm_add_ps(_mm_mul_ps(pz, m10), m14)));
+    }
+    for(; i < count; i++)
+    {
+        float px = x[i];
+        float py = y[i];
+        float pz = z[i];
+        out_x[i] = m[0] * px + m[4] * py + m[8] * pz + m[12];
+        out_y[i] = m[1] * px + m[5] * py + m[9] * pz + m[13];
+        out_z[i] = m[2] * px + m[6] * py + m[10] * pz + m[14];
+    }
+}
+
+// Load 8 packed points: points 0-3 in the low half, 4-7 in the high half
+CG_TARGET_AVX2 inline __m256 load_halves(const float *p)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 12), 1);
+}
+
+CG_TARGET_AVX2 inline void store_halves(float *p, __m256 v)
+{
+    _mm_storeu_ps(p, _mm256_castps256_ps128(v));
+    _mm_storeu_ps(p + 12, _mm256_extractf128_ps(v, 1));
+}
+
+template <bool POINTS> CG_TARGET_AVX2 void transform_xyz_avx2(const float *m, const float *in, float *out, size_t count)
+{
+    __m256 m0 = _mm256_set1_ps(m[0]);
+    __m256 m1 = _mm256_set1_ps(m[1]);
+    __m256 m2 = _mm256_set1_ps(m[2]);
+    __m256 m4 = _mm256_set1_ps(m[4]);
+    __m256 m5 = _mm256_set1_ps(m[5]);
+    __m256 m6 = _mm256_set1_ps(m[6]);
+    __m256 m8 = _mm256_set1_ps(m[8]);
+    __m256 m9 = _mm256_set1_ps(m[9]);
+    __m256 m10 = _mm256_set1_ps(m[10]);
+    __m256 m12 = _mm256_set1_ps(POINTS ? m[12] : 0.0f);
+    __m256 m13 = _mm256_set1_ps(POINTS ? m[13] : 0.0f);
+    __m256 m14 = _mm256_set1_ps(POINTS ? m[14] : 0.0f);
+
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        // Same shuffles as the SSE version, applied to each 128-bit half
+        const float *p = in + i * 3;
+        __m256       a = load_halves(p);
+        __m256       b = load_halves(p + 4);
+        __m256       c = load_halves(p + 8);
+        __m256       x2y2x3y3 = _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+        __m256       y0z0y1z1 = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+        __m256       x = _mm256_shuffle_ps(a, x2y2x3y3, _MM_SHUFFLE(2, 0, 3, 0));
+        __m256       y = _mm256_shuffle_ps(y0z0y1z1, x2y2x3y3, _MM_SHUFFLE(3, 1, 2, 0));
+        __m256       z = _mm256_shuffle_ps(y0z0y1z1, c, _MM_SHUFFLE(3, 0, 3, 1));
+
+        __m256 ox = _mm256_fmadd_ps(x, m0, _mm256_fmadd_ps(y, m4, _mm256_fmadd_ps(z, m8, m12)));
+        __m256 oy = _mm256_fmadd_ps(x, m1, _mm256_fmadd_ps(y, m5, _mm256_fmadd_ps(z, m9, m13)));
+        __m256 oz = _mm256_fmadd_ps(x, m2, _mm256_fmadd_ps(y, m6, _mm256_fmadd_ps(z, m10, m14)));
+
+        __m256 x0x2y0y2 = _mm256_shuffle_ps(ox, oy, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 y1y3z1z3 = _mm256_shuffle_ps(oy, oz, _MM_SHUFFLE(3, 1, 3, 1));
+        __m256 z0z2x1x3 = _mm256_shuffle_ps(oz, ox, _MM_SHUFFLE(3, 1, 2, 0));
+        float *q = out + i * 3;
+        store_halves(q, _mm256_shuffle_ps(x0x2y0y2, z0z2x1x3, _MM_SHUFFLE(2, 0, 2, 0)));
+        store_halves(q + 4, _mm256_shuffle_ps(y1y3z1z3, x0x2y0y2, _MM_SHUFFLE(3, 1, 2, 0)));
+        store_halves(q + 8, _mm256_shuffle_ps(z0z2x1x3, y1y3z1z3, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    transform_xyz_tail<POINTS>(m, in, out, i, count);
+}
+
+CG_TARGET_AVX2 void transform_points_avx2(const float *m, const float *in, float *out, size_t count)
+{
+    transform_xyz_avx2<true>(m, in, out, count);
+}
+
+CG_TARGET_AVX2 void transform_vectors_avx2(const float *m, const float *in, float *out, size_t count)
+{
+    transform_xyz_avx2<false>(m, in, out, count);
+}
+
+CG_TARGET_AVX2 void transform_hpoints_avx2(const float *m, const float *in, float *out, size_t count)
+{
+    // Two points at a time, one in each 128-bit half
+    __m256 c0 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(m));
+    __m256 c1 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(m + 4));
+    __m256 c2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(m + 8));
+    __m256 c3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(m + 12));
+    size_t i = 0;
+    for(; i + 2 <= count; i += 2)
+    {
+        __m256 p = _mm256_loadu_ps(in + i * 4);
+        __m256 r = _mm256_mul_ps(c0, _mm256_shuffle_ps(p, p, 0x00));
+        r = _mm256_fmadd_ps(c1, _mm256_shuffle_ps(p, p, 0x55), r);
+        r = _mm256_fmadd_ps(c2, _mm256_shuffle_ps(p, p, 0xAA), r);
+        r = _mm256_fmadd_ps(c3, _mm256_shuffle_ps(p, p, 0xFF), r);
+        _mm256_storeu_ps(out + i * 4, r);
+    }
+    if(i < count) transform_sse(m, in + i * 4, out + i * 4);
+}
+
+CG_TARGET_AVX2 void transform_points_soa_avx2(const float *m,
+                                              const float *x,
+                                              const float *y,
+                                              const float *z,
+                                              float       *out_x,
+                                              float       *out_y,
+                                              float       *out_z,
+                                              size_t       count)
+{
+    __m256 m0 = _mm256_set1_ps(m[0]);
+    __m256 m1 = _mm256_set1_ps(m[1]);
+    __m256 m2 = _mm256_set1_ps(m[2]);
+    __m256 m4 = _mm256_set1_ps(m[4]);
+    __m256 m5 = _mm256_set1_ps(m[5]);
+    __m256 m6 = _mm256_set1_ps(m[6]);
+    __m256 m8 = _mm256_set1_ps(m[8]);
+    __m256 m9 = _mm256_set1_ps(m[9]);
+    __m256 m10 = _mm256_set1_ps(m[10]);
+    __m256 m12 = _mm256_set1_ps(m[12]);
+    __m256 m13 = _mm256_set1_ps(m[13]);
+    __m256 m14 = _mm256_set1_ps(m[14]);
+
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 pz = _mm256_loadu_ps(z + i);
+        _mm256_storeu_ps(out_x + i, _mm256_fmadd_ps(px, m0, _mm256_fmadd_ps(py, m4, _mm256_fmadd_ps(pz, m8, m12))));
+        _mm256_storeu_ps(out_y + i, _mm256_fmadd_ps(px, m1, _mm256_fmadd_ps(py, m5, _mm256_fmadd_ps(pz, m9, m13))));
+        _mm256_storeu_ps(out_z + i, _mm256_fmadd_ps(px, m2, _mm256_fmadd_ps(py, m6, _mm256_fmadd_ps(pz, m10, m14))));
+    }
+    transform_points_soa_sse(m, x + i, y + i, z + i, out_x + i, out_y + i, out_z + i, count - i);
+}
+
+#undef CG_SHUFFLE_MASK
+#undef CG_SWIZZLE
+#undef CG_SHUFFLE
+
+// Check CPU and operating system support for AVX2 and FMA
+bool cpu_supports_avx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if(info[0] < 7) return false;
+
+    // OSXSAVE, AVX and FMA, then the OS must save the YMM registers
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    if(!osxsave || !avx || !fma) return false;
+    if((_xgetbv(0) & 0x6) != 0x6) return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+// The inverses are latency bound shuffles - the SSE versions are used with AVX2
+const MatrixKernels SSE_KERNELS = {SimdLevel::SSE,         "sse",
+                                   mul_sse,                transpose_sse,
+                                   inverse_sse,            affine_inverse_sse,
+                                   normal_matrix_sse,      transform_sse,
+                                   transform_points_sse,   transform_vectors_sse,
+                                   transform_hpoints_sse,  transform_points_soa_sse};
+const MatrixKernels AVX2_KERNELS = {SimdLevel::AVX2,        "avx2",
+                                    mul_avx2,               transpose_sse,
+                                    inverse_sse,            affine_inverse_sse,
+                                    normal_matrix_sse,      transform_avx2,
+                                    transform_points_avx2,  transform_vectors_avx2,
+                                    transform_hpoints_avx2, transform_points_soa_avx2};
+
+} // namespace
+
+const MatrixKernels *get_sse_kernels() { return &SSE_KERNELS; }
+
+const MatrixKernels *get_avx2_kernels()
+{
+    static const bool supported = cpu_supports_avx2();
+    return supported ? &AVX2_KERNELS : nullptr;
+}
+
+#else
+
+const MatrixKernels *get_sse_kernels() { return nullptr; }
+const MatrixKernels *get_avx2_kernels() { return nullptr; }
+
+#endif
+
+} // namespace cg
@@ -0,0 +1,376 @@
+#include "geometry/mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cg
+{
+
+namespace
+{
+
+// Cache size modeled by the vertex cache optimizer and the vertex score weights
+// (values from Forsyth's article)
+constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+constexpr uint32_t FORSYTH_MAX_VALENCE = 32;
+constexpr float    CACHE_DECAY_POWER = 1.5f;
+constexpr float    LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float    VALENCE_BOOST_SCALE = 2.0f;
+constexpr float    VALENCE_BOOST_POWER = 0.5f;
+
+// Cache size and minimum cluster size used to split a mesh into clusters for
+// overdraw ordering
+constexpr uint32_t OVERDRAW_CACHE_SIZE = 16;
+constexpr uint32_t MIN_CLUSTER_SIZE = 64;
+
+/**
+ * Vertex score tables: score for each cache position and for the number of
+ * remaining triangles using a vertex.
+ */
+struct VertexScoreTables
+{
+    float cache[FORSYTH_CACHE_SIZE];
+    float valence[FORSYTH_MAX_VALENCE + 1];
+
+    VertexScoreTables()
+    {
+        for(uint32_t i = 0; i < FORSYTH_CACHE_SIZE; i++)
+        {
+            // The last triangle's vertices get a fixed score so the next
+            // triangle is not just chosen to share an edge with it
+            if(i < 3) cache[i] = LAST_TRIANGLE_SCORE;
+            else
+            {
+                float scale = 1.0f / static_cast<float>(FORSYTH_CACHE_SIZE - 3);
+                cache[i] = std::pow(1.0f - static_cast<float>(i - 3) * scale, CACHE_DECAY_POWER);
+            }
+        }
+
+        // Boost vertices with few remaining triangles to avoid leaving
+        // isolated triangles that need all 3 vertices transformed later
+        valence[0] = 0.0f;
+        for(uint32_t i = 1; i <= FORSYTH_MAX_VALENCE; i++)
+        {
+            valence[i] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -VALENCE_BOOST_POWER);
+        }
+    }
+
+    float score(int32_t cache_position, uint32_t live_triangles) const
+    {
+        if(live_triangles == 0) return -1.0f;
+        float s = (cache_position >= 0) ? cache[cache_position] : 0.0f;
+        return s + valence[std::min(live_triangles, FORSYTH_MAX_VALENCE)];
+    }
+};
+
+/**
+ * Split a triangle list into clusters and sort the clusters for overdraw.
+ * Hard boundaries are where the vertex cache is effectively flushed (all 3
+ * vertices miss). Soft boundaries are where the cluster so far has a cache
+ * miss ratio within acmr_limit, so starting a new cluster costs little.
+ * Clusters facing away from the mesh center are likely to occlude other
+ * clusters so they are drawn first.
+ * @return  Returns the reordered triangle list (empty if there is only 1 cluster).
+ */
+std::vector<uint32_t> sort_clusters(const std::vector<uint32_t>        &indexes,
+                                    const std::vector<VertexAndNormal> &vertices,
+                                    const Vector3                      &mesh_centroid,
+                                    size_t                              min_size,
+                                    float                               acmr_limit)
+{
+    size_t                face_count = indexes.size() / 3;
+    std::vector<size_t>   cluster_start;
+    std::vector<uint32_t> transform_time(vertices.size(), 0);
+    uint32_t              transformed = 0;
+    uint32_t              cluster_misses = 0;
+    uint32_t              cluster_faces = 0;
+    for(size_t f = 0; f < face_count; f++)
+    {
+        uint32_t misses = 0;
+        for(uint32_t k = 0; k < 3; k++)
+        {
+            uint32_t v = indexes[f * 3 + k];
+            if(transform_time[v] == 0 || transformed - transform_time[v] >= OVERDRAW_CACHE_SIZE)
+            {
+                transformed++;
+                transform_time[v] = transformed;
+                misses++;
+            }
+        }
+
+        bool hard = (misses == 3);
+        bool soft = cluster_faces >= min_size &&
+                    static_cast<float>(cluster_misses) <= acmr_limit * static_cast<float>(cluster_faces);
+        if(f == 0 || (hard && cluster_faces > 0) || soft)
+        {
+            cluster_start.push_back(f);
+            cluster_misses = 0;
+            cluster_faces = 0;
+        }
+        cluster_misses += misses;
+        cluster_faces++;
+    }
+    size_t cluster_count = cluster_start.size();
+    if(cluster_count < 2) return {};
+    cluster_start.push_back(face_count);
+
+    // Sort by the distance of the cluster centroid from the mesh centroid along
+    // the cluster normal (both area weighted)
+    std::vector<float>    sort_key(cluster_count);
+    std::vector<uint32_t> order(cluster_count);
+    for(size_t c = 0; c < cluster_count; c++)
+    {
+        Vector3 sum(0.0f, 0.0f, 0.0f);
+        Vector3 normal(0.0f, 0.0f, 0.0f);
+        float   area = 0.0f;
+        for(size_t f = cluster_start[c]; f < cluster_start[c + 1]; f++)
+        {
+            const Point3 &p0 = vertices[indexes[f * 3]].vertex;
+            const Point3 &p1 = vertices[indexes[f * 3 + 1]].vertex;
+            const Point3 &p2 = vertices[indexes[f * 3 + 2]].vertex;
+            Vector3       n = Vector3(p0, p1).cross(Vector3(p0, p2));
+            float         a = n.norm();
+            sum += (Vector3(p0) + Vector3(p1) + Vector3(p2)) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+        Vector3 centroid = (area > 0.0f) ? sum * (1.0f / area) : sum;
+        sort_key[c] = (centroid - mesh_centroid).dot(normal.normalize());
+        order[c] = static_cast<uint32_t>(c);
+    }
+    std::stable_sort(order.begin(),
+                     order.end(),
+                     [&](uint32_t a, uint32_t b) { return sort_key[a] > sort_key[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(face_count * 3);
+    for(uint32_t c : order)
+    {
+        result.insert(result.end(),
+                      indexes.begin() + cluster_start[c] * 3,
+                      indexes.begin() + cluster_start[c + 1] * 3);
+    }
+    return result;
+}
+
+} // namespace
+
+VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t> &indexes,
+                                      size_t                       vertex_count,
+                                      uint32_t                     cache_size)
+{
+    // A vertex is in the FIFO if fewer than cache_size vertices have been
+    // transformed since it was (0 = never transformed)
+    std::vector<uint32_t> transform_time(vertex_count, 0);
+    uint32_t              transformed = 0;
+    uint32_t              referenced = 0;
+    size_t                face_count = indexes.size() / 3;
+    for(size_t i = 0; i < face_count * 3; i++)
+    {
+        uint32_t v = indexes[i];
+        if(transform_time[v] == 0) referenced++;
+        if(transform_time[v] == 0 || transformed - transform_time[v] >= cache_size)
+        {
+            transformed++;
+            transform_time[v] = transformed;
+        }
+    }
+
+    VertexCacheStats stats;
+    stats.vertices_transformed = transformed;
+    stats.acmr = (face_count > 0) ? static_cast<float>(transformed) / static_cast<float>(face_count) : 0.0f;
+    stats.atvr = (referenced > 0) ? static_cast<float>(transformed) / static_cast<float>(referenced) : 0.0f;
+    return stats;
+}
+
+void optimize_vertex_cache(std::vector<uint32_t> &indexes, size_t vertex_count)
+{
+    static const VertexScoreTables tables;
+
+    size_t face_count = indexes.size() / 3;
+    if(face_count < 2) return;
+
+    // Triangles using each vertex. The first live[v] entries of a vertex's
+    // list are the triangles not yet emitted.
+    std::vector<uint32_t> live(vertex_count, 0);
+    for(size_t i = 0; i < face_count * 3; i++) live[indexes[i]]++;
+
+    std::vector<uint32_t> offsets(vertex_count + 1);
+    offsets[0] = 0;
+    for(size_t v = 0; v < vertex_count; v++) offsets[v + 1] = offsets[v] + live[v];
+
+    std::vector<uint32_t> adjacency(face_count * 3);
+    {
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for(size_t i = 0; i < face_count * 3; i++)
+        {
+            adjacency[cursor[indexes[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    // Initial vertex and triangle scores
+    std::vector<int32_t> cache_position(vertex_count, -1);
+    std::vector<float>   vertex_score(vertex_count);
+    for(size_t v = 0; v < vertex_count; v++) vertex_score[v] = tables.score(-1, live[v]);
+
+    std::vector<float> face_score(face_count);
+    for(size_t f = 0; f < face_count; f++)
+    {
+        face_score[f] = vertex_score[indexes[f * 3]] + vertex_score[indexes[f * 3 + 1]] +
+                        vertex_score[indexes[f * 3 + 2]];
+    }
+
+    std::vector<uint8_t>  emitted(face_count, 0);
+    std::vector<uint32_t> result;
+    result.reserve(face_count * 3);
+
+    uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+    uint32_t cache_count = 0;
+    size_t   input_cursor = 0;
+    size_t   best = std::max_element(face_score.begin(), face_score.end()) - face_score.begin();
+    while(true)
+    {
+        // Emit the best triangle and remove it from its vertices' lists
+        const uint32_t *tri = &indexes[best * 3];
+        emitted[best] = 1;
+        result.insert(result.end(), tri, tri + 3);
+        for(uint32_t k = 0; k < 3; k++)
+        {
+            uint32_t  v = tri[k];
+            uint32_t *list = &adjacency[offsets[v]];
+            for(uint32_t j = 0; j < live[v]; j++)
+            {
+                if(list[j] == best)
+                {
+                    list[j] = list[live[v] - 1];
+                    live[v]--;
+                    break;
+                }
+            }
+        }
+
+        // Move the triangle's vertices to the front of the cache
+        uint32_t new_cache[FORSYTH_CACHE_SIZE + 3];
+        uint32_t new_count = 0;
+        for(uint32_t k = 0; k < 3; k++)
+        {
+            if(std::find(new_cache, new_cache + new_count, tri[k]) == new_cache + new_count)
+            {
+                new_cache[new_count++] = tri[k];
+            }
+        }
+        for(uint32_t i = 0; i < cache_count; i++)
+        {
+            if(cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+            {
+                new_cache[new_count++] = cache[i];
+            }
+        }
+
+        // Update the scores of vertices in the cache (and those just evicted)
+        // and of their remaining triangles
+        for(uint32_t i = 0; i < new_count; i++)
+        {
+            uint32_t v = new_cache[i];
+            cache_position[v] = (i < FORSYTH_CACHE_SIZE) ? static_cast<int32_t>(i) : -1;
+            float score = tables.score(cache_position[v], live[v]);
+            float delta = score - vertex_score[v];
+            vertex_score[v] = score;
+            for(uint32_t j = 0; j < live[v]; j++) face_score[adjacency[offsets[v] + j]] += delta;
+        }
+        cache_count = std::min(new_count, FORSYTH_CACHE_SIZE);
+        std::copy(new_cache, new_cache + cache_count, cache);
+
+        // Next triangle is the best one using a cached vertex
+        float best_score = -1.0f;
+        bool  found = false;
+        for(uint32_t i = 0; i < cache_count; i++)
+        {
+            uint32_t v = cache[i];
+            for(uint32_t j = 0; j < live[v]; j++)
+            {
+                uint32_t f = adjacency[offsets[v] + j];
+                if(face_score[f] > best_score)
+                {
+                    best_score = face_score[f];
+                    best = f;
+                    found = true;
+                }
+            }
+        }
+
+        // None (dead end): continue with the next triangle in input order
+        if(!found)
+        {
+            while(input_cursor < face_count && emitted[input_cursor]) input_cursor++;
+            if(input_cursor == face_count) break;
+            best = input_cursor;
+        }
+    }
+
+    std::copy(result.begin(), result.end(), indexes.begin());
+}
+
+void optimize_overdraw(std::vector<uint32_t>              &indexes,
+                       const std::vector<VertexAndNormal> &vertices,
+                       float                               threshold)
+{
+    size_t face_count = indexes.size() / 3;
+    if(face_count < 2 * MIN_CLUSTER_SIZE) return;
+
+    // Area weighted centroid of the mesh
+    Vector3 mesh_centroid(0.0f, 0.0f, 0.0f);
+    float   mesh_area = 0.0f;
+    for(size_t f = 0; f < face_count; f++)
+    {
+        const Point3 &p0 = vertices[indexes[f * 3]].vertex;
+        const Point3 &p1 = vertices[indexes[f * 3 + 1]].vertex;
+        const Point3 &p2 = vertices[indexes[f * 3 + 2]].vertex;
+        float         a = Vector3(p0, p1).cross(Vector3(p0, p2)).norm();
+        mesh_centroid += (Vector3(p0) + Vector3(p1) + Vector3(p2)) * (a / 3.0f);
+        mesh_area += a;
+    }
+    if(mesh_area > 0.0f) mesh_centroid *= 1.0f / mesh_area;
+
+    // Each cluster boundary costs a partial reload of the vertex cache. Start
+    // with small clusters (best for overdraw) and double the minimum size
+    // until the vertex cache cost is within the threshold.
+    VertexCacheStats original = analyze_vertex_cache(indexes, vertices.size(), OVERDRAW_CACHE_SIZE);
+    for(size_t min_size = MIN_CLUSTER_SIZE; min_size * 2 <= face_count; min_size *= 2)
+    {
+        std::vector<uint32_t> result = sort_clusters(
+            indexes, vertices, mesh_centroid, min_size, original.acmr * threshold);
+        if(result.empty()) return;
+
+        VertexCacheStats reordered = analyze_vertex_cache(result, vertices.size(), OVERDRAW_CACHE_SIZE);
+        if(reordered.acmr <= original.acmr * threshold)
+        {
+            std::copy(result.begin(), result.end(), indexes.begin());
+            return;
+        }
+    }
+}
+
+void optimize_vertex_fetch(std::vector<uint32_t> &indexes, std::vector<VertexAndNormal> &vertices)
+{
+    constexpr uint32_t UNUSED = 0xFFFFFFFF;
+
+    // New index of each vertex, in order of first use
+    std::vector<uint32_t> remap(vertices.size(), UNUSED);
+    uint32_t              next = 0;
+    for(auto &index : indexes)
+    {
+        if(remap[index] == UNUSED) remap[index] = next++;
+        index = remap[index];
+    }
+    for(auto &r : remap)
+    {
+        if(r == UNUSED) r = next++;
+    }
+
+    std::vector<VertexAndNormal> reordered(vertices.size());
+    for(size_t v = 0; v < vertices.size(); v++) reordered[remap[v]] = vertices[v];
+    vertices.swap(reordered);
+}
+
+} // namespace cg
@@ -0,0 +1,84 @@
+//============================================================================
+//	Johns Hopkins University Engineering for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    mesh_optimizer.hpp
+//	Purpose: Triangle mesh reordering for the GPU: post-transform vertex
+//           cache order, overdraw order and vertex fetch order. Includes a
+//           vertex cache simulator to measure the result.
+//
+//============================================================================
+
+#ifndef __GEOMETRY_MESH_OPTIMIZER_HPP__
+#define __GEOMETRY_MESH_OPTIMIZER_HPP__
+
+#include "geometry/types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+/**
+ * Results of a post-transform vertex cache simulation.
+ */
+struct VertexCacheStats
+{
+    uint32_t vertices_transformed; // Cache misses (vertex shader invocations)
+    float    acmr; // Average cache miss ratio: transformed vertices per triangle (0.5 - 3)
+    float    atvr; // Average transformed vertex ratio: transformed / referenced vertices (>= 1)
+};
+
+/**
+ * Simulate a FIFO post-transform vertex cache for a triangle list.
+ * @param  indexes       Triangle list (3 indexes per triangle).
+ * @param  vertex_count  Number of vertices.
+ * @param  cache_size    Number of vertices held in the cache.
+ * @return  Returns the number of transformed vertices, ACMR and ATVR.
+ */
+VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t> &indexes,
+                                      size_t                       vertex_count,
+                                      uint32_t                     cache_size = 16);
+
+/**
+ * Reorder triangles to reduce post-transform vertex cache misses (Forsyth,
+ * "Linear-Speed Vertex Cache Optimisation"). Triangles are chosen greedily
+ * by the score of their vertices, which favors vertices recently used and
+ * vertices with few remaining triangles. Does not depend on the cache size of
+ * the hardware.
+ * @param  indexes       Triangle list (reordered in place).
+ * @param  vertex_count  Number of vertices.
+ */
+void optimize_vertex_cache(std::vector<uint32_t> &indexes, size_t vertex_count);
+
+/**
+ * Reorder clusters of triangles to reduce overdraw (Sander et al., "Fast
+ * Triangle Reordering for Vertex Locality and Reduced Overdraw"). Splits a
+ * vertex cache optimized triangle list into clusters and sorts the clusters
+ * so those facing away from the center of the mesh (likely occluders) are
+ * drawn first. Keeps the original order if the ACMR would increase by more
+ * than the threshold.
+ * @param  indexes    Triangle list, already optimized for the vertex cache
+ *                    (reordered in place).
+ * @param  vertices   Vertex list.
+ * @param  threshold  Allowed ACMR increase (1.05 allows 5% more vertex cache misses).
+ */
+void optimize_overdraw(std::vector<uint32_t>              &indexes,
+                       const std::vector<VertexAndNormal> &vertices,
+                       float                               threshold = 1.05f);
+
+/**
+ * Reorder vertices in the order they are first used by the triangle list so
+ * vertex fetches are sequential. Unused vertices are moved to the end.
+ * @param  indexes   Triangle list (indexes are remapped in place).
+ * @param  vertices  Vertex list (reordered in place).
+ */
+void optimize_vertex_fetch(std::vector<uint32_t> &indexes, std::vector<VertexAndNormal> &vertices);
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,220 @@
+#include "geometry/parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cg
+{
+
+uint32_t get_thread_count()
+{
+    static const uint32_t count = std::max(1u, std::thread::hardware_concurrency());
+    return count;
+}
+
+namespace
+{
+
+// True on a thread while it runs a run_parallel job
+thread_local bool g_in_parallel_job = false;
+
+// Worker threads that wait for jobs. Starting threads for every loop costs
+// tens of microseconds per thread, which matters for loops run every frame.
+class WorkerPool
+{
+  public:
+    WorkerPool() : job_(nullptr), threads_(0), generation_(0), remaining_(0), stop_(false)
+    {
+        for(uint32_t t = 1; t < get_thread_count(); t++) workers_.emplace_back(&WorkerPool::work, this, t);
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        start_.notify_all();
+        for(auto &w : workers_) w.join();
+    }
+
+    // Run job(0) on the calling thread and job(t) on worker t for t in
+    // [1, threads). threads must not exceed get_thread_count().
+    void run(uint32_t threads, const std::function<void(uint32_t)> &job)
+    {
+        std::lock_guard<std::mutex> turn(dispatch_mutex_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = &job;
+            threads_ = threads;
+            remaining_ = threads - 1;
+            generation_++;
+        }
+        start_.notify_all();
+
+        g_in_parallel_job = true;
+        job(0);
+        g_in_parallel_job = false;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return remaining_ == 0; });
+        job_ = nullptr;
+    }
+
+  private:
+    std::vector<std::thread>             workers_;
+    std::mutex                           dispatch_mutex_; // Held by the thread running a job
+    std::mutex                           mutex_;
+    std::condition_variable              start_;
+    std::condition_variable              done_;
+    const std::function<void(uint32_t)> *job_;
+    uint32_t                             threads_;
+    uint64_t                             generation_; // Incremented for each job
+    uint32_t                             remaining_;  // Workers still running the job
+    bool                                 stop_;
+
+    void work(uint32_t thread)
+    {
+        g_in_parallel_job = true;
+        uint64_t                     generation = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(true)
+        {
+            start_.wait(lock, [&]() { return stop_ || generation_ != generation; });
+            if(stop_) return;
+            generation = generation_;
+            if(thread >= threads_) continue;
+
+            const std::function<void(uint32_t)> *job = job_;
+            lock.unlock();
+            (*job)(thread);
+            lock.lock();
+            if(--remaining_ == 0) done_.notify_one();
+        }
+    }
+};
+
+} // namespace
+
+void run_parallel(uint32_t threads, const std::function<void(uint32_t)> &job)
+{
+    if(threads < 2 || threads > get_thread_count() || g_in_parallel_job)
+    {
+        for(uint32_t t = 0; t < threads; t++) job(t);
+        return;
+    }
+    static WorkerPool pool;
+    pool.run(threads, job);
+}
+
+void parallel_for(size_t count, size_t min_block, const std::function<void(size_t, size_t)> &f)
+{
+    size_t blocks = std::min<size_t>(get_thread_count(), count / std::max<size_t>(min_block, 1));
+    if(blocks < 2)
+    {
+        if(count > 0) f(0, count);
+        return;
+    }
+
+    // Block b covers [b * count / blocks, (b + 1) * count / blocks)
+    run_parallel(static_cast<uint32_t>(blocks),
+                 [&](uint32_t b) { f(b * count / blocks, (b + 1) * count / blocks); });
+}
+
+namespace
+{
+
+// Items [begin, end) not yet taken from a thread's share, packed into one
+// word (begin in the high half) so the owner and thieves update it with a
+// single compare and swap. Padded to a cache line.
+struct alignas(64) WorkRange
+{
+    std::atomic<uint64_t> range;
+};
+
+inline uint64_t pack_range(uint64_t begin, uint64_t end) { return (begin << 32) | end; }
+
+// Take the first item of a range. Returns false if the range is empty.
+bool take_front(WorkRange &work, size_t &item)
+{
+    uint64_t r = work.range.load(std::memory_order_relaxed);
+    while(true)
+    {
+        uint64_t begin = r >> 32;
+        uint64_t end = r & 0xFFFFFFFF;
+        if(begin >= end) return false;
+        if(work.range.compare_exchange_weak(r, pack_range(begin + 1, end), std::memory_order_acq_rel))
+        {
+            item = static_cast<size_t>(begin);
+            return true;
+        }
+    }
+}
+
+// Take the last item of a range. Returns false if the range is empty.
+bool take_back(WorkRange &work, size_t &item)
+{
+    uint64_t r = work.range.load(std::memory_order_relaxed);
+    while(true)
+    {
+        uint64_t begin = r >> 32;
+        uint64_t end = r & 0xFFFFFFFF;
+        if(begin >= end) return false;
+        if(work.range.compare_exchange_weak(r, pack_range(begin, end - 1), std::memory_order_acq_rel))
+        {
+            item = static_cast<size_t>(end - 1);
+            return true;
+        }
+    }
+}
+
+} // namespace
+
+uint32_t parallel_for_stealing(size_t count, uint32_t max_threads, const std::function<void(size_t, uint32_t)> &f)
+{
+    uint32_t threads = (max_threads == 0) ? get_thread_count() : std::min(max_threads, get_thread_count());
+    threads = static_cast<uint32_t>(std::min<size_t>(threads, count));
+    if(threads < 2)
+    {
+        for(size_t i = 0; i < count; i++) f(i, 0);
+        return 1;
+    }
+
+    // Thread t starts with [t * count / threads, (t + 1) * count / threads)
+    std::vector<WorkRange> work(threads);
+    for(uint32_t t = 0; t < threads; t++)
+    {
+        work[t].range.store(pack_range(t * count / threads, (t + 1) * count / threads));
+    }
+
+    // Shares only shrink, so once every share is empty there is no more work
+    auto run = [&](uint32_t t)
+    {
+        size_t item;
+        while(true)
+        {
+            if(take_front(work[t], item))
+            {
+                f(item, t);
+                continue;
+            }
+
+            bool stolen = false;
+            for(uint32_t i = 1; i < threads && !stolen; i++)
+            {
+                stolen = take_back(work[(t + i) % threads], item);
+            }
+            if(!stolen) return;
+            f(item, t);
+        }
+    };
+
+    run_parallel(threads, run);
+    return threads;
+}
+
+} // namespace cg
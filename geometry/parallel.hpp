@@ -0,0 +1,68 @@
+//============================================================================
+//	Johns Hopkins University Engineering for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    parallel.hpp
+//	Purpose: Simple data-parallel loops over a range using a persistent pool
+//           of worker threads.
+//
+//============================================================================
+
+#ifndef __GEOMETRY_PARALLEL_HPP__
+#define __GEOMETRY_PARALLEL_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace cg
+{
+
+/**
+ * Get the number of threads used by parallel_for.
+ * @return  Returns the number of hardware threads (at least 1).
+ */
+uint32_t get_thread_count();
+
+/**
+ * Call job(thread) for each thread in [0, threads) at the same time: the
+ * calling thread runs thread 0 and a persistent pool of worker threads
+ * (get_thread_count() - 1 of them, started on first use) runs the others.
+ * Returns once every call has returned. Calls from several threads take
+ * turns. Calls made from within a job, or for more threads than
+ * get_thread_count(), run each thread in turn on the calling thread.
+ * @param  threads  Number of threads.
+ * @param  job      Function called with each thread index.
+ */
+void run_parallel(uint32_t threads, const std::function<void(uint32_t)> &job);
+
+/**
+ * Split the range [0, count) into contiguous blocks and call f(begin, end)
+ * for each block, using one block per thread. The calling thread processes
+ * the first block. Runs on the calling thread alone if the range is smaller
+ * than 2 * min_block or only one hardware thread is available.
+ * @param  count      Number of elements.
+ * @param  min_block  Minimum number of elements given to a thread.
+ * @param  f          Function called with each block [begin, end).
+ */
+void parallel_for(size_t count, size_t min_block, const std::function<void(size_t, size_t)> &f);
+
+/**
+ * Call f(item, thread) for each item in [0, count) using work stealing. Each
+ * thread starts with a contiguous share of the items and takes them from the
+ * front; a thread that runs out takes items from the back of another thread's
+ * share. Suits items with uneven cost (for example image tiles). The calling
+ * thread is thread 0 and the others come from the run_parallel pool.
+ * @param  count         Number of items (less than 2^32).
+ * @param  max_threads   Maximum number of threads (0 for get_thread_count()).
+ * @param  f             Function called with each item and the index of the
+ *                       thread running it (less than the thread count used).
+ * @return  Returns the number of threads used.
+ */
+uint32_t parallel_for_stealing(size_t count, uint32_t max_threads, const std::function<void(size_t, uint32_t)> &f);
+
+} // namespace cg
+
+#endif
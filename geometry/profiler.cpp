@@ -0,0 +1,249 @@
+#include "geometry/profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+namespace cg
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Timestamp and clock time when the profiler started (for calibrating the
+// time stamp counter against the steady clock)
+struct ProfileEpoch
+{
+    uint64_t          ticks;
+    Clock::time_point time;
+};
+
+ProfileEpoch get_epoch()
+{
+    static const ProfileEpoch epoch = {get_profile_ticks(), Clock::now()};
+    return epoch;
+}
+
+// Nanoseconds per tick
+double get_ns_per_tick()
+{
+#if defined(CG_PROFILER_TSC)
+    // Measure over at least 20 ms since the epoch
+    ProfileEpoch epoch = get_epoch();
+    Clock::time_point now = Clock::now();
+    while(now - epoch.time < std::chrono::milliseconds(20)) now = Clock::now();
+    uint64_t ticks = get_profile_ticks();
+    double   ns = std::chrono::duration<double, std::nano>(now - epoch.time).count();
+    return ns / static_cast<double>(ticks - epoch.ticks);
+#else
+    return 1.0e9 * static_cast<double>(Clock::period::num) / static_cast<double>(Clock::period::den);
+#endif
+}
+
+// Writes a string as a JSON string (zone names are identifiers, but quote
+// anything unusual)
+void write_json_string(FILE *file, const char *str)
+{
+    fputc('"', file);
+    for(const char *c = str; *c != '\0'; c++)
+    {
+        if(*c == '"' || *c == '\\') fputc('\\', file);
+        if(static_cast<unsigned char>(*c) < ' ') continue;
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+} // namespace
+
+void set_profiling(bool enable)
+{
+    get_epoch();
+    g_profile_registry.enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool is_profiling() { return g_profile_registry.enabled.load(std::memory_order_relaxed); }
+
+void set_profile_thread_name(const char *name)
+{
+    ProfileBuffer              *buffer = get_thread_profile_buffer();
+    std::lock_guard<std::mutex> lock(g_profile_registry.mutex);
+    buffer->thread_name = name;
+}
+
+void clear_profile()
+{
+    std::lock_guard<std::mutex> lock(g_profile_registry.mutex);
+    for(ProfileBuffer *buffer : g_profile_registry.buffers)
+    {
+        buffer->first.store(buffer->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+size_t copy_profile(std::vector<std::vector<ProfileEvent>> &buffer_events)
+{
+    std::lock_guard<std::mutex> lock(g_profile_registry.mutex);
+    buffer_events.resize(g_profile_registry.buffers.size());
+    size_t count = 0;
+    for(ProfileBuffer *buffer : g_profile_registry.buffers)
+    {
+        std::vector<ProfileEvent> &events = buffer_events[buffer->thread_id];
+        events.clear();
+
+        // Copy [first, head), at most a full ring
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = buffer->first.load(std::memory_order_relaxed);
+        if(head > ProfileBuffer::CAPACITY) first = std::max(first, head - ProfileBuffer::CAPACITY);
+        for(uint64_t i = first; i < head; i++) events.push_back(buffer->events[i & (ProfileBuffer::CAPACITY - 1)]);
+
+        // Drop zones the thread overwrote while copying
+        uint64_t new_head = buffer->head.load(std::memory_order_acquire);
+        if(new_head > ProfileBuffer::CAPACITY && new_head - ProfileBuffer::CAPACITY > first)
+        {
+            size_t overwritten = static_cast<size_t>(std::min(new_head - ProfileBuffer::CAPACITY - first, head - first));
+            events.erase(events.begin(), events.begin() + overwritten);
+        }
+        count += events.size();
+    }
+    return count;
+}
+
+double profile_ticks_to_ns(uint64_t ticks)
+{
+    static const double ns_per_tick = get_ns_per_tick();
+    return static_cast<double>(ticks) * ns_per_tick;
+}
+
+bool write_chrome_trace(const char *filename)
+{
+    std::vector<std::vector<ProfileEvent>> buffer_events;
+    copy_profile(buffer_events);
+
+    std::vector<const char *> thread_names;
+    {
+        std::lock_guard<std::mutex> lock(g_profile_registry.mutex);
+        for(ProfileBuffer *buffer : g_profile_registry.buffers) thread_names.push_back(buffer->thread_name);
+    }
+
+    FILE *file = fopen(filename, "w");
+    if(file == nullptr)
+    {
+        printf("Could not open %s\n", filename);
+        return false;
+    }
+
+    // Times in microseconds from the earliest zone
+    uint64_t origin = UINT64_MAX;
+    for(const auto &events : buffer_events)
+    {
+        for(const ProfileEvent &e : events) origin = std::min(origin, e.start);
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for(size_t t = 0; t < buffer_events.size(); t++)
+    {
+        if(thread_names[t] != nullptr)
+        {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":", first ? "" : ",\n", t);
+            write_json_string(file, thread_names[t]);
+            fprintf(file, "}}");
+            first = false;
+        }
+        for(const ProfileEvent &e : buffer_events[t])
+        {
+            fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+            write_json_string(file, e.name);
+            fprintf(file,
+                    ",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}",
+                    t,
+                    profile_ticks_to_ns(e.start - origin) * 1.0e-3,
+                    profile_ticks_to_ns(e.end - e.start) * 1.0e-3);
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    bool success = (ferror(file) == 0);
+    fclose(file);
+    return success;
+}
+
+void print_profile_summary()
+{
+    std::vector<std::vector<ProfileEvent>> buffer_events;
+    size_t                                 count = copy_profile(buffer_events);
+
+    struct ZoneTotals
+    {
+        const char *name;
+        uint64_t    count;
+        uint64_t    total; // Outermost zones of this name
+        uint64_t    self;  // All zones of this name, less their child zones
+    };
+    std::vector<ZoneTotals>                 totals;
+    std::unordered_map<std::string, size_t> index;
+
+    // Zone still open at the current point of the sweep
+    struct OpenZone
+    {
+        size_t   zone;     // Index into totals
+        uint64_t end;      // End time
+        uint64_t duration;
+        uint64_t children; // Time in child zones
+    };
+
+    for(auto &events : buffer_events)
+    {
+        // Outer zones before the zones they contain
+        std::sort(events.begin(), events.end(), [](const ProfileEvent &a, const ProfileEvent &b) {
+            return a.start < b.start || (a.start == b.start && a.depth < b.depth);
+        });
+
+        std::vector<OpenZone> open;
+        auto                  close_zone = [&]()
+        {
+            totals[open.back().zone].self += open.back().duration - std::min(open.back().duration, open.back().children);
+            open.pop_back();
+        };
+        for(const ProfileEvent &e : events)
+        {
+            while(!open.empty() && open.back().end <= e.start) close_zone();
+
+            auto it = index.find(e.name);
+            if(it == index.end())
+            {
+                it = index.emplace(e.name, totals.size()).first;
+                totals.push_back({e.name, 0, 0, 0});
+            }
+            size_t   zone = it->second;
+            uint64_t duration = e.end - e.start;
+            totals[zone].count++;
+
+            // Recursive zones add to the total only at the outermost level
+            if(std::none_of(open.begin(), open.end(), [&](const OpenZone &o) { return o.zone == zone; }))
+            {
+                totals[zone].total += duration;
+            }
+            if(!open.empty()) open.back().children += duration;
+            open.push_back({zone, e.end, duration, 0});
+        }
+        while(!open.empty()) close_zone();
+    }
+
+    std::sort(totals.begin(), totals.end(), [](const ZoneTotals &a, const ZoneTotals &b) { return a.total > b.total; });
+    printf("Profile: %zu zones\n", count);
+    printf("  %-40s %10s %12s %12s\n", "zone", "count", "total (ms)", "self (ms)");
+    for(const ZoneTotals &zone : totals)
+    {
+        printf("  %-40s %10llu %12.3f %12.3f\n",
+               zone.name,
+               static_cast<unsigned long long>(zone.count),
+               profile_ticks_to_ns(zone.total) * 1.0e-6,
+               profile_ticks_to_ns(zone.self) * 1.0e-6);
+    }
+}
+
+} // namespace cg
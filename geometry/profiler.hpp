@@ -0,0 +1,259 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    profiler.hpp
+//	Purpose: Hierarchical profiler. Scoped zones record their start and end
+//           times into per-thread ring buffers, exported as a Chrome trace
+//           (chrome://tracing or ui.perfetto.dev) or a summary.
+//
+//============================================================================
+
+#ifndef __GEOMETRY_PROFILER_HPP__
+#define __GEOMETRY_PROFILER_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CG_PROFILER_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Set by CMake (option CG_PROFILER). 0 compiles the zone macros to nothing.
+#ifndef CG_PROFILER
+#define CG_PROFILER 1
+#endif
+
+namespace cg
+{
+
+/**
+ * Get the profiler's timestamp: the CPU time stamp counter on x86, the
+ * steady clock (nanoseconds) elsewhere. Converted to time on export.
+ * @return  Returns the timestamp (ticks).
+ */
+inline uint64_t get_profile_ticks()
+{
+#if defined(CG_PROFILER_TSC)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// Zone recorded by a thread
+struct ProfileEvent
+{
+    const char *name;  // Zone name (string literal)
+    uint64_t    start; // Start and end (ticks)
+    uint64_t    end;
+    uint32_t    depth; // Number of enclosing zones on the thread
+};
+
+/**
+ * Ring buffer of one thread's zones. Only the owning thread writes (no
+ * locks); once full the oldest zones are overwritten. Readers copy the
+ * zones below the published head and drop any the writer may have
+ * overwritten while they were copying.
+ */
+struct ProfileBuffer
+{
+    static constexpr uint32_t CAPACITY = 1u << 16; // Zones kept (power of 2)
+
+    ProfileEvent          events[CAPACITY];
+    std::atomic<uint64_t> head{0};       // Zones recorded
+    std::atomic<uint64_t> first{0};      // First zone kept (set by clear_profile)
+    uint32_t              depth = 0;     // Open zones
+    uint32_t              thread_id = 0; // Index in the profiler's buffer list
+    const char           *thread_name = nullptr;
+    bool                  in_use = true; // Owned by a running thread
+
+    /**
+     * Record a zone that ended.
+     */
+    void record(const char *name, uint64_t start, uint64_t end, uint32_t zone_depth)
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        events[h & (CAPACITY - 1)] = {name, start, end, zone_depth};
+        head.store(h + 1, std::memory_order_release);
+        depth = zone_depth;
+    }
+};
+
+// Buffers of all threads that recorded zones. Buffers are never freed; a
+// buffer whose thread exited is reused by the next new thread.
+struct ProfileRegistry
+{
+    std::mutex                  mutex;
+    std::vector<ProfileBuffer *> buffers;
+    std::atomic<bool>           enabled{false};
+};
+
+inline ProfileRegistry g_profile_registry;
+
+// Releases the thread's buffer for reuse when the thread exits
+struct ProfileThread
+{
+    ProfileBuffer *buffer = nullptr;
+
+    ~ProfileThread()
+    {
+        if(buffer == nullptr) return;
+        std::lock_guard<std::mutex> lock(g_profile_registry.mutex);
+        buffer->in_use = false;
+    }
+};
+
+// The calling thread's buffer. A plain pointer, so reading it needs no
+// thread_local initialization check.
+inline thread_local ProfileBuffer *g_profile_buffer = nullptr;
+
+/**
+ * Take a free buffer (or create one) for the calling thread.
+ * @return  Returns the thread's buffer.
+ */
+inline ProfileBuffer *acquire_thread_profile_buffer()
+{
+    static thread_local ProfileThread thread;
+
+    std::lock_guard<std::mutex> lock(g_profile_registry.mutex);
+    for(ProfileBuffer *buffer : g_profile_registry.buffers)
+    {
+        if(!buffer->in_use)
+        {
+            buffer->in_use = true;
+            buffer->depth = 0;
+            buffer->thread_name = nullptr;
+            thread.buffer = g_profile_buffer = buffer;
+            return buffer;
+        }
+    }
+    ProfileBuffer *buffer = new ProfileBuffer;
+    buffer->thread_id = static_cast<uint32_t>(g_profile_registry.buffers.size());
+    g_profile_registry.buffers.push_back(buffer);
+    thread.buffer = g_profile_buffer = buffer;
+    return buffer;
+}
+
+/**
+ * Get the calling thread's buffer.
+ * @return  Returns the thread's buffer.
+ */
+inline ProfileBuffer *get_thread_profile_buffer()
+{
+    ProfileBuffer *buffer = g_profile_buffer;
+    return (buffer != nullptr) ? buffer : acquire_thread_profile_buffer();
+}
+
+/**
+ * Scoped zone: records the time from construction to destruction on the
+ * calling thread, if profiling was enabled at construction. Use through
+ * CG_PROFILE_ZONE so zones compile out with CG_PROFILER=0.
+ */
+class ProfileZone
+{
+  public:
+    /**
+     * Start a zone.
+     * @param  name  Zone name. Must outlive the profile (a string literal).
+     */
+    explicit ProfileZone(const char *name) : buffer_(nullptr), name_(name), start_(0), depth_(0)
+    {
+        if(!g_profile_registry.enabled.load(std::memory_order_relaxed)) return;
+        buffer_ = get_thread_profile_buffer();
+        depth_ = buffer_->depth++;
+        start_ = get_profile_ticks();
+    }
+
+    /**
+     * End the zone.
+     */
+    ~ProfileZone()
+    {
+        if(buffer_ != nullptr) buffer_->record(name_, start_, get_profile_ticks(), depth_);
+    }
+
+    ProfileZone(const ProfileZone &) = delete;
+    ProfileZone &operator=(const ProfileZone &) = delete;
+
+  protected:
+    ProfileBuffer *buffer_;
+    const char    *name_;
+    uint64_t       start_;
+    uint32_t       depth_;
+};
+
+/**
+ * Start or stop recording zones (on all threads). Zones open when
+ * profiling stops are still recorded.
+ * @param  enable  True to record zones.
+ */
+void set_profiling(bool enable);
+
+/**
+ * Check whether zones are being recorded.
+ * @return  Returns true if profiling is enabled.
+ */
+bool is_profiling();
+
+/**
+ * Name the calling thread in exported traces.
+ * @param  name  Thread name (a string literal).
+ */
+void set_profile_thread_name(const char *name);
+
+/**
+ * Drop the zones recorded so far (on all threads).
+ */
+void clear_profile();
+
+/**
+ * Copy the zones recorded so far. Safe while other threads record zones.
+ * @param  buffer_events  Receives the zones of each thread (index is the
+ *                        thread id), oldest first.
+ * @return  Returns the number of zones copied.
+ */
+size_t copy_profile(std::vector<std::vector<ProfileEvent>> &buffer_events);
+
+/**
+ * Convert a tick count to nanoseconds.
+ * @param  ticks  Ticks (a difference of timestamps).
+ * @return  Returns the time in nanoseconds.
+ */
+double profile_ticks_to_ns(uint64_t ticks);
+
+/**
+ * Write the recorded zones as a Chrome trace (JSON trace event format, also
+ * read by Perfetto).
+ * @param  filename  File to write.
+ * @return  Returns true if the file was written.
+ */
+bool write_chrome_trace(const char *filename);
+
+/**
+ * Print the count, total and self time (total less the child zones) of
+ * each zone name, most total time first.
+ */
+void print_profile_summary();
+
+} // namespace cg
+
+#if CG_PROFILER
+#define CG_PROFILE_CONCAT_(a, b) a##b
+#define CG_PROFILE_CONCAT(a, b) CG_PROFILE_CONCAT_(a, b)
+#define CG_PROFILE_ZONE(name) cg::ProfileZone CG_PROFILE_CONCAT(cg_profile_zone_, __LINE__)(name)
+#else
+#define CG_PROFILE_ZONE(name) ((void)0)
+#endif
+
+#endif
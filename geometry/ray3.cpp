@@ -2,6 +2,8 @@
 
 #include "geometry/geometry.hpp"
 
+#include <algorithm>
+#include <cfloat>
 #include <cmath>
 
 namespace cg
@@ -86,8 +88,39 @@ RayObjectIntersectResult Ray3::intersect(const BoundingSphere &sphere) const
 
 RayObjectIntersectResult Ray3::intersect(const AABB &box) const
 {
-    // Required in 605.767
-    return {false, 0.0f};
+    if(box.is_empty()) return {false, 0.0f};
+
+    // Slab method: intersect the ranges of t where the ray lies between each
+    // pair of planes. A zero direction component gives infinite slab
+    // distances, which the comparisons handle.
+    float t_near = -FLT_MAX;
+    float t_far = FLT_MAX;
+    const float origin[3] = {o.x, o.y, o.z};
+    const float dir[3] = {d.x, d.y, d.z};
+    const float min[3] = {box.min_point.x, box.min_point.y, box.min_point.z};
+    const float max[3] = {box.max_point.x, box.max_point.y, box.max_point.z};
+    for(uint32_t i = 0; i < 3; i++)
+    {
+        if(dir[i] == 0.0f)
+        {
+            // Parallel to the slab: must start inside it
+            if(origin[i] < min[i] || origin[i] > max[i]) return {false, 0.0f};
+            continue;
+        }
+        float inv_d = 1.0f / dir[i];
+        float t0 = (min[i] - origin[i]) * inv_d;
+        float t1 = (max[i] - origin[i]) * inv_d;
+        if(t0 > t1) std::swap(t0, t1);
+        t_near = std::max(t_near, t0);
+        t_far = std::min(t_far, t1);
+        if(t_near > t_far) return {false, 0.0f};
+    }
+
+    // Box is behind the ray
+    if(t_far < 0.0f) return {false, 0.0f};
+
+    // The origin is inside the box if t_near < 0: the exit is the intersection
+    return {true, (t_near >= 0.0f) ? t_near : t_far};
 }
 
 RayObjectIntersectResult Ray3::intersect(const std::vector<Point3> &polygon,
@@ -100,38 +133,120 @@ RayObjectIntersectResult Ray3::intersect(const std::vector<Point3> &polygon,
 RayTriangleIntersectResult
     Ray3::intersect(const Point3 &v0, const Point3 &v1, const Point3 &v2) const
 {
-    // Required in 605.767
-    return {false, 0.0f, 0.0f, 0.0f};
+    // Moller-Trumbore: solve o + t d = v0 + u e1 + v e2 with Cramer's rule
+    Vector3 e1 = v1 - v0;
+    Vector3 e2 = v2 - v0;
+    Vector3 p = d.cross(e2);
+    float   det = e1.dot(p);
+    if(std::abs(det) < EPSILON * EPSILON)
+    {
+        // Ray is parallel to the triangle
+        return {false, 0.0f, 0.0f, 0.0f};
+    }
+
+    float   inv_det = 1.0f / det;
+    Vector3 s = o - v0;
+    float   u = s.dot(p) * inv_det;
+    if(u < 0.0f || u > 1.0f) return {false, 0.0f, 0.0f, 0.0f};
+
+    Vector3 q = s.cross(e1);
+    float   v = d.dot(q) * inv_det;
+    if(v < 0.0f || u + v > 1.0f) return {false, 0.0f, 0.0f, 0.0f};
+
+    // Intersections behind the ray origin are not counted
+    float t = e2.dot(q) * inv_det;
+    if(t < EPSILON) return {false, 0.0f, 0.0f, 0.0f};
+    return {true, t, u, v};
 }
 
 bool Ray3::does_intersect_exist(const Point3 &v0, const Point3 &v1, const Point3 &v2) const
 {
-    // Required in 605.767
-    return false;
+    return intersect(v0, v1, v2).intersects;
 }
 
+namespace
+{
+
+inline const Point3 &get_position(const Point3 &p) { return p; }
+
+inline const Point3 &get_position(const VertexAndNormal &v) { return v.vertex; }
+
+/**
+ * Intersect a ray with a triangle mesh 8 faces at a time using the triangle
+ * kernels. Finds the nearest hit closer than t_max, or stops at the first
+ * hit found if any_hit is set.
+ */
+template <typename V>
+RayMeshIntersectResult intersect_mesh(const Ray3                  &ray,
+                                      const std::vector<V>        &vertex_list,
+                                      const std::vector<uint32_t> &face_list,
+                                      float                        t_max,
+                                      bool                         any_hit)
+{
+    const TriangleKernels &kernels = get_triangle_kernels();
+    const float            o[3] = {ray.o.x, ray.o.y, ray.o.z};
+    const float            d[3] = {ray.d.x, ray.d.y, ray.d.z};
+
+    // Block of 8 triangles (first vertex and edges, see TriangleSoA)
+    float    tris[TriangleSoA::COMPONENTS * 8];
+    float    t[8], u[8], v[8];
+    uint32_t face_count = static_cast<uint32_t>(face_list.size() / 3);
+
+    RayMeshIntersectResult result = {false, 0.0f, 0.0f, 0.0f, 0};
+    for(uint32_t first = 0; first < face_count; first += 8)
+    {
+        uint32_t count = std::min(face_count - first, 8u);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            const uint32_t *face = &face_list[(first + i) * 3];
+            const Point3   &v0 = get_position(vertex_list[face[0]]);
+            const Point3   &v1 = get_position(vertex_list[face[1]]);
+            const Point3   &v2 = get_position(vertex_list[face[2]]);
+            tris[i] = v0.x;
+            tris[8 + i] = v0.y;
+            tris[16 + i] = v0.z;
+            tris[24 + i] = v1.x - v0.x;
+            tris[32 + i] = v1.y - v0.y;
+            tris[40 + i] = v1.z - v0.z;
+            tris[48 + i] = v2.x - v0.x;
+            tris[56 + i] = v2.y - v0.y;
+            tris[64 + i] = v2.z - v0.z;
+        }
+
+        uint32_t mask = kernels.intersect_1x8(o, d, t_max, tris, 8, count, t, u, v);
+        for(uint32_t i = 0; mask != 0; i++, mask >>= 1)
+        {
+            if((mask & 1) == 0 || t[i] >= t_max) continue;
+
+            t_max = t[i];
+            result = {true, t[i], u[i], v[i], first + i};
+            if(any_hit) return result;
+        }
+    }
+    return result;
+}
+
+} // namespace
+
 RayMeshIntersectResult Ray3::intersect(const std::vector<Point3>   &vertex_list,
-                                       const std::vector<uint16_t> &face_list,
+                                       const std::vector<uint32_t> &face_list,
                                        float                        t_min) const
 {
-    // Required in 605.767
-    return {false, 0.0f, 0.0f, 0.0f, 0};
+    return intersect_mesh(*this, vertex_list, face_list, t_min, false);
 }
 
 bool Ray3::does_intersect_exist(const std::vector<Point3>   &vertex_list,
-                                const std::vector<uint16_t> &face_list,
+                                const std::vector<uint32_t> &face_list,
                                 float                        t_min) const
 {
-    // Required in 605.767
-    return false;
+    return intersect_mesh(*this, vertex_list, face_list, t_min, true).intersects;
 }
 
 bool Ray3::does_intersect_exist(const std::vector<VertexAndNormal> &vertex_list,
-                                const std::vector<uint16_t>        &face_list,
+                                const std::vector<uint32_t>        &face_list,
                                 float                               t_min) const
 {
-    // Required in 605.767
-    return false;
+    return intersect_mesh(*this, vertex_list, face_list, t_min, true).intersects;
 }
 
 } // namespace cg
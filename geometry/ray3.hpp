@@ -164,7 +164,7 @@ struct Ray3
      *         the barycentric coordinates of intersection, and the face index.
      */
     RayMeshIntersectResult intersect(const std::vector<Point3>   &vertex_list,
-                                     const std::vector<uint16_t> &face_list,
+                                     const std::vector<uint32_t> &face_list,
                                      float                        t_min) const;
 
     /**
@@ -176,7 +176,7 @@ struct Ray3
      * @return Returns true if an intersection exists, false if not.
      */
     bool does_intersect_exist(const std::vector<Point3>   &vertex_list,
-                              const std::vector<uint16_t> &face_list,
+                              const std::vector<uint32_t> &face_list,
                               float                        t_min) const;
 
     /**
@@ -188,7 +188,7 @@ struct Ray3
      * @return Returns true if an intersection exists, false if not.
      */
     bool does_intersect_exist(const std::vector<VertexAndNormal> &vertex_list,
-                              const std::vector<uint16_t>        &face_list,
+                              const std::vector<uint32_t>        &face_list,
                               float                               t_min) const;
 };
 
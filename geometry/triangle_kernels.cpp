@@ -0,0 +1,180 @@
+#include "geometry/triangle_kernels.hpp"
+
+#include "geometry/geometry.hpp"
+
+#include <cmath>
+
+namespace cg
+{
+
+// Instruction set specific kernels. Returns nullptr if the instruction set is
+// not available in this build or on this CPU.
+const TriangleKernels *get_avx2_triangle_kernels();
+
+TriangleSoA::TriangleSoA() : count_(0), stride_(0) {}
+
+void TriangleSoA::resize(size_t count)
+{
+    // Pad so a load of 8 starting at the last triangle stays in the array
+    count_ = count;
+    stride_ = (count + 7 + 7) / 8 * 8;
+    data_.assign(COMPONENTS * stride_, 0.0f);
+}
+
+void TriangleSoA::set(size_t i, const Point3 &v0, const Point3 &v1, const Point3 &v2)
+{
+    float *p = data_.data() + i;
+    p[0] = v0.x;
+    p[stride_] = v0.y;
+    p[2 * stride_] = v0.z;
+    p[3 * stride_] = v1.x - v0.x;
+    p[4 * stride_] = v1.y - v0.y;
+    p[5 * stride_] = v1.z - v0.z;
+    p[6 * stride_] = v2.x - v0.x;
+    p[7 * stride_] = v2.y - v0.y;
+    p[8 * stride_] = v2.z - v0.z;
+}
+
+size_t TriangleSoA::size() const { return count_; }
+
+size_t TriangleSoA::get_stride() const { return stride_; }
+
+const float *TriangleSoA::get_data(size_t i) const { return data_.data() + i; }
+
+RayPacket8::RayPacket8()
+{
+    for(uint32_t i = 0; i < 8; i++)
+    {
+        o[0][i] = o[1][i] = o[2][i] = 0.0f;
+        d[0][i] = 1.0f;
+        d[1][i] = d[2][i] = 0.0f;
+        t_max[i] = 0.0f;
+    }
+}
+
+void RayPacket8::set(uint32_t i, const Ray3 &ray, float t)
+{
+    o[0][i] = ray.o.x;
+    o[1][i] = ray.o.y;
+    o[2][i] = ray.o.z;
+    d[0][i] = ray.d.x;
+    d[1][i] = ray.d.y;
+    d[2][i] = ray.d.z;
+    t_max[i] = t;
+}
+
+namespace
+{
+
+/**
+ * Moller-Trumbore intersection of a ray with a triangle given as its first
+ * vertex and two edges. Same operations (and results) as Ray3::intersect.
+ */
+inline bool intersect_triangle(const float *o,
+                               const float *d,
+                               float        t_max,
+                               const float *v0,
+                               const float *e1,
+                               const float *e2,
+                               float       &t,
+                               float       &u,
+                               float       &v)
+{
+    float px = d[1] * e2[2] - d[2] * e2[1];
+    float py = d[2] * e2[0] - d[0] * e2[2];
+    float pz = d[0] * e2[1] - d[1] * e2[0];
+    float det = e1[0] * px + e1[1] * py + e1[2] * pz;
+    if(std::abs(det) < EPSILON * EPSILON) return false;
+
+    float inv_det = 1.0f / det;
+    float sx = o[0] - v0[0];
+    float sy = o[1] - v0[1];
+    float sz = o[2] - v0[2];
+    u = (sx * px + sy * py + sz * pz) * inv_det;
+    if(u < 0.0f || u > 1.0f) return false;
+
+    float qx = sy * e1[2] - sz * e1[1];
+    float qy = sz * e1[0] - sx * e1[2];
+    float qz = sx * e1[1] - sy * e1[0];
+    v = (d[0] * qx + d[1] * qy + d[2] * qz) * inv_det;
+    if(v < 0.0f || u + v > 1.0f) return false;
+
+    t = (e2[0] * qx + e2[1] * qy + e2[2] * qz) * inv_det;
+    return t >= EPSILON && t < t_max;
+}
+
+uint32_t intersect_1x8_scalar(const float *o,
+                              const float *d,
+                              float        t_max,
+                              const float *tris,
+                              size_t       stride,
+                              uint32_t     count,
+                              float       *t,
+                              float       *u,
+                              float       *v)
+{
+    uint32_t mask = 0;
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const float *tri = tris + i;
+        const float  v0[3] = {tri[0], tri[stride], tri[2 * stride]};
+        const float  e1[3] = {tri[3 * stride], tri[4 * stride], tri[5 * stride]};
+        const float  e2[3] = {tri[6 * stride], tri[7 * stride], tri[8 * stride]};
+        if(intersect_triangle(o, d, t_max, v0, e1, e2, t[i], u[i], v[i])) mask |= 1u << i;
+    }
+    return mask;
+}
+
+uint32_t intersect_8x1_scalar(const RayPacket8 &rays,
+                              const float      *tri,
+                              size_t            stride,
+                              float            *t,
+                              float            *u,
+                              float            *v)
+{
+    const float v0[3] = {tri[0], tri[stride], tri[2 * stride]};
+    const float e1[3] = {tri[3 * stride], tri[4 * stride], tri[5 * stride]};
+    const float e2[3] = {tri[6 * stride], tri[7 * stride], tri[8 * stride]};
+    uint32_t    mask = 0;
+    for(uint32_t i = 0; i < 8; i++)
+    {
+        const float o[3] = {rays.o[0][i], rays.o[1][i], rays.o[2][i]};
+        const float d[3] = {rays.d[0][i], rays.d[1][i], rays.d[2][i]};
+        if(intersect_triangle(o, d, rays.t_max[i], v0, e1, e2, t[i], u[i], v[i])) mask |= 1u << i;
+    }
+    return mask;
+}
+
+const TriangleKernels SCALAR_TRIANGLE_KERNELS = {SimdLevel::SCALAR, "scalar", intersect_1x8_scalar,
+                                                 intersect_8x1_scalar};
+
+// Select the widest kernels the CPU supports when the library is loaded.
+// Until then (during static initialization of other translation units) the
+// scalar kernels are used.
+const bool g_kernels_selected = set_triangle_simd_level(
+    (get_avx2_triangle_kernels() != nullptr) ? SimdLevel::AVX2 : SimdLevel::SCALAR);
+
+} // namespace
+
+const TriangleKernels *g_triangle_kernels = &SCALAR_TRIANGLE_KERNELS;
+
+const TriangleKernels *get_triangle_kernels(SimdLevel level)
+{
+    switch(level)
+    {
+        case SimdLevel::SCALAR: return &SCALAR_TRIANGLE_KERNELS;
+        case SimdLevel::AVX2: return get_avx2_triangle_kernels();
+        default: return nullptr;
+    }
+}
+
+bool set_triangle_simd_level(SimdLevel level)
+{
+    const TriangleKernels *kernels = get_triangle_kernels(level);
+    if(kernels == nullptr) return false;
+
+    g_triangle_kernels = kernels;
+    return true;
+}
+
+} // namespace cg
@@ -0,0 +1,170 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    triangle_kernels.hpp
+//	Purpose: Moller-Trumbore ray / triangle kernels (scalar, AVX2) that test
+//           one ray against 8 triangles or a packet of 8 rays against one
+//           triangle. Selected at startup like the matrix kernels.
+//
+//============================================================================
+
+#ifndef __GEOMETRY_TRIANGLE_KERNELS_HPP__
+#define __GEOMETRY_TRIANGLE_KERNELS_HPP__
+
+#include "geometry/matrix_kernels.hpp"
+#include "geometry/point3.hpp"
+#include "geometry/ray3.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+/**
+ * Triangles stored as a structure of arrays for the triangle kernels. Each
+ * triangle is stored as its first vertex and two edge vectors (v1 - v0 and
+ * v2 - v0). Component k (v0.x, v0.y, v0.z, e1.x, ..., e2.z) of triangle i is
+ * at get_data()[k * get_stride() + i]. Each array is padded with degenerate
+ * triangles so 8 triangles can be loaded starting at any triangle.
+ */
+class TriangleSoA
+{
+  public:
+    static constexpr uint32_t COMPONENTS = 9;
+
+    /**
+     * Constructor. Constructs an empty list.
+     */
+    TriangleSoA();
+
+    /**
+     * Resize the list. All triangles are reset to degenerate triangles.
+     * @param  count  Number of triangles.
+     */
+    void resize(size_t count);
+
+    /**
+     * Set a triangle.
+     * @param  i   Index of the triangle.
+     * @param  v0  First vertex.
+     * @param  v1  Second vertex.
+     * @param  v2  Third vertex.
+     */
+    void set(size_t i, const Point3 &v0, const Point3 &v1, const Point3 &v2);
+
+    /**
+     * Get the number of triangles.
+     * @return  Returns the number of triangles.
+     */
+    size_t size() const;
+
+    /**
+     * Get the distance between components of a triangle.
+     * @return  Returns the array stride (in floats).
+     */
+    size_t get_stride() const;
+
+    /**
+     * Get the component arrays.
+     * @param  i  Index of the first triangle.
+     * @return  Returns a pointer to v0.x of triangle i.
+     */
+    const float *get_data(size_t i = 0) const;
+
+  protected:
+    std::vector<float> data_;
+    size_t             count_;
+    size_t             stride_;
+};
+
+/**
+ * Packet of 8 rays stored as a structure of arrays. Rays that are not in use
+ * have t_max = 0 so the kernels never report hits for them.
+ */
+struct alignas(32) RayPacket8
+{
+    float o[3][8];  // Origins (x, y, z arrays)
+    float d[3][8];  // Directions (x, y, z arrays)
+    float t_max[8]; // Maximum distance along each ray
+
+    /**
+     * Constructor. All rays are unused.
+     */
+    RayPacket8();
+
+    /**
+     * Set a ray of the packet.
+     * @param  i      Index of the ray (0-7).
+     * @param  ray    Ray.
+     * @param  t      Maximum distance along the ray.
+     */
+    void set(uint32_t i, const Ray3 &ray, float t);
+};
+
+/**
+ * Table of ray / triangle kernels. Both kernels find hits with
+ * EPSILON <= t < t_max and write the distance and barycentric coordinates
+ * (u and v, weights of v1 and v2) to lane i of the output arrays (8 floats
+ * each) for each lane i that hits. Lanes that miss are left undefined.
+ */
+struct TriangleKernels
+{
+    SimdLevel   level;
+    const char *name;
+
+    // One ray (o and d are 3 floats) against count (at most 8) triangles
+    // starting at tris, with component arrays stride floats apart (see
+    // TriangleSoA). Returns a bit mask of the triangles hit.
+    uint32_t (*intersect_1x8)(const float *o,
+                              const float *d,
+                              float        t_max,
+                              const float *tris,
+                              size_t       stride,
+                              uint32_t     count,
+                              float       *t,
+                              float       *u,
+                              float       *v);
+
+    // A packet of 8 rays against the triangle at tri, with components stride
+    // floats apart. Returns a bit mask of the rays that hit it.
+    uint32_t (*intersect_8x1)(const RayPacket8 &rays,
+                              const float      *tri,
+                              size_t            stride,
+                              float            *t,
+                              float            *u,
+                              float            *v);
+};
+
+// Kernels currently in use (do not access directly, use get_triangle_kernels)
+extern const TriangleKernels *g_triangle_kernels;
+
+/**
+ * Get the triangle kernels currently in use. The best kernels supported by
+ * the CPU are selected at startup.
+ * @return  Returns the current triangle kernels.
+ */
+inline const TriangleKernels &get_triangle_kernels() { return *g_triangle_kernels; }
+
+/**
+ * Get the triangle kernels for an instruction set.
+ * @param  level  Instruction set.
+ * @return  Returns the kernels, or nullptr if there are no kernels for the
+ *          instruction set or it is not supported by this build or the CPU.
+ */
+const TriangleKernels *get_triangle_kernels(SimdLevel level);
+
+/**
+ * Select the triangle kernels to use (for example to compare implementations).
+ * @param  level  Instruction set.
+ * @return  Returns true if the kernels are supported and now in use.
+ */
+bool set_triangle_simd_level(SimdLevel level);
+
+} // namespace cg
+
+#endif
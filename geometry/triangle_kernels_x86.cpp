@@ -0,0 +1,153 @@
+#include "geometry/triangle_kernels.hpp"
+
+#include "geometry/geometry.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CG_TRIANGLE_X86 1
+#include <immintrin.h>
+#endif
+
+// AVX2 functions are compiled for AVX2 individually so the rest of the
+// library runs on any x86-64 CPU (see matrix_kernels_x86.cpp)
+#if defined(CG_TRIANGLE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CG_TARGET_AVX2
+#endif
+
+namespace cg
+{
+
+#if defined(CG_TRIANGLE_X86)
+
+namespace
+{
+
+// The kernels use separate multiplies and adds in the same order as the
+// scalar kernels (no FMA) so all kernels return identical results.
+
+CG_TARGET_AVX2 inline __m256 cross_component(__m256 ay, __m256 az, __m256 by, __m256 bz)
+{
+    return _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+}
+
+CG_TARGET_AVX2 inline __m256 dot(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+{
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+}
+
+/**
+ * Moller-Trumbore intersection of 8 rays with 8 triangles (either may be
+ * broadcast). Returns the bit mask of lanes that hit with EPSILON <= t < t_max
+ * and stores t, u, v for all lanes.
+ */
+CG_TARGET_AVX2 inline uint32_t intersect_8(const __m256 *o,
+                                           const __m256 *d,
+                                           __m256        t_max,
+                                           const __m256 *v0,
+                                           const __m256 *e1,
+                                           const __m256 *e2,
+                                           float        *t_out,
+                                           float        *u_out,
+                                           float        *v_out)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 sign_bit = _mm256_set1_ps(-0.0f);
+
+    // p = d x e2, det = e1 . p
+    __m256 px = cross_component(d[1], d[2], e2[1], e2[2]);
+    __m256 py = cross_component(d[2], d[0], e2[2], e2[0]);
+    __m256 pz = cross_component(d[0], d[1], e2[0], e2[1]);
+    __m256 det = dot(e1[0], e1[1], e1[2], px, py, pz);
+    __m256 hit = _mm256_cmp_ps(_mm256_andnot_ps(sign_bit, det), _mm256_set1_ps(EPSILON * EPSILON), _CMP_GE_OQ);
+
+    // Barycentric coordinates
+    __m256 inv_det = _mm256_div_ps(one, det);
+    __m256 sx = _mm256_sub_ps(o[0], v0[0]);
+    __m256 sy = _mm256_sub_ps(o[1], v0[1]);
+    __m256 sz = _mm256_sub_ps(o[2], v0[2]);
+    __m256 u = _mm256_mul_ps(dot(sx, sy, sz, px, py, pz), inv_det);
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(u, one, _CMP_LE_OQ));
+
+    __m256 qx = cross_component(sy, sz, e1[1], e1[2]);
+    __m256 qy = cross_component(sz, sx, e1[2], e1[0]);
+    __m256 qz = cross_component(sx, sy, e1[0], e1[1]);
+    __m256 v = _mm256_mul_ps(dot(d[0], d[1], d[2], qx, qy, qz), inv_det);
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+
+    // Distance, excluding hits behind the origin and beyond t_max
+    __m256 t = _mm256_mul_ps(dot(e2[0], e2[1], e2[2], qx, qy, qz), inv_det);
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_set1_ps(EPSILON), _CMP_GE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, t_max, _CMP_LT_OQ));
+
+    _mm256_storeu_ps(t_out, t);
+    _mm256_storeu_ps(u_out, u);
+    _mm256_storeu_ps(v_out, v);
+    return static_cast<uint32_t>(_mm256_movemask_ps(hit));
+}
+
+CG_TARGET_AVX2 uint32_t intersect_1x8_avx2(const float *o,
+                                           const float *d,
+                                           float        t_max,
+                                           const float *tris,
+                                           size_t       stride,
+                                           uint32_t     count,
+                                           float       *t,
+                                           float       *u,
+                                           float       *v)
+{
+    const __m256 ray_o[3] = {_mm256_set1_ps(o[0]), _mm256_set1_ps(o[1]), _mm256_set1_ps(o[2])};
+    const __m256 ray_d[3] = {_mm256_set1_ps(d[0]), _mm256_set1_ps(d[1]), _mm256_set1_ps(d[2])};
+    const __m256 v0[3] = {_mm256_loadu_ps(tris), _mm256_loadu_ps(tris + stride), _mm256_loadu_ps(tris + 2 * stride)};
+    const __m256 e1[3] = {_mm256_loadu_ps(tris + 3 * stride),
+                          _mm256_loadu_ps(tris + 4 * stride),
+                          _mm256_loadu_ps(tris + 5 * stride)};
+    const __m256 e2[3] = {_mm256_loadu_ps(tris + 6 * stride),
+                          _mm256_loadu_ps(tris + 7 * stride),
+                          _mm256_loadu_ps(tris + 8 * stride)};
+    uint32_t     mask = intersect_8(ray_o, ray_d, _mm256_set1_ps(t_max), v0, e1, e2, t, u, v);
+
+    // Lanes past count hold other (or padding) triangles
+    return mask & ((1u << count) - 1);
+}
+
+CG_TARGET_AVX2 uint32_t intersect_8x1_avx2(const RayPacket8 &rays,
+                                           const float      *tri,
+                                           size_t            stride,
+                                           float            *t,
+                                           float            *u,
+                                           float            *v)
+{
+    const __m256 ray_o[3] = {_mm256_load_ps(rays.o[0]), _mm256_load_ps(rays.o[1]), _mm256_load_ps(rays.o[2])};
+    const __m256 ray_d[3] = {_mm256_load_ps(rays.d[0]), _mm256_load_ps(rays.d[1]), _mm256_load_ps(rays.d[2])};
+    const __m256 v0[3] = {_mm256_set1_ps(tri[0]), _mm256_set1_ps(tri[stride]), _mm256_set1_ps(tri[2 * stride])};
+    const __m256 e1[3] = {_mm256_set1_ps(tri[3 * stride]),
+                          _mm256_set1_ps(tri[4 * stride]),
+                          _mm256_set1_ps(tri[5 * stride])};
+    const __m256 e2[3] = {_mm256_set1_ps(tri[6 * stride]),
+                          _mm256_set1_ps(tri[7 * stride]),
+                          _mm256_set1_ps(tri[8 * stride])};
+    return intersect_8(ray_o, ray_d, _mm256_load_ps(rays.t_max), v0, e1, e2, t, u, v);
+}
+
+const TriangleKernels AVX2_TRIANGLE_KERNELS = {SimdLevel::AVX2, "avx2", intersect_1x8_avx2, intersect_8x1_avx2};
+
+} // namespace
+
+const TriangleKernels *get_avx2_triangle_kernels()
+{
+    // The matrix kernels check CPU and operating system support
+    static const bool supported = get_matrix_kernels(SimdLevel::AVX2) != nullptr;
+    return supported ? &AVX2_TRIANGLE_KERNELS : nullptr;
+}
+
+#else
+
+const TriangleKernels *get_avx2_triangle_kernels() { return nullptr; }
+
+#endif
+
+} // namespace cg
@@ -0,0 +1,139 @@
+#include "geometry/vertex_packing.hpp"
+
+#include "geometry/geometry.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cg
+{
+
+namespace
+{
+
+constexpr float UNORM16_MAX = 65535.0f;
+constexpr float SNORM16_MAX = 32767.0f;
+
+// Sign that treats 0 as positive (so the octahedral fold is well defined)
+float sign_not_zero(float v) { return (v >= 0.0f) ? 1.0f : -1.0f; }
+
+// Float in [-1, 1] to signed normalized
+int16_t to_snorm16(float v)
+{
+    return static_cast<int16_t>(std::round(std::max(-1.0f, std::min(v, 1.0f)) * SNORM16_MAX));
+}
+
+// Signed normalized to float (OpenGL conversion rule)
+float from_snorm16(int16_t v) { return std::max(static_cast<float>(v) / SNORM16_MAX, -1.0f); }
+
+} // namespace
+
+void encode_octahedral(const Vector3 &n, int16_t out[2])
+{
+    // Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower
+    // hemisphere over the upper one
+    float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    float u = (l1 > 0.0f) ? n.x / l1 : 0.0f;
+    float v = (l1 > 0.0f) ? n.y / l1 : 0.0f;
+    if(n.z < 0.0f)
+    {
+        float fold_u = (1.0f - std::abs(v)) * sign_not_zero(u);
+        float fold_v = (1.0f - std::abs(u)) * sign_not_zero(v);
+        u = fold_u;
+        v = fold_v;
+    }
+    out[0] = to_snorm16(u);
+    out[1] = to_snorm16(v);
+}
+
+Vector3 decode_octahedral(const int16_t in[2])
+{
+    float   u = from_snorm16(in[0]);
+    float   v = from_snorm16(in[1]);
+    Vector3 n(u, v, 1.0f - std::abs(u) - std::abs(v));
+    if(n.z < 0.0f)
+    {
+        n.x = (1.0f - std::abs(v)) * sign_not_zero(u);
+        n.y = (1.0f - std::abs(u)) * sign_not_zero(v);
+    }
+    return n.normalize();
+}
+
+VertexQuantization get_vertex_quantization(const std::vector<VertexAndNormal> &vertices)
+{
+    VertexQuantization quantization;
+    quantization.offset.set(0.0f, 0.0f, 0.0f);
+    quantization.scale.set(0.0f, 0.0f, 0.0f);
+    if(vertices.empty()) return quantization;
+
+    Point3 lo = vertices[0].vertex;
+    Point3 hi = vertices[0].vertex;
+    for(const auto &v : vertices)
+    {
+        lo.set(std::min(lo.x, v.vertex.x), std::min(lo.y, v.vertex.y), std::min(lo.z, v.vertex.z));
+        hi.set(std::max(hi.x, v.vertex.x), std::max(hi.y, v.vertex.y), std::max(hi.z, v.vertex.z));
+    }
+    quantization.offset.set(lo.x, lo.y, lo.z);
+    quantization.scale.set(hi.x - lo.x, hi.y - lo.y, hi.z - lo.z);
+    return quantization;
+}
+
+void pack_vertices(const std::vector<VertexAndNormal> &vertices,
+                   const VertexQuantization           &quantization,
+                   std::vector<PackedVertexAndNormal> &packed)
+{
+    // Map each coordinate to [0, 65535] within the bounds (0 if the bounds are flat)
+    auto quantize = [](float v, float offset, float scale)
+    {
+        if(scale <= 0.0f) return static_cast<uint16_t>(0);
+        float t = std::max(0.0f, std::min((v - offset) / scale, 1.0f));
+        return static_cast<uint16_t>(std::round(t * UNORM16_MAX));
+    };
+
+    packed.resize(vertices.size());
+    for(size_t i = 0; i < vertices.size(); i++)
+    {
+        const auto &v = vertices[i];
+        auto       &p = packed[i];
+        p.position[0] = quantize(v.vertex.x, quantization.offset.x, quantization.scale.x);
+        p.position[1] = quantize(v.vertex.y, quantization.offset.y, quantization.scale.y);
+        p.position[2] = quantize(v.vertex.z, quantization.offset.z, quantization.scale.z);
+        p.pad = 0;
+        encode_octahedral(v.normal, p.normal);
+    }
+}
+
+VertexAndNormal unpack_vertex(const PackedVertexAndNormal &packed, const VertexQuantization &quantization)
+{
+    VertexAndNormal v;
+    v.vertex.set(quantization.offset.x + quantization.scale.x * (packed.position[0] / UNORM16_MAX),
+                 quantization.offset.y + quantization.scale.y * (packed.position[1] / UNORM16_MAX),
+                 quantization.offset.z + quantization.scale.z * (packed.position[2] / UNORM16_MAX));
+    v.normal = decode_octahedral(packed.normal);
+    return v;
+}
+
+PackingError get_packing_error(const std::vector<VertexAndNormal>       &vertices,
+                               const VertexQuantization                 &quantization,
+                               const std::vector<PackedVertexAndNormal> &packed)
+{
+    PackingError error = {0.0f, 0.0f};
+    for(size_t i = 0; i < vertices.size() && i < packed.size(); i++)
+    {
+        VertexAndNormal v = unpack_vertex(packed[i], quantization);
+        error.max_position_error =
+            std::max(error.max_position_error, (v.vertex - vertices[i].vertex).norm());
+
+        // Angle between unit normals (skip zero length normals)
+        Vector3 n = vertices[i].normal;
+        float   len = n.norm();
+        if(len > 0.0f)
+        {
+            float c = std::max(-1.0f, std::min(n.dot(v.normal) / len, 1.0f));
+            error.max_normal_error = std::max(error.max_normal_error, radians_to_degrees(std::acos(c)));
+        }
+    }
+    return error;
+}
+
+} // namespace cg
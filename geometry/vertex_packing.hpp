@@ -0,0 +1,117 @@
+//============================================================================
+//	Johns Hopkins University Engineering for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    vertex_packing.hpp
+//	Purpose: Compact (quantized) vertex format: 16 bit positions relative
+//           to the mesh bounds and octahedral encoded normals.
+//
+//============================================================================
+
+#ifndef __GEOMETRY_VERTEX_PACKING_HPP__
+#define __GEOMETRY_VERTEX_PACKING_HPP__
+
+#include "geometry/types.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+/**
+ * Vertex buffer layout. The value is passed to shaders (vertex_format uniform).
+ */
+enum class VertexFormat : uint32_t
+{
+    FLOAT = 0, // VertexAndNormal (24 bytes)
+    PACKED = 1 // PackedVertexAndNormal (12 bytes)
+};
+
+/**
+ * Packed vertex position and normal (12 bytes). The position is stored as 16
+ * bit unsigned normalized values within the mesh bounds and the normal is
+ * octahedral encoded as 2 16 bit signed normalized values.
+ */
+struct PackedVertexAndNormal
+{
+    uint16_t position[3];
+    uint16_t pad;
+    int16_t  normal[2];
+};
+
+/**
+ * Position dequantization: position = offset + scale * p, where p is the
+ * packed position mapped to [0, 1]. The float format uses scale (1,1,1) and
+ * offset (0,0,0).
+ */
+struct VertexQuantization
+{
+    Vector3 scale;
+    Vector3 offset;
+};
+
+/**
+ * Maximum errors of a packed vertex list.
+ */
+struct PackingError
+{
+    float max_position_error; // Largest position error (distance)
+    float max_normal_error;   // Largest angle between original and packed normals (degrees)
+};
+
+/**
+ * Encode a unit normal using the octahedral mapping.
+ * @param  n    Unit normal.
+ * @param  out  Encoded normal (signed normalized).
+ */
+void encode_octahedral(const Vector3 &n, int16_t out[2]);
+
+/**
+ * Decode an octahedral encoded normal (as the vertex shader does).
+ * @param  in  Encoded normal (signed normalized).
+ * @return  Returns the unit normal.
+ */
+Vector3 decode_octahedral(const int16_t in[2]);
+
+/**
+ * Get the quantization covering the bounds of a vertex list.
+ * @param  vertices  Vertex list.
+ * @return  Returns the position scale and offset.
+ */
+VertexQuantization get_vertex_quantization(const std::vector<VertexAndNormal> &vertices);
+
+/**
+ * Pack a vertex list.
+ * @param  vertices      Vertex list.
+ * @param  quantization  Position quantization (see get_vertex_quantization).
+ * @param  packed        Packed vertex list (output).
+ */
+void pack_vertices(const std::vector<VertexAndNormal> &vertices,
+                   const VertexQuantization           &quantization,
+                   std::vector<PackedVertexAndNormal> &packed);
+
+/**
+ * Unpack a vertex.
+ * @param  packed        Packed vertex.
+ * @param  quantization  Position quantization used to pack the vertex.
+ * @return  Returns the vertex position and normal.
+ */
+VertexAndNormal unpack_vertex(const PackedVertexAndNormal &packed, const VertexQuantization &quantization);
+
+/**
+ * Measure the error of a packed vertex list.
+ * @param  vertices      Original vertex list.
+ * @param  quantization  Position quantization used to pack the vertices.
+ * @param  packed        Packed vertex list.
+ * @return  Returns the largest position and normal errors.
+ */
+PackingError get_packing_error(const std::vector<VertexAndNormal>       &vertices,
+                               const VertexQuantization                 &quantization,
+                               const std::vector<PackedVertexAndNormal> &packed);
+
+} // namespace cg
+
+#endif
@@ -1,10 +1,19 @@
 #include "scene/camera_node.hpp"
 
 #include "geometry/geometry.hpp"
+#include "geometry/profiler.hpp"
+#include "scene/render_queue.hpp"
+#include "scene/scene_store.hpp"
 
 namespace cg
 {
 
+bool CameraView::operator==(const CameraView &v) const
+{
+    return position == v.position && look_at == v.look_at && view_up == v.view_up && fov == v.fov &&
+           aspect_ratio == v.aspect_ratio && near_clip == v.near_clip && far_clip == v.far_clip;
+}
+
 CameraNode::CameraNode()
 {
     node_type_ = SceneNodeType::CAMERA;
@@ -19,23 +28,49 @@ CameraNode::CameraNode()
     lpt_ = Point3(0.0f, 0.0f, 0.0f);
     vrp_ = Point3(0.0f, 0.0f, 1.0f);
     view_up_ = Vector3(0.0f, 1.0f, 0.0f);
+
+    update_pv();
 }
 
 void CameraNode::draw(SceneState &scene_state)
+{
+    CG_PROFILE_ZONE("CameraNode::draw");
+    apply_state(scene_state);
+
+    // Draw children
+    SceneNode::draw(scene_state);
+}
+
+void CameraNode::apply_state(SceneState &scene_state)
 {
     scene_state.camera_position = vrp_;
 
     // Copy the current composite projection and viewing matrix to the scene state
-    scene_state.pv = proj_ * view_;
+    scene_state.pv = pv_;
+    scene_state.pv_version = pv_version_;
+    scene_state.frustum = frustum_;
 
     // Set the shader PVM matrix - this will allow drawing children without a TransformNode
-    glUniformMatrix4fv(scene_state.pvm_matrix_loc, 1, GL_FALSE, scene_state.pv.get());
+    scene_state.gl_state.uniform_matrix4fv(scene_state.pvm_matrix_loc, scene_state.pv.get());
+
+    // Set the camera position (in the frame block if the shader has one)
+    if(scene_state.frame_buffer != nullptr)
+    {
+        scene_state.frame_block.camera_position = vrp_;
+        scene_state.frame_block_changed = true;
+    }
+    else scene_state.gl_state.uniform3fv(scene_state.camera_position_loc, &vrp_.x);
+}
 
-    // Set the camera position
-    glUniform3fv(scene_state.camera_position_loc, 1, &vrp_.x);
+void CameraNode::compile(RenderQueue &queue, SceneState &scene_state)
+{
+    queue.add_state_node(this);
+    SceneNode::compile(queue, scene_state);
+}
 
-    // Draw children
-    SceneNode::draw(scene_state);
+void CameraNode::flatten(SceneStore &store, uint32_t parent)
+{
+    flatten_children(store, store.add_state(parent, this));
 }
 
 void CameraNode::set_position(const Point3 &vrp)
@@ -66,6 +101,24 @@ const Vector3 &CameraNode::get_view_right() const { return view_right_; }
 
 const Vector3 &CameraNode::get_view_up() const { return view_up_; }
 
+CameraView CameraNode::get_view() const
+{
+    return {vrp_, lpt_, view_up_, fov_, aspect_ratio_, near_clip_, far_clip_};
+}
+
+void CameraNode::set_view(const CameraView &view)
+{
+    vrp_ = view.position;
+    lpt_ = view.look_at;
+    view_up_ = view.view_up;
+    fov_ = view.fov;
+    aspect_ratio_ = view.aspect_ratio;
+    near_clip_ = view.near_clip;
+    far_clip_ = view.far_clip;
+    set_perspective();
+    look_at();
+}
+
 void CameraNode::roll(float degrees)
 {
     // Method below is described in FS Hill and lecture notes. Just
@@ -149,6 +202,10 @@ void CameraNode::slide(float x, float y, float z)
 
 const Matrix4x4 &CameraNode::get_view_matrix() const { return view_; }
 
+const Matrix4x4 &CameraNode::get_pv_matrix() const { return pv_; }
+
+const Frustum &CameraNode::get_frustum() const { return frustum_; }
+
 void CameraNode::set_perspective(float fov, float ratio, float n, float f)
 {
     fov_ = fov;
@@ -177,6 +234,14 @@ void CameraNode::change_clipping_planes(float n, float f)
     set_perspective();
 }
 
+float CameraNode::get_field_of_view() const { return fov_; }
+
+float CameraNode::get_aspect_ratio() const { return aspect_ratio_; }
+
+float CameraNode::get_near_clip() const { return near_clip_; }
+
+float CameraNode::get_far_clip() const { return far_clip_; }
+
 void CameraNode::look_at()
 {
     // Set the VPN, which is the vector vp - vc
@@ -219,6 +284,8 @@ void CameraNode::set_perspective()
     proj_.m31() = 0.0f;
     proj_.m32() = -1.0f;
     proj_.m33() = 0.0f;
+
+    update_pv();
 }
 
 void CameraNode::set_view_matrix()
@@ -242,6 +309,18 @@ void CameraNode::set_view_matrix()
     view_.m31() = 0.0f;
     view_.m32() = 0.0f;
     view_.m33() = 1.0f;
+
+    // The view axes are orthonormal so the view matrix is rigid
+    view_.set_type(MatrixType::RIGID);
+
+    update_pv();
+}
+
+void CameraNode::update_pv()
+{
+    pv_ = proj_ * view_;
+    frustum_.set(pv_);
+    pv_version_ = SceneState::next_matrix_version();
 }
 
 } // namespace cg
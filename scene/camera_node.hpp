@@ -23,6 +23,28 @@ enum class ProjectionType
     ORTHOGRAPHIC
 };
 
+/**
+ * Camera position, orientation and perspective projection without the scene
+ * node (for example to hand a view from one thread to another).
+ */
+struct CameraView
+{
+    Point3  position;     // View reference point (eye)
+    Point3  look_at;      // Lookat point
+    Vector3 view_up;      // View up direction
+    float   fov;          // Field of view angle y (degrees)
+    float   aspect_ratio; // Aspect ratio (width / height)
+    float   near_clip;    // Near plane distance
+    float   far_clip;     // Far plane distance
+
+    /**
+     * Equality operator.
+     * @param  v  View to compare to.
+     * @return  Returns true if all members are equal.
+     */
+    bool operator==(const CameraView &v) const;
+};
+
 /**
  * Camera node class.
  */
@@ -41,6 +63,28 @@ class CameraNode : public SceneNode
      */
     void draw(SceneState &scene_state) override;
 
+    /**
+     * Sets the composite projection and view matrix and the camera position.
+     * @param  scene_state  Current scene state.
+     */
+    void apply_state(SceneState &scene_state) override;
+
+    /**
+     * Compile the camera node and its children into a render queue. The
+     * camera is registered as a per-frame state node.
+     * @param  queue        Render queue.
+     * @param  scene_state  Current scene state.
+     */
+    void compile(RenderQueue &queue, SceneState &scene_state) override;
+
+    /**
+     * Flatten the camera node and its children into a scene store. The
+     * camera is added as a state node.
+     * @param  store   Scene store.
+     * @param  parent  Handle of the parent in the store.
+     */
+    void flatten(SceneStore &store, uint32_t parent) override;
+
     /**
      * Sets the view reference point (camera position)
      *	@param	vrp		View reference point.
@@ -89,6 +133,18 @@ class CameraNode : public SceneNode
      */
     const Vector3 &get_view_up() const;
 
+    /**
+     * Gets the position, orientation and projection of the camera.
+     * @return  Returns the camera view.
+     */
+    CameraView get_view() const;
+
+    /**
+     * Sets the position, orientation and projection of the camera at once.
+     * @param  view  Camera view.
+     */
+    void set_view(const CameraView &view);
+
     /**
      * Roll the camera by the specified degrees about the VPN.
      * Rotation about n. Note that the lookat point does not change
@@ -136,6 +192,18 @@ class CameraNode : public SceneNode
      */
     const Matrix4x4 &get_view_matrix() const;
 
+    /**
+     * Gets the composite projection and view matrix.
+     * @return  Returns the composite projection and view matrix.
+     */
+    const Matrix4x4 &get_pv_matrix() const;
+
+    /**
+     * Gets the view frustum.
+     * @return  Returns the view frustum (world coordinates).
+     */
+    const Frustum &get_frustum() const;
+
     /**
      * Sets a symmetric perspective projection
      * @param  fov  Field of view angle y (degrees)
@@ -164,6 +232,30 @@ class CameraNode : public SceneNode
      */
     void change_clipping_planes(float n, float f);
 
+    /**
+     * Gets the field of view.
+     * @return  Returns the field of view angle y (degrees).
+     */
+    float get_field_of_view() const;
+
+    /**
+     * Gets the aspect ratio.
+     * @return  Returns the aspect ratio (width / height).
+     */
+    float get_aspect_ratio() const;
+
+    /**
+     * Gets the near clipping plane distance.
+     * @return  Returns the near plane distance.
+     */
+    float get_near_clip() const;
+
+    /**
+     * Gets the far clipping plane distance.
+     * @return  Returns the far plane distance.
+     */
+    float get_far_clip() const;
+
   protected:
     // Perspective projection parameters
     float fov_;          // Field of view in degrees
@@ -180,8 +272,11 @@ class CameraNode : public SceneNode
     Vector3 view_up_;     // View up axis
 
     // Matrices
-    Matrix4x4 view_; // Viewing matrix
-    Matrix4x4 proj_; // Projection matrix
+    Matrix4x4 view_;       // Viewing matrix
+    Matrix4x4 proj_;       // Projection matrix
+    Matrix4x4 pv_;         // Composite projection and view matrix
+    uint64_t  pv_version_; // Version of the composite matrix (changes when pv_ changes)
+    Frustum   frustum_;    // View frustum (from pv_)
 
     // Sets the view axes
     void look_at();
@@ -192,6 +287,9 @@ class CameraNode : public SceneNode
     // Create viewing transformation matrix by composing the translation
     // matrix with the rotation matrix given by the view coordinate axes
     void set_view_matrix();
+
+    // Forms the composite projection and view matrix and assigns it a new version
+    void update_pv();
 };
 
 } // namespace cg
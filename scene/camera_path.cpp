@@ -0,0 +1,79 @@
+#include "scene/camera_path.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cg
+{
+
+namespace
+{
+
+// Catmull-Rom interpolation between p1 and p2
+Point3 catmull_rom(const Point3 &p0, const Point3 &p1, const Point3 &p2, const Point3 &p3, float t)
+{
+    float t2 = t * t;
+    float t3 = t2 * t;
+    float w0 = 0.5f * (-t3 + 2.0f * t2 - t);
+    float w1 = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+    float w2 = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+    float w3 = 0.5f * (t3 - t2);
+    return Point3(p0.x * w0 + p1.x * w1 + p2.x * w2 + p3.x * w3,
+                  p0.y * w0 + p1.y * w1 + p2.y * w2 + p3.y * w3,
+                  p0.z * w0 + p1.z * w1 + p2.z * w2 + p3.z * w3);
+}
+
+} // namespace
+
+CameraPath::CameraPath() : up_(0.0f, 0.0f, 1.0f) {}
+
+void CameraPath::set_view_up(const Vector3 &up) { up_ = up; }
+
+CameraPath CameraPath::orbit(const Point3 &center, float radius, float height, uint32_t keyframes)
+{
+    CameraPath path;
+    keyframes = std::max(keyframes, 3u);
+    for(uint32_t i = 0; i < keyframes; i++)
+    {
+        float angle = 2.0f * PI * static_cast<float>(i) / static_cast<float>(keyframes);
+        path.add_keyframe(
+            Point3(center.x + radius * std::cos(angle), center.y + radius * std::sin(angle), center.z + height),
+            center);
+    }
+    return path;
+}
+
+void CameraPath::add_keyframe(const Point3 &position, const Point3 &look_at)
+{
+    keyframes_.push_back({position, look_at});
+}
+
+const std::vector<CameraKeyframe> &CameraPath::get_keyframes() const { return keyframes_; }
+
+CameraKeyframe CameraPath::evaluate(float t) const
+{
+    if(keyframes_.empty()) return {Point3(0.0f, 0.0f, 0.0f), Point3(0.0f, 0.0f, -1.0f)};
+
+    // Segment and the time within it
+    size_t n = keyframes_.size();
+    float  s = (t - std::floor(t)) * static_cast<float>(n);
+    size_t i = std::min(static_cast<size_t>(s), n - 1);
+    float  u = s - static_cast<float>(i);
+
+    const CameraKeyframe &k0 = keyframes_[(i + n - 1) % n];
+    const CameraKeyframe &k1 = keyframes_[i];
+    const CameraKeyframe &k2 = keyframes_[(i + 1) % n];
+    const CameraKeyframe &k3 = keyframes_[(i + 2) % n];
+    return {catmull_rom(k0.position, k1.position, k2.position, k3.position, u),
+            catmull_rom(k0.look_at, k1.look_at, k2.look_at, k3.look_at, u)};
+}
+
+void CameraPath::apply(CameraNode &camera, float t) const
+{
+    CameraKeyframe k = evaluate(t);
+    camera.set_position(k.position);
+    camera.set_look_at_pt(k.look_at);
+    camera.set_view_up(up_);
+}
+
+} // namespace cg
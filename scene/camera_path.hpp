@@ -0,0 +1,97 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    camera_path.hpp
+//	Purpose: Scripted camera path (closed Catmull-Rom spline through
+//           keyframes) used to drive repeatable benchmark runs.
+//
+//============================================================================
+
+#ifndef __SCENE_CAMERA_PATH_HPP__
+#define __SCENE_CAMERA_PATH_HPP__
+
+#include "geometry/geometry.hpp"
+#include "scene/camera_node.hpp"
+
+#include <vector>
+
+namespace cg
+{
+
+/**
+ * Camera keyframe: eye position and look at point.
+ */
+struct CameraKeyframe
+{
+    Point3 position;
+    Point3 look_at;
+};
+
+/**
+ * Closed camera path through a list of keyframes. The path passes through
+ * every keyframe, spends equal time between neighboring keyframes and
+ * returns to the first keyframe at the end. The camera keeps a fixed world
+ * up direction (z by default) so it does not roll along the path.
+ */
+class CameraPath
+{
+  public:
+    /**
+     * Constructor. Constructs an empty path.
+     */
+    CameraPath();
+
+    /**
+     * Set the world up direction used to orient the camera.
+     * @param  up  Up direction (must not be parallel to the view direction).
+     */
+    void set_view_up(const Vector3 &up);
+
+    /**
+     * Construct a path that circles a point.
+     * @param  center     Point to look at (the center of the circle).
+     * @param  radius     Radius of the circle (in the xy plane).
+     * @param  height     Height of the eye above the center.
+     * @param  keyframes  Number of keyframes around the circle (at least 3).
+     * @return  Returns the path.
+     */
+    static CameraPath orbit(const Point3 &center, float radius, float height, uint32_t keyframes);
+
+    /**
+     * Add a keyframe to the end of the path.
+     * @param  position  Eye position.
+     * @param  look_at   Look at point.
+     */
+    void add_keyframe(const Point3 &position, const Point3 &look_at);
+
+    /**
+     * Get the keyframes.
+     * @return  Returns the keyframes.
+     */
+    const std::vector<CameraKeyframe> &get_keyframes() const;
+
+    /**
+     * Evaluate the path.
+     * @param  t  Time along the path (0 to 1, wraps around).
+     * @return  Returns the interpolated eye position and look at point.
+     */
+    CameraKeyframe evaluate(float t) const;
+
+    /**
+     * Move a camera to a point on the path.
+     * @param  camera  Camera to move.
+     * @param  t       Time along the path (0 to 1, wraps around).
+     */
+    void apply(CameraNode &camera, float t) const;
+
+  protected:
+    std::vector<CameraKeyframe> keyframes_;
+    Vector3                     up_;
+};
+
+} // namespace cg
+
+#endif
@@ -1,5 +1,7 @@
 #include "scene/color_node.hpp"
 
+#include "scene/scene_store.hpp"
+
 namespace cg
 {
 
@@ -10,8 +12,29 @@ ColorNode::ColorNode(const Color4 &c) { material_color_ = c; }
 void ColorNode::draw(SceneState &scene_state)
 {
     // Set the current color and draw all children. Very simple lighting support
-    glUniform3fv(scene_state.material_diffuse_loc, 1, &material_color_.r);
+    if(scene_state.material_stream != nullptr)
+    {
+        MaterialBlock material = scene_state.material_stream->get_bound();
+        material.diffuse = material_color_;
+        scene_state.material_stream->stream(material);
+    }
+    else scene_state.gl_state.uniform3fv(scene_state.material_diffuse_loc, &material_color_.r);
     SceneNode::draw(scene_state);
 }
 
+void ColorNode::compile(RenderQueue &queue, SceneState &scene_state)
+{
+    MaterialBlock material = queue.get_material();
+    material.diffuse = material_color_;
+    queue.set_material(material);
+    SceneNode::compile(queue, scene_state);
+}
+
+void ColorNode::flatten(SceneStore &store, uint32_t parent)
+{
+    MaterialBlock material = store.get_material(parent);
+    material.diffuse = material_color_;
+    flatten_children(store, store.add_material(parent, material));
+}
+
 } // namespace cg
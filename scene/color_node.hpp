@@ -40,6 +40,18 @@ class ColorNode : public PresentationNode
      */
     void draw(SceneState &scene_state) override;
 
+    /**
+     * Compile this presentation node and its children. Replaces the diffuse
+     * color of the current material.
+     */
+    void compile(RenderQueue &queue, SceneState &scene_state) override;
+
+    /**
+     * Flatten this presentation node and its children. Adds a material node
+     * with the diffuse color replaced.
+     */
+    void flatten(SceneStore &store, uint32_t parent) override;
+
   protected:
     Color4 material_color_;
 };
@@ -1,6 +1,7 @@
 #include "scene/conic.hpp"
 
 #include "geometry/geometry.hpp"
+#include "geometry/profiler.hpp"
 
 #include <cmath>
 
@@ -16,6 +17,8 @@ ConicSurface::ConicSurface(float    bottom_radius,
                            int32_t  position_loc,
                            int32_t  normal_loc)
 {
+    CG_PROFILE_ZONE("ConicSurface::ConicSurface");
+
     // Fail if top and bottom radius are both 0
     if(bottom_radius <= 0.0f && top_radius <= 0.0f) return;
 
@@ -44,6 +47,7 @@ ConicSurface::ConicSurface(float    bottom_radius,
     float           cos_theta, sin_theta;
     VertexAndNormal vtx;
 
+    vertices_.reserve(static_cast<size_t>(num_rows_) * num_cols_);
     for(i = 0; i < num_sides; i++, theta += d_theta)
     {
         // Compute sin,cos to use in the loop below
@@ -0,0 +1,92 @@
+#include "scene/frame_pacer.hpp"
+
+#include "geometry/profiler.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace cg
+{
+
+namespace
+{
+
+double to_ms(FramePacer::Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+} // namespace
+
+FramePacer::FramePacer(double rate) : mode_(PacingMode::FIXED_RATE), started_(false)
+{
+    set_target_rate(rate);
+    set_spin_time(1.0);
+}
+
+void FramePacer::set_mode(PacingMode mode)
+{
+    mode_ = mode;
+    started_ = false;
+}
+
+PacingMode FramePacer::get_mode() const { return mode_; }
+
+void FramePacer::set_target_rate(double rate)
+{
+    interval_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / std::max(rate, 1.0e-3)));
+    started_ = false;
+}
+
+double FramePacer::get_target_rate() const { return 1.0 / std::chrono::duration<double>(interval_).count(); }
+
+void FramePacer::set_spin_time(double ms)
+{
+    spin_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(std::max(ms, 0.0)));
+}
+
+void FramePacer::wait_for_next_frame()
+{
+    CG_PROFILE_ZONE("FramePacer::wait_for_next_frame");
+    Clock::time_point now = Clock::now();
+    if(mode_ == PacingMode::FIXED_RATE && started_)
+    {
+        if(now < deadline_)
+        {
+            // Sleep for the bulk of the remaining time, then spin
+            if(deadline_ - now > spin_) std::this_thread::sleep_for(deadline_ - now - spin_);
+            while(Clock::now() < deadline_) {}
+            now = Clock::now();
+            deadline_ += interval_;
+        }
+        else if(now - deadline_ < interval_)
+        {
+            // A little late: keep the schedule
+            deadline_ += interval_;
+        }
+        else
+        {
+            // Missed a whole interval: restart the schedule from now
+            deadline_ = now + interval_;
+        }
+    }
+    else
+    {
+        deadline_ = now + interval_;
+    }
+
+    if(started_) frame_times_.add(to_ms(now - frame_start_));
+    frame_start_ = now;
+    started_ = true;
+}
+
+void FramePacer::end_frame() { work_times_.add(to_ms(Clock::now() - frame_start_)); }
+
+const FrameStats &FramePacer::get_frame_times() const { return frame_times_; }
+
+const FrameStats &FramePacer::get_work_times() const { return work_times_; }
+
+void FramePacer::clear_stats()
+{
+    frame_times_.clear();
+    work_times_.clear();
+}
+
+} // namespace cg
@@ -0,0 +1,127 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    frame_pacer.hpp
+//	Purpose: Frame scheduler for the main loop. Starts frames at a fixed
+//           rate by sleeping only for the time left after the frame's work
+//           (finishing with a short spin wait), or leaves pacing to vsync
+//           or runs unlocked.
+//
+//============================================================================
+
+#ifndef __SCENE_FRAME_PACER_HPP__
+#define __SCENE_FRAME_PACER_HPP__
+
+#include "scene/frame_stats.hpp"
+
+#include <chrono>
+
+namespace cg
+{
+
+/**
+ * How frames are paced.
+ */
+enum class PacingMode
+{
+    FIXED_RATE, // Start frames at the target rate (buffer swaps do not wait)
+    VSYNC,      // Buffer swaps wait for vertical sync, the pacer does not wait
+    UNLOCKED    // No waiting at all
+};
+
+/**
+ * Frame scheduler. Call wait_for_next_frame before each frame's work and
+ * end_frame after it. In fixed rate mode frames start on a regular schedule
+ * of deadlines: the wait sleeps until shortly before the next deadline and
+ * spins for the rest, so frame rate does not depend on how long each frame
+ * took (as long as it fits in the interval). A frame that overruns by more
+ * than an interval restarts the schedule instead of rushing to catch up.
+ */
+class FramePacer
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Constructor.
+     * @param  rate  Target frame rate (frames per second) in fixed rate mode.
+     */
+    FramePacer(double rate = 72.0);
+
+    /**
+     * Set the pacing mode.
+     * @param  mode  Pacing mode.
+     */
+    void set_mode(PacingMode mode);
+
+    /**
+     * Get the pacing mode.
+     * @return  Returns the pacing mode.
+     */
+    PacingMode get_mode() const;
+
+    /**
+     * Set the target frame rate (fixed rate mode).
+     * @param  rate  Frames per second (must be positive).
+     */
+    void set_target_rate(double rate);
+
+    /**
+     * Get the target frame rate.
+     * @return  Returns the frames per second.
+     */
+    double get_target_rate() const;
+
+    /**
+     * Set how long before a deadline the wait stops sleeping and spins. Sleep
+     * can overshoot by about the scheduler's time slice; spinning the last
+     * part keeps frame starts precise.
+     * @param  ms  Spin time in milliseconds (0 to only sleep).
+     */
+    void set_spin_time(double ms);
+
+    /**
+     * Wait until the next frame should start (fixed rate mode only) and mark
+     * the start of the frame.
+     */
+    void wait_for_next_frame();
+
+    /**
+     * Mark the end of the frame's work.
+     */
+    void end_frame();
+
+    /**
+     * Get the times between frame starts (milliseconds).
+     * @return  Returns the frame interval samples.
+     */
+    const FrameStats &get_frame_times() const;
+
+    /**
+     * Get the work time of each frame (wait_for_next_frame to end_frame).
+     * @return  Returns the work time samples (milliseconds).
+     */
+    const FrameStats &get_work_times() const;
+
+    /**
+     * Remove the frame and work time samples.
+     */
+    void clear_stats();
+
+  protected:
+    PacingMode        mode_;
+    Clock::duration   interval_;    // Time between frame starts (fixed rate)
+    Clock::duration   spin_;        // Spin instead of sleeping this close to a deadline
+    Clock::time_point deadline_;    // Start of the next frame (fixed rate)
+    Clock::time_point frame_start_; // Start of the current frame
+    bool              started_;     // True after the first frame started
+    FrameStats        frame_times_;
+    FrameStats        work_times_;
+};
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,60 @@
+#include "scene/frame_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+namespace cg
+{
+
+FrameStats::FrameStats() {}
+
+void FrameStats::clear() { samples_.clear(); }
+
+void FrameStats::add(double ms) { samples_.push_back(ms); }
+
+size_t FrameStats::get_count() const { return samples_.size(); }
+
+double FrameStats::get_min() const
+{
+    return samples_.empty() ? 0.0 : *std::min_element(samples_.begin(), samples_.end());
+}
+
+double FrameStats::get_max() const
+{
+    return samples_.empty() ? 0.0 : *std::max_element(samples_.begin(), samples_.end());
+}
+
+double FrameStats::get_mean() const
+{
+    if(samples_.empty()) return 0.0;
+    return std::accumulate(samples_.begin(), samples_.end(), 0.0) / static_cast<double>(samples_.size());
+}
+
+double FrameStats::get_percentile(double p) const
+{
+    if(samples_.empty()) return 0.0;
+
+    // Nearest rank: the ceil(p / 100 * n)'th smallest sample
+    size_t n = samples_.size();
+    size_t rank = static_cast<size_t>(std::ceil(std::clamp(p, 0.0, 100.0) * 0.01 * static_cast<double>(n)));
+    size_t index = (rank == 0) ? 0 : std::min(rank, n) - 1;
+
+    std::vector<double> sorted(samples_);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+void FrameStats::print(const char *name) const
+{
+    printf("%s: %zu frames, min %.3f ms, avg %.3f ms, p99 %.3f ms, max %.3f ms\n",
+           name,
+           get_count(),
+           get_min(),
+           get_mean(),
+           get_percentile(99.0),
+           get_max());
+}
+
+} // namespace cg
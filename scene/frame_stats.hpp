@@ -0,0 +1,87 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    frame_stats.hpp
+//	Purpose: Collects frame times and reports min / average / percentiles.
+//
+//============================================================================
+
+#ifndef __SCENE_FRAME_STATS_HPP__
+#define __SCENE_FRAME_STATS_HPP__
+
+#include <cstddef>
+#include <vector>
+
+namespace cg
+{
+
+/**
+ * Frame time samples (milliseconds).
+ */
+class FrameStats
+{
+  public:
+    /**
+     * Constructor. Constructs an empty set of samples.
+     */
+    FrameStats();
+
+    /**
+     * Remove all samples.
+     */
+    void clear();
+
+    /**
+     * Add a frame time.
+     * @param  ms  Frame time in milliseconds.
+     */
+    void add(double ms);
+
+    /**
+     * Get the number of frames.
+     * @return  Returns the number of samples.
+     */
+    size_t get_count() const;
+
+    /**
+     * Get the shortest frame time.
+     * @return  Returns the minimum (0 if there are no samples).
+     */
+    double get_min() const;
+
+    /**
+     * Get the longest frame time.
+     * @return  Returns the maximum (0 if there are no samples).
+     */
+    double get_max() const;
+
+    /**
+     * Get the mean frame time.
+     * @return  Returns the mean (0 if there are no samples).
+     */
+    double get_mean() const;
+
+    /**
+     * Get a percentile of the frame times (nearest rank).
+     * @param  p  Percentile (0 to 100).
+     * @return  Returns the smallest sample that at least p percent of the
+     *          samples are less than or equal to (0 if there are no samples).
+     */
+    double get_percentile(double p) const;
+
+    /**
+     * Print the frame count and min / avg / p99 / max frame times.
+     * @param  name  Label printed before the values.
+     */
+    void print(const char *name) const;
+
+  protected:
+    std::vector<double> samples_;
+};
+
+} // namespace cg
+
+#endif
@@ -1,5 +1,7 @@
 #include "scene/geometry_node.hpp"
 
+#include "scene/scene_store.hpp"
+
 namespace cg
 {
 
@@ -9,4 +11,12 @@ GeometryNode::~GeometryNode() {}
 
 void GeometryNode::draw(SceneState &scene_state) {}
 
+void GeometryNode::update_bound()
+{
+    bound_ = AABB();
+    cullable_ = false;
+}
+
+void GeometryNode::flatten(SceneStore &store, uint32_t parent) { store.add_node(parent, this); }
+
 } // namespace cg
@@ -38,6 +38,21 @@ class GeometryNode : public SceneNode
      * @param  scene_state  Current scene state
      */
     virtual void draw(SceneState &scene_state) override;
+
+    /**
+     * Add this node to a scene store as a node drawn by the scene graph.
+     * Derived classes the store can draw directly override this.
+     * @param  store   Scene store
+     * @param  parent  Handle of the parent in the store
+     */
+    void flatten(SceneStore &store, uint32_t parent) override;
+
+  protected:
+    /**
+     * The extent of general geometry is unknown: the bound is empty and the
+     * node is not cullable. Derived classes that know their extent override this.
+     */
+    void update_bound() override;
 };
 
 } // namespace cg
@@ -0,0 +1,132 @@
+#include "scene/gl_state_cache.hpp"
+
+#include <cstring>
+
+namespace cg
+{
+
+GLStateCache::GLStateCache() :
+    enabled_(true),
+    program_known_(false),
+    program_(0),
+    program_index_(-1),
+    vertex_array_known_(false),
+    vertex_array_(0),
+    counters_{0, 0, 0, 0, 0, 0}
+{
+}
+
+void GLStateCache::use_program(GLuint program)
+{
+    if(enabled_ && program_known_ && program_ == program)
+    {
+        counters_.program_hits++;
+        return;
+    }
+    glUseProgram(program);
+    counters_.program_misses++;
+    if(!enabled_) return;
+
+    // Find the uniform values of this program (few programs, linear search)
+    program_known_ = true;
+    program_ = program;
+    program_index_ = -1;
+    for(size_t i = 0; i < programs_.size(); i++)
+    {
+        if(programs_[i].program == program) program_index_ = static_cast<int32_t>(i);
+    }
+    if(program_index_ < 0)
+    {
+        programs_.push_back(ProgramUniforms{program, {}});
+        program_index_ = static_cast<int32_t>(programs_.size() - 1);
+    }
+}
+
+void GLStateCache::bind_vertex_array(GLuint vao)
+{
+    if(enabled_ && vertex_array_known_ && vertex_array_ == vao)
+    {
+        counters_.vertex_array_hits++;
+        return;
+    }
+    glBindVertexArray(vao);
+    counters_.vertex_array_misses++;
+    vertex_array_known_ = enabled_;
+    vertex_array_ = vao;
+}
+
+void GLStateCache::uniform1i(GLint location, GLint value)
+{
+    if(location >= 0 && update_uniform(location, &value, 1)) glUniform1i(location, value);
+}
+
+void GLStateCache::uniform1f(GLint location, GLfloat value)
+{
+    if(location >= 0 && update_uniform(location, &value, 1)) glUniform1f(location, value);
+}
+
+void GLStateCache::uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z)
+{
+    GLfloat value[3] = {x, y, z};
+    if(location >= 0 && update_uniform(location, value, 3)) glUniform3f(location, x, y, z);
+}
+
+void GLStateCache::uniform3fv(GLint location, const GLfloat *value)
+{
+    if(location >= 0 && update_uniform(location, value, 3)) glUniform3fv(location, 1, value);
+}
+
+void GLStateCache::uniform4fv(GLint location, const GLfloat *value)
+{
+    if(location >= 0 && update_uniform(location, value, 4)) glUniform4fv(location, 1, value);
+}
+
+void GLStateCache::uniform_matrix4fv(GLint location, const GLfloat *value)
+{
+    if(location >= 0 && update_uniform(location, value, 16)) glUniformMatrix4fv(location, 1, GL_FALSE, value);
+}
+
+void GLStateCache::invalidate()
+{
+    program_known_ = false;
+    program_index_ = -1;
+    vertex_array_known_ = false;
+    programs_.clear();
+}
+
+void GLStateCache::set_enabled(bool enabled)
+{
+    enabled_ = enabled;
+    invalidate();
+}
+
+bool GLStateCache::is_enabled() const { return enabled_; }
+
+const GLStateCounters &GLStateCache::get_counters() const { return counters_; }
+
+void GLStateCache::reset_counters() { counters_ = GLStateCounters{0, 0, 0, 0, 0, 0}; }
+
+bool GLStateCache::update_uniform(GLint location, const void *value, uint32_t size)
+{
+    if(program_index_ < 0 || location >= MAX_CACHED_LOCATION)
+    {
+        counters_.uniform_misses++;
+        return true;
+    }
+
+    // Compare the bits (a float compare would treat -0 and 0 as equal)
+    std::vector<UniformValue> &values = programs_[program_index_].values;
+    if(static_cast<size_t>(location) >= values.size()) values.resize(location + 1, UniformValue{0, {}});
+    UniformValue &cached = values[location];
+    if(cached.size == size && memcmp(cached.data, value, size * sizeof(uint32_t)) == 0)
+    {
+        counters_.uniform_hits++;
+        return false;
+    }
+    cached.size = size;
+    memcpy(cached.data, value, size * sizeof(uint32_t));
+    counters_.uniform_misses++;
+    return true;
+}
+
+} // namespace cg
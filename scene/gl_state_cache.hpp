@@ -0,0 +1,141 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    gl_state_cache.hpp
+//	Purpose: Filters redundant OpenGL state changes: program and vertex
+//           array binds and uniform values already current are skipped.
+//
+//============================================================================
+
+#ifndef __SCENE_GL_STATE_CACHE_HPP__
+#define __SCENE_GL_STATE_CACHE_HPP__
+
+#include "scene/graphics.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+// Calls made and skipped by the state cache (reset by SceneState::init)
+struct GLStateCounters
+{
+    uint32_t program_hits;        // glUseProgram calls skipped
+    uint32_t program_misses;      // glUseProgram calls made
+    uint32_t vertex_array_hits;   // glBindVertexArray calls skipped
+    uint32_t vertex_array_misses; // glBindVertexArray calls made
+    uint32_t uniform_hits;        // glUniform* calls skipped
+    uint32_t uniform_misses;      // glUniform* calls made
+};
+
+/**
+ * Shadow copy of the OpenGL state the scene sets while drawing: the current
+ * program, the bound vertex array and the uniform values of each program.
+ * A call that would set a value already current is skipped. Each call costs
+ * the driver validation and bookkeeping even when nothing changes, which is
+ * significant on software OpenGL (llvmpipe).
+ *
+ * The cache belongs to one OpenGL context. State changed directly (not
+ * through the cache) must be followed by invalidate. Uniforms of unknown
+ * programs and locations past MAX_CACHED_LOCATION are always set.
+ */
+class GLStateCache
+{
+  public:
+    // Uniform locations tracked per program
+    static constexpr GLint MAX_CACHED_LOCATION = 256;
+
+    /**
+     * Constructor. Nothing is known to be current.
+     */
+    GLStateCache();
+
+    /**
+     * Make a program current (glUseProgram).
+     * @param  program  Program.
+     */
+    void use_program(GLuint program);
+
+    /**
+     * Bind a vertex array (glBindVertexArray).
+     * @param  vao  Vertex array object (0 to unbind).
+     */
+    void bind_vertex_array(GLuint vao);
+
+    /**
+     * Set uniforms of the current program. Locations < 0 are ignored (as
+     * OpenGL does).
+     * @param  location  Uniform location.
+     * @param  value     Value (vector and matrix values are one element).
+     */
+    void uniform1i(GLint location, GLint value);
+    void uniform1f(GLint location, GLfloat value);
+    void uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z);
+    void uniform3fv(GLint location, const GLfloat *value);
+    void uniform4fv(GLint location, const GLfloat *value);
+    void uniform_matrix4fv(GLint location, const GLfloat *value);
+
+    /**
+     * Forget all cached state (after state was changed directly).
+     */
+    void invalidate();
+
+    /**
+     * Enable or disable filtering. When disabled every call is made. The
+     * cached state is invalidated.
+     * @param  enabled  True to skip redundant calls.
+     */
+    void set_enabled(bool enabled);
+
+    /**
+     * Check whether redundant calls are skipped.
+     * @return  Returns true if filtering is enabled.
+     */
+    bool is_enabled() const;
+
+    /**
+     * Get the calls made and skipped since the counters were reset.
+     * @return  Returns the counters.
+     */
+    const GLStateCounters &get_counters() const;
+
+    /**
+     * Reset the counters.
+     */
+    void reset_counters();
+
+  protected:
+    // Uniform value (as 32 bit words). size is 0 while the value is unknown.
+    struct UniformValue
+    {
+        uint32_t size;
+        uint32_t data[16];
+    };
+
+    struct ProgramUniforms
+    {
+        GLuint                    program;
+        std::vector<UniformValue> values; // By location
+    };
+
+    bool                         enabled_;
+    bool                         program_known_;
+    GLuint                       program_;
+    int32_t                      program_index_; // Uniforms of the current program (-1 if unknown)
+    bool                         vertex_array_known_;
+    GLuint                       vertex_array_;
+    std::vector<ProgramUniforms> programs_;
+    GLStateCounters              counters_;
+
+    // Record a uniform value of the current program. Returns true if it must
+    // be set (changed or not cached).
+    bool update_uniform(GLint location, const void *value, uint32_t size);
+};
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,64 @@
+#include "scene/image.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+namespace cg
+{
+
+namespace
+{
+
+inline uint8_t to_byte(float c) { return static_cast<uint8_t>(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f); }
+
+} // namespace
+
+Image::Image() : width_(0), height_(0) {}
+
+Image::Image(uint32_t width, uint32_t height) : width_(0), height_(0) { resize(width, height); }
+
+void Image::resize(uint32_t width, uint32_t height)
+{
+    width_ = width;
+    height_ = height;
+    pixels_.assign(static_cast<size_t>(width) * height * 3, 0);
+}
+
+uint32_t Image::get_width() const { return width_; }
+
+uint32_t Image::get_height() const { return height_; }
+
+void Image::set_pixel(uint32_t x, uint32_t y, const Color4 &c)
+{
+    uint8_t *p = &pixels_[(static_cast<size_t>(y) * width_ + x) * 3];
+    p[0] = to_byte(c.r);
+    p[1] = to_byte(c.g);
+    p[2] = to_byte(c.b);
+}
+
+Color4 Image::get_pixel(uint32_t x, uint32_t y) const
+{
+    const uint8_t *p = &pixels_[(static_cast<size_t>(y) * width_ + x) * 3];
+    return Color4(p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f, 1.0f);
+}
+
+const std::vector<uint8_t> &Image::get_data() const { return pixels_; }
+
+bool Image::write_ppm(const char *filename) const
+{
+    FILE *file = fopen(filename, "wb");
+    if(file == nullptr)
+    {
+        std::cout << "Image: could not open " << filename << " for writing\n";
+        return false;
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", width_, height_);
+    bool ok = fwrite(pixels_.data(), 1, pixels_.size(), file) == pixels_.size();
+    fclose(file);
+    if(!ok) std::cout << "Image: error writing " << filename << '\n';
+    return ok;
+}
+
+} // namespace cg
@@ -0,0 +1,98 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    image.hpp
+//	Purpose: 8 bit RGB image produced by the software renderers. Can be
+//           written as a binary PPM file.
+//
+//============================================================================
+
+#ifndef __SCENE_IMAGE_HPP__
+#define __SCENE_IMAGE_HPP__
+
+#include "scene/color4.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+/**
+ * RGB image with 8 bits per channel. Row 0 is the top of the image.
+ */
+class Image
+{
+  public:
+    /**
+     * Constructor. Constructs an empty image.
+     */
+    Image();
+
+    /**
+     * Constructor. All pixels are black.
+     * @param  width   Width in pixels.
+     * @param  height  Height in pixels.
+     */
+    Image(uint32_t width, uint32_t height);
+
+    /**
+     * Resize the image. All pixels are set to black.
+     * @param  width   Width in pixels.
+     * @param  height  Height in pixels.
+     */
+    void resize(uint32_t width, uint32_t height);
+
+    /**
+     * Get the width of the image.
+     * @return  Returns the width in pixels.
+     */
+    uint32_t get_width() const;
+
+    /**
+     * Get the height of the image.
+     * @return  Returns the height in pixels.
+     */
+    uint32_t get_height() const;
+
+    /**
+     * Set a pixel. The color is clamped to [0,1]; alpha is ignored.
+     * @param  x  Column (0 is the left).
+     * @param  y  Row (0 is the top).
+     * @param  c  Color.
+     */
+    void set_pixel(uint32_t x, uint32_t y, const Color4 &c);
+
+    /**
+     * Get a pixel.
+     * @param  x  Column (0 is the left).
+     * @param  y  Row (0 is the top).
+     * @return  Returns the pixel color (alpha is 1).
+     */
+    Color4 get_pixel(uint32_t x, uint32_t y) const;
+
+    /**
+     * Get the pixel data (RGB, 3 bytes per pixel, rows top to bottom).
+     * @return  Returns the pixel data.
+     */
+    const std::vector<uint8_t> &get_data() const;
+
+    /**
+     * Write the image as a binary (P6) PPM file.
+     * @param  filename  Name of the file.
+     * @return  Returns true if the file was written.
+     */
+    bool write_ppm(const char *filename) const;
+
+  protected:
+    uint32_t             width_;
+    uint32_t             height_;
+    std::vector<uint8_t> pixels_;
+};
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,238 @@
+#include "scene/instanced_geometry_node.hpp"
+
+#include "geometry/profiler.hpp"
+#include "scene/scene_bvh.hpp"
+
+#include <cstring>
+
+namespace cg
+{
+
+InstancedGeometryNode::InstancedGeometryNode(std::shared_ptr<TriSurface> surface) :
+    surface_(surface),
+    instance_buffer_(0),
+    buffer_dirty_(true),
+    surface_vbo_(0),
+    vao_locations_{-1, -1, -1, -1}
+{
+}
+
+InstancedGeometryNode::~InstancedGeometryNode()
+{
+    delete_vertex_arrays();
+    glDeleteBuffers(1, &instance_buffer_);
+}
+
+void InstancedGeometryNode::draw(SceneState &scene_state)
+{
+    CG_PROFILE_ZONE("InstancedGeometryNode::draw");
+    if(instances_.empty()) return;
+
+    if(!is_instancing_supported(scene_state))
+    {
+        // Draw each instance with its own matrices
+        Matrix4x4 parent_model_matrix = scene_state.model_matrix;
+        Matrix4x4 parent_normal_matrix = scene_state.normal_matrix;
+        Matrix4x4 model_matrix;
+        Matrix4x4 normal_matrix;
+        for(const auto &instance : instances_)
+        {
+            model_matrix.set(instance.model_matrix);
+            normal_matrix.set(instance.normal_matrix);
+            model_matrix = parent_model_matrix * model_matrix;
+            normal_matrix = parent_normal_matrix * normal_matrix;
+            Matrix4x4 pvm_matrix = scene_state.pv * model_matrix;
+            scene_state.gl_state.uniform_matrix4fv(scene_state.model_matrix_loc, model_matrix.get());
+            scene_state.gl_state.uniform_matrix4fv(scene_state.normal_matrix_loc, normal_matrix.get());
+            scene_state.gl_state.uniform_matrix4fv(scene_state.pvm_matrix_loc, pvm_matrix.get());
+            surface_->draw(scene_state);
+        }
+
+        // Restore the matrices of the parent
+        Matrix4x4 pvm_matrix = scene_state.pv * parent_model_matrix;
+        scene_state.gl_state.uniform_matrix4fv(scene_state.model_matrix_loc, parent_model_matrix.get());
+        scene_state.gl_state.uniform_matrix4fv(scene_state.normal_matrix_loc, parent_normal_matrix.get());
+        scene_state.gl_state.uniform_matrix4fv(scene_state.pvm_matrix_loc, pvm_matrix.get());
+        return;
+    }
+
+    update_vertex_arrays(scene_state);
+    scene_state.flush_frame_block();
+    scene_state.gl_state.uniform1i(scene_state.instanced_loc, 1);
+    for(uint32_t i = 0; i < vaos_.size(); i++)
+    {
+        DrawGeometry g = surface_->get_draw_geometry(i);
+        if(scene_state.vertex_format_loc >= 0)
+        {
+            scene_state.gl_state.uniform1i(scene_state.vertex_format_loc, static_cast<GLint>(g.vertex_format));
+            scene_state.gl_state.uniform3fv(scene_state.position_scale_loc, &g.quantization.scale.x);
+            scene_state.gl_state.uniform3fv(scene_state.position_offset_loc, &g.quantization.offset.x);
+        }
+        scene_state.gl_state.bind_vertex_array(vaos_[i]);
+        glDrawElementsInstanced(GL_TRIANGLES,
+                                g.index_count,
+                                g.index_type,
+                                (void *)g.index_offset,
+                                static_cast<GLsizei>(instances_.size()));
+    }
+    scene_state.gl_state.bind_vertex_array(0);
+    scene_state.gl_state.uniform1i(scene_state.instanced_loc, 0);
+}
+
+void InstancedGeometryNode::compile(RenderQueue &queue, SceneState &scene_state)
+{
+    if(instances_.empty()) return;
+
+    if(!is_instancing_supported(scene_state))
+    {
+        // One draw record per instance
+        Matrix4x4 parent_model_matrix = scene_state.model_matrix;
+        Matrix4x4 parent_normal_matrix = scene_state.normal_matrix;
+        Matrix4x4 matrix;
+        for(const auto &instance : instances_)
+        {
+            matrix.set(instance.model_matrix);
+            scene_state.model_matrix = parent_model_matrix * matrix;
+            matrix.set(instance.normal_matrix);
+            scene_state.normal_matrix = parent_normal_matrix * matrix;
+            surface_->compile(queue, scene_state);
+        }
+        scene_state.model_matrix = parent_model_matrix;
+        scene_state.normal_matrix = parent_normal_matrix;
+        return;
+    }
+
+    update_vertex_arrays(scene_state);
+    for(uint32_t i = 0; i < vaos_.size(); i++)
+    {
+        DrawGeometry g = surface_->get_draw_geometry(i);
+        g.vao = vaos_[i];
+        g.instance_count = static_cast<GLsizei>(instances_.size());
+        g.bound = get_bound();
+        queue.add_draw(g, scene_state);
+    }
+}
+
+void InstancedGeometryNode::gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix)
+{
+    Matrix4x4 instance_matrix;
+    for(const auto &instance : instances_)
+    {
+        instance_matrix.set(instance.model_matrix);
+        gather.instances.push_back(SceneInstance(surface_.get(), model_matrix * instance_matrix, gather.material));
+    }
+}
+
+uint32_t InstancedGeometryNode::add_instance(const Matrix4x4 &model_matrix)
+{
+    InstanceMatrices instance;
+    memcpy(instance.model_matrix, model_matrix.get(), sizeof(instance.model_matrix));
+    memcpy(instance.normal_matrix, model_matrix.get_normal_matrix().get(), sizeof(instance.normal_matrix));
+    instances_.push_back(instance);
+    buffer_dirty_ = true;
+
+    // The instance count is compiled into render queues
+    graph_changed();
+    return static_cast<uint32_t>(instances_.size() - 1);
+}
+
+void InstancedGeometryNode::set_instance(uint32_t index, const Matrix4x4 &model_matrix)
+{
+    InstanceMatrices &instance = instances_[index];
+    memcpy(instance.model_matrix, model_matrix.get(), sizeof(instance.model_matrix));
+    memcpy(instance.normal_matrix, model_matrix.get_normal_matrix().get(), sizeof(instance.normal_matrix));
+
+    // Update just this instance if the buffer is otherwise current
+    if(instance_buffer_ != 0 && !buffer_dirty_)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+        glBufferSubData(GL_ARRAY_BUFFER, index * sizeof(InstanceMatrices), sizeof(InstanceMatrices), &instance);
+    }
+
+    // Bounds up the graph (used for culling) must be recomputed if the
+    // instance moved outside the bound of this node
+    if(bound_version_ != graph_version_ || !bound_.contains(surface_->get_bound().transform(model_matrix)))
+    {
+        graph_changed();
+    }
+}
+
+void InstancedGeometryNode::clear_instances()
+{
+    instances_.clear();
+    buffer_dirty_ = true;
+    graph_changed();
+}
+
+uint32_t InstancedGeometryNode::get_instance_count() const { return static_cast<uint32_t>(instances_.size()); }
+
+std::shared_ptr<TriSurface> InstancedGeometryNode::get_surface() const { return surface_; }
+
+bool InstancedGeometryNode::is_instancing_supported(const SceneState &scene_state) const
+{
+    return scene_state.instanced_loc >= 0 && scene_state.instance_model_loc >= 0 &&
+           scene_state.instance_normal_loc >= 0;
+}
+
+void InstancedGeometryNode::update_vertex_arrays(SceneState &scene_state)
+{
+    if(buffer_dirty_)
+    {
+        if(instance_buffer_ == 0) glGenBuffers(1, &instance_buffer_);
+        glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+        glBufferData(GL_ARRAY_BUFFER,
+                     instances_.size() * sizeof(InstanceMatrices),
+                     instances_.data(),
+                     GL_DYNAMIC_DRAW);
+        buffer_dirty_ = false;
+    }
+
+    // Vertex arrays refer to the surface buffers and the attribute locations of the program
+    GLint  locations[4] = {scene_state.position_loc,
+                           scene_state.normal_loc,
+                           scene_state.instance_model_loc,
+                           scene_state.instance_normal_loc};
+    GLuint surface_vbo = (surface_->get_submesh_count() > 0) ? surface_->get_draw_geometry(0).vbo : 0;
+    if(vaos_.size() == surface_->get_submesh_count() && surface_vbo == surface_vbo_ &&
+       memcmp(locations, vao_locations_, sizeof(locations)) == 0)
+    {
+        return;
+    }
+
+    delete_vertex_arrays();
+    for(uint32_t i = 0; i < surface_->get_submesh_count(); i++)
+    {
+        vaos_.push_back(create_instanced_vertex_array(surface_->get_draw_geometry(i),
+                                                      scene_state.position_loc,
+                                                      scene_state.normal_loc,
+                                                      instance_buffer_,
+                                                      0,
+                                                      scene_state.instance_model_loc,
+                                                      scene_state.instance_normal_loc));
+    }
+    surface_vbo_ = surface_vbo;
+    memcpy(vao_locations_, locations, sizeof(locations));
+
+    // Creating the vertex arrays changed the binding (and names may be reused)
+    scene_state.gl_state.invalidate();
+}
+
+void InstancedGeometryNode::update_bound()
+{
+    bound_ = AABB();
+    cullable_ = surface_->is_cullable();
+    Matrix4x4 model_matrix;
+    for(const auto &instance : instances_)
+    {
+        model_matrix.set(instance.model_matrix);
+        bound_.merge(surface_->get_bound().transform(model_matrix));
+    }
+}
+
+void InstancedGeometryNode::delete_vertex_arrays()
+{
+    for(GLuint vao : vaos_) { glDeleteVertexArrays(1, &vao); }
+    vaos_.clear();
+}
+
+} // namespace cg
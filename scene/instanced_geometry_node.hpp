@@ -0,0 +1,137 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:	 David W. Nesbitt
+//	File:    instanced_geometry_node.hpp
+//	Purpose: Scene graph geometry node that draws many copies of a triangle
+//           mesh with a single instanced draw call.
+//
+//============================================================================
+
+#ifndef __SCENE_INSTANCED_GEOMETRY_NODE_HPP__
+#define __SCENE_INSTANCED_GEOMETRY_NODE_HPP__
+
+#include "scene/render_queue.hpp"
+#include "scene/tri_surface.hpp"
+
+namespace cg
+{
+
+/**
+ * Instanced geometry node. Draws a triangle surface once per instance using
+ * glDrawElementsInstanced. Each instance has a modeling matrix applied before
+ * the current modeling matrix; the instance modeling and normal matrices are
+ * stored in an instance buffer. Falls back to one draw per instance if the
+ * current shader does not support instancing.
+ */
+class InstancedGeometryNode : public GeometryNode
+{
+  public:
+    /**
+     * Constructor.
+     * @param  surface  Surface to draw for each instance. The surface need not
+     *                  be part of the scene graph.
+     */
+    InstancedGeometryNode(std::shared_ptr<TriSurface> surface);
+
+    /**
+     * Destructor. Deletes the instance buffer and vertex arrays.
+     */
+    ~InstancedGeometryNode();
+
+    /**
+     * Draw all instances.
+     * @param  scene_state  Current scene state.
+     */
+    void draw(SceneState &scene_state) override;
+
+    /**
+     * Add an instanced draw record to the render queue.
+     * @param  queue        Render queue.
+     * @param  scene_state  Current scene state.
+     */
+    void compile(RenderQueue &queue, SceneState &scene_state) override;
+
+    /**
+     * Add the surface once per instance to the list.
+     * @param  gather        Instance and light lists.
+     * @param  model_matrix  Composite modeling matrix of the parent.
+     */
+    void gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix) override;
+
+    /**
+     * Add an instance.
+     * @param  model_matrix  Modeling matrix of the instance.
+     * @return  Returns the index of the instance.
+     */
+    uint32_t add_instance(const Matrix4x4 &model_matrix);
+
+    /**
+     * Change the modeling matrix of an instance. Only this instance is
+     * uploaded to the instance buffer. Compiled render queues stay valid
+     * unless the instance moves outside the bound of this node.
+     * @param  index         Index of the instance.
+     * @param  model_matrix  Modeling matrix of the instance.
+     */
+    void set_instance(uint32_t index, const Matrix4x4 &model_matrix);
+
+    /**
+     * Remove all instances.
+     */
+    void clear_instances();
+
+    /**
+     * Get the number of instances.
+     * @return  Returns the number of instances.
+     */
+    uint32_t get_instance_count() const;
+
+    /**
+     * Get the surface drawn for each instance.
+     * @return  Returns the surface.
+     */
+    std::shared_ptr<TriSurface> get_surface() const;
+
+  protected:
+    std::shared_ptr<TriSurface>   surface_;
+    std::vector<InstanceMatrices> instances_;
+
+    // Instance buffer and a vertex array for each submesh of the surface
+    GLuint              instance_buffer_;
+    bool                buffer_dirty_;
+    std::vector<GLuint> vaos_;
+
+    // Surface vertex buffer and attribute locations the vertex arrays were created with
+    GLuint surface_vbo_;
+    GLint  vao_locations_[4];
+
+    /**
+     * Check whether the current shader supports instanced draws.
+     * @param  scene_state  Current scene state.
+     * @return  Returns true if the instancing locations are set.
+     */
+    bool is_instancing_supported(const SceneState &scene_state) const;
+
+    /**
+     * Upload the instance buffer if it changed and (re)create the vertex
+     * arrays if the surface buffers or the attribute locations changed.
+     * @param  scene_state  Current scene state.
+     */
+    void update_vertex_arrays(SceneState &scene_state);
+
+    /**
+     * Delete the vertex arrays.
+     */
+    void delete_vertex_arrays();
+
+    /**
+     * Bound of the surface transformed by each instance.
+     */
+    void update_bound() override;
+};
+
+} // namespace cg
+
+#endif
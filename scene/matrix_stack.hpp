@@ -0,0 +1,104 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    matrix_stack.hpp
+//	Purpose: Contiguous stack of modeling matrices used during scene graph
+//           traversal.
+//
+//============================================================================
+
+#ifndef __SCENE_MATRIX_STACK_HPP__
+#define __SCENE_MATRIX_STACK_HPP__
+
+#include "geometry/matrix.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+/**
+ * Stack of matrices. The first INLINE_CAPACITY matrices are stored in the
+ * stack itself, deeper ones in an overflow array that grows as needed. Clear
+ * keeps the overflow capacity, so once a traversal has reached its deepest
+ * level pushes and pops never allocate.
+ */
+class MatrixStack
+{
+  public:
+    static constexpr uint32_t INLINE_CAPACITY = 32; // Matrices stored without allocation
+
+    /**
+     * Constructor.
+     */
+    MatrixStack() : size_(0) {}
+
+    /**
+     * Push a copy of a matrix.
+     * @param  m  Matrix.
+     */
+    void push(const Matrix4x4 &m)
+    {
+        if(size_ < INLINE_CAPACITY) inline_[size_] = m;
+        else overflow_.push_back(m);
+        size_++;
+    }
+
+    /**
+     * Remove the top matrix. The stack must not be empty.
+     */
+    void pop()
+    {
+        size_--;
+        if(size_ >= INLINE_CAPACITY) overflow_.pop_back();
+    }
+
+    /**
+     * Get the top matrix. The stack must not be empty.
+     * @return  Returns the top matrix.
+     */
+    const Matrix4x4 &top() const
+    {
+        return (size_ <= INLINE_CAPACITY) ? inline_[size_ - 1] : overflow_.back();
+    }
+
+    /**
+     * Remove all matrices (keeps the capacity).
+     */
+    void clear()
+    {
+        size_ = 0;
+        overflow_.clear();
+    }
+
+    /**
+     * Get the number of matrices on the stack.
+     * @return  Returns the number of matrices.
+     */
+    uint32_t size() const { return size_; }
+
+    /**
+     * Check whether the stack is empty.
+     * @return  Returns true if there are no matrices on the stack.
+     */
+    bool empty() const { return size_ == 0; }
+
+    /**
+     * Get the number of matrices the stack holds without allocating.
+     * @return  Returns the capacity.
+     */
+    size_t capacity() const { return INLINE_CAPACITY + overflow_.capacity(); }
+
+  protected:
+    Matrix4x4              inline_[INLINE_CAPACITY];
+    std::vector<Matrix4x4> overflow_; // Matrices past INLINE_CAPACITY
+    uint32_t               size_;
+};
+
+} // namespace cg
+
+#endif
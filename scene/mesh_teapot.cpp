@@ -1,5 +1,7 @@
 #include "scene/mesh_teapot.hpp"
 
+#include "geometry/profiler.hpp"
+
 #include <algorithm>
 
 namespace cg
@@ -354,6 +356,8 @@ static uint32_t PatchIndices[32][4][4] = {
 
 MeshTeapot::MeshTeapot(uint16_t level, int32_t position_loc, int32_t normal_loc)
 {
+    CG_PROFILE_ZONE("MeshTeapot::MeshTeapot");
+
     // Data is 32 patches, each with a 4x4 array of point[3].
     // Convert array data into a triple-array of Vector3.
     using PatchType = std::array<std::array<Vector3, 4>, 4>;
@@ -371,63 +375,73 @@ MeshTeapot::MeshTeapot(uint16_t level, int32_t position_loc, int32_t normal_loc)
         }
     }
 
-    // Level 6 or higher would produce more than 65,536 vertices
-    level = std::max<uint16_t>(level, 5);
+    // Level 11 or higher would produce more indexes than a draw call allows
+    level = std::min<uint16_t>(level, 10);
 
-    // Subdivide all 32 patches
-    for(size_t patch = 0; patch < 32; patch++) { divide_patch(data[patch], level); }
+    // Each patch adds at most (2^level + 1)^2 vertices and 2 * 4^level triangles
+    size_t patch_dim = (static_cast<size_t>(1) << level) + 1;
+    vertices_.reserve(32 * patch_dim * patch_dim);
+    faces_.reserve(32 * 6 * (patch_dim - 1) * (patch_dim - 1));
+
+    // Subdivide all 32 patches. The subdivided patch and its indexes are
+    // scratch space, allocated from an arena that is reset for each patch.
+    Arena scratch;
+    for(size_t patch = 0; patch < 32; patch++)
+    {
+        divide_patch(data[patch], level, scratch);
+        scratch.reset();
+    }
 
     // End the mesh - construct vertex normals by averaging
     end(position_loc, normal_loc);
 }
 
-void MeshTeapot::divide_patch(std::array<std::array<Vector3, 4>, 4> patch, uint16_t level)
+void MeshTeapot::divide_patch(std::array<std::array<Vector3, 4>, 4> patch, uint16_t level, Arena &scratch)
 {
-    // Helper function to determine the number of points on each individual curve.
-    // Note: for integers, this is MUCH faster than std::pow
-    auto powi = [](uint32_t val, uint32_t exp) -> uint32_t
-    {
-        uint32_t res = 1;
-        for(uint32_t i = 0; i < exp; ++i) res *= val;
-        return res;
-    };
-
     // Each curve will finally have [2^(level) + 1] points.
-    const auto sub_patch_dim = powi(2, level) + 1;
+    const size_t sub_patch_dim = (static_cast<size_t>(1) << level) + 1;
 
-    std::vector<std::vector<Vector3>> row_ctrl_points(4);
-    std::vector<std::vector<Vector3>> patch_vertices(sub_patch_dim);
+    using ScratchVector = std::vector<Vector3, ArenaAllocator<Vector3>>;
+    ScratchVector row_ctrl_points(4 * sub_patch_dim, ArenaAllocator<Vector3>(scratch));
+    ScratchVector patch_vertices(sub_patch_dim * sub_patch_dim, ArenaAllocator<Vector3>(scratch));
 
     // Compute the curves for each patch row
     for(size_t r = 0; r < 4; ++r)
     {
-        row_ctrl_points[r] =
-            divide_curve(patch[0][r], patch[1][r], patch[2][r], patch[3][r], level);
+        divide_curve(patch[0][r], patch[1][r], patch[2][r], patch[3][r], level,
+                     &row_ctrl_points[r * sub_patch_dim]);
     }
 
     // Use the patch rows as the control points for each column
     for(size_t c = 0; c < sub_patch_dim; ++c)
     {
-        patch_vertices[c] = divide_curve(row_ctrl_points[0][c],
-                                         row_ctrl_points[1][c],
-                                         row_ctrl_points[2][c],
-                                         row_ctrl_points[3][c],
-                                         level);
+        divide_curve(row_ctrl_points[c],
+                     row_ctrl_points[sub_patch_dim + c],
+                     row_ctrl_points[2 * sub_patch_dim + c],
+                     row_ctrl_points[3 * sub_patch_dim + c],
+                     level,
+                     &patch_vertices[c * sub_patch_dim]);
     }
 
     // Add the subdividied patch to the mesh
-    add_patch(patch_vertices);
+    add_patch(patch_vertices.data(), sub_patch_dim, scratch);
 }
 
-std::vector<Vector3> MeshTeapot::divide_curve(const Vector3 &ctrl_0,
-                                              const Vector3 &ctrl_1,
-                                              const Vector3 &ctrl_2,
-                                              const Vector3 &ctrl_3,
-                                              uint16_t       level)
+void MeshTeapot::divide_curve(const Vector3 &ctrl_0,
+                              const Vector3 &ctrl_1,
+                              const Vector3 &ctrl_2,
+                              const Vector3 &ctrl_3,
+                              uint16_t       level,
+                              Vector3       *curve)
 {
     // Level 0: add the start and end points only.
     // Note: ctrl_1 and ctrl_2 are not on the curve
-    if(level == 0) return {ctrl_0, ctrl_3};
+    if(level == 0)
+    {
+        curve[0] = ctrl_0;
+        curve[1] = ctrl_3;
+        return;
+    }
 
     Vector3 lt_0, lt_1, lt_2, lt_3;
     Vector3 rt_0, rt_1, rt_2, rt_3;
@@ -450,71 +464,62 @@ std::vector<Vector3> MeshTeapot::divide_curve(const Vector3 &ctrl_0,
     lt_3 = (lt_2 + rt_1) * 0.5f;
     rt_0 = lt_3;
 
-    // Recursively compute the left and right sides of the curve
-    auto lt_sample = divide_curve(lt_0, lt_1, lt_2, lt_3, level - 1);
-    auto rt_sample = divide_curve(rt_0, rt_1, rt_2, rt_3, level - 1);
-
-    std::vector<Vector3> result;
-    result.reserve(lt_sample.size() + rt_sample.size() - 1);
-
-    // Insert all of the left curve
-    result.insert(result.end(), lt_sample.begin(), lt_sample.end());
-    // Insert all of the right curve, except for the first vertex (which is the
-    // same as the last vertex in the left curve)
-    result.insert(result.end(), std::next(rt_sample.begin()), rt_sample.end());
-
-    return result;
+    // Recursively compute the left and right sides of the curve in place. The
+    // first point of the right curve is the last point of the left curve.
+    size_t half = static_cast<size_t>(1) << (level - 1);
+    divide_curve(lt_0, lt_1, lt_2, lt_3, level - 1, curve);
+    divide_curve(rt_0, rt_1, rt_2, rt_3, level - 1, curve + half);
 }
 
-uint16_t MeshTeapot::add_vertex(const Vector3 &v, bool find_existing)
+uint32_t MeshTeapot::add_vertex(const Vector3 &v, bool find_existing)
 {
     if(find_existing) return TriSurface::add_vertex(Point3(v.x, v.y, v.z));
 
     // Don't search for an equivalent vertex, just append to the vertex list
     vertices_.push_back(VertexAndNormal(Point3(v.x, v.y, v.z)));
-    return static_cast<uint16_t>(vertices_.size() - 1);
+    return static_cast<uint32_t>(vertices_.size() - 1);
 }
 
-void MeshTeapot::add_patch(const std::vector<std::vector<Vector3>> &patch)
+void MeshTeapot::add_patch(const Vector3 *patch, size_t patch_size, Arena &scratch)
 {
-    size_t patch_size = patch.size();
     size_t max_idx = patch_size - 1;
 
-    std::vector<std::vector<uint16_t>> patch_idxs(patch_size);
-
-    // Initialize index arrays
-    for(size_t i = 0; i < patch_size; ++i) patch_idxs[i].resize(patch_size);
+    // Vertex index of each patch vertex (by column, like the patch)
+    std::vector<uint32_t, ArenaAllocator<uint32_t>> idxs(patch_size * patch_size,
+                                                         ArenaAllocator<uint32_t>(scratch));
+    auto patch_idx = [&](size_t c, size_t r) -> uint32_t & { return idxs[c * patch_size + r]; };
+    auto vertex = [&](size_t c, size_t r) -> const Vector3 & { return patch[c * patch_size + r]; };
 
     // Add left column edge vertices
-    for(size_t r = 0; r < patch_size; ++r) patch_idxs[0][r] = add_vertex(patch[0][r], true);
+    for(size_t r = 0; r < patch_size; ++r) patch_idx(0, r) = add_vertex(vertex(0, r), true);
 
     // Add right column edge vertices
     for(size_t r = 0; r < patch_size; ++r)
-        patch_idxs[max_idx][r] = add_vertex(patch[max_idx][r], true);
+        patch_idx(max_idx, r) = add_vertex(vertex(max_idx, r), true);
 
     // Add bottom row edge vertices
-    for(size_t c = 1; c < max_idx; ++c) patch_idxs[c][0] = add_vertex(patch[c][0], true);
+    for(size_t c = 1; c < max_idx; ++c) patch_idx(c, 0) = add_vertex(vertex(c, 0), true);
 
     // Add top row edge vertices
     for(size_t c = 1; c < max_idx; ++c)
-        patch_idxs[c][max_idx] = add_vertex(patch[c][max_idx], true);
+        patch_idx(c, max_idx) = add_vertex(vertex(c, max_idx), true);
 
     // Add middle vertices
     for(size_t r = 1; r < max_idx; ++r)
-        for(size_t c = 1; c < max_idx; ++c) patch_idxs[c][r] = add_vertex(patch[c][r], false);
+        for(size_t c = 1; c < max_idx; ++c) patch_idx(c, r) = add_vertex(vertex(c, r), false);
 
     // Add the faces using the indices returned by 'add_vertex'
     for(size_t r = 0; r < max_idx; ++r)
     {
         for(size_t c = 0; c < max_idx; ++c)
         {
-            faces_.push_back(patch_idxs[c][r]);
-            faces_.push_back(patch_idxs[c + 1][r + 1]);
-            faces_.push_back(patch_idxs[c + 1][r]);
+            faces_.push_back(patch_idx(c, r));
+            faces_.push_back(patch_idx(c + 1, r + 1));
+            faces_.push_back(patch_idx(c + 1, r));
 
-            faces_.push_back(patch_idxs[c][r]);
-            faces_.push_back(patch_idxs[c][r + 1]);
-            faces_.push_back(patch_idxs[c + 1][r + 1]);
+            faces_.push_back(patch_idx(c, r));
+            faces_.push_back(patch_idx(c, r + 1));
+            faces_.push_back(patch_idx(c + 1, r + 1));
         }
     }
 }
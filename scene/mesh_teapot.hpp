@@ -11,6 +11,7 @@
 #ifndef __SCENE_MESH_TEAPOT_HPP__
 #define __SCENE_MESH_TEAPOT_HPP__
 
+#include "geometry/arena.hpp"
 #include "geometry/point3.hpp"
 #include "geometry/vector3.hpp"
 #include "scene/tri_surface.hpp"
@@ -28,9 +29,10 @@ class MeshTeapot : public TriSurface
      * Constructs the Utah teapot using uniform patch subdivision.  Reads in the
      * patch vertices and indices into a Vector3 array.  Recursively subdivides and store
      *	patches into a mesh surface.
-     * @param level Number of levels to subdivide the patches
-     *              Note: level cannot exceed 5, otherwise the number or vertices
-     *                    exceeds the maximum allowed ( max<uint16_t> )
+     * @param level Number of levels to subdivide the patches. Each level has 4
+     *              times the triangles of the previous level (level 5 has 65,536
+     *              triangles). Levels above 5 use 32 bit indexes (see IndexFormat).
+     *              Level cannot exceed 10.
      */
     MeshTeapot(uint16_t level, int32_t position_loc, int32_t normal_loc);
 
@@ -41,8 +43,9 @@ class MeshTeapot : public TriSurface
      * stored in the mesh surface.
      * @param patch Patch (4x4 array of Vector3)
      * @param level Current level of subdivision
+     * @param scratch Arena for the subdivided patch (reset by the caller)
      */
-    void divide_patch(std::array<std::array<Vector3, 4>, 4> patch, uint16_t level);
+    void divide_patch(std::array<std::array<Vector3, 4>, 4> patch, uint16_t level, Arena &scratch);
 
     /**
      * Helper function to divide a curve recursively until level == 0
@@ -51,13 +54,14 @@ class MeshTeapot : public TriSurface
      * @param ctrl_2 Control point 2 of a curve
      * @param ctrl_3 End point of a curve
      * @param level Current level of subdivision
-     * @return The fully sub-divided curve
+     * @param curve Receives the fully sub-divided curve (2^level + 1 points)
      */
-    static std::vector<Vector3> divide_curve(const Vector3 &ctrl_0,
-                                             const Vector3 &ctrl_1,
-                                             const Vector3 &ctrl_2,
-                                             const Vector3 &ctrl_3,
-                                             uint16_t       level);
+    static void divide_curve(const Vector3 &ctrl_0,
+                             const Vector3 &ctrl_1,
+                             const Vector3 &ctrl_2,
+                             const Vector3 &ctrl_3,
+                             uint16_t       level,
+                             Vector3       *curve);
 
     /**
      * Adds a vertex to the mesh; calls TriSurface::add_vertex if
@@ -68,13 +72,15 @@ class MeshTeapot : public TriSurface
      *                      existing vertex at 'v'
      * @return The index of the added vertex in the mesh
      */
-    uint16_t add_vertex(const Vector3 &v, bool find_existing);
+    uint32_t add_vertex(const Vector3 &v, bool find_existing);
 
     /**
      * Adds a sub-divided patch to the mesh
-     * @param patch double vector of Vector3
+     * @param patch Patch vertices by column (patch[c * patch_size + r])
+     * @param patch_size Number of rows and columns in the patch
+     * @param scratch Arena for the vertex indexes of the patch
      */
-    void add_patch(const std::vector<std::vector<Vector3>> &patch);
+    void add_patch(const Vector3 *patch, size_t patch_size, Arena &scratch);
 };
 
 } // namespace cg
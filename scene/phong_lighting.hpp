@@ -0,0 +1,111 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    phong_lighting.hpp
+//	Purpose: CPU version of the Phong lighting in vertex_lighting.frag,
+//           shared by the ray tracer and the software rasterizer.
+//
+//============================================================================
+
+#ifndef __SCENE_PHONG_LIGHTING_HPP__
+#define __SCENE_PHONG_LIGHTING_HPP__
+
+#include "geometry/geometry.hpp"
+#include "scene/color4.hpp"
+#include "scene/render_queue.hpp"
+#include "scene/scene_bvh.hpp"
+
+#include <cmath>
+#include <vector>
+
+namespace cg
+{
+
+/**
+ * Phong lighting at a point, with the same terms as vertex_lighting.frag.
+ * @param  material        Material.
+ * @param  lights          Lights.
+ * @param  global_ambient  Global ambient light.
+ * @param  p               Position (world coordinates).
+ * @param  n               Unit normal (world coordinates).
+ * @param  eye             Camera position.
+ * @param  is_lit          Called as is_lit(l, distance) with the unit
+ *                         direction and the distance (FLT_MAX for directional
+ *                         lights) to each light that would add diffuse and
+ *                         specular light. Returning false drops those terms
+ *                         (for example where the light is in shadow).
+ * @return  Returns the color.
+ */
+template <typename F>
+Color4 shade_phong(const MaterialBlock           &material,
+                   const std::vector<SceneLight> &lights,
+                   const Color4                  &global_ambient,
+                   const Point3                  &p,
+                   const Vector3                 &n,
+                   const Point3                  &eye,
+                   F                              is_lit)
+{
+    Vector3 v(p, eye);
+    v.normalize();
+
+    Color4 ambient(0.0f, 0.0f, 0.0f, 0.0f);
+    Color4 diffuse(0.0f, 0.0f, 0.0f, 0.0f);
+    Color4 specular(0.0f, 0.0f, 0.0f, 0.0f);
+    for(const SceneLight &light : lights)
+    {
+        if(!light.enabled) continue;
+
+        // Direction and distance to the light
+        Vector3 l;
+        float   distance = FLT_MAX;
+        if(light.position.w == 0.0f)
+        {
+            l = Vector3(light.position.x, light.position.y, light.position.z);
+        }
+        else
+        {
+            l = Vector3(p, Point3(light.position.x, light.position.y, light.position.z));
+            distance = l.norm();
+        }
+        l.normalize();
+
+        float spotlight_effect = 1.0f;
+        if(light.spotlight)
+        {
+            Vector3 spot_dir = light.spot_direction;
+            spot_dir.normalize();
+            float spot_cos = -l.dot(spot_dir);
+            if(spot_cos < std::cos(degrees_to_radians(light.spot_cutoff))) continue;
+            spotlight_effect = std::pow(spot_cos, light.spot_exponent);
+            if(spotlight_effect <= 0.0f) continue;
+        }
+
+        Color4 light_ambient = light.ambient;
+        ambient += light_ambient;
+
+        float n_dot_l = n.dot(l);
+        if(n_dot_l <= 0.0f || !is_lit(l, distance)) continue;
+
+        Color4 light_diffuse = light.diffuse;
+        diffuse += light_diffuse * (n_dot_l * spotlight_effect);
+
+        Vector3 h = l + v;
+        h.normalize();
+        float n_dot_h = n.dot(h);
+        if(n_dot_h > 0.0f)
+        {
+            Color4 light_specular = light.specular;
+            specular += light_specular * (std::pow(n_dot_h, material.shininess) * spotlight_effect);
+        }
+    }
+
+    return material.emission + global_ambient * material.ambient + ambient * material.ambient +
+           diffuse * material.diffuse + specular * material.specular;
+}
+
+} // namespace cg
+
+#endif
@@ -1,5 +1,9 @@
 #include "scene/presentation_node.hpp"
 
+#include "geometry/profiler.hpp"
+#include "scene/scene_bvh.hpp"
+#include "scene/scene_store.hpp"
+
 namespace cg
 {
 
@@ -20,35 +24,92 @@ PresentationNode::PresentationNode(const Color4 &ambient,
     material_emission_(emission),
     material_shininess_(shininess)
 {
+    node_type_ = SceneNodeType::PRESENTATION;
 }
 
-void PresentationNode::set_material_ambient(const Color4 &c) { material_ambient_ = c; }
+void PresentationNode::set_material_ambient(const Color4 &c)
+{
+    material_ambient_ = c;
+    graph_changed();
+}
 
-void PresentationNode::set_material_diffuse(const Color4 &c) { material_diffuse_ = c; }
+void PresentationNode::set_material_diffuse(const Color4 &c)
+{
+    material_diffuse_ = c;
+    graph_changed();
+}
 
 void PresentationNode::set_material_ambient_and_diffuse(const Color4 &c)
 {
     material_ambient_ = c;
     material_diffuse_ = c;
+    graph_changed();
 }
 
-void PresentationNode::set_material_specular(const Color4 &c) { material_specular_ = c; }
+void PresentationNode::set_material_specular(const Color4 &c)
+{
+    material_specular_ = c;
+    graph_changed();
+}
 
-void PresentationNode::set_material_emission(const Color4 &c) { material_emission_ = c; }
+void PresentationNode::set_material_emission(const Color4 &c)
+{
+    material_emission_ = c;
+    graph_changed();
+}
 
-void PresentationNode::set_material_shininess(float s) { material_shininess_ = s; }
+void PresentationNode::set_material_shininess(float s)
+{
+    material_shininess_ = s;
+    graph_changed();
+}
 
 void PresentationNode::draw(SceneState &scene_state)
 {
-    // Set the material uniform values
-    glUniform4fv(scene_state.material_ambient_loc, 1, &material_ambient_.r);
-    glUniform4fv(scene_state.material_diffuse_loc, 1, &material_diffuse_.r);
-    glUniform4fv(scene_state.material_specular_loc, 1, &material_specular_.r);
-    glUniform4fv(scene_state.material_emission_loc, 1, &material_emission_.r);
-    glUniform1f(scene_state.material_shininess_loc, material_shininess_);
+    CG_PROFILE_ZONE("PresentationNode::draw");
+
+    // Set the material (one buffer write and bind if the shader has a
+    // material block, otherwise the material uniform values)
+    if(scene_state.material_stream != nullptr) scene_state.material_stream->stream(get_material());
+    else
+    {
+        scene_state.gl_state.uniform4fv(scene_state.material_ambient_loc, &material_ambient_.r);
+        scene_state.gl_state.uniform4fv(scene_state.material_diffuse_loc, &material_diffuse_.r);
+        scene_state.gl_state.uniform4fv(scene_state.material_specular_loc, &material_specular_.r);
+        scene_state.gl_state.uniform4fv(scene_state.material_emission_loc, &material_emission_.r);
+        scene_state.gl_state.uniform1f(scene_state.material_shininess_loc, material_shininess_);
+    }
 
     // Draw children of this node
     SceneNode::draw(scene_state);
 }
 
+void PresentationNode::compile(RenderQueue &queue, SceneState &scene_state)
+{
+    // Like draw, the material stays current after this subtree (not restored)
+    queue.set_material(get_material());
+    SceneNode::compile(queue, scene_state);
+}
+
+void PresentationNode::flatten(SceneStore &store, uint32_t parent)
+{
+    flatten_children(store, store.add_material(parent, get_material()));
+}
+
+void PresentationNode::gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix)
+{
+    // Like draw, the material stays current after this subtree (not restored)
+    gather.material = get_material();
+    SceneNode::gather_instances(gather, model_matrix);
+}
+
+MaterialBlock PresentationNode::get_material() const
+{
+    return MaterialBlock{material_ambient_,
+                         material_diffuse_,
+                         material_specular_,
+                         material_emission_,
+                         material_shininess_};
+}
+
 } // namespace cg
@@ -13,6 +13,7 @@
 #define __SCENE_PRESENTATION_NODE_HPP__
 
 #include "scene/color4.hpp"
+#include "scene/render_queue.hpp"
 #include "scene/scene_node.hpp"
 
 namespace cg
@@ -86,6 +87,33 @@ class PresentationNode : public SceneNode
      */
     void draw(SceneState &scene_state) override;
 
+    /**
+     * Compile. Sets the current material in the render queue.
+     * @param  queue        Render queue
+     * @param  scene_state  Scene state
+     */
+    void compile(RenderQueue &queue, SceneState &scene_state) override;
+
+    /**
+     * Flatten. Adds a material node to the scene store.
+     * @param  store   Scene store
+     * @param  parent  Handle of the parent in the store
+     */
+    void flatten(SceneStore &store, uint32_t parent) override;
+
+    /**
+     * Set the current material and gather the children.
+     * @param  gather        Instance and light lists.
+     * @param  model_matrix  Composite modeling matrix of the parent.
+     */
+    void gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix) override;
+
+    /**
+     * Get the material properties of this node.
+     * @return  Returns the material block.
+     */
+    MaterialBlock get_material() const;
+
   protected:
     Color4  material_ambient_;
     Color4  material_diffuse_;
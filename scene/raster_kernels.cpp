@@ -0,0 +1,77 @@
+#include "scene/raster_kernels.hpp"
+
+namespace cg
+{
+
+// Instruction set specific kernels. Returns nullptr if the instruction set is
+// not available in this build or on this CPU.
+const RasterKernels *get_avx2_raster_kernels();
+
+namespace
+{
+
+uint32_t raster_8_scalar(const RasterEdges &edges,
+                         float              x,
+                         float              y,
+                         uint32_t           active,
+                         float             *depth,
+                         float             *b0,
+                         float             *b1,
+                         float             *b2)
+{
+    float   *b[3] = {b0, b1, b2};
+    uint32_t mask = 0;
+    for(uint32_t i = 0; i < 8; i++)
+    {
+        float    px = x + static_cast<float>(i);
+        uint32_t inside = (active >> i) & 1;
+        for(uint32_t k = 0; k < 3; k++)
+        {
+            float e = edges.a[k] * (px - edges.x[k]) + edges.b[k] * (y - edges.y[k]);
+            bool  top_left = (edges.top_left & (1u << k)) != 0;
+            if(!(e > 0.0f || (top_left && e == 0.0f))) inside = 0;
+            b[k][i] = e * edges.inv_area;
+        }
+
+        float z = b0[i] * edges.z[0] + b1[i] * edges.z[1] + b2[i] * edges.z[2];
+        if(inside && z >= 0.0f && z <= 1.0f && z < depth[i])
+        {
+            depth[i] = z;
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+const RasterKernels SCALAR_RASTER_KERNELS = {SimdLevel::SCALAR, "scalar", raster_8_scalar};
+
+// Select the widest kernels the CPU supports when the library is loaded.
+// Until then (during static initialization of other translation units) the
+// scalar kernels are used.
+const bool g_kernels_selected =
+    set_raster_simd_level((get_avx2_raster_kernels() != nullptr) ? SimdLevel::AVX2 : SimdLevel::SCALAR);
+
+} // namespace
+
+const RasterKernels *g_raster_kernels = &SCALAR_RASTER_KERNELS;
+
+const RasterKernels *get_raster_kernels(SimdLevel level)
+{
+    switch(level)
+    {
+        case SimdLevel::SCALAR: return &SCALAR_RASTER_KERNELS;
+        case SimdLevel::AVX2: return get_avx2_raster_kernels();
+        default: return nullptr;
+    }
+}
+
+bool set_raster_simd_level(SimdLevel level)
+{
+    const RasterKernels *kernels = get_raster_kernels(level);
+    if(kernels == nullptr) return false;
+
+    g_raster_kernels = kernels;
+    return true;
+}
+
+} // namespace cg
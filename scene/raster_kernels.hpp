@@ -0,0 +1,93 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    raster_kernels.hpp
+//	Purpose: Edge function kernels (scalar, AVX2) for the software rasterizer
+//           that cover and depth test 8 pixels of a row at a time. Selected
+//           at startup like the matrix kernels.
+//
+//============================================================================
+
+#ifndef __SCENE_RASTER_KERNELS_HPP__
+#define __SCENE_RASTER_KERNELS_HPP__
+
+#include "geometry/matrix_kernels.hpp"
+
+#include <cstdint>
+
+namespace cg
+{
+
+/**
+ * Edge functions and depths of a screen space triangle. Edge i is opposite
+ * vertex i and E_i(x, y) = a[i] * (x - x[i]) + b[i] * (y - y[i]) is positive
+ * inside the triangle. Each edge is evaluated from the same endpoint, with
+ * the same operations, by both triangles that share it, so shared edges have
+ * no gaps or double coverage. Pixels on an edge are covered only if it is a
+ * top or left edge (as in OpenGL).
+ */
+struct RasterEdges
+{
+    float    x[3];     // Edge origins (pixels)
+    float    y[3];
+    float    a[3];     // Edge coefficients
+    float    b[3];
+    float    z[3];     // Window depth (0 to 1) at each vertex
+    float    inv_area; // 1 / E_i(vertex i) (so E_i * inv_area is barycentric i)
+    uint32_t top_left; // Bit i is set if edge i is a top or left edge
+};
+
+/**
+ * Table of raster kernels.
+ */
+struct RasterKernels
+{
+    SimdLevel   level;
+    const char *name;
+
+    // Cover 8 pixels of a row with centers (x + i, y) for lanes i in the
+    // active bit mask. Lanes that are covered and pass the depth test
+    // (0 <= z <= 1 and z less than depth[i]) store z in depth[i]. Writes the
+    // barycentric coordinates of all lanes to b0, b1, b2 (8 floats each) and
+    // returns the bit mask of lanes that passed.
+    uint32_t (*raster_8)(const RasterEdges &edges,
+                         float              x,
+                         float              y,
+                         uint32_t           active,
+                         float             *depth,
+                         float             *b0,
+                         float             *b1,
+                         float             *b2);
+};
+
+// Kernels currently in use (do not access directly, use get_raster_kernels)
+extern const RasterKernels *g_raster_kernels;
+
+/**
+ * Get the raster kernels currently in use. The best kernels supported by the
+ * CPU are selected at startup.
+ * @return  Returns the current raster kernels.
+ */
+inline const RasterKernels &get_raster_kernels() { return *g_raster_kernels; }
+
+/**
+ * Get the raster kernels for an instruction set.
+ * @param  level  Instruction set.
+ * @return  Returns the kernels, or nullptr if there are no kernels for the
+ *          instruction set or it is not supported by this build or the CPU.
+ */
+const RasterKernels *get_raster_kernels(SimdLevel level);
+
+/**
+ * Select the raster kernels to use (for example to compare implementations).
+ * @param  level  Instruction set.
+ * @return  Returns true if the kernels are supported and now in use.
+ */
+bool set_raster_simd_level(SimdLevel level);
+
+} // namespace cg
+
+#endif
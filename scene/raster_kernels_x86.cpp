@@ -0,0 +1,84 @@
+#include "scene/raster_kernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CG_RASTER_X86 1
+#include <immintrin.h>
+#endif
+
+// AVX2 functions are compiled for AVX2 individually so the rest of the
+// library runs on any x86-64 CPU (see matrix_kernels_x86.cpp)
+#if defined(CG_RASTER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CG_TARGET_AVX2
+#endif
+
+namespace cg
+{
+
+#if defined(CG_RASTER_X86)
+
+namespace
+{
+
+// Separate multiplies and adds in the same order as the scalar kernel (no
+// FMA) so both kernels cover the same pixels.
+CG_TARGET_AVX2 uint32_t raster_8_avx2(const RasterEdges &edges,
+                                      float              x,
+                                      float              y,
+                                      uint32_t           active,
+                                      float             *depth,
+                                      float             *b0,
+                                      float             *b1,
+                                      float             *b2)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 px = _mm256_add_ps(_mm256_set1_ps(x), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+    const __m256 inv_area = _mm256_set1_ps(edges.inv_area);
+    float       *b_out[3] = {b0, b1, b2};
+
+    // Active lanes as a mask (lane i takes bit i)
+    const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256 inside = _mm256_castsi256_ps(
+        _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int32_t>(active)), bits), bits));
+
+    __m256 z = zero;
+    for(uint32_t k = 0; k < 3; k++)
+    {
+        __m256 e = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edges.a[k]), _mm256_sub_ps(px, _mm256_set1_ps(edges.x[k]))),
+                                 _mm256_set1_ps(edges.b[k] * (y - edges.y[k])));
+        inside = _mm256_and_ps(inside, (edges.top_left & (1u << k)) ? _mm256_cmp_ps(e, zero, _CMP_GE_OQ)
+                                                                    : _mm256_cmp_ps(e, zero, _CMP_GT_OQ));
+        __m256 b = _mm256_mul_ps(e, inv_area);
+        _mm256_storeu_ps(b_out[k], b);
+        __m256 bz = _mm256_mul_ps(b, _mm256_set1_ps(edges.z[k]));
+        z = (k == 0) ? bz : _mm256_add_ps(z, bz);
+    }
+
+    // Depth test (GL_LESS) within the depth range
+    __m256 old_depth = _mm256_loadu_ps(depth);
+    __m256 pass = _mm256_and_ps(inside, _mm256_cmp_ps(z, old_depth, _CMP_LT_OQ));
+    pass = _mm256_and_ps(pass, _mm256_cmp_ps(z, zero, _CMP_GE_OQ));
+    pass = _mm256_and_ps(pass, _mm256_cmp_ps(z, _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+    _mm256_storeu_ps(depth, _mm256_blendv_ps(old_depth, z, pass));
+    return static_cast<uint32_t>(_mm256_movemask_ps(pass));
+}
+
+const RasterKernels AVX2_RASTER_KERNELS = {SimdLevel::AVX2, "avx2", raster_8_avx2};
+
+} // namespace
+
+const RasterKernels *get_avx2_raster_kernels()
+{
+    // The matrix kernels check CPU and operating system support
+    static const bool supported = get_matrix_kernels(SimdLevel::AVX2) != nullptr;
+    return supported ? &AVX2_RASTER_KERNELS : nullptr;
+}
+
+#else
+
+const RasterKernels *get_avx2_raster_kernels() { return nullptr; }
+
+#endif
+
+} // namespace cg
@@ -0,0 +1,126 @@
+#include "scene/ray_tracer.hpp"
+
+#include "geometry/geometry.hpp"
+#include "geometry/parallel.hpp"
+#include "geometry/profiler.hpp"
+#include "scene/phong_lighting.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+namespace cg
+{
+
+RayTracer::RayTracer() : stats_{0, 0, 0, 0, 0.0}, bias_(0.0f) {}
+
+void RayTracer::set_settings(const RayTraceSettings &settings) { settings_ = settings; }
+
+const RayTraceSettings &RayTracer::get_settings() const { return settings_; }
+
+void RayTracer::build(SceneNode &root)
+{
+    CG_PROFILE_ZONE("RayTracer::build");
+    scene_.build(root);
+
+    // Build the triangle BVH of each surface now, since the render threads
+    // would otherwise build them lazily at the same time
+    for(const auto &instance : scene_.get_instances()) instance.surface->get_bvh();
+
+    // Shadow rays start a little way from the surface so they do not hit it
+    AABB bound = scene_.get_bvh().get_bound();
+    bias_ = bound.is_empty() ? 0.0f : settings_.shadow_bias * (bound.max_point - bound.min_point).norm();
+}
+
+void RayTracer::render(const CameraNode &camera, Image &image)
+{
+    CG_PROFILE_ZONE("RayTracer::render");
+    auto start = std::chrono::steady_clock::now();
+
+    const uint32_t width = settings_.width;
+    const uint32_t height = settings_.height;
+    const uint32_t tile_size = std::max(settings_.tile_size, 1u);
+    const uint32_t tiles_x = (width + tile_size - 1) / tile_size;
+    const uint32_t tiles_y = (height + tile_size - 1) / tile_size;
+    image.resize(width, height);
+
+    // Rays through pixel centers. The direction has unit length along the
+    // view direction, so distances along a ray are depths, and rays start at
+    // the near plane and end at the far plane like the projection clips.
+    const Point3  eye = camera.get_position();
+    const Vector3 forward = camera.get_view_plane_normal() * -1.0f;
+    const float   tan_y = std::tan(degrees_to_radians(camera.get_field_of_view()) * 0.5f);
+    const Vector3 right = camera.get_view_right() * (tan_y * camera.get_aspect_ratio());
+    const Vector3 up = camera.get_view_up() * tan_y;
+    const float   near_clip = camera.get_near_clip();
+    const float   depth_range = camera.get_far_clip() - near_clip;
+
+    std::atomic<uint64_t> shadow_rays(0);
+    stats_.threads = parallel_for_stealing(
+        static_cast<size_t>(tiles_x) * tiles_y,
+        settings_.max_threads,
+        [&](size_t tile, uint32_t)
+        {
+            uint32_t x0 = static_cast<uint32_t>(tile % tiles_x) * tile_size;
+            uint32_t y0 = static_cast<uint32_t>(tile / tiles_x) * tile_size;
+            uint32_t x1 = std::min(x0 + tile_size, width);
+            uint32_t y1 = std::min(y0 + tile_size, height);
+            uint64_t tile_shadow_rays = 0;
+            for(uint32_t y = y0; y < y1; y++)
+            {
+                float sy = 1.0f - 2.0f * (static_cast<float>(y) + 0.5f) / static_cast<float>(height);
+                for(uint32_t x = x0; x < x1; x++)
+                {
+                    float   sx = 2.0f * (static_cast<float>(x) + 0.5f) / static_cast<float>(width) - 1.0f;
+                    Vector3 d = forward + right * sx + up * sy;
+                    Ray3    ray(eye + d * near_clip, d);
+                    image.set_pixel(x, y, trace(ray, depth_range, eye, tile_shadow_rays));
+                }
+            }
+            shadow_rays += tile_shadow_rays;
+        });
+
+    stats_.primary_rays = static_cast<uint64_t>(width) * height;
+    stats_.shadow_rays = shadow_rays.load();
+    stats_.tiles = tiles_x * tiles_y;
+    stats_.render_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+Color4 RayTracer::trace(const Ray3 &ray, float t_max, const Point3 &eye, uint64_t &shadow_rays) const
+{
+    ScenePickResult hit = scene_.intersect(ray, t_max);
+    if(!hit.intersects) return settings_.background;
+
+    const SceneInstance &instance = scene_.get_instances()[hit.instance];
+    Point3               p = ray.intersect(hit.distance);
+    Vector3              n = instance.normal_matrix *
+                instance.surface->get_interpolated_normal(hit.face_index, hit.barycentric_u, hit.barycentric_v);
+    n.normalize();
+
+    // Diffuse and specular only where the light is not blocked
+    return shade_phong(instance.material,
+                       scene_.get_lights(),
+                       settings_.global_ambient,
+                       p,
+                       n,
+                       eye,
+                       [&](const Vector3 &l, float distance)
+                       {
+                           if(!settings_.shadows) return true;
+                           shadow_rays++;
+                           return distance - bias_ > 0.0f && !is_blocked(Ray3(p + l * bias_, l), distance - bias_);
+                       });
+}
+
+const RayTraceStats &RayTracer::get_stats() const { return stats_; }
+
+const SceneBVH &RayTracer::get_scene() const { return scene_; }
+
+bool RayTracer::is_blocked(const Ray3 &ray, float t_max) const
+{
+    return scene_.intersect(ray, t_max).intersects;
+}
+
+} // namespace cg
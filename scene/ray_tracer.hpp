@@ -0,0 +1,139 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    ray_tracer.hpp
+//	Purpose: Multithreaded CPU ray caster for a scene graph. Uses the
+//           materials, lights and camera of the graph and the lighting model
+//           of the Phong shaders, with shadows. Needs no OpenGL context.
+//
+//============================================================================
+
+#ifndef __SCENE_RAY_TRACER_HPP__
+#define __SCENE_RAY_TRACER_HPP__
+
+#include "scene/camera_node.hpp"
+#include "scene/color4.hpp"
+#include "scene/image.hpp"
+#include "scene/scene_bvh.hpp"
+
+#include <cstdint>
+
+namespace cg
+{
+
+/**
+ * Ray tracer settings.
+ */
+struct RayTraceSettings
+{
+    uint32_t width = 800;         // Image width (pixels)
+    uint32_t height = 600;        // Image height (pixels)
+    uint32_t tile_size = 16;      // Tile width and height (pixels)
+    uint32_t max_threads = 0;     // Maximum threads (0 for all hardware threads)
+    bool     shadows = true;      // Cast shadow rays towards each light
+    float    shadow_bias = 1.0e-4f; // Shadow ray offset (fraction of the scene size)
+    Color4   global_ambient = Color4(0.2f, 0.2f, 0.2f, 1.0f); // Global ambient light
+    Color4   background = Color4(0.0f, 0.0f, 0.0f, 1.0f);     // Color where rays miss
+};
+
+/**
+ * Counts from the last render.
+ */
+struct RayTraceStats
+{
+    uint64_t primary_rays; // Rays from the camera
+    uint64_t shadow_rays;  // Rays towards lights
+    uint32_t tiles;        // Tiles rendered
+    uint32_t threads;      // Threads used
+    double   render_ms;    // Time to render the image (milliseconds)
+};
+
+/**
+ * Ray caster for a scene graph. build() takes a snapshot of the geometry
+ * instances (with their modeling matrices and materials) and lights of the
+ * graph; render() casts one ray per pixel through the view of a camera node.
+ * Shading matches the Phong fragment shader (Module9/vertex_lighting.frag):
+ * emission, global ambient, and per light ambient, diffuse and Blinn-Phong
+ * specular terms with the spotlight cone and falloff, except that the
+ * diffuse and specular terms of a light are dropped where it is blocked.
+ *
+ * The image is split into tiles that threads take with work stealing, so
+ * render time scales with the number of cores.
+ */
+class RayTracer
+{
+  public:
+    /**
+     * Constructor.
+     */
+    RayTracer();
+
+    /**
+     * Set the settings.
+     * @param  settings  Image size, threading, shadows and global lighting.
+     */
+    void set_settings(const RayTraceSettings &settings);
+
+    /**
+     * Get the settings.
+     * @return  Returns the settings.
+     */
+    const RayTraceSettings &get_settings() const;
+
+    /**
+     * Gather the geometry and lights of a scene graph and build the scene
+     * hierarchy. Call again after the graph changes.
+     * @param  root  Root of the scene graph.
+     */
+    void build(SceneNode &root);
+
+    /**
+     * Render the scene from a camera.
+     * @param  camera  Camera (position, view axes and perspective projection).
+     * @param  image   Image, resized to the settings width and height.
+     */
+    void render(const CameraNode &camera, Image &image);
+
+    /**
+     * Find the color seen along a ray.
+     * @param  ray          Ray in world coordinates.
+     * @param  t_max        Maximum distance along the ray.
+     * @param  eye          Viewer position (for specular highlights).
+     * @param  shadow_rays  Incremented by the number of shadow rays cast.
+     * @return  Returns the color, or the background color if nothing is hit.
+     */
+    Color4 trace(const Ray3 &ray, float t_max, const Point3 &eye, uint64_t &shadow_rays) const;
+
+    /**
+     * Get the counts from the last render.
+     * @return  Returns the render statistics.
+     */
+    const RayTraceStats &get_stats() const;
+
+    /**
+     * Get the scene hierarchy.
+     * @return  Returns the scene BVH.
+     */
+    const SceneBVH &get_scene() const;
+
+  protected:
+    RayTraceSettings settings_;
+    RayTraceStats    stats_;
+    SceneBVH         scene_;
+    float            bias_; // Shadow ray offset (world units)
+
+    /**
+     * Check whether anything blocks a ray before a distance.
+     * @param  ray    Shadow ray.
+     * @param  t_max  Distance to the light.
+     * @return  Returns true if the light is blocked.
+     */
+    bool is_blocked(const Ray3 &ray, float t_max) const;
+};
+
+} // namespace cg
+
+#endif
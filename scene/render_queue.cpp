@@ -0,0 +1,422 @@
+#include "scene/render_queue.hpp"
+
+#include "geometry/profiler.hpp"
+#include "scene/scene_node.hpp"
+#include "scene/tri_surface.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+namespace cg
+{
+
+GLuint create_instanced_vertex_array(const DrawGeometry &geometry,
+                                     int32_t             position_loc,
+                                     int32_t             normal_loc,
+                                     GLuint              instance_buffer,
+                                     size_t              instance_offset,
+                                     int32_t             instance_model_loc,
+                                     int32_t             instance_normal_loc)
+{
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    // Per vertex attributes from the geometry's vertex buffer
+    glBindBuffer(GL_ARRAY_BUFFER, geometry.vbo);
+    TriSurface::set_vertex_attributes(geometry.vertex_format, geometry.vertex_offset, position_loc, normal_loc);
+
+    // Per instance matrices: a mat4 attribute uses 4 consecutive locations (one per column)
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    for(int32_t col = 0; col < 4; col++)
+    {
+        size_t model_offset = instance_offset + offsetof(InstanceMatrices, model_matrix) + col * 4 * sizeof(float);
+        size_t normal_offset = instance_offset + offsetof(InstanceMatrices, normal_matrix) + col * 4 * sizeof(float);
+        glVertexAttribPointer(
+            instance_model_loc + col, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceMatrices), (void *)model_offset);
+        glVertexAttribPointer(
+            instance_normal_loc + col, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceMatrices), (void *)normal_offset);
+        glVertexAttribDivisor(instance_model_loc + col, 1);
+        glVertexAttribDivisor(instance_normal_loc + col, 1);
+        glEnableVertexAttribArray(instance_model_loc + col);
+        glEnableVertexAttribArray(instance_normal_loc + col);
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry.ibo);
+    glBindVertexArray(0);
+    return vao;
+}
+
+RenderQueue::RenderQueue() :
+    compiled_(false),
+    instancing_(true),
+    graph_version_(0),
+    current_material_(INVALID_INDEX),
+    merged_count_(0),
+    instance_buffer_(0)
+{
+}
+
+RenderQueue::~RenderQueue() { delete_instances(); }
+
+void RenderQueue::draw(SceneNode &root, SceneState &scene_state)
+{
+    CG_PROFILE_ZONE("RenderQueue::draw");
+    if(is_stale()) compile(root, scene_state);
+
+    // Apply per-frame state (program, camera, lights) in traversal order
+    for(auto node : state_nodes_) { node->apply_state(scene_state); }
+    scene_state.flush_frame_block();
+
+    // Issue the draw records. Only rebind the program and material when they change.
+    uint32_t              program = INVALID_INDEX;
+    uint32_t              material = INVALID_INDEX;
+    const ProgramBinding *binding = nullptr;
+    cull_stack_.clear();
+    uint32_t next_range = 0;
+    uint32_t count = static_cast<uint32_t>(records_.size());
+    for(uint32_t i = 0; i < count; i++)
+    {
+        // Skip ranges and then the record if outside the view frustum
+        if(scene_state.frustum_culling)
+        {
+            uint32_t plane_mask = cull_ranges(i, next_range, scene_state);
+            if(i >= count) break;
+            if(plane_mask != 0)
+            {
+                scene_state.culling_counters.nodes_tested++;
+                if(scene_state.frustum.test(records_[i].world_bound, plane_mask) == FrustumTest::OUTSIDE)
+                {
+                    scene_state.culling_counters.nodes_culled++;
+                    continue;
+                }
+            }
+        }
+
+        DrawRecord &r = records_[i];
+        if(r.program != program)
+        {
+            program = r.program;
+            binding = &programs_[program];
+            scene_state.gl_state.use_program(binding->program);
+            material = INVALID_INDEX;
+        }
+
+        if(r.material != material && r.material != INVALID_INDEX)
+        {
+            material = r.material;
+            if(binding->material_block)
+            {
+                materials_.bind(material);
+            }
+            else
+            {
+                const MaterialBlock &m = materials_.get(material);
+                scene_state.gl_state.uniform4fv(binding->material_ambient_loc, &m.ambient.r);
+                scene_state.gl_state.uniform4fv(binding->material_diffuse_loc, &m.diffuse.r);
+                scene_state.gl_state.uniform4fv(binding->material_specular_loc, &m.specular.r);
+                scene_state.gl_state.uniform4fv(binding->material_emission_loc, &m.emission.r);
+                scene_state.gl_state.uniform1f(binding->material_shininess_loc, m.shininess);
+            }
+        }
+
+        // The composite PVM matrix depends on the camera - only form it when the camera changes
+        if(r.pv_version != scene_state.pv_version)
+        {
+            r.pvm_matrix = scene_state.pv * r.model_matrix;
+            r.pv_version = scene_state.pv_version;
+            scene_state.transform_counters.pvm_updates++;
+        }
+        scene_state.gl_state.uniform_matrix4fv(binding->model_matrix_loc, r.model_matrix.get());
+        scene_state.gl_state.uniform_matrix4fv(binding->normal_matrix_loc, r.normal_matrix.get());
+        scene_state.gl_state.uniform_matrix4fv(binding->pvm_matrix_loc, r.pvm_matrix.get());
+
+        // Vertex format and position dequantization (if the shader supports packed vertices)
+        const DrawGeometry &g = r.geometry;
+        if(binding->vertex_format_loc >= 0)
+        {
+            scene_state.gl_state.uniform1i(binding->vertex_format_loc, static_cast<GLint>(g.vertex_format));
+            scene_state.gl_state.uniform3fv(binding->position_scale_loc, &g.quantization.scale.x);
+            scene_state.gl_state.uniform3fv(binding->position_offset_loc, &g.quantization.offset.x);
+        }
+
+        scene_state.gl_state.bind_vertex_array(g.vao);
+        if(g.instance_count > 0)
+        {
+            scene_state.gl_state.uniform1i(binding->instanced_loc, 1);
+            glDrawElementsInstanced(
+                GL_TRIANGLES, g.index_count, g.index_type, (void *)g.index_offset, g.instance_count);
+            scene_state.gl_state.uniform1i(binding->instanced_loc, 0);
+        }
+        else
+        {
+            glDrawElements(GL_TRIANGLES, g.index_count, g.index_type, (void *)g.index_offset);
+        }
+    }
+    scene_state.gl_state.bind_vertex_array(0);
+}
+
+void RenderQueue::compile(SceneNode &root, SceneState &scene_state)
+{
+    CG_PROFILE_ZONE("RenderQueue::compile");
+    records_.clear();
+    ranges_.clear();
+    programs_.clear();
+    materials_.clear();
+    state_nodes_.clear();
+    current_material_ = INVALID_INDEX;
+    delete_instances();
+
+    scene_state.init();
+    root.compile(*this, scene_state);
+    if(instancing_) merge_instances();
+    bound_ranges();
+    materials_.upload();
+
+    // Merging created vertex arrays (names of deleted ones may be reused)
+    scene_state.gl_state.invalidate();
+
+    graph_version_ = SceneNode::graph_version();
+    compiled_ = true;
+}
+
+bool RenderQueue::is_stale() const
+{
+    return !compiled_ || graph_version_ != SceneNode::graph_version();
+}
+
+void RenderQueue::invalidate() { compiled_ = false; }
+
+void RenderQueue::release()
+{
+    records_.clear();
+    ranges_.clear();
+    programs_.clear();
+    state_nodes_.clear();
+    current_material_ = INVALID_INDEX;
+    delete_instances();
+    materials_.release();
+    compiled_ = false;
+}
+
+void RenderQueue::add_state_node(SceneNode *node) { state_nodes_.push_back(node); }
+
+void RenderQueue::set_material(const MaterialBlock &material)
+{
+    current_material_ = materials_.add(material);
+}
+
+MaterialBlock RenderQueue::get_material() const
+{
+    if(current_material_ != INVALID_INDEX) return materials_.get(current_material_);
+    return MaterialBlock{Color4(), Color4(), Color4(), Color4(), 1.0f};
+}
+
+void RenderQueue::add_draw(const DrawGeometry &geometry, const SceneState &scene_state)
+{
+    DrawRecord record;
+    record.program = get_program_index(scene_state);
+    record.material = current_material_;
+    record.model_matrix = scene_state.model_matrix;
+    record.normal_matrix = scene_state.normal_matrix;
+    record.pv_version = ~0ull;
+    record.geometry = geometry;
+    record.world_bound = geometry.bound.transform(scene_state.model_matrix);
+    records_.push_back(record);
+}
+
+uint32_t RenderQueue::begin_range()
+{
+    uint32_t first = static_cast<uint32_t>(records_.size());
+    ranges_.push_back(DrawRange{first, first, AABB()});
+    return static_cast<uint32_t>(ranges_.size() - 1);
+}
+
+void RenderQueue::end_range(uint32_t range) { ranges_[range].end = static_cast<uint32_t>(records_.size()); }
+
+const std::vector<DrawRecord> &RenderQueue::get_records() const { return records_; }
+
+void RenderQueue::set_instancing(bool enable)
+{
+    instancing_ = enable;
+    compiled_ = false;
+}
+
+bool RenderQueue::get_instancing() const { return instancing_; }
+
+uint32_t RenderQueue::get_merged_count() const { return merged_count_; }
+
+uint32_t RenderQueue::get_program_index(const SceneState &scene_state)
+{
+    // Few programs are expected - a linear search is fine (most recent first)
+    for(size_t i = programs_.size(); i > 0; i--)
+    {
+        if(programs_[i - 1].program == scene_state.program) return static_cast<uint32_t>(i - 1);
+    }
+
+    ProgramBinding binding;
+    binding.program = scene_state.program;
+    binding.pvm_matrix_loc = scene_state.pvm_matrix_loc;
+    binding.model_matrix_loc = scene_state.model_matrix_loc;
+    binding.normal_matrix_loc = scene_state.normal_matrix_loc;
+    binding.material_ambient_loc = scene_state.material_ambient_loc;
+    binding.material_diffuse_loc = scene_state.material_diffuse_loc;
+    binding.material_specular_loc = scene_state.material_specular_loc;
+    binding.material_emission_loc = scene_state.material_emission_loc;
+    binding.material_shininess_loc = scene_state.material_shininess_loc;
+    binding.vertex_format_loc = scene_state.vertex_format_loc;
+    binding.position_scale_loc = scene_state.position_scale_loc;
+    binding.position_offset_loc = scene_state.position_offset_loc;
+    binding.position_loc = scene_state.position_loc;
+    binding.normal_loc = scene_state.normal_loc;
+    binding.instanced_loc = scene_state.instanced_loc;
+    binding.instance_model_loc = scene_state.instance_model_loc;
+    binding.instance_normal_loc = scene_state.instance_normal_loc;
+    binding.material_block = scene_state.material_stream != nullptr;
+    programs_.push_back(binding);
+    return static_cast<uint32_t>(programs_.size() - 1);
+}
+
+void RenderQueue::merge_instances()
+{
+    // Group the records that are not already instanced by program, material
+    // and geometry. Only programs with instance attributes can be merged.
+    using GroupKey = std::tuple<uint32_t, uint32_t, GLuint, size_t>;
+    std::map<GroupKey, std::vector<uint32_t>> groups;
+    for(uint32_t i = 0; i < records_.size(); i++)
+    {
+        const DrawRecord     &r = records_[i];
+        const ProgramBinding &binding = programs_[r.program];
+        if(r.geometry.instance_count > 0 || binding.instanced_loc < 0 ||
+           binding.instance_model_loc < 0 || binding.instance_normal_loc < 0)
+        {
+            continue;
+        }
+        groups[GroupKey(r.program, r.material, r.geometry.vao, r.geometry.index_offset)].push_back(i);
+    }
+
+    // Gather the instance matrices of each group drawn more than once
+    constexpr uint32_t            NOT_MERGED = INVALID_INDEX;
+    std::vector<uint32_t>         first_instance(records_.size(), NOT_MERGED);
+    std::vector<uint32_t>         instance_count(records_.size(), 0);
+    std::vector<InstanceMatrices> instances;
+    for(const auto &group : groups)
+    {
+        const std::vector<uint32_t> &members = group.second;
+        if(members.size() < 2) continue;
+
+        uint32_t first = static_cast<uint32_t>(instances.size());
+        for(uint32_t i : members)
+        {
+            InstanceMatrices m;
+            memcpy(m.model_matrix, records_[i].model_matrix.get(), sizeof(m.model_matrix));
+            memcpy(m.normal_matrix, records_[i].normal_matrix.get(), sizeof(m.normal_matrix));
+            instances.push_back(m);
+            first_instance[i] = first;
+            if(i != members.front()) records_[members.front()].world_bound.merge(records_[i].world_bound);
+        }
+        instance_count[members.front()] = static_cast<uint32_t>(members.size());
+    }
+    if(instances.empty()) return;
+
+    glGenBuffers(1, &instance_buffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+    glBufferData(
+        GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceMatrices), instances.data(), GL_STATIC_DRAW);
+
+    // Replace each group with one instanced record at the position of its
+    // first record. The instance matrices hold the full modeling transforms.
+    std::vector<DrawRecord> merged;
+    std::vector<uint32_t>   merged_index(records_.size() + 1);
+    merged.reserve(records_.size());
+    for(uint32_t i = 0; i < records_.size(); i++)
+    {
+        merged_index[i] = static_cast<uint32_t>(merged.size());
+        if(first_instance[i] == NOT_MERGED)
+        {
+            merged.push_back(records_[i]);
+            continue;
+        }
+        if(instance_count[i] == 0)
+        {
+            merged_count_++;
+            continue;
+        }
+
+        DrawRecord            record = records_[i];
+        const ProgramBinding &binding = programs_[record.program];
+        record.model_matrix.set_identity();
+        record.normal_matrix.set_identity();
+        record.pv_version = ~0ull;
+        record.geometry.vao = create_instanced_vertex_array(record.geometry,
+                                                            binding.position_loc,
+                                                            binding.normal_loc,
+                                                            instance_buffer_,
+                                                            first_instance[i] * sizeof(InstanceMatrices),
+                                                            binding.instance_model_loc,
+                                                            binding.instance_normal_loc);
+        record.geometry.instance_count = static_cast<GLsizei>(instance_count[i]);
+        instance_vaos_.push_back(record.geometry.vao);
+        merged.push_back(record);
+        merged_count_++;
+    }
+    merged_index[records_.size()] = static_cast<uint32_t>(merged.size());
+    records_.swap(merged);
+
+    // An instanced record stays in the ranges of its first record (its bound
+    // holds all instances, so culling remains conservative)
+    for(DrawRange &range : ranges_)
+    {
+        range.begin = merged_index[range.begin];
+        range.end = merged_index[range.end];
+    }
+}
+
+void RenderQueue::bound_ranges()
+{
+    std::vector<DrawRange> bounded;
+    bounded.reserve(ranges_.size());
+    for(DrawRange &range : ranges_)
+    {
+        if(range.end - range.begin < 2) continue;
+        for(uint32_t i = range.begin; i < range.end; i++) range.world_bound.merge(records_[i].world_bound);
+        bounded.push_back(range);
+    }
+    ranges_.swap(bounded);
+}
+
+uint32_t RenderQueue::cull_ranges(uint32_t &index, uint32_t &next_range, SceneState &scene_state)
+{
+    while(true)
+    {
+        while(!cull_stack_.empty() && cull_stack_.back().end <= index) cull_stack_.pop_back();
+        uint32_t plane_mask = cull_stack_.empty() ? Frustum::ALL_PLANES : cull_stack_.back().plane_mask;
+        if(next_range >= ranges_.size() || ranges_[next_range].begin != index) return plane_mask;
+
+        // Ranges starting at the same record are nested (outermost first)
+        const DrawRange &range = ranges_[next_range++];
+        if(plane_mask == 0) continue;
+        scene_state.culling_counters.nodes_tested++;
+        if(scene_state.frustum.test(range.world_bound, plane_mask) == FrustumTest::OUTSIDE)
+        {
+            // Skip the records of the range and the ranges nested in it
+            scene_state.culling_counters.nodes_culled++;
+            index = range.end;
+            while(next_range < ranges_.size() && ranges_[next_range].begin < index) next_range++;
+        }
+        else cull_stack_.push_back(CullScope{range.end, plane_mask});
+    }
+}
+
+void RenderQueue::delete_instances()
+{
+    for(GLuint vao : instance_vaos_) { glDeleteVertexArrays(1, &vao); }
+    instance_vaos_.clear();
+    if(instance_buffer_ != 0) glDeleteBuffers(1, &instance_buffer_);
+    instance_buffer_ = 0;
+    merged_count_ = 0;
+}
+
+} // namespace cg
@@ -0,0 +1,312 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:	 David W. Nesbitt
+//	File:    render_queue.hpp
+//	Purpose: Flattened render queue compiled from the scene graph.
+//
+//============================================================================
+
+#ifndef __SCENE_RENDER_QUEUE_HPP__
+#define __SCENE_RENDER_QUEUE_HPP__
+
+#include "geometry/aabb.hpp"
+#include "geometry/matrix.hpp"
+#include "geometry/vertex_packing.hpp"
+#include "scene/color4.hpp"
+#include "scene/graphics.hpp"
+#include "scene/scene_state.hpp"
+#include "scene/uniform_buffer.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+class SceneNode;
+
+/**
+ * Uniform locations of a shader program, captured from the scene state when
+ * the queue is compiled.
+ */
+struct ProgramBinding
+{
+    GLuint program;
+    GLint  pvm_matrix_loc;
+    GLint  model_matrix_loc;
+    GLint  normal_matrix_loc;
+    GLint  material_ambient_loc;
+    GLint  material_diffuse_loc;
+    GLint  material_specular_loc;
+    GLint  material_emission_loc;
+    GLint  material_shininess_loc;
+    GLint  vertex_format_loc;
+    GLint  position_scale_loc;
+    GLint  position_offset_loc;
+    GLint  position_loc;
+    GLint  normal_loc;
+    GLint  instanced_loc;
+    GLint  instance_model_loc;
+    GLint  instance_normal_loc;
+    bool   material_block; // Materials are read from the material uniform block
+};
+
+/**
+ * Vertex array, index range and vertex format of a single draw call.
+ */
+struct DrawGeometry
+{
+    GLuint             vao;            // Vertex array object
+    GLuint             vbo;            // Vertex buffer
+    GLuint             ibo;            // Element (index) buffer
+    GLsizei            index_count;    // Number of indexes to draw
+    GLenum             index_type;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    size_t             index_offset;   // Byte offset of the first index in the element buffer
+    size_t             vertex_offset;  // Byte offset of the first vertex in the vertex buffer
+    GLsizei            instance_count; // Number of instances (0 if not instanced)
+    VertexFormat       vertex_format;  // Vertex buffer layout
+    VertexQuantization quantization;   // Position dequantization (packed format)
+    AABB               bound;          // Bounding box (modeling coordinates)
+};
+
+/**
+ * Per instance attributes of an instanced draw: the modeling matrix and the
+ * normal matrix of each instance (column order). The vertex shader applies
+ * these before the model, normal and PVM matrix uniforms.
+ */
+struct InstanceMatrices
+{
+    float model_matrix[16];
+    float normal_matrix[16];
+};
+
+/**
+ * Create a vertex array object that draws geometry with per instance
+ * matrices read from an instance buffer (attribute divisor 1).
+ * @param  geometry             Geometry to draw (vertex and element buffers).
+ * @param  position_loc         Vertex position attribute location.
+ * @param  normal_loc           Vertex normal attribute location.
+ * @param  instance_buffer      Buffer of InstanceMatrices.
+ * @param  instance_offset      Byte offset of the first instance in the instance buffer.
+ * @param  instance_model_loc   First of 4 instance model matrix attribute locations.
+ * @param  instance_normal_loc  First of 4 instance normal matrix attribute locations.
+ * @return  Returns the vertex array object.
+ */
+GLuint create_instanced_vertex_array(const DrawGeometry &geometry,
+                                     int32_t             position_loc,
+                                     int32_t             normal_loc,
+                                     GLuint              instance_buffer,
+                                     size_t              instance_offset,
+                                     int32_t             instance_model_loc,
+                                     int32_t             instance_normal_loc);
+
+/**
+ * A single draw: everything needed to draw one geometry node instance
+ * without traversing the scene graph.
+ */
+struct DrawRecord
+{
+    uint32_t     program;       // Index into the program bindings
+    uint32_t     material;      // Index into the material blocks (INVALID_INDEX if none)
+    Matrix4x4    model_matrix;  // Composite modeling matrix
+    Matrix4x4    normal_matrix; // Normal matrix (transpose of inverse of the model matrix)
+    Matrix4x4    pvm_matrix;    // Cached composite projection, view, modeling matrix
+    uint64_t     pv_version;    // Version of the PV matrix used to form pvm_matrix
+    DrawGeometry geometry;      // Vertex array, index range and vertex format to draw
+    AABB         world_bound;   // Bounding box in world coordinates (for view frustum culling)
+};
+
+/**
+ * Draw records compiled from a transform subtree (records begin to end - 1)
+ * and the bound of those records. Ranges nest in traversal order like the
+ * subtrees.
+ */
+struct DrawRange
+{
+    uint32_t begin;       // First draw record
+    uint32_t end;         // One past the last draw record
+    AABB     world_bound; // Bounding box of the records in world coordinates
+};
+
+/**
+ * Render queue. The scene graph is compiled into a contiguous array of draw
+ * records which is rebuilt only when the graph changes (topology, transforms,
+ * materials). Nodes that own per-frame state (shaders, camera, lights) are
+ * registered as state nodes and have their state applied each frame before
+ * the draw records are issued.
+ *
+ * Draw records that use the same program, material and geometry (for example
+ * a GeometryNode shared by several TransformNodes) are merged into a single
+ * instanced draw when the program supports instancing.
+ *
+ * Each transform subtree is compiled into a range of draw records. When
+ * culling, a range outside the view frustum is skipped whole, and planes a
+ * range is entirely inside are not tested for the ranges and records within
+ * it (hierarchical culling, as in scene graph traversal).
+ *
+ * Limitations: a queue supports a single camera, and geometry nodes other
+ * than TriSurface derived classes are not compiled.
+ */
+class RenderQueue
+{
+  public:
+    static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+    /**
+     * Constructor.
+     */
+    RenderQueue();
+
+    /**
+     * Destructor. Deletes the instance buffer and instanced vertex arrays.
+     */
+    ~RenderQueue();
+
+    /**
+     * Draw the scene using the compiled queue. Compiles the queue first if the
+     * scene graph has changed since the last compile.
+     * @param  root         Root of the scene graph.
+     * @param  scene_state  Current scene state.
+     */
+    void draw(SceneNode &root, SceneState &scene_state);
+
+    /**
+     * Compile the scene graph into the queue.
+     * @param  root         Root of the scene graph.
+     * @param  scene_state  Current scene state.
+     */
+    void compile(SceneNode &root, SceneState &scene_state);
+
+    /**
+     * Check whether the queue must be recompiled.
+     * @return  Returns true if the queue is out of date with the scene graph.
+     */
+    bool is_stale() const;
+
+    /**
+     * Force a recompile on the next draw.
+     */
+    void invalidate();
+
+    /**
+     * Remove the compiled queue and delete its OpenGL objects (before the
+     * OpenGL context is destroyed). The next draw compiles the queue again.
+     */
+    void release();
+
+    /**
+     * Register a node whose state must be applied every frame. State nodes
+     * are applied in traversal order.
+     * @param  node  Scene node.
+     */
+    void add_state_node(SceneNode *node);
+
+    /**
+     * Set the current material. Subsequent draw records use this material.
+     * @param  material  Material block.
+     */
+    void set_material(const MaterialBlock &material);
+
+    /**
+     * Get the current material.
+     * @return  Returns the current material (default material if none set).
+     */
+    MaterialBlock get_material() const;
+
+    /**
+     * Add a draw record using the current program, material and modeling
+     * matrix in the scene state.
+     * @param  geometry     Vertex array and index range to draw.
+     * @param  scene_state  Current scene state.
+     */
+    void add_draw(const DrawGeometry &geometry, const SceneState &scene_state);
+
+    /**
+     * Start a range of draw records: the records added until end_range is
+     * called (a transform subtree).
+     * @return  Returns the range (pass to end_range).
+     */
+    uint32_t begin_range();
+
+    /**
+     * End a range of draw records started by begin_range.
+     * @param  range  Range returned by begin_range.
+     */
+    void end_range(uint32_t range);
+
+    /**
+     * Get the compiled draw records.
+     * @return  Returns the draw records.
+     */
+    const std::vector<DrawRecord> &get_records() const;
+
+    /**
+     * Enable or disable merging draw records of shared geometry into instanced
+     * draws (enabled by default). Takes effect on the next compile.
+     * @param  enable  Merge shared geometry if true.
+     */
+    void set_instancing(bool enable);
+
+    /**
+     * Check whether shared geometry is merged into instanced draws.
+     * @return  Returns true if instancing is enabled.
+     */
+    bool get_instancing() const;
+
+    /**
+     * Get the number of draw records merged into instanced draws by the last
+     * compile.
+     * @return  Returns the number of merged draw records.
+     */
+    uint32_t get_merged_count() const;
+
+  protected:
+    bool     compiled_;
+    bool     instancing_;
+    uint32_t graph_version_;
+    uint32_t current_material_;
+    uint32_t merged_count_;
+
+    // Instance matrices and vertex arrays of the merged (instanced) draw records
+    GLuint              instance_buffer_;
+    std::vector<GLuint> instance_vaos_;
+
+    std::vector<DrawRecord>     records_;
+    std::vector<DrawRange>      ranges_;
+    std::vector<ProgramBinding> programs_;
+    MaterialBuffer              materials_;
+    std::vector<SceneNode *>    state_nodes_;
+
+    // Frustum planes still to test in each enclosing range (while drawing)
+    struct CullScope
+    {
+        uint32_t end;
+        uint32_t plane_mask;
+    };
+    std::vector<CullScope> cull_stack_;
+
+    // Find (or add) the program binding for the current program in the scene state
+    uint32_t get_program_index(const SceneState &scene_state);
+
+    // Merge draw records with the same program, material and geometry into instanced draws
+    void merge_instances();
+
+    // Form the bounds of the ranges. Ranges of less than 2 records are
+    // removed (testing the record is as cheap).
+    void bound_ranges();
+
+    // Test the ranges that start at record index (from next_range on) and
+    // skip those outside the view frustum: index is advanced past them.
+    // Returns the planes still to test for the record at index.
+    uint32_t cull_ranges(uint32_t &index, uint32_t &next_range, SceneState &scene_state);
+
+    // Delete the instance buffer and instanced vertex arrays
+    void delete_instances();
+};
+
+} // namespace cg
+
+#endif
@@ -16,14 +16,28 @@
 // clang-format off
 #include "scene/color3.hpp"
 #include "scene/color4.hpp"
+#include "scene/matrix_stack.hpp"
+#include "scene/gl_state_cache.hpp"
 #include "scene/scene_state.hpp"
 #include "scene/scene_node.hpp"
+#include "scene/render_queue.hpp"
+#include "scene/uniform_buffer.hpp"
+#include "scene/scene_store.hpp"
 #include "scene/transform_node.hpp"
 #include "scene/presentation_node.hpp"
 #include "scene/color_node.hpp"
 #include "scene/geometry_node.hpp"
+#include "scene/instanced_geometry_node.hpp"
 #include "scene/shader_node.hpp"
 #include "scene/camera_node.hpp"
+#include "scene/camera_path.hpp"
+#include "scene/frame_stats.hpp"
+#include "scene/frame_pacer.hpp"
+#include "scene/snapshot_buffer.hpp"
+#include "scene/scene_bvh.hpp"
+#include "scene/image.hpp"
+#include "scene/ray_tracer.hpp"
+#include "scene/software_rasterizer.hpp"
 // clang-format on
 
 // Model nodes
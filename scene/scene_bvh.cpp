@@ -0,0 +1,93 @@
+#include "scene/scene_bvh.hpp"
+
+namespace cg
+{
+
+SceneInstance::SceneInstance(TriSurface *s, const Matrix4x4 &m, const MaterialBlock &mat) :
+    surface(s),
+    model_matrix(m),
+    inverse_matrix(m.get_inverse()),
+    normal_matrix(m.get_normal_matrix()),
+    world_bound(s->get_bound().transform(m)),
+    material(mat)
+{
+}
+
+SceneGather::SceneGather() : material{Color4(), Color4(), Color4(), Color4(), 1.0f} {}
+
+SceneBVH::SceneBVH() {}
+
+void SceneBVH::build(SceneNode &root, bool allow_threads)
+{
+    gather(root);
+    bvh_.build(bounds_, allow_threads);
+}
+
+bool SceneBVH::refit(SceneNode &root)
+{
+    size_t count = instances_.size();
+    gather(root);
+    if(instances_.size() == count && bvh_.refit(bounds_)) return true;
+
+    bvh_.build(bounds_);
+    return false;
+}
+
+ScenePickResult SceneBVH::intersect(const Ray3 &ray, float t_max) const
+{
+    ScenePickResult result = {false, 0.0f, 0, 0, 0.0f, 0.0f};
+    bvh_.intersect(ray,
+                   t_max,
+                   [&](uint32_t i, float &t)
+                   {
+                       // The modeling coordinate ray is not normalized so
+                       // distances along it match distances along the world ray
+                       const SceneInstance   &instance = instances_[i];
+                       RayMeshIntersectResult hit = instance.surface->intersect(instance.inverse_matrix * ray, t);
+                       if(!hit.intersects) return false;
+                       t = hit.distance;
+                       result = {true, hit.distance, i, hit.face_index, hit.barycentric_u, hit.barycentric_v};
+                       return true;
+                   });
+    return result;
+}
+
+void SceneBVH::query(const Frustum &frustum, std::vector<uint32_t> &instances) const
+{
+    instances.clear();
+    bvh_.query(frustum,
+               [&](uint32_t i, uint32_t plane_mask)
+               {
+                   if(plane_mask == 0 ||
+                      frustum.test(instances_[i].world_bound, plane_mask) != FrustumTest::OUTSIDE)
+                   {
+                       instances.push_back(i);
+                   }
+               });
+}
+
+const std::vector<SceneInstance> &SceneBVH::get_instances() const { return instances_; }
+
+const std::vector<SceneLight> &SceneBVH::get_lights() const { return lights_; }
+
+const BVH &SceneBVH::get_bvh() const { return bvh_; }
+
+void SceneBVH::gather(SceneNode &root)
+{
+    Matrix4x4   identity;
+    SceneGather gather;
+    root.gather_instances(gather, identity);
+    instances_ = std::move(gather.instances);
+    lights_ = std::move(gather.lights);
+
+    bounds_.resize(instances_.size());
+    for(size_t i = 0; i < instances_.size(); i++)
+    {
+        bounds_[i] = instances_[i].world_bound;
+
+        // Build triangle hierarchies now so intersect does not modify surfaces
+        instances_[i].surface->get_bvh();
+    }
+}
+
+} // namespace cg
@@ -0,0 +1,181 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:	 David W. Nesbitt
+//	File:    scene_bvh.hpp
+//	Purpose: Bounding volume hierarchy over the geometry instances of a
+//           scene graph for picking and other ray / volume queries.
+//
+//============================================================================
+
+#ifndef __SCENE_SCENE_BVH_HPP__
+#define __SCENE_SCENE_BVH_HPP__
+
+#include "geometry/bvh.hpp"
+#include "geometry/hpoint3.hpp"
+#include "scene/color4.hpp"
+#include "scene/render_queue.hpp"
+#include "scene/tri_surface.hpp"
+
+#include <cfloat>
+#include <vector>
+
+namespace cg
+{
+
+/**
+ * A triangle surface drawn with a composite modeling matrix. A surface shared
+ * by several transform nodes (or an instanced geometry node) gives one
+ * instance per use.
+ */
+struct SceneInstance
+{
+    TriSurface   *surface;        // Surface (modeling coordinates)
+    Matrix4x4     model_matrix;   // Composite modeling matrix
+    Matrix4x4     inverse_matrix; // Inverse of the modeling matrix (world to modeling)
+    Matrix4x4     normal_matrix;  // Normal matrix (modeling to world normals)
+    AABB          world_bound;    // Bound of the surface in world coordinates
+    MaterialBlock material;       // Material current when the surface is drawn
+
+    /**
+     * Constructor. Computes the inverse and normal matrices and the world bound.
+     * @param  s    Surface.
+     * @param  m    Composite modeling matrix.
+     * @param  mat  Material.
+     */
+    SceneInstance(TriSurface *s, const Matrix4x4 &m, const MaterialBlock &mat);
+};
+
+/**
+ * Light source, with the parameters of the lighting shaders (see
+ * Module9/vertex_lighting.frag). Positions and directions are in world
+ * coordinates.
+ */
+struct SceneLight
+{
+    bool    enabled;
+    bool    spotlight;
+    HPoint3 position; // Position (w = 1) or direction towards the light (w = 0)
+    Color4  ambient;
+    Color4  diffuse;
+    Color4  specular;
+    Vector3 spot_direction;
+    float   spot_cutoff;   // Degrees
+    float   spot_exponent;
+};
+
+/**
+ * Geometry instances and lights collected by SceneNode::gather_instances.
+ * The traversal keeps the current material the same way draw does:
+ * presentation nodes set it and it is not restored after their subtree.
+ */
+struct SceneGather
+{
+    std::vector<SceneInstance> instances;
+    std::vector<SceneLight>    lights;
+    MaterialBlock              material; // Current material
+
+    /**
+     * Constructor. Sets the default material (see RenderQueue::get_material).
+     */
+    SceneGather();
+};
+
+/**
+ * Result of intersecting a ray with a scene.
+ */
+struct ScenePickResult
+{
+    bool     intersects;    // True if the ray hit a triangle
+    float    distance;      // Distance along the ray (units of the ray direction)
+    uint32_t instance;      // Index of the instance that was hit
+    uint32_t face_index;    // Face of the instance's surface that was hit
+    float    barycentric_u; // Barycentric coordinates of the hit in the face
+    float    barycentric_v;
+};
+
+/**
+ * Two level bounding volume hierarchy over a scene graph: a BVH over the
+ * world bounds of the geometry instances, and within each instance the
+ * triangle BVH of its surface (see TriSurface::intersect). Rays are
+ * transformed into the modeling coordinates of each instance they reach, so
+ * moving a transform only requires a refit of the top level.
+ *
+ * The instance list is a snapshot: call refit after transforms change and
+ * build after the graph topology changes.
+ */
+class SceneBVH
+{
+  public:
+    /**
+     * Constructor.
+     */
+    SceneBVH();
+
+    /**
+     * Gather the instances of a scene graph and build the hierarchy.
+     * @param  root           Root of the scene graph.
+     * @param  allow_threads  Allow multiple threads for large builds.
+     */
+    void build(SceneNode &root, bool allow_threads = true);
+
+    /**
+     * Gather the instances again and refit the hierarchy to their new world
+     * bounds. Rebuilds if the number of instances changed.
+     * @param  root  Root of the scene graph.
+     * @return  Returns true if refit, false if rebuilt.
+     */
+    bool refit(SceneNode &root);
+
+    /**
+     * Find the nearest triangle hit by a ray.
+     * @param  ray    Ray in world coordinates.
+     * @param  t_max  Maximum distance along the ray.
+     * @return  Returns the nearest hit, if any.
+     */
+    ScenePickResult intersect(const Ray3 &ray, float t_max = FLT_MAX) const;
+
+    /**
+     * Find the instances whose world bounds are not outside a frustum.
+     * @param  frustum    View frustum.
+     * @param  instances  Filled with the indexes of the visible instances.
+     */
+    void query(const Frustum &frustum, std::vector<uint32_t> &instances) const;
+
+    /**
+     * Get the instances. The BVH primitive index is the index in this list.
+     * @return  Returns the instance list.
+     */
+    const std::vector<SceneInstance> &get_instances() const;
+
+    /**
+     * Get the lights found in the scene graph when the instances were gathered.
+     * @return  Returns the light list.
+     */
+    const std::vector<SceneLight> &get_lights() const;
+
+    /**
+     * Get the top level hierarchy.
+     * @return  Returns the BVH over the instance bounds.
+     */
+    const BVH &get_bvh() const;
+
+  protected:
+    std::vector<SceneInstance> instances_;
+    std::vector<SceneLight>    lights_;
+    std::vector<AABB>          bounds_;
+    BVH                        bvh_;
+
+    /**
+     * Gather the instances and lights of the scene graph and the instance
+     * world bounds. Builds the triangle BVH of each surface.
+     * @param  root  Root of the scene graph.
+     */
+    void gather(SceneNode &root);
+};
+
+} // namespace cg
+
+#endif
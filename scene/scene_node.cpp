@@ -1,5 +1,8 @@
 #include "scene/scene_node.hpp"
 
+#include "geometry/profiler.hpp"
+#include "scene/scene_store.hpp"
+
 namespace cg
 {
 
@@ -18,14 +21,25 @@ std::ostream &operator<<(std::ostream &out, const SceneNodeType &type)
     return out;
 }
 
-SceneNode::SceneNode() : node_type_(SceneNodeType::BASE) {}
+uint32_t SceneNode::graph_version_ = 0;
+
+SceneNode::SceneNode() : node_type_(SceneNodeType::BASE), cullable_(false), bound_version_(~0u) {}
 
 SceneNode::~SceneNode() { destroy(); }
 
 void SceneNode::draw(SceneState &scene_state)
 {
-    // Loop through the list and draw the children
-    for(auto c : children_) { c->draw(scene_state); }
+    CG_PROFILE_ZONE("SceneNode::draw");
+
+    // Loop through the list and draw the children that are not culled.
+    // Each child starts with this node's frustum planes.
+    uint32_t plane_mask = scene_state.frustum_planes;
+    for(auto c : children_)
+    {
+        if(scene_state.frustum_culling && c->is_culled(scene_state, plane_mask)) continue;
+        c->draw(scene_state);
+    }
+    scene_state.frustum_planes = plane_mask;
 }
 
 void SceneNode::update(SceneState &scene_state)
@@ -34,9 +48,32 @@ void SceneNode::update(SceneState &scene_state)
     for(auto c : children_) { c->update(scene_state); }
 }
 
-void SceneNode::destroy() { children_.clear(); }
+void SceneNode::compile(RenderQueue &queue, SceneState &scene_state)
+{
+    // Loop through the list and compile the children
+    for(auto &c : children_) { c->compile(queue, scene_state); }
+}
+
+void SceneNode::gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix)
+{
+    for(auto &c : children_) { c->gather_instances(gather, model_matrix); }
+}
+
+void SceneNode::flatten(SceneStore &store, uint32_t parent) { flatten_children(store, store.add_group(parent)); }
 
-void SceneNode::add_child(std::shared_ptr<SceneNode> node) { children_.push_back(node); }
+void SceneNode::apply_state(SceneState &) {}
+
+void SceneNode::destroy()
+{
+    children_.clear();
+    graph_changed();
+}
+
+void SceneNode::add_child(std::shared_ptr<SceneNode> node)
+{
+    children_.push_back(node);
+    graph_changed();
+}
 
 SceneNodeType SceneNode::node_type() const { return node_type_; }
 
@@ -46,7 +83,7 @@ const std::string &SceneNode::get_name() const { return name_; }
 
 void SceneNode::print_graph(std::ostream &out, int32_t level) const
 {
-    for(size_t i = 0; i < level; ++i) out << "- ";
+    for(int32_t i = 0; i < level; ++i) out << "- ";
 
     if(name_.length() == 0) out << "[";
     else out << name_ << " - [";
@@ -56,4 +93,57 @@ void SceneNode::print_graph(std::ostream &out, int32_t level) const
     for(auto c : children_) { c->print_graph(out, level + 1); }
 }
 
+const AABB &SceneNode::get_bound()
+{
+    if(bound_version_ != graph_version_)
+    {
+        update_bound();
+        bound_version_ = graph_version_;
+    }
+    return bound_;
+}
+
+bool SceneNode::is_cullable()
+{
+    get_bound();
+    return cullable_;
+}
+
+bool SceneNode::is_culled(SceneState &scene_state, uint32_t plane_mask)
+{
+    // Children of a node entirely inside the frustum need no tests
+    scene_state.frustum_planes = plane_mask;
+    if(plane_mask == 0 || !is_cullable()) return false;
+
+    scene_state.culling_counters.nodes_tested++;
+    AABB world_bound = get_bound().transform(scene_state.model_matrix);
+    if(scene_state.frustum.test(world_bound, scene_state.frustum_planes) == FrustumTest::OUTSIDE)
+    {
+        scene_state.culling_counters.nodes_culled++;
+        return true;
+    }
+    return false;
+}
+
+uint32_t SceneNode::graph_version() { return graph_version_; }
+
+void SceneNode::graph_changed() { ++graph_version_; }
+
+void SceneNode::update_bound()
+{
+    bound_ = AABB();
+    cullable_ = node_type_ == SceneNodeType::TRANSFORM || node_type_ == SceneNodeType::PRESENTATION ||
+                node_type_ == SceneNodeType::GEOMETRY;
+    for(auto &c : children_)
+    {
+        bound_.merge(c->get_bound());
+        cullable_ = cullable_ && c->is_cullable();
+    }
+}
+
+void SceneNode::flatten_children(SceneStore &store, uint32_t parent)
+{
+    for(auto &c : children_) { c->flatten(store, parent); }
+}
+
 } // namespace cg
@@ -13,6 +13,8 @@
 #ifndef __SCENE_SCENE_NODE_HPP__
 #define __SCENE_SCENE_NODE_HPP__
 
+#include "geometry/aabb.hpp"
+#include "geometry/arena.hpp"
 #include "scene/graphics.hpp"
 #include "scene/scene_state.hpp"
 
@@ -24,6 +26,10 @@
 namespace cg
 {
 
+class RenderQueue;
+class SceneStore;
+struct SceneGather;
+
 enum class SceneNodeType
 {
     BASE,
@@ -54,8 +60,9 @@ class SceneNode
 
     /**
      * Draw the scene node and its children. The base class just draws the
-     * children. Derived classes can use this (SceneNode::draw()) to draw
-     * all children without having to duplicate this code.
+     * children, skipping children outside the view frustum. Derived classes
+     * can use this (SceneNode::draw()) to draw all children without having to
+     * duplicate this code.
      * @param  scene_state  Current scene state
      */
     virtual void draw(SceneState &scene_state);
@@ -66,6 +73,42 @@ class SceneNode
      */
     virtual void update(SceneState &scene_state);
 
+    /**
+     * Compile the scene node and its children into a render queue (flattened
+     * list of draw records). The base class just compiles the children.
+     * @param  queue        Render queue to add draw records / state nodes to
+     * @param  scene_state  Current scene state
+     */
+    virtual void compile(RenderQueue &queue, SceneState &scene_state);
+
+    /**
+     * Add the geometry instances of this node and its children, with their
+     * composite modeling matrices and materials, and any lights to a list
+     * (used to build a SceneBVH and by the ray tracer). The base class just
+     * gathers the children.
+     * @param  gather        Instance and light lists.
+     * @param  model_matrix  Composite modeling matrix of the parent.
+     */
+    virtual void gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix);
+
+    /**
+     * Add this node and its children to a scene store, in depth first order.
+     * The base class adds a group node and flattens the children under it.
+     * Derived classes that draw or set state override this.
+     * @param  store   Scene store.
+     * @param  parent  Handle of the parent in the store (INVALID_SCENE_HANDLE
+     *                 at the top level).
+     */
+    virtual void flatten(SceneStore &store, uint32_t parent);
+
+    /**
+     * Apply per-frame state owned by this node (uniforms that are not part of
+     * a draw record, e.g. camera and light uniforms). Does not draw children.
+     * The base class has no state.
+     * @param  scene_state  Current scene state
+     */
+    virtual void apply_state(SceneState &scene_state);
+
     /**
      * Destroy all the children
      */
@@ -97,12 +140,89 @@ class SceneNode
 
     void print_graph(std::ostream &out = std::cout, int32_t level = 0) const;
 
+    /**
+     * Get the bounding box of this node and its children in the coordinate
+     * frame of the parent (a TransformNode's bound includes its transform).
+     * Shared nodes have one bound for all parents. Recomputed when the scene
+     * graph changes.
+     * @return  Returns the bounding box (empty if there is no geometry).
+     */
+    const AABB &get_bound();
+
+    /**
+     * Check whether this node and its children can be skipped when outside
+     * the view frustum. Only transform, presentation and geometry nodes are
+     * cullable; other nodes (shaders, cameras, lights) may set state used
+     * outside their subtree, so subtrees containing them are never culled.
+     * @return  Returns true if the subtree can be culled.
+     */
+    bool is_cullable();
+
+    /**
+     * Test this node's world space bound against the view frustum in the
+     * scene state. The current modeling matrix is the parent's. Sets the
+     * plane mask of the scene state for the children of this node.
+     * @param  scene_state  Current scene state
+     * @param  plane_mask   Frustum planes still to test (from the parent).
+     * @return  Returns true if the node is outside the frustum.
+     */
+    bool is_culled(SceneState &scene_state, uint32_t plane_mask);
+
+    /**
+     * Get the scene graph version. The version changes whenever any graph
+     * topology, transform, or material changes. Used to detect when compiled
+     * render queues are out of date.
+     * @return  Returns the current scene graph version.
+     */
+    static uint32_t graph_version();
+
   protected:
+    // Increment the scene graph version (call when topology or state that is
+    // compiled into a render queue changes)
+    static void graph_changed();
+
+    /**
+     * Compute the bound of this node (bound_ and cullable_). The base class
+     * merges the bounds of the children.
+     */
+    virtual void update_bound();
+
+    /**
+     * Flatten the children of this node into a scene store.
+     * @param  store   Scene store.
+     * @param  parent  Handle of this node in the store.
+     */
+    void flatten_children(SceneStore &store, uint32_t parent);
+
+    static uint32_t graph_version_;
+
     std::string                             name_;
     SceneNodeType                           node_type_;
     std::vector<std::shared_ptr<SceneNode>> children_;
+
+    // Bound of this subtree (see get_bound) and the graph version it was computed for
+    AABB     bound_;
+    bool     cullable_;
+    uint32_t bound_version_;
 };
 
+/**
+ * Create a scene node, allocating it (and its shared_ptr control block) from
+ * an arena if one is given. The node is still destroyed when the last
+ * shared_ptr to it is released, but its memory is only reclaimed when the
+ * arena is reset: tear a scene down by releasing it, then resetting the
+ * arena once.
+ * @param  arena  Arena to allocate from (nullptr to use the heap).
+ * @param  args   Constructor arguments.
+ * @return  Returns the node.
+ */
+template <typename T, typename... Args>
+std::shared_ptr<T> make_scene_node(Arena *arena, Args &&...args)
+{
+    if(arena == nullptr) return std::make_shared<T>(std::forward<Args>(args)...);
+    return std::allocate_shared<T>(ArenaAllocator<T>(*arena), std::forward<Args>(args)...);
+}
+
 } // namespace cg
 
 #endif
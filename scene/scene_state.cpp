@@ -1,26 +1,50 @@
 #include "scene/scene_state.hpp"
 
+#include <atomic>
+
 namespace cg
 {
 
 void SceneState::init()
 {
     model_matrix.set_identity();
+    normal_matrix.set_identity();
+    model_version = 0;
+    pv_version = 0;
     model_matrix_stack.clear();
+    transform_counters = TransformCounters{0, 0, 0};
+    frustum_planes = Frustum::ALL_PLANES;
+    culling_counters = CullingCounters{0, 0};
+    gl_state.reset_counters();
+}
+
+void SceneState::flush_frame_block()
+{
+    if(!frame_block_changed || frame_buffer == nullptr) return;
+    frame_buffer->update(0, &frame_block, sizeof(FrameBlock));
+    frame_block_changed = false;
 }
 
-void SceneState::push_transforms() { model_matrix_stack.push_back(model_matrix); }
+void SceneState::push_transforms() { model_matrix_stack.push(model_matrix); }
 
 void SceneState::pop_transforms()
 {
     // If there are any matrices on the stack, retrieve the last one and
     // remove it from the stack
-    if(model_matrix_stack.size() > 0)
+    if(!model_matrix_stack.empty())
     {
-        model_matrix = model_matrix_stack.back();
-        model_matrix_stack.pop_back();
+        model_matrix = model_matrix_stack.top();
+        model_matrix_stack.pop();
     }
     else model_matrix.set_identity();
 }
 
+uint64_t SceneState::next_matrix_version()
+{
+    // Version 0 is reserved for the identity matrix at the root. Versions are
+    // taken by both the update and render threads.
+    static std::atomic<uint64_t> version{0};
+    return version.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
 } // namespace cg
@@ -12,10 +12,12 @@
 #ifndef __SCENE_SCENE_STATE_HPP__
 #define __SCENE_SCENE_STATE_HPP__
 
+#include "geometry/frustum.hpp"
 #include "geometry/matrix.hpp"
+#include "scene/gl_state_cache.hpp"
 #include "scene/graphics.hpp"
-
-#include <list>
+#include "scene/matrix_stack.hpp"
+#include "scene/uniform_buffer.hpp"
 
 #include <array>
 
@@ -36,12 +38,29 @@ struct LightUniforms
     GLint spot_exponent;
 };
 
+// Per-frame counts of matrix recomputations (reset by SceneState::init)
+struct TransformCounters
+{
+    uint32_t world_updates;  // Composite modeling matrices recomputed
+    uint32_t normal_updates; // Normal matrices recomputed (matrix inversions)
+    uint32_t pvm_updates;    // Composite projection, view, model matrices recomputed
+};
+
+struct CullingCounters
+{
+    uint32_t nodes_tested; // Bounds tested against the view frustum
+    uint32_t nodes_culled; // Bounds outside the view frustum (subtree skipped)
+};
+
 /**
  * Scene state structure. Used to store OpenGL state - shader locations,
  * matrices, etc.
  */
 struct SceneState
 {
+    // Current shader program
+    GLuint program;
+
     // Vertex attribute locations
     GLint position_loc;  // Vertex position attribute location
     GLint vtx_color_loc; // Vertex color attribute location
@@ -62,9 +81,34 @@ struct SceneState
     GLint material_emission_loc;  // Material emission location
     GLint material_shininess_loc; // Material shininess location
 
+    // Packed vertex format uniform locations (-1 if the shader only supports
+    // the float vertex format)
+    GLint vertex_format_loc = -1;   // Vertex format location
+    GLint position_scale_loc = -1;  // Position dequantization scale location
+    GLint position_offset_loc = -1; // Position dequantization offset location
+
+    // Instancing locations (-1 if the shader does not support instanced draws)
+    GLint instanced_loc = -1;       // Instanced draw flag uniform location
+    GLint instance_model_loc = -1;  // Instance model matrix attribute location (4 columns)
+    GLint instance_normal_loc = -1; // Instance normal matrix attribute location (4 columns)
+
     // Lights
     LightUniforms lights[3];
 
+    // Uniform blocks (nullptr if the program uses plain uniforms). The camera
+    // and lights write frame_block, which is uploaded with one call before
+    // the next draw (see flush_frame_block). Materials set while drawing the
+    // scene graph are streamed to the material buffer.
+    UniformBuffer  *frame_buffer = nullptr;     // Frame block buffer
+    FrameBlock      frame_block{};              // Frame block contents
+    bool            frame_block_changed = false; // frame_block changed since the last upload
+    MaterialBuffer *material_stream = nullptr;  // Material block buffer
+
+    // Program, vertex array and uniform calls go through the state cache,
+    // which skips those that would not change anything. It is kept across
+    // frames (init only resets its counters).
+    GLStateCache gl_state;
+
     // Current matrices
     std::array<float, 16> ortho;        // Orthographic projection matrix (2-D)
     Matrix4x4             ortho_matrix; // Orthographic projection matrix (2-D)
@@ -72,16 +116,38 @@ struct SceneState
     Matrix4x4             model_matrix; // Current model matrix
     Matrix4x4             normal_matrix;
 
+    // Versions of the current matrices. A version identifies the value of a
+    // matrix so cached products can be reused while the version is unchanged.
+    // Version 0 is the identity modeling matrix at the root of the scene.
+    uint64_t pv_version;
+    uint64_t model_version;
+
+    TransformCounters transform_counters;
+
+    // View frustum culling. The frustum is set by the camera. The plane mask
+    // holds the planes the current subtree may still cross.
+    bool            frustum_culling = true; // Skip nodes outside the view frustum
+    Frustum         frustum;                // View frustum (world coordinates)
+    uint32_t        frustum_planes;         // Frustum planes still to test (bit mask)
+    CullingCounters culling_counters;
+
     Point3 camera_position;
 
     // Retained state to push/pop modeling matrix
-    std::list<Matrix4x4> model_matrix_stack;
+    MatrixStack model_matrix_stack;
 
     /**
-     * Initialize scene state prior to drawing.
+     * Initialize scene state prior to drawing. Keeps the capacity of the
+     * matrix stack, so drawing the same scene again does not allocate.
      */
     void init();
 
+    /**
+     * Upload the frame block if the camera or lights changed it. Called
+     * before drawing.
+     */
+    void flush_frame_block();
+
     /**
      * Copy current matrix onto stack
      */
@@ -92,6 +158,12 @@ struct SceneState
      * (or 0 if none are set at this node)
      */
     void pop_transforms();
+
+    /**
+     * Get a new, unique matrix version. Thread safe.
+     * @return  Returns a matrix version that has not been used before.
+     */
+    static uint64_t next_matrix_version();
 };
 
 } // namespace cg
@@ -0,0 +1,376 @@
+#include "scene/scene_store.hpp"
+
+#include "geometry/profiler.hpp"
+#include "scene/scene_node.hpp"
+
+#include <cstdio>
+
+namespace cg
+{
+
+SceneStore::SceneStore() : built_(false), graph_version_(0), transforms_changed_(false) {}
+
+void SceneStore::clear()
+{
+    nodes_.clear();
+    transforms_.clear();
+    materials_.clear();
+    geometry_.clear();
+    state_nodes_.clear();
+    draw_nodes_.clear();
+    transforms_changed_ = false;
+    built_ = false;
+}
+
+void SceneStore::release()
+{
+    clear();
+    materials_.release();
+}
+
+void SceneStore::build(SceneNode &root)
+{
+    CG_PROFILE_ZONE("SceneStore::build");
+    clear();
+    root.flatten(*this, INVALID_SCENE_HANDLE);
+    graph_version_ = SceneNode::graph_version();
+    built_ = true;
+}
+
+bool SceneStore::is_stale() const { return !built_ || graph_version_ != SceneNode::graph_version(); }
+
+void SceneStore::draw(SceneNode &root, SceneState &scene_state)
+{
+    if(is_stale()) build(root);
+    draw(scene_state);
+}
+
+void SceneStore::draw(SceneState &scene_state)
+{
+    CG_PROFILE_ZONE("SceneStore::draw");
+    update_transforms();
+    materials_.upload();
+
+    // Matrices currently loaded in the shader. State nodes and scene nodes
+    // may change the program or the matrix uniforms.
+    bool     loaded = false;
+    uint32_t loaded_transform = INVALID_INDEX;
+
+    // Current material and the material set in the shader. Materials are
+    // applied before the next draw, so those of culled subtrees are skipped.
+    uint32_t material = INVALID_INDEX;
+    uint32_t applied_material = INVALID_INDEX;
+
+    // Frustum planes still to test in each enclosing transform subtree that
+    // was tested (hierarchical culling)
+    cull_stack_.clear();
+    auto get_plane_mask = [this](SceneHandle h)
+    {
+        while(!cull_stack_.empty() && cull_stack_.back().end <= h) cull_stack_.pop_back();
+        return cull_stack_.empty() ? Frustum::ALL_PLANES : cull_stack_.back().plane_mask;
+    };
+
+    SceneHandle count = size();
+    for(SceneHandle h = 0; h < count; h++)
+    {
+        const StoreNode &n = nodes_[h];
+        switch(n.kind)
+        {
+            case StoreNodeKind::GROUP: break;
+
+            case StoreNodeKind::TRANSFORM:
+            {
+                // Skip the subtree if it is outside the view frustum
+                const StoreTransform &t = transforms_[n.item];
+                if(!scene_state.frustum_culling || !t.cullable) break;
+                uint32_t plane_mask = get_plane_mask(h);
+                if(plane_mask == 0) break;
+
+                scene_state.culling_counters.nodes_tested++;
+                if(scene_state.frustum.test(t.bound, plane_mask) == FrustumTest::OUTSIDE)
+                {
+                    scene_state.culling_counters.nodes_culled++;
+                    h = n.end - 1;
+                }
+                else cull_stack_.push_back(CullScope{n.end, plane_mask});
+                break;
+            }
+
+            case StoreNodeKind::MATERIAL: material = n.item; break;
+
+            case StoreNodeKind::GEOMETRY:
+            {
+                const StoreGeometry &g = geometry_[n.item];
+                uint32_t             plane_mask = scene_state.frustum_culling ? get_plane_mask(h) : 0;
+                if(plane_mask != 0)
+                {
+                    scene_state.culling_counters.nodes_tested++;
+                    if(scene_state.frustum.test(g.world_bound, plane_mask) == FrustumTest::OUTSIDE)
+                    {
+                        scene_state.culling_counters.nodes_culled++;
+                        break;
+                    }
+                }
+
+                // Geometry under the same transform shares the loaded matrices
+                if(!loaded || loaded_transform != g.transform)
+                {
+                    load_transform(g.transform, scene_state);
+                    loaded = true;
+                    loaded_transform = g.transform;
+                }
+
+                // Vertex format and position dequantization (if the shader supports packed vertices)
+                const DrawGeometry &d = g.geometry;
+                if(scene_state.vertex_format_loc >= 0)
+                {
+                    scene_state.gl_state.uniform1i(scene_state.vertex_format_loc, static_cast<GLint>(d.vertex_format));
+                    scene_state.gl_state.uniform3fv(scene_state.position_scale_loc, &d.quantization.scale.x);
+                    scene_state.gl_state.uniform3fv(scene_state.position_offset_loc, &d.quantization.offset.x);
+                }
+                if(material != applied_material)
+                {
+                    apply_material(material, scene_state);
+                    applied_material = material;
+                }
+                scene_state.flush_frame_block();
+                scene_state.gl_state.bind_vertex_array(d.vao);
+                glDrawElements(GL_TRIANGLES, d.index_count, d.index_type, (void *)d.index_offset);
+                break;
+            }
+
+            case StoreNodeKind::STATE:
+                state_nodes_[n.item].node->apply_state(scene_state);
+                loaded = false;
+                applied_material = INVALID_INDEX;
+                break;
+
+            case StoreNodeKind::NODE:
+            {
+                // Draw the scene node (and its children) with its parent's matrices
+                const StoreSceneNode &s = draw_nodes_[n.item];
+                load_transform(s.transform, scene_state);
+                loaded = false;
+                if(scene_state.frustum_culling && s.node->is_culled(scene_state, get_plane_mask(h))) break;
+                if(material != applied_material) apply_material(material, scene_state);
+                s.node->draw(scene_state);
+                applied_material = INVALID_INDEX;
+                break;
+            }
+        }
+    }
+    scene_state.gl_state.bind_vertex_array(0);
+}
+
+SceneHandle SceneStore::add_group(SceneHandle parent) { return add(parent, StoreNodeKind::GROUP, 0); }
+
+SceneHandle SceneStore::add_transform(SceneHandle parent, const Matrix4x4 &local_matrix)
+{
+    SceneHandle handle = add(parent, StoreNodeKind::TRANSFORM, static_cast<uint32_t>(transforms_.size()));
+    if(handle == INVALID_SCENE_HANDLE) return handle;
+
+    StoreTransform t;
+    t.local_matrix = local_matrix;
+    t.version = 0;
+    t.pv_version = ~0ull;
+    t.parent = get_transform(parent);
+    t.changed = true;
+    t.cullable = true;
+    transforms_.push_back(t);
+    transforms_changed_ = true;
+    return handle;
+}
+
+SceneHandle SceneStore::add_material(SceneHandle parent, const MaterialBlock &material)
+{
+    SceneHandle handle = add(parent, StoreNodeKind::MATERIAL, materials_.size());
+    if(handle != INVALID_SCENE_HANDLE) materials_.add(material);
+    return handle;
+}
+
+SceneHandle SceneStore::add_geometry(SceneHandle parent, const DrawGeometry &geometry)
+{
+    SceneHandle handle = add(parent, StoreNodeKind::GEOMETRY, static_cast<uint32_t>(geometry_.size()));
+    if(handle == INVALID_SCENE_HANDLE) return handle;
+
+    geometry_.push_back(StoreGeometry{geometry, get_transform(parent), AABB()});
+    transforms_changed_ = true;
+    return handle;
+}
+
+SceneHandle SceneStore::add_state(SceneHandle parent, SceneNode *node)
+{
+    SceneHandle handle = add(parent, StoreNodeKind::STATE, static_cast<uint32_t>(state_nodes_.size()));
+    if(handle == INVALID_SCENE_HANDLE) return handle;
+
+    state_nodes_.push_back(StoreSceneNode{node, get_transform(parent)});
+    transforms_changed_ = true;
+    return handle;
+}
+
+SceneHandle SceneStore::add_node(SceneHandle parent, SceneNode *node)
+{
+    SceneHandle handle = add(parent, StoreNodeKind::NODE, static_cast<uint32_t>(draw_nodes_.size()));
+    if(handle == INVALID_SCENE_HANDLE) return handle;
+
+    draw_nodes_.push_back(StoreSceneNode{node, get_transform(parent)});
+    transforms_changed_ = true;
+    return handle;
+}
+
+void SceneStore::set_transform(SceneHandle handle, const Matrix4x4 &local_matrix)
+{
+    StoreTransform &t = transforms_[nodes_[handle].item];
+    t.local_matrix = local_matrix;
+    t.changed = true;
+    transforms_changed_ = true;
+}
+
+void SceneStore::set_material(SceneHandle handle, const MaterialBlock &material)
+{
+    materials_.set(nodes_[handle].item, material);
+}
+
+MaterialBlock SceneStore::get_material(SceneHandle handle) const
+{
+    for(SceneHandle h = handle; h != INVALID_SCENE_HANDLE; h = nodes_[h].parent)
+    {
+        if(nodes_[h].kind == StoreNodeKind::MATERIAL) return materials_.get(nodes_[h].item);
+    }
+    return MaterialBlock{Color4(), Color4(), Color4(), Color4(), 1.0f};
+}
+
+const std::vector<StoreNode> &SceneStore::get_nodes() const { return nodes_; }
+
+uint32_t SceneStore::size() const { return static_cast<uint32_t>(nodes_.size()); }
+
+SceneHandle SceneStore::add(SceneHandle parent, StoreNodeKind kind, uint32_t item)
+{
+    // Depth first order: the parent's subtree must end at the new node
+    SceneHandle handle = size();
+    if(parent != INVALID_SCENE_HANDLE && (parent >= handle || nodes_[parent].end != handle))
+    {
+        printf("SceneStore: parent %u is not the last node added or one of its ancestors\n", parent);
+        return INVALID_SCENE_HANDLE;
+    }
+
+    nodes_.push_back(StoreNode{kind, item, parent, handle + 1});
+    for(SceneHandle p = parent; p != INVALID_SCENE_HANDLE; p = nodes_[p].parent) nodes_[p].end = handle + 1;
+    return handle;
+}
+
+uint32_t SceneStore::get_transform(SceneHandle handle) const
+{
+    for(SceneHandle h = handle; h != INVALID_SCENE_HANDLE; h = nodes_[h].parent)
+    {
+        if(nodes_[h].kind == StoreNodeKind::TRANSFORM) return nodes_[h].item;
+    }
+    return INVALID_INDEX;
+}
+
+void SceneStore::update_transforms()
+{
+    if(!transforms_changed_) return;
+    CG_PROFILE_ZONE("SceneStore::update_transforms");
+
+    // Parents come before their children, so one pass updates the composite
+    // matrices of changed transforms and of everything below them
+    for(StoreTransform &t : transforms_)
+    {
+        bool parent_changed = (t.parent != INVALID_INDEX) && transforms_[t.parent].changed;
+        if(!t.changed && !parent_changed) continue;
+
+        t.changed = true;
+        t.model_matrix = (t.parent != INVALID_INDEX) ? transforms_[t.parent].model_matrix * t.local_matrix
+                                                     : t.local_matrix;
+        t.normal_matrix = t.model_matrix.get_normal_matrix();
+        t.version = SceneState::next_matrix_version();
+        t.pv_version = ~0ull;
+    }
+
+    // Bounds of the leaves, merged into the enclosing transforms and then up
+    // the transform hierarchy (children before parents)
+    Matrix4x4 identity;
+    for(StoreTransform &t : transforms_)
+    {
+        t.bound = AABB();
+        t.cullable = true;
+    }
+    for(StoreGeometry &g : geometry_)
+    {
+        bool top_level = (g.transform == INVALID_INDEX);
+        g.world_bound = g.geometry.bound.transform(top_level ? identity : transforms_[g.transform].model_matrix);
+        if(!top_level) transforms_[g.transform].bound.merge(g.world_bound);
+    }
+    for(const StoreSceneNode &s : draw_nodes_)
+    {
+        if(s.transform == INVALID_INDEX) continue;
+        StoreTransform &t = transforms_[s.transform];
+        t.bound.merge(s.node->get_bound().transform(t.model_matrix));
+        t.cullable = t.cullable && s.node->is_cullable();
+    }
+    for(const StoreSceneNode &s : state_nodes_)
+    {
+        if(s.transform != INVALID_INDEX) transforms_[s.transform].cullable = false;
+    }
+    for(size_t i = transforms_.size(); i > 0; i--)
+    {
+        StoreTransform &t = transforms_[i - 1];
+        t.changed = false;
+        if(t.parent == INVALID_INDEX) continue;
+        transforms_[t.parent].bound.merge(t.bound);
+        transforms_[t.parent].cullable = transforms_[t.parent].cullable && t.cullable;
+    }
+    transforms_changed_ = false;
+}
+
+void SceneStore::load_transform(uint32_t transform, SceneState &scene_state)
+{
+    if(transform == INVALID_INDEX)
+    {
+        // Top level: identity modeling matrix
+        scene_state.model_matrix.set_identity();
+        scene_state.normal_matrix.set_identity();
+        scene_state.model_version = 0;
+        scene_state.gl_state.uniform_matrix4fv(scene_state.model_matrix_loc, scene_state.model_matrix.get());
+        scene_state.gl_state.uniform_matrix4fv(scene_state.normal_matrix_loc, scene_state.normal_matrix.get());
+        scene_state.gl_state.uniform_matrix4fv(scene_state.pvm_matrix_loc, scene_state.pv.get());
+        return;
+    }
+
+    // The composite PVM matrix depends on the camera - only form it when the camera changes
+    StoreTransform &t = transforms_[transform];
+    if(t.pv_version != scene_state.pv_version)
+    {
+        t.pvm_matrix = scene_state.pv * t.model_matrix;
+        t.pv_version = scene_state.pv_version;
+        scene_state.transform_counters.pvm_updates++;
+    }
+    scene_state.model_matrix = t.model_matrix;
+    scene_state.normal_matrix = t.normal_matrix;
+    scene_state.model_version = t.version;
+    scene_state.gl_state.uniform_matrix4fv(scene_state.model_matrix_loc, t.model_matrix.get());
+    scene_state.gl_state.uniform_matrix4fv(scene_state.normal_matrix_loc, t.normal_matrix.get());
+    scene_state.gl_state.uniform_matrix4fv(scene_state.pvm_matrix_loc, t.pvm_matrix.get());
+}
+
+void SceneStore::apply_material(uint32_t material, SceneState &scene_state)
+{
+    if(material == INVALID_INDEX) return;
+
+    // Bind the material's range of the material buffer if the shader has a
+    // material block, otherwise set its uniforms
+    if(scene_state.material_stream != nullptr)
+    {
+        materials_.bind(material);
+        return;
+    }
+    const MaterialBlock &m = materials_.get(material);
+    scene_state.gl_state.uniform4fv(scene_state.material_ambient_loc, &m.ambient.r);
+    scene_state.gl_state.uniform4fv(scene_state.material_diffuse_loc, &m.diffuse.r);
+    scene_state.gl_state.uniform4fv(scene_state.material_specular_loc, &m.specular.r);
+    scene_state.gl_state.uniform4fv(scene_state.material_emission_loc, &m.emission.r);
+    scene_state.gl_state.uniform1f(scene_state.material_shininess_loc, m.shininess);
+}
+
+} // namespace cg
@@ -0,0 +1,272 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    scene_store.hpp
+//	Purpose: Data oriented scene storage. Nodes are kept in depth first
+//           order in contiguous arrays and refer to each other by index.
+//
+//============================================================================
+
+#ifndef __SCENE_SCENE_STORE_HPP__
+#define __SCENE_SCENE_STORE_HPP__
+
+#include "geometry/aabb.hpp"
+#include "geometry/matrix.hpp"
+#include "scene/render_queue.hpp"
+#include "scene/scene_state.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+class SceneNode;
+
+// Index of a node in a scene store
+using SceneHandle = uint32_t;
+
+constexpr SceneHandle INVALID_SCENE_HANDLE = 0xFFFFFFFF;
+
+enum class StoreNodeKind : uint8_t
+{
+    GROUP,     // Only groups its children
+    TRANSFORM, // Modeling transform (transform pool)
+    MATERIAL,  // Material (material pool)
+    GEOMETRY,  // One draw of a vertex array (geometry pool)
+    STATE,     // Scene node applying per-frame state (shader, camera, light)
+    NODE       // Scene node drawn by the scene graph (its children are not stored)
+};
+
+/**
+ * Node of a scene store. The subtree of the node at handle h is the range
+ * of handles [h, end): the first child (if any) is h + 1 and the next
+ * sibling of a child c is the end of c.
+ */
+struct StoreNode
+{
+    StoreNodeKind kind;
+    uint32_t      item;   // Index into the pool of the node's kind
+    SceneHandle   parent; // INVALID_SCENE_HANDLE at the top level
+    SceneHandle   end;    // One past the last node of the subtree
+};
+
+// Transform pool item
+struct StoreTransform
+{
+    Matrix4x4 local_matrix;  // Local modeling transform
+    Matrix4x4 model_matrix;  // Composite modeling matrix
+    Matrix4x4 normal_matrix; // Normal matrix (transpose of the inverse)
+    Matrix4x4 pvm_matrix;    // Composite projection, view, modeling matrix
+    uint64_t  version;       // Version of model_matrix (see SceneState)
+    uint64_t  pv_version;    // Version of the PV matrix used to form pvm_matrix
+    uint32_t  parent;        // Enclosing transform (INVALID_INDEX if none)
+    bool      changed;       // Local transform changed since the last update
+    bool      cullable;      // Subtree has no state nodes
+    AABB      bound;         // Bound of the subtree (world coordinates)
+};
+
+// Geometry pool item
+struct StoreGeometry
+{
+    DrawGeometry geometry;    // Vertex array, index range and vertex format to draw
+    uint32_t     transform;   // Enclosing transform (INVALID_INDEX if none)
+    AABB         world_bound; // Bound in world coordinates
+};
+
+// State node and scene node pool item
+struct StoreSceneNode
+{
+    SceneNode *node;
+    uint32_t   transform; // Enclosing transform (INVALID_INDEX if none)
+};
+
+/**
+ * Scene store: an alternative to drawing the scene graph. Nodes live in
+ * one array in depth first order, with the data of each kind of node in
+ * its own contiguous pool (transforms, materials, geometry, scene nodes).
+ * Parents and subtrees are 32-bit handles, so drawing is one pass over the
+ * array with no pointer chasing or reference counting; culled subtrees are
+ * skipped by jumping to their end.
+ *
+ * A store is built directly (add_* in depth first order) or flattened from
+ * a scene graph (build), which keeps the construct_* scene builders working.
+ * Shader, camera and light nodes are kept as state nodes and applied in
+ * order; geometry other than TriSurface is drawn by its scene node. The
+ * store does not own scene nodes: the graph must outlive the store.
+ */
+class SceneStore
+{
+  public:
+    static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+    /**
+     * Constructor.
+     */
+    SceneStore();
+
+    /**
+     * Remove all nodes (keeps the capacity).
+     */
+    void clear();
+
+    /**
+     * Remove all nodes and delete the material buffer (before the OpenGL
+     * context is destroyed).
+     */
+    void release();
+
+    /**
+     * Flatten a scene graph into the store, replacing its nodes.
+     * @param  root  Root of the scene graph.
+     */
+    void build(SceneNode &root);
+
+    /**
+     * Check whether the store must be rebuilt from its scene graph.
+     * @return  Returns true if the store was not built from the current
+     *          version of the scene graph.
+     */
+    bool is_stale() const;
+
+    /**
+     * Draw a scene graph from the store, rebuilding the store first if the
+     * graph has changed.
+     * @param  root         Root of the scene graph.
+     * @param  scene_state  Current scene state.
+     */
+    void draw(SceneNode &root, SceneState &scene_state);
+
+    /**
+     * Draw the nodes of the store.
+     * @param  scene_state  Current scene state.
+     */
+    void draw(SceneState &scene_state);
+
+    /**
+     * Add a group node. Nodes must be added in depth first order: the parent
+     * must be the last node added or one of its ancestors.
+     * @param  parent  Parent (INVALID_SCENE_HANDLE for a top level node).
+     * @return  Returns the handle of the node (INVALID_SCENE_HANDLE if the
+     *          parent is not valid).
+     */
+    SceneHandle add_group(SceneHandle parent);
+
+    /**
+     * Add a transform node.
+     * @param  parent        Parent (see add_group).
+     * @param  local_matrix  Local modeling transform.
+     * @return  Returns the handle of the node.
+     */
+    SceneHandle add_transform(SceneHandle parent, const Matrix4x4 &local_matrix);
+
+    /**
+     * Add a material node.
+     * @param  parent    Parent (see add_group).
+     * @param  material  Material.
+     * @return  Returns the handle of the node.
+     */
+    SceneHandle add_material(SceneHandle parent, const MaterialBlock &material);
+
+    /**
+     * Add a geometry node (a leaf).
+     * @param  parent    Parent (see add_group).
+     * @param  geometry  Vertex array, index range and vertex format to draw.
+     * @return  Returns the handle of the node.
+     */
+    SceneHandle add_geometry(SceneHandle parent, const DrawGeometry &geometry);
+
+    /**
+     * Add a scene node whose state (apply_state) is applied when drawing.
+     * Its children are added as children of the returned node.
+     * @param  parent  Parent (see add_group).
+     * @param  node    Scene node.
+     * @return  Returns the handle of the node.
+     */
+    SceneHandle add_state(SceneHandle parent, SceneNode *node);
+
+    /**
+     * Add a scene node drawn by the scene graph (a leaf: the scene node
+     * draws its own children).
+     * @param  parent  Parent (see add_group).
+     * @param  node    Scene node.
+     * @return  Returns the handle of the node.
+     */
+    SceneHandle add_node(SceneHandle parent, SceneNode *node);
+
+    /**
+     * Set the local modeling transform of a transform node.
+     * @param  handle        Transform node.
+     * @param  local_matrix  Local modeling transform.
+     */
+    void set_transform(SceneHandle handle, const Matrix4x4 &local_matrix);
+
+    /**
+     * Set the material of a material node.
+     * @param  handle    Material node.
+     * @param  material  Material.
+     */
+    void set_material(SceneHandle handle, const MaterialBlock &material);
+
+    /**
+     * Get the material in effect below a node (the material of the nearest
+     * material node at or above it).
+     * @param  handle  Node (INVALID_SCENE_HANDLE for the top level).
+     * @return  Returns the material (default material if none).
+     */
+    MaterialBlock get_material(SceneHandle handle) const;
+
+    /**
+     * Get the nodes in depth first order.
+     * @return  Returns the nodes.
+     */
+    const std::vector<StoreNode> &get_nodes() const;
+
+    /**
+     * Get the number of nodes.
+     * @return  Returns the number of nodes.
+     */
+    uint32_t size() const;
+
+  protected:
+    bool     built_;
+    uint32_t graph_version_;
+    bool     transforms_changed_;
+
+    std::vector<StoreNode>      nodes_;
+    std::vector<StoreTransform> transforms_;
+    MaterialBuffer              materials_;
+    std::vector<StoreGeometry>  geometry_;
+    std::vector<StoreSceneNode> state_nodes_; // STATE nodes
+    std::vector<StoreSceneNode> draw_nodes_;  // NODE nodes
+
+    // Frustum planes left to test within a subtree (see draw)
+    struct CullScope
+    {
+        SceneHandle end;
+        uint32_t    plane_mask;
+    };
+    std::vector<CullScope> cull_stack_;
+
+    // Append a node after checking the parent keeps depth first order
+    SceneHandle add(SceneHandle parent, StoreNodeKind kind, uint32_t item);
+
+    // Get the transform enclosing a node (INVALID_INDEX if none)
+    uint32_t get_transform(SceneHandle handle) const;
+
+    // Recompute the composite matrices of changed transforms and the bounds
+    void update_transforms();
+
+    // Load the matrices of a transform (PVM formed when the camera changes)
+    void load_transform(uint32_t transform, SceneState &scene_state);
+
+    // Make a material current (material block range or material uniforms)
+    void apply_material(uint32_t material, SceneState &scene_state);
+};
+
+} // namespace cg
+
+#endif
@@ -1,5 +1,9 @@
 #include "scene/shader_node.hpp"
 
+#include "geometry/profiler.hpp"
+#include "scene/render_queue.hpp"
+#include "scene/scene_store.hpp"
+
 #include <iostream>
 
 namespace cg
@@ -11,6 +15,8 @@ ShaderNode::~ShaderNode() {}
 
 bool ShaderNode::create(const char *vertex_shader_filename, const char *fragment_shader_filename)
 {
+    CG_PROFILE_ZONE("ShaderNode::create");
+
     // Create and compile the vertex shader
     if(!vertex_shader_.create(vertex_shader_filename))
     {
@@ -60,4 +66,35 @@ bool ShaderNode::create_from_source(const char *vertex_shader_source,
     return true;
 }
 
+void ShaderNode::apply_state(SceneState &scene_state)
+{
+    scene_state.gl_state.use_program(shader_program_.get_program());
+    scene_state.program = shader_program_.get_program();
+
+    // Derived shader nodes set these if their shader supports packed vertices
+    // and instancing
+    scene_state.vertex_format_loc = -1;
+    scene_state.position_scale_loc = -1;
+    scene_state.position_offset_loc = -1;
+    scene_state.instanced_loc = -1;
+    scene_state.instance_model_loc = -1;
+    scene_state.instance_normal_loc = -1;
+
+    // ... and these if it has frame and material uniform blocks
+    scene_state.frame_buffer = nullptr;
+    scene_state.material_stream = nullptr;
+}
+
+void ShaderNode::compile(RenderQueue &queue, SceneState &scene_state)
+{
+    queue.add_state_node(this);
+    apply_state(scene_state);
+    SceneNode::compile(queue, scene_state);
+}
+
+void ShaderNode::flatten(SceneStore &store, uint32_t parent)
+{
+    flatten_children(store, store.add_state(parent, this));
+}
+
 } // namespace cg
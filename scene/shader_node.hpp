@@ -59,6 +59,29 @@ class ShaderNode : public SceneNode
     // Derived classes must add this to set all internal uniforms and attribute locations
     virtual bool get_locations() = 0;
 
+    /**
+     * Enable the shader program. Derived classes should extend this to set
+     * their uniform locations into the scene state.
+     * @param  scene_state  Current scene state.
+     */
+    void apply_state(SceneState &scene_state) override;
+
+    /**
+     * Compile the shader node and its children into a render queue. The
+     * shader is registered as a per-frame state node.
+     * @param  queue        Render queue.
+     * @param  scene_state  Current scene state.
+     */
+    void compile(RenderQueue &queue, SceneState &scene_state) override;
+
+    /**
+     * Flatten the shader node and its children into a scene store. The
+     * shader is added as a state node.
+     * @param  store   Scene store.
+     * @param  parent  Handle of the parent in the store.
+     */
+    void flatten(SceneStore &store, uint32_t parent) override;
+
   protected:
     GLSLVertexShader   vertex_shader_;
     GLSLFragmentShader fragment_shader_;
@@ -0,0 +1,115 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    snapshot_buffer.hpp
+//	Purpose: Double buffered hand-off of per-frame snapshots from an update
+//           thread to a render thread.
+//
+//============================================================================
+
+#ifndef __SCENE_SNAPSHOT_BUFFER_HPP__
+#define __SCENE_SNAPSHOT_BUFFER_HPP__
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace cg
+{
+
+/**
+ * Double buffered snapshot. The producer (update thread) fills the back
+ * snapshot while the consumer (render thread) works from the front one;
+ * publish swaps them. Neither side copies or locks while filling or reading
+ * a snapshot, only around the swap. The producer runs at most one snapshot
+ * ahead: publish waits until the consumer has taken and released the
+ * previous snapshot. Producer and consumer may also be the same thread
+ * (publish, then acquire and release).
+ */
+template <typename T>
+class SnapshotBuffer
+{
+  public:
+    /**
+     * Constructor.
+     */
+    SnapshotBuffer() : front_(0), fresh_(false), reading_(false), closed_(false) {}
+
+    /**
+     * Get the back snapshot. Only the producer may use it, between calls to
+     * publish. It holds the snapshot published two swaps ago, so fill all
+     * of it.
+     * @return  Returns the back snapshot.
+     */
+    T &get_back() { return slots_[1 - front_]; }
+
+    /**
+     * Publish the back snapshot, making it the front snapshot. Waits while
+     * the consumer has not yet acquired the previous snapshot or is still
+     * reading it.
+     * @return  Returns false if the buffer was closed.
+     */
+    bool publish()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this]() { return closed_ || (!fresh_ && !reading_); });
+        if(closed_) return false;
+        front_ = 1 - front_;
+        fresh_ = true;
+        condition_.notify_all();
+        return true;
+    }
+
+    /**
+     * Wait for a snapshot that has not been acquired yet. The snapshot stays
+     * valid until release is called.
+     * @return  Returns the front snapshot, or nullptr if the buffer was closed.
+     */
+    const T *acquire()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this]() { return closed_ || fresh_; });
+        if(closed_) return nullptr;
+        fresh_ = false;
+        reading_ = true;
+        return &slots_[front_];
+    }
+
+    /**
+     * Release the snapshot returned by acquire, letting the producer publish
+     * the next one.
+     */
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        reading_ = false;
+        condition_.notify_all();
+    }
+
+    /**
+     * Close the buffer. Waiting and later calls to publish and acquire
+     * return immediately.
+     */
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        condition_.notify_all();
+    }
+
+  protected:
+    T                       slots_[2];
+    uint32_t                front_;   // Index of the front snapshot
+    bool                    fresh_;   // Front snapshot published but not yet acquired
+    bool                    reading_; // Consumer holds the front snapshot
+    bool                    closed_;
+    std::mutex              mutex_;
+    std::condition_variable condition_;
+};
+
+} // namespace cg
+
+#endif
@@ -0,0 +1,440 @@
+#include "scene/software_rasterizer.hpp"
+
+#include "geometry/parallel.hpp"
+#include "geometry/profiler.hpp"
+#include "scene/phong_lighting.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+namespace cg
+{
+
+namespace
+{
+
+// Work items of the vertex and setup passes
+constexpr uint32_t VERTEX_BLOCK = 4096;
+constexpr uint32_t FACE_BLOCK = 1024;
+
+struct WorkBlock
+{
+    uint32_t instance; // Index into the visible instances
+    uint32_t begin;
+    uint32_t end;
+};
+
+/**
+ * Split each visible instance into blocks of at most block_size elements.
+ */
+template <typename F>
+std::vector<WorkBlock> make_blocks(size_t visible_count, uint32_t block_size, F element_count)
+{
+    std::vector<WorkBlock> blocks;
+    for(uint32_t i = 0; i < visible_count; i++)
+    {
+        uint32_t count = element_count(i);
+        for(uint32_t begin = 0; begin < count; begin += block_size)
+        {
+            blocks.push_back({i, begin, std::min(begin + block_size, count)});
+        }
+    }
+    return blocks;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+SoftwareRasterizer::SoftwareRasterizer() :
+    stats_{0, 0, 0, 0, 0, 0, 0, 0, 0.0, 0.0, 0.0},
+    tile_size_(0),
+    tiles_x_(0),
+    tiles_y_(0)
+{
+}
+
+void SoftwareRasterizer::set_settings(const RasterSettings &settings) { settings_ = settings; }
+
+const RasterSettings &SoftwareRasterizer::get_settings() const { return settings_; }
+
+void SoftwareRasterizer::build(SceneNode &root)
+{
+    CG_PROFILE_ZONE("SoftwareRasterizer::build");
+    Matrix4x4 identity;
+    scene_ = SceneGather();
+    root.gather_instances(scene_, identity);
+}
+
+void SoftwareRasterizer::render(const CameraNode &camera, Image &image)
+{
+    CG_PROFILE_ZONE("SoftwareRasterizer::render");
+    auto start = std::chrono::steady_clock::now();
+
+    const uint32_t width = settings_.width;
+    const uint32_t height = settings_.height;
+    tile_size_ = (std::max(settings_.tile_size, 1u) + 7) / 8 * 8;
+    tiles_x_ = (width + tile_size_ - 1) / tile_size_;
+    tiles_y_ = (height + tile_size_ - 1) / tile_size_;
+    const uint32_t tile_count = tiles_x_ * tiles_y_;
+    image.resize(width, height);
+
+    bins_.resize(get_thread_count());
+    for(auto &bins : bins_)
+    {
+        bins.triangles.clear();
+        bins.tiles.resize(tile_count);
+        for(auto &tile : bins.tiles) tile.clear();
+        bins.depth.resize(static_cast<size_t>(tile_size_) * tile_size_);
+        bins.triangles_culled = 0;
+        bins.triangles_clipped = 0;
+    }
+
+    // Instances outside the view frustum are skipped
+    const Matrix4x4       &pv = camera.get_pv_matrix();
+    const Frustum         &frustum = camera.get_frustum();
+    std::vector<uint32_t>  visible;
+    std::vector<size_t>    vertex_offsets;
+    std::vector<Matrix4x4> pvm;
+    size_t                 vertex_count = 0;
+    stats_.triangles = 0;
+    for(uint32_t i = 0; i < scene_.instances.size(); i++)
+    {
+        const SceneInstance &instance = scene_.instances[i];
+        if(frustum.is_outside(instance.world_bound)) continue;
+
+        visible.push_back(i);
+        vertex_offsets.push_back(vertex_count);
+        pvm.push_back(pv * instance.model_matrix);
+        vertex_count += instance.surface->get_vertices().size();
+        stats_.triangles += instance.surface->get_faces().size() / 3;
+    }
+    stats_.instances_culled = scene_.instances.size() - visible.size();
+    vertices_.resize(vertex_count);
+
+    // Vertex pass (the vertex shader)
+    std::vector<WorkBlock> vertex_blocks =
+        make_blocks(visible.size(),
+                    VERTEX_BLOCK,
+                    [&](uint32_t i)
+                    { return static_cast<uint32_t>(scene_.instances[visible[i]].surface->get_vertices().size()); });
+    parallel_for_stealing(vertex_blocks.size(),
+                          settings_.max_threads,
+                          [&](size_t item, uint32_t)
+                          {
+                              const WorkBlock                    &block = vertex_blocks[item];
+                              const SceneInstance                &instance = scene_.instances[visible[block.instance]];
+                              const std::vector<VertexAndNormal> &in = instance.surface->get_vertices();
+                              ClipVertex *out = &vertices_[vertex_offsets[block.instance]];
+                              for(uint32_t v = block.begin; v < block.end; v++)
+                              {
+                                  HPoint3 world = instance.model_matrix * in[v].vertex;
+                                  out[v].clip = pvm[block.instance] * in[v].vertex;
+                                  out[v].position = Point3(world.x, world.y, world.z);
+                                  out[v].normal = instance.normal_matrix * in[v].normal;
+                                  out[v].normal.normalize();
+                              }
+                          });
+
+    // Setup pass: clip, cull and bin each triangle into the bins of the
+    // thread that handles it
+    std::vector<WorkBlock> face_blocks = make_blocks(
+        visible.size(),
+        FACE_BLOCK,
+        [&](uint32_t i)
+        { return static_cast<uint32_t>(scene_.instances[visible[i]].surface->get_faces().size() / 3); });
+    parallel_for_stealing(face_blocks.size(),
+                          settings_.max_threads,
+                          [&](size_t item, uint32_t thread)
+                          {
+                              const WorkBlock             &block = face_blocks[item];
+                              uint32_t                     instance = visible[block.instance];
+                              const std::vector<uint32_t> &faces = scene_.instances[instance].surface->get_faces();
+                              const ClipVertex            *v = &vertices_[vertex_offsets[block.instance]];
+                              for(uint32_t f = block.begin; f < block.end; f++)
+                              {
+                                  const ClipVertex *tri[3] = {&v[faces[f * 3]], &v[faces[f * 3 + 1]],
+                                                              &v[faces[f * 3 + 2]]};
+                                  setup_triangle(tri, instance, f, bins_[thread]);
+                              }
+                          });
+    stats_.setup_ms = elapsed_ms(start);
+
+    // Raster pass: tiles are independent, so threads need no synchronization
+    auto                  raster_start = std::chrono::steady_clock::now();
+    const Point3          eye = camera.get_position();
+    std::atomic<uint64_t> fragments(0);
+    stats_.threads = parallel_for_stealing(tile_count,
+                                           settings_.max_threads,
+                                           [&](size_t tile, uint32_t thread)
+                                           {
+                                               fragments += raster_tile(static_cast<uint32_t>(tile),
+                                                                        bins_[thread], eye, image);
+                                           });
+    stats_.raster_ms = elapsed_ms(raster_start);
+
+    stats_.triangles_culled = 0;
+    stats_.triangles_clipped = 0;
+    stats_.triangles_binned = 0;
+    for(const auto &bins : bins_)
+    {
+        stats_.triangles_culled += bins.triangles_culled;
+        stats_.triangles_clipped += bins.triangles_clipped;
+        stats_.triangles_binned += bins.triangles.size();
+    }
+    stats_.fragments = fragments.load();
+    stats_.tiles = tile_count;
+    stats_.render_ms = elapsed_ms(start);
+}
+
+const RasterStats &SoftwareRasterizer::get_stats() const { return stats_; }
+
+const SceneGather &SoftwareRasterizer::get_scene() const { return scene_; }
+
+void SoftwareRasterizer::setup_triangle(const ClipVertex *const *v,
+                                        uint32_t                 instance,
+                                        uint32_t                 face,
+                                        ThreadBins              &bins)
+{
+    // Reject triangles entirely outside one of the clip planes
+    uint32_t outside_all = 0x3f;
+    for(uint32_t k = 0; k < 3; k++)
+    {
+        const HPoint3 &c = v[k]->clip;
+        uint32_t       outside = 0;
+        if(c.x > c.w) outside |= 1;
+        if(c.x < -c.w) outside |= 2;
+        if(c.y > c.w) outside |= 4;
+        if(c.y < -c.w) outside |= 8;
+        if(c.z > c.w) outside |= 16;
+        if(c.z < -c.w) outside |= 32;
+        outside_all &= outside;
+    }
+    if(outside_all != 0)
+    {
+        bins.triangles_culled++;
+        return;
+    }
+
+    // Distances to the near plane (z = -w)
+    float d[3];
+    bool  crosses = false;
+    for(uint32_t k = 0; k < 3; k++)
+    {
+        d[k] = v[k]->clip.z + v[k]->clip.w;
+        if(d[k] < 0.0f) crosses = true;
+    }
+    if(!crosses)
+    {
+        const ClipVertex tri[3] = {*v[0], *v[1], *v[2]};
+        bin_triangle(tri, instance, face, bins);
+        return;
+    }
+
+    // Clip against the near plane (Sutherland-Hodgman), giving 3 or 4
+    // vertices. Attributes are interpolated linearly in clip space.
+    bins.triangles_clipped++;
+    ClipVertex polygon[4];
+    uint32_t   n = 0;
+    for(uint32_t k = 0; k < 3; k++)
+    {
+        uint32_t next = (k + 1) % 3;
+        if(d[k] >= 0.0f) polygon[n++] = *v[k];
+        if((d[k] >= 0.0f) != (d[next] >= 0.0f))
+        {
+            const ClipVertex &a = *v[k];
+            const ClipVertex &b = *v[next];
+            float             t = d[k] / (d[k] - d[next]);
+            ClipVertex       &c = polygon[n++];
+            c.clip = HPoint3(a.clip.x + (b.clip.x - a.clip.x) * t,
+                             a.clip.y + (b.clip.y - a.clip.y) * t,
+                             a.clip.z + (b.clip.z - a.clip.z) * t,
+                             a.clip.w + (b.clip.w - a.clip.w) * t);
+            c.position = a.position + Vector3(a.position, b.position) * t;
+            c.normal = a.normal + (b.normal - a.normal) * t;
+        }
+    }
+    for(uint32_t k = 1; k + 1 < n; k++)
+    {
+        const ClipVertex tri[3] = {polygon[0], polygon[k], polygon[k + 1]};
+        bin_triangle(tri, instance, face, bins);
+    }
+}
+
+void SoftwareRasterizer::bin_triangle(const ClipVertex *v, uint32_t instance, uint32_t face, ThreadBins &bins)
+{
+    const float width = static_cast<float>(settings_.width);
+    const float height = static_cast<float>(settings_.height);
+
+    // Window coordinates, with y down so rows match the image
+    SetupTriangle tri;
+    float         sx[3], sy[3];
+    for(uint32_t k = 0; k < 3; k++)
+    {
+        float inv_w = 1.0f / v[k].clip.w;
+        sx[k] = (v[k].clip.x * inv_w * 0.5f + 0.5f) * width;
+        sy[k] = (0.5f - v[k].clip.y * inv_w * 0.5f) * height;
+        tri.edges.z[k] = v[k].clip.z * inv_w * 0.5f + 0.5f;
+        tri.inv_w[k] = inv_w;
+        tri.position[k] = v[k].position;
+        tri.normal[k] = v[k].normal;
+    }
+
+    // Counterclockwise (front facing) triangles have negative area with y down
+    float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+    if(area == 0.0f || (settings_.cull_back_faces && area > 0.0f))
+    {
+        bins.triangles_culled++;
+        return;
+    }
+
+    // Pixels with centers (x + 0.5, y + 0.5) within the bounding box
+    tri.x0 = std::max(static_cast<int32_t>(std::ceil(std::min({sx[0], sx[1], sx[2]}) - 0.5f)), 0);
+    tri.y0 = std::max(static_cast<int32_t>(std::ceil(std::min({sy[0], sy[1], sy[2]}) - 0.5f)), 0);
+    tri.x1 = std::min(static_cast<int32_t>(std::floor(std::max({sx[0], sx[1], sx[2]}) - 0.5f)),
+                      static_cast<int32_t>(settings_.width) - 1);
+    tri.y1 = std::min(static_cast<int32_t>(std::floor(std::max({sy[0], sy[1], sy[2]}) - 0.5f)),
+                      static_cast<int32_t>(settings_.height) - 1);
+    if(tri.x0 > tri.x1 || tri.y0 > tri.y1)
+    {
+        bins.triangles_culled++;
+        return;
+    }
+
+    // Edge i runs between the other two vertices. Each edge is evaluated from
+    // its lower endpoint (ordered by x, then y) whichever triangle uses it,
+    // and oriented to be positive inside. Negation is exact, so triangles
+    // sharing an edge get exactly opposite values along it.
+    float orientation = (area < 0.0f) ? -1.0f : 1.0f;
+    tri.edges.inv_area = 1.0f / std::abs(area);
+    tri.edges.top_left = 0;
+    for(uint32_t k = 0; k < 3; k++)
+    {
+        uint32_t p = (k + 1) % 3;
+        uint32_t q = (k + 2) % 3;
+        float    sign = orientation;
+        if(sx[q] < sx[p] || (sx[q] == sx[p] && sy[q] < sy[p]))
+        {
+            std::swap(p, q);
+            sign = -sign;
+        }
+        tri.edges.x[k] = sx[p];
+        tri.edges.y[k] = sy[p];
+        tri.edges.a[k] = sign * (sy[p] - sy[q]);
+        tri.edges.b[k] = sign * (sx[q] - sx[p]);
+
+        // Left edges have the inside to the right, top edges (horizontal)
+        // have it below
+        if(tri.edges.a[k] > 0.0f || (tri.edges.a[k] == 0.0f && tri.edges.b[k] > 0.0f))
+        {
+            tri.edges.top_left |= 1u << k;
+        }
+    }
+    tri.instance = instance;
+    tri.order = (static_cast<uint64_t>(instance) << 32) | face;
+
+    uint32_t index = static_cast<uint32_t>(bins.triangles.size());
+    bins.triangles.push_back(tri);
+    for(uint32_t ty = tri.y0 / tile_size_; ty <= tri.y1 / tile_size_; ty++)
+    {
+        for(uint32_t tx = tri.x0 / tile_size_; tx <= tri.x1 / tile_size_; tx++)
+        {
+            bins.tiles[ty * tiles_x_ + tx].push_back(index);
+        }
+    }
+}
+
+uint64_t SoftwareRasterizer::raster_tile(uint32_t tile, ThreadBins &scratch, const Point3 &eye, Image &image) const
+{
+    const int32_t tile_x0 = static_cast<int32_t>((tile % tiles_x_) * tile_size_);
+    const int32_t tile_y0 = static_cast<int32_t>((tile / tiles_x_) * tile_size_);
+    const int32_t tile_x1 = std::min(tile_x0 + static_cast<int32_t>(tile_size_), static_cast<int32_t>(settings_.width));
+    const int32_t tile_y1 = std::min(tile_y0 + static_cast<int32_t>(tile_size_), static_cast<int32_t>(settings_.height));
+
+    // Clear
+    float *depth = scratch.depth.data();
+    std::fill(depth, depth + static_cast<size_t>(tile_size_) * tile_size_, 1.0f);
+    for(int32_t y = tile_y0; y < tile_y1; y++)
+    {
+        for(int32_t x = tile_x0; x < tile_x1; x++) image.set_pixel(x, y, settings_.background);
+    }
+
+    // Triangles in submission order. Threads take face blocks in any order,
+    // so merge the threads' bins. Triangles clipped from one face share its
+    // order and keep the order they were binned in (same thread, increasing
+    // index).
+    std::vector<TileTriangle> &tile_triangles = scratch.tile_triangles;
+    tile_triangles.clear();
+    for(uint32_t thread = 0; thread < bins_.size(); thread++)
+    {
+        for(uint32_t index : bins_[thread].tiles[tile])
+        {
+            tile_triangles.push_back(TileTriangle{bins_[thread].triangles[index].order, thread, index});
+        }
+    }
+    std::sort(tile_triangles.begin(),
+              tile_triangles.end(),
+              [](const TileTriangle &a, const TileTriangle &b)
+              { return (a.order != b.order) ? a.order < b.order : a.index < b.index; });
+
+    const RasterKernels &kernels = get_raster_kernels();
+    uint64_t             fragments = 0;
+    float                b[3][8];
+    for(const TileTriangle &t : tile_triangles)
+    {
+        const SetupTriangle &tri = bins_[t.thread].triangles[t.index];
+        const SceneInstance &instance = scene_.instances[tri.instance];
+        int32_t              x0 = std::max(tri.x0, tile_x0);
+        int32_t              x1 = std::min(tri.x1 + 1, tile_x1);
+        int32_t              y0 = std::max(tri.y0, tile_y0);
+        int32_t              y1 = std::min(tri.y1 + 1, tile_y1);
+
+        // Spans of 8 pixels aligned within the tile
+        int32_t span_x0 = tile_x0 + (x0 - tile_x0) / 8 * 8;
+        for(int32_t y = y0; y < y1; y++)
+        {
+            float *row = depth + static_cast<size_t>(y - tile_y0) * tile_size_ - tile_x0;
+            for(int32_t x = span_x0; x < x1; x += 8)
+            {
+                uint32_t active = 0xff;
+                if(x < x0) active &= 0xffu << (x0 - x);
+                if(x + 8 > x1) active &= 0xffu >> (x + 8 - x1);
+                uint32_t mask = kernels.raster_8(tri.edges, static_cast<float>(x) + 0.5f,
+                                                 static_cast<float>(y) + 0.5f, active, row + x, b[0], b[1],
+                                                 b[2]);
+
+                // Perspective correct interpolation of the world
+                // position and normal, then the fragment shader
+                for(uint32_t i = 0; mask != 0; i++, mask >>= 1)
+                {
+                    if((mask & 1) == 0) continue;
+
+                    float    w0 = b[0][i] * tri.inv_w[0];
+                    float    w1 = b[1][i] * tri.inv_w[1];
+                    float    w2 = b[2][i] * tri.inv_w[2];
+                    float    inv_sum = 1.0f / (w0 + w1 + w2);
+                    w0 *= inv_sum;
+                    w1 *= inv_sum;
+                    w2 *= inv_sum;
+                    Point3 p(tri.position[0].x * w0 + tri.position[1].x * w1 + tri.position[2].x * w2,
+                             tri.position[0].y * w0 + tri.position[1].y * w1 + tri.position[2].y * w2,
+                             tri.position[0].z * w0 + tri.position[1].z * w1 + tri.position[2].z * w2);
+                    Vector3 n = tri.normal[0] * w0 + tri.normal[1] * w1 + tri.normal[2] * w2;
+                    n.normalize();
+                    image.set_pixel(x + i, y,
+                                    shade_phong(instance.material, scene_.lights, settings_.global_ambient, p,
+                                                n, eye, [](const Vector3 &, float) { return true; }));
+                    fragments++;
+                }
+            }
+        }
+    }
+    return fragments;
+}
+
+} // namespace cg
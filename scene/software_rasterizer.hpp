@@ -0,0 +1,198 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    software_rasterizer.hpp
+//	Purpose: Multithreaded tile based CPU rasterizer for a scene graph. Runs
+//           the pipeline of vertex_lighting.vert/.frag (transform, clipping,
+//           back face culling, depth test, perspective correct Phong
+//           shading) without an OpenGL context.
+//
+//============================================================================
+
+#ifndef __SCENE_SOFTWARE_RASTERIZER_HPP__
+#define __SCENE_SOFTWARE_RASTERIZER_HPP__
+
+#include "geometry/hpoint3.hpp"
+#include "scene/camera_node.hpp"
+#include "scene/color4.hpp"
+#include "scene/image.hpp"
+#include "scene/raster_kernels.hpp"
+#include "scene/scene_bvh.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+struct RasterSettings
+{
+    uint32_t width = 800;                                         // Image width (pixels)
+    uint32_t height = 600;                                        // Image height (pixels)
+    uint32_t tile_size = 32;                                      // Tile size (pixels, rounded up to a multiple of 8)
+    uint32_t max_threads = 0;                                     // Maximum threads (0 for all hardware threads)
+    bool     cull_back_faces = true;                              // glCullFace(GL_BACK) with glFrontFace(GL_CCW)
+    Color4   global_ambient = Color4(0.2f, 0.2f, 0.2f, 1.0f);     // Global ambient light
+    Color4   background = Color4(0.0f, 0.0f, 0.0f, 1.0f);         // Clear color
+};
+
+struct RasterStats
+{
+    uint64_t instances_culled;  // Instances outside the view frustum
+    uint64_t triangles;         // Triangles of the visible instances
+    uint64_t triangles_culled;  // Back facing, outside the view or covering no pixel centers
+    uint64_t triangles_clipped; // Triangles clipped by the near plane
+    uint64_t triangles_binned;  // Triangles rasterized (after clipping)
+    uint64_t fragments;         // Fragments shaded (passed the depth test)
+    uint32_t tiles;             // Tiles rasterized
+    uint32_t threads;           // Threads used
+    double   setup_ms;          // Time to transform, clip and bin (milliseconds)
+    double   raster_ms;         // Time to rasterize and shade the tiles (milliseconds)
+    double   render_ms;         // Total time (milliseconds)
+};
+
+/**
+ * Software rasterizer. Renders the instances, materials and lights gathered
+ * from a scene graph (see SceneNode::gather_instances). Frames run in two
+ * parallel passes: vertices are transformed and triangles are clipped,
+ * culled and binned into the screen tiles they overlap, then the tiles are
+ * rasterized and shaded independently with work stealing. Each tile keeps
+ * its own depth buffer. A tile draws its triangles in submission order
+ * (instance, then face) whichever thread binned them, so depth ties resolve
+ * the same way on every run, as in OpenGL.
+ */
+class SoftwareRasterizer
+{
+  public:
+    /**
+     * Constructor.
+     */
+    SoftwareRasterizer();
+
+    /**
+     * Set the settings used by later renders.
+     * @param  settings  Settings.
+     */
+    void set_settings(const RasterSettings &settings);
+
+    /**
+     * Get the settings.
+     * @return  Returns the settings.
+     */
+    const RasterSettings &get_settings() const;
+
+    /**
+     * Gather the instances, materials and lights of a scene graph. Call again
+     * after the scene changes.
+     * @param  root  Root of the scene graph.
+     */
+    void build(SceneNode &root);
+
+    /**
+     * Render the gathered scene as seen by a camera.
+     * @param  camera  Camera (position, orientation and projection).
+     * @param  image   Image to render to (resized to the settings).
+     */
+    void render(const CameraNode &camera, Image &image);
+
+    /**
+     * Get the statistics of the last render.
+     * @return  Returns the statistics.
+     */
+    const RasterStats &get_stats() const;
+
+    /**
+     * Get the gathered scene.
+     * @return  Returns the instances, lights and current material.
+     */
+    const SceneGather &get_scene() const;
+
+  protected:
+    // Transformed vertex (outputs of the vertex shader)
+    struct ClipVertex
+    {
+        HPoint3 clip;     // Clip coordinates
+        Point3  position; // World position
+        Vector3 normal;   // Unit world normal
+    };
+
+    // Triangle after clipping, ready to rasterize
+    struct SetupTriangle
+    {
+        RasterEdges edges;
+        float       inv_w[3];    // 1 / w of each vertex (perspective correction)
+        Point3      position[3]; // World positions
+        Vector3     normal[3];   // World normals
+        uint32_t    instance;    // Instance index (material)
+        uint64_t    order;       // Submission order: instance (high half), then face
+        int32_t     x0, y0;      // Pixel bounds (inclusive)
+        int32_t     x1, y1;
+    };
+
+    // Triangle binned to a tile: the binning thread and the triangle index
+    // in its bins
+    struct TileTriangle
+    {
+        uint64_t order;
+        uint32_t thread;
+        uint32_t index;
+    };
+
+    // Triangles and tile bins filled by one thread in the setup pass, and its
+    // tile depth buffer and triangle order in the raster pass
+    struct ThreadBins
+    {
+        std::vector<SetupTriangle>         triangles;
+        std::vector<std::vector<uint32_t>> tiles;
+        std::vector<float>                 depth;
+        std::vector<TileTriangle>          tile_triangles;
+        uint64_t                           triangles_culled;
+        uint64_t                           triangles_clipped;
+    };
+
+    RasterSettings          settings_;
+    RasterStats             stats_;
+    SceneGather             scene_;
+    std::vector<ClipVertex> vertices_;
+    std::vector<ThreadBins> bins_;
+
+    // Tile layout of the current render
+    uint32_t tile_size_;
+    uint32_t tiles_x_;
+    uint32_t tiles_y_;
+
+    /**
+     * Clip a triangle against the near plane, then cull and bin the result.
+     * @param  v         The 3 transformed vertices.
+     * @param  instance  Instance index.
+     * @param  face      Face index within the instance's surface.
+     * @param  bins      Bins of the calling thread.
+     */
+    void setup_triangle(const ClipVertex *const *v, uint32_t instance, uint32_t face, ThreadBins &bins);
+
+    /**
+     * Cull a clipped triangle or add it to the tiles it overlaps.
+     * @param  v         The 3 vertices (in front of the near plane).
+     * @param  instance  Instance index.
+     * @param  face      Face index within the instance's surface.
+     * @param  bins      Bins of the calling thread.
+     */
+    void bin_triangle(const ClipVertex *v, uint32_t instance, uint32_t face, ThreadBins &bins);
+
+    /**
+     * Rasterize and shade the triangles binned to a tile.
+     * @param  tile     Tile index.
+     * @param  scratch  Depth buffer and triangle order of the calling thread.
+     * @param  eye      Camera position.
+     * @param  image    Image.
+     * @return  Returns the number of fragments shaded.
+     */
+    uint64_t raster_tile(uint32_t tile, ThreadBins &scratch, const Point3 &eye, Image &image) const;
+};
+
+} // namespace cg
+
+#endif
@@ -1,6 +1,7 @@
 #include "scene/sphere_section.hpp"
 
 #include "geometry/geometry.hpp"
+#include "geometry/profiler.hpp"
 
 #include <cmath>
 
@@ -19,6 +20,8 @@ SphereSection::SphereSection(float    min_lat,
                              int32_t  position_loc,
                              int32_t  normal_loc)
 {
+    CG_PROFILE_ZONE("SphereSection::SphereSection");
+
     // Convert to radians
     float min_lat_rad = degrees_to_radians(min_lat);
     float max_lat_rad = degrees_to_radians(max_lat);
@@ -30,6 +33,10 @@ SphereSection::SphereSection(float    min_lat,
     float           d_lat = (max_lat_rad - min_lat_rad) / static_cast<float>(num_lat);
     float           d_lon = (max_lon_rad - min_lon_rad) / static_cast<float>(num_lon);
     VertexAndNormal vtx;
+
+    // The float loops form num_lon+1 columns of num_lat+1 rows (give or take
+    // one for rounding), then the first column is copied
+    vertices_.reserve(static_cast<size_t>(num_lon + 3) * (num_lat + 2));
     for(float curr_lon = min_lon_rad; curr_lon < max_lon_rad + EPSILON; curr_lon += d_lon)
     {
         cos_lon = std::cos(curr_lon);
@@ -1,5 +1,7 @@
 #include "scene/surface_of_revolution.hpp"
 
+#include "geometry/profiler.hpp"
+
 #include <algorithm>
 
 namespace cg
@@ -12,6 +14,8 @@ SurfaceOfRevolution::SurfaceOfRevolution(std::vector<Point3> &v,
                                          int32_t              position_loc,
                                          int32_t              normal_loc)
 {
+    CG_PROFILE_ZONE("SurfaceOfRevolution::SurfaceOfRevolution");
+
     // Set number of rows and columns
     num_rows_ = static_cast<uint32_t>(v.size());
     num_cols_ = n + 1;
@@ -19,6 +23,7 @@ SurfaceOfRevolution::SurfaceOfRevolution(std::vector<Point3> &v,
     // Add vertices to the vertex list, compute normals
     Vector3         normal, prev_normal;
     VertexAndNormal vtx;
+    vertices_.reserve(static_cast<size_t>(num_rows_) * (num_cols_ + 1));
     auto            vtx_iter_1 = v.begin();
     auto            vtx_iter_2 = vtx_iter_1 + 1;
     for(uint32_t i = 0; vtx_iter_2 != v.end(); vtx_iter_1++, vtx_iter_2++, i++)
@@ -51,21 +56,29 @@ SurfaceOfRevolution::SurfaceOfRevolution(std::vector<Point3> &v,
     // ConstructRowColFaceList forms ccw triangles
     std::reverse(vertices_.begin(), vertices_.end());
 
-    // Create a rotation matrix
-    Matrix4x4 m;
-    m.rotate_z(360.0f / static_cast<float>(n));
+    // Gather the edge vertices and normals so each column can be rotated as a batch
+    std::vector<Point3>  edge_vertices(num_rows_);
+    std::vector<Vector3> edge_normals(num_rows_);
+    for(uint32_t j = 0; j < num_rows_; j++)
+    {
+        edge_vertices[j] = vertices_[j].vertex;
+        edge_normals[j] = vertices_[j].normal;
+    }
 
-    // Rotate the prior "edge" vertices
-    uint32_t index = 0; // Index to the prior edge at this row
-    for(uint32_t i = 0; i < n; i++)
+    // Rotate the edge to form each column
+    std::vector<Point3>  column_vertices(num_rows_);
+    std::vector<Vector3> column_normals(num_rows_);
+    for(uint32_t i = 1; i <= n; i++)
     {
+        Matrix4x4 m;
+        m.rotate_z(360.0f * static_cast<float>(i) / static_cast<float>(n));
+        m.transform_points(edge_vertices.data(), column_vertices.data(), num_rows_);
+        m.transform_vectors(edge_normals.data(), column_normals.data(), num_rows_);
         for(uint32_t j = 0; j < num_rows_; j++)
         {
-            // Rotate the vertex and the normal
-            vtx.vertex = m * vertices_[index].vertex;
-            vtx.normal = m * vertices_[index].normal;
+            vtx.vertex = column_vertices[j];
+            vtx.normal = column_normals[j];
             vertices_.push_back(vtx);
-            index++;
         }
     }
 
@@ -1,9 +1,12 @@
 #include "scene/transform_node.hpp"
 
+#include "geometry/profiler.hpp"
+#include "scene/scene_store.hpp"
+
 namespace cg
 {
 
-TransformNode::TransformNode()
+TransformNode::TransformNode() : next_slot_(0)
 {
     node_type_ = SceneNodeType::TRANSFORM;
     load_identity();
@@ -11,47 +14,164 @@ TransformNode::TransformNode()
 
 TransformNode::~TransformNode() {}
 
-void TransformNode::load_identity() { model_matrix_.set_identity(); }
+void TransformNode::load_identity()
+{
+    model_matrix_.set_identity();
+    local_changed();
+}
 
-void TransformNode::translate(float x, float y, float z) { model_matrix_.translate(x, y, z); }
+void TransformNode::translate(float x, float y, float z)
+{
+    model_matrix_.translate(x, y, z);
+    local_changed();
+}
 
-void TransformNode::rotate(float deg, Vector3 &v) { model_matrix_.rotate(deg, v.x, v.y, v.z); }
+void TransformNode::rotate(float deg, Vector3 &v)
+{
+    model_matrix_.rotate(deg, v.x, v.y, v.z);
+    local_changed();
+}
 
-void TransformNode::rotate_x(float deg) { model_matrix_.rotate_x(deg); }
+void TransformNode::rotate_x(float deg)
+{
+    model_matrix_.rotate_x(deg);
+    local_changed();
+}
 
-void TransformNode::rotate_y(float deg) { model_matrix_.rotate_y(deg); }
+void TransformNode::rotate_y(float deg)
+{
+    model_matrix_.rotate_y(deg);
+    local_changed();
+}
 
-void TransformNode::rotate_z(float deg) { model_matrix_.rotate_z(deg); }
+void TransformNode::rotate_z(float deg)
+{
+    model_matrix_.rotate_z(deg);
+    local_changed();
+}
 
-void TransformNode::scale(float x, float y, float z) { model_matrix_.scale(x, y, z); }
+void TransformNode::scale(float x, float y, float z)
+{
+    model_matrix_.scale(x, y, z);
+    local_changed();
+}
 
 void TransformNode::draw(SceneState &scene_state)
 {
+    CG_PROFILE_ZONE("TransformNode::draw");
+
     // Copy current transforms onto stack
     scene_state.push_transforms();
+    uint64_t  parent_version = scene_state.model_version;
+    Matrix4x4 parent_normal_matrix = scene_state.normal_matrix;
 
-    // Apply this modeling transform to the current modeling matrix.
-    // Note the right-multiply - this allows hierarchical transformations
-    // in the scene
-    scene_state.model_matrix *= model_matrix_;
-    glUniformMatrix4fv(scene_state.model_matrix_loc, 1, GL_FALSE, scene_state.model_matrix.get());
+    // Apply this modeling transform to the current modeling matrix (cached).
+    const CachedTransform &cached = get_cached_transform(scene_state, true);
+    scene_state.model_matrix = cached.model_matrix;
+    scene_state.normal_matrix = cached.normal_matrix;
+    scene_state.model_version = cached.version;
+    scene_state.gl_state.uniform_matrix4fv(scene_state.model_matrix_loc, cached.model_matrix.get());
 
     // Set the normal transform matrix (transpose of the inverse of the model matrix).
     // This transforms normals into view coordinates
-    Matrix4x4 normal_matrix = scene_state.model_matrix.get_inverse().transpose();
-    glUniformMatrix4fv(scene_state.normal_matrix_loc, 1, GL_FALSE, normal_matrix.get());
+    scene_state.gl_state.uniform_matrix4fv(scene_state.normal_matrix_loc, cached.normal_matrix.get());
 
     // Set the composite projection, view, modeling matrix
-    Matrix4x4 pvm = scene_state.pv * scene_state.model_matrix;
-    glUniformMatrix4fv(scene_state.pvm_matrix_loc, 1, GL_FALSE, pvm.get());
+    scene_state.gl_state.uniform_matrix4fv(scene_state.pvm_matrix_loc, cached.pvm_matrix.get());
 
     // Draw all children
     SceneNode::draw(scene_state);
 
     // Pop matrix stack to revert to prior matrices
     scene_state.pop_transforms();
+    scene_state.model_version = parent_version;
+    scene_state.normal_matrix = parent_normal_matrix;
 }
 
-void TransformNode::update(SceneState &scene_state) {}
+void TransformNode::update(SceneState &) {}
+
+void TransformNode::compile(RenderQueue &queue, SceneState &scene_state)
+{
+    // Same matrix composition as draw - the draw records capture the composite matrices
+    scene_state.push_transforms();
+    uint64_t  parent_version = scene_state.model_version;
+    Matrix4x4 parent_normal_matrix = scene_state.normal_matrix;
+
+    const CachedTransform &cached = get_cached_transform(scene_state, false);
+    scene_state.model_matrix = cached.model_matrix;
+    scene_state.normal_matrix = cached.normal_matrix;
+    scene_state.model_version = cached.version;
+
+    // The subtree's draw records are culled together
+    uint32_t range = queue.begin_range();
+    SceneNode::compile(queue, scene_state);
+    queue.end_range(range);
+
+    scene_state.pop_transforms();
+    scene_state.model_version = parent_version;
+    scene_state.normal_matrix = parent_normal_matrix;
+}
+
+void TransformNode::flatten(SceneStore &store, uint32_t parent)
+{
+    flatten_children(store, store.add_transform(parent, model_matrix_));
+}
+
+void TransformNode::gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix)
+{
+    SceneNode::gather_instances(gather, model_matrix * model_matrix_);
+}
+
+void TransformNode::local_changed()
+{
+    for(auto &c : cache_) c.parent_version = INVALID_VERSION;
+    graph_changed();
+}
+
+const TransformNode::CachedTransform &TransformNode::get_cached_transform(SceneState &scene_state,
+                                                                          bool        need_pvm)
+{
+    // Find the slot computed from the current parent matrix
+    CachedTransform *cached = nullptr;
+    for(auto &c : cache_)
+    {
+        if(c.parent_version == scene_state.model_version)
+        {
+            cached = &c;
+            break;
+        }
+    }
+
+    // Not cached (or the local transform changed): replace the oldest slot.
+    // Note the right-multiply - this allows hierarchical transformations
+    if(cached == nullptr)
+    {
+        cached = &cache_[next_slot_];
+        next_slot_ = (next_slot_ + 1) % CACHE_SLOTS;
+
+        cached->model_matrix = scene_state.model_matrix * model_matrix_;
+        cached->normal_matrix = cached->model_matrix.get_normal_matrix();
+        cached->parent_version = scene_state.model_version;
+        cached->version = SceneState::next_matrix_version();
+        cached->pv_version = INVALID_VERSION;
+        scene_state.transform_counters.world_updates++;
+        scene_state.transform_counters.normal_updates++;
+    }
+
+    // The composite PVM matrix also depends on the camera
+    if(need_pvm && cached->pv_version != scene_state.pv_version)
+    {
+        cached->pvm_matrix = scene_state.pv * cached->model_matrix;
+        cached->pv_version = scene_state.pv_version;
+        scene_state.transform_counters.pvm_updates++;
+    }
+    return *cached;
+}
+
+void TransformNode::update_bound()
+{
+    SceneNode::update_bound();
+    bound_ = bound_.transform(model_matrix_);
+}
 
 } // namespace cg
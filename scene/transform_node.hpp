@@ -16,12 +16,20 @@
 
 #include "geometry/geometry.hpp"
 
+#include <array>
+
 namespace cg
 {
 
 /**
  * Transform node. Applies a transformation. This class allows OpenGL style
  * transforms applied to the scene graph.
+ *
+ * The composite (world) matrix, normal matrix and composite PVM matrix are
+ * cached. They are recomputed only when the local transform, the parent
+ * matrix (identified by its version) or the camera changes. A node may be
+ * shared by more than one parent, so a small number of cache slots are kept
+ * (one per distinct parent matrix).
  */
 class TransformNode : public SceneNode
 {
@@ -94,8 +102,56 @@ class TransformNode : public SceneNode
      */
     void update(SceneState &scene_state) override;
 
+    /**
+     * Compile this transformation node and its children into a render queue.
+     * @param  queue         Render queue
+     * @param  scene_state   Current scene state
+     */
+    void compile(RenderQueue &queue, SceneState &scene_state) override;
+
+    /**
+     * Flatten this transformation node and its children into a scene store.
+     * @param  store   Scene store
+     * @param  parent  Handle of the parent in the store
+     */
+    void flatten(SceneStore &store, uint32_t parent) override;
+
+    /**
+     * Gather the geometry instances of the children using the composite
+     * modeling matrix.
+     * @param  gather        Instance and light lists.
+     * @param  model_matrix  Composite modeling matrix of the parent.
+     */
+    void gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix) override;
+
   protected:
-    Matrix4x4 model_matrix_; // Local modeling transformation
+    // Cached matrices computed from one parent matrix
+    struct CachedTransform
+    {
+        uint64_t  parent_version; // Version of the parent modeling matrix
+        uint64_t  version;        // Version of the composite modeling matrix
+        uint64_t  pv_version;     // Version of the PV matrix used to form pvm_matrix
+        Matrix4x4 model_matrix;   // Composite modeling matrix
+        Matrix4x4 normal_matrix;  // Normal matrix (transpose of the inverse)
+        Matrix4x4 pvm_matrix;     // Composite projection, view, modeling matrix
+    };
+
+    static constexpr uint32_t CACHE_SLOTS = 2;
+    static constexpr uint64_t INVALID_VERSION = ~0ull;
+
+    Matrix4x4                                model_matrix_; // Local modeling transformation
+    std::array<CachedTransform, CACHE_SLOTS> cache_;
+    uint32_t                                 next_slot_; // Next cache slot to replace
+
+    // Mark the cached matrices out of date (local transform changed)
+    void local_changed();
+
+    // Bound of the children transformed by the local transform
+    void update_bound() override;
+
+    // Get the cached matrices for the current parent matrix and camera in the
+    // scene state. Recomputes the matrices that are out of date.
+    const CachedTransform &get_cached_transform(SceneState &scene_state, bool need_pvm);
 };
 
 } // namespace cg
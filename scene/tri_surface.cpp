@@ -1,29 +1,184 @@
 #include "scene/tri_surface.hpp"
 
+#include "geometry/mesh_optimizer.hpp"
+#include "geometry/parallel.hpp"
+#include "geometry/profiler.hpp"
+#include "geometry/vertex_packing.hpp"
+#include "scene/scene_bvh.hpp"
+#include "scene/scene_store.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
 namespace cg
 {
 
-TriSurface::TriSurface() : vao_{0}, vbo_{0}, facebuffer_{0}, GeometryNode() {}
+namespace
+{
+
+// Hash 3 integer coordinates (position bits or grid cell) into a 64 bit key.
+// Keys may collide so candidates are always compared against the position.
+uint64_t hash_cell(uint64_t x, uint64_t y, uint64_t z)
+{
+    uint64_t h = x * 0x9E3779B97F4A7C15ull;
+    h ^= y * 0xC2B2AE3D27D4EB4Full;
+    h ^= z * 0x165667B19E3779F9ull;
+    return h ^ (h >> 29);
+}
+
+// Bit pattern of a float. Adding 0 maps -0 to +0 so they hash the same.
+uint64_t float_bits(float f)
+{
+    f += 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+// Grid cell containing a coordinate (clamped so the conversion cannot overflow)
+int64_t weld_cell(float v, float tolerance)
+{
+    double c = std::floor(static_cast<double>(v) / tolerance);
+    return static_cast<int64_t>(std::max(-4.0e18, std::min(c, 4.0e18)));
+}
+
+// Interior angle between 2 edges leaving a corner (0 if an edge has no length)
+float corner_angle(const Vector3 &a, const Vector3 &b)
+{
+    float len = std::sqrt(a.norm_squared() * b.norm_squared());
+    if(len <= 0.0f) return 0.0f;
+    return std::acos(std::max(-1.0f, std::min(a.dot(b) / len, 1.0f)));
+}
+
+// Minimum number of faces per thread for vertex normals
+constexpr size_t NORMAL_MIN_BLOCK = 32768;
+
+// Largest vertex count that can be indexed with uint16_t
+constexpr size_t MAX_UINT16_VERTICES = 65536;
+
+// Split a face list into submeshes that each use at most MAX_UINT16_VERTICES
+// vertices. Triangles keep their order. Each submesh gets its own copy of the
+// vertices it uses (vertices on submesh boundaries are duplicated) and its
+// indexes are relative to the first vertex of the submesh.
+void split_faces(const std::vector<VertexAndNormal> &vertices,
+                 const std::vector<uint32_t>        &faces,
+                 std::vector<VertexAndNormal>       &split_vertices,
+                 std::vector<uint16_t>              &split_indexes,
+                 std::vector<size_t>                &vertex_starts,
+                 std::vector<size_t>                &index_starts)
+{
+    constexpr uint32_t UNUSED = 0xFFFFFFFF;
+
+    // Index of each vertex within the current submesh
+    std::vector<uint32_t> local(vertices.size(), UNUSED);
+    std::vector<uint32_t> used;
+
+    vertex_starts.push_back(0);
+    index_starts.push_back(0);
+    split_indexes.reserve(faces.size());
+    for(size_t f = 0; f + 2 < faces.size(); f += 3)
+    {
+        // Start a new submesh if this triangle's new vertices do not fit
+        size_t new_vertices = 0;
+        for(size_t k = 0; k < 3; k++) new_vertices += (local[faces[f + k]] == UNUSED);
+        if(used.size() + new_vertices > MAX_UINT16_VERTICES)
+        {
+            for(uint32_t v : used) local[v] = UNUSED;
+            used.clear();
+            vertex_starts.push_back(split_vertices.size());
+            index_starts.push_back(split_indexes.size());
+        }
+
+        for(size_t k = 0; k < 3; k++)
+        {
+            uint32_t v = faces[f + k];
+            if(local[v] == UNUSED)
+            {
+                local[v] = static_cast<uint32_t>(used.size());
+                used.push_back(v);
+                split_vertices.push_back(vertices[v]);
+            }
+            split_indexes.push_back(static_cast<uint16_t>(local[v]));
+        }
+    }
+}
+
+} // namespace
+
+bool TriSurface::mesh_optimization_ = true;
+
+TriSurface::TriSurface() :
+    GeometryNode(),
+    vbo_{0},
+    facebuffer_{0},
+    index_type_{GL_UNSIGNED_SHORT},
+    index_format_{IndexFormat::AUTO},
+    vertex_format_{VertexFormat::FLOAT},
+    quantization_{Vector3(1.0f, 1.0f, 1.0f), Vector3(0.0f, 0.0f, 0.0f)},
+    vertex_buffer_size_{0},
+    index_buffer_size_{0},
+    bvh_valid_{false},
+    normal_weighting_{NormalWeighting::UNIFORM},
+    weld_tolerance_{0.0f},
+    weld_count_{0},
+    weld_hash_{WeldHash::allocator_type(weld_arena_)}
+{
+}
 
 TriSurface::~TriSurface()
 {
     // Delete vertex buffer objects
-    glDeleteBuffers(1, &vbo_);
-    glDeleteBuffers(1, &facebuffer_);
-    glDeleteVertexArrays(1, &vao_);
+    delete_vertex_buffers();
 }
 
 void TriSurface::draw(SceneState &scene_state)
 {
-    glBindVertexArray(vao_);
-    glDrawElements(GL_TRIANGLES, face_count_, GL_UNSIGNED_SHORT, (void *)0);
-    glBindVertexArray(0);
+    CG_PROFILE_ZONE("TriSurface::draw");
+
+    // Vertex format and position dequantization (if the shader supports packed vertices)
+    if(scene_state.vertex_format_loc >= 0)
+    {
+        scene_state.gl_state.uniform1i(scene_state.vertex_format_loc, static_cast<GLint>(vertex_format_));
+        scene_state.gl_state.uniform3fv(scene_state.position_scale_loc, &quantization_.scale.x);
+        scene_state.gl_state.uniform3fv(scene_state.position_offset_loc, &quantization_.offset.x);
+    }
+    scene_state.flush_frame_block();
+
+    for(const auto &submesh : submeshes_)
+    {
+        scene_state.gl_state.bind_vertex_array(submesh.vao);
+        glDrawElements(
+            GL_TRIANGLES, submesh.index_count, index_type_, (void *)submesh.index_offset);
+    }
+    scene_state.gl_state.bind_vertex_array(0);
+}
+
+void TriSurface::compile(RenderQueue &queue, SceneState &scene_state)
+{
+    for(uint32_t i = 0; i < get_submesh_count(); i++)
+    {
+        queue.add_draw(get_draw_geometry(i), scene_state);
+    }
 }
 
-void TriSurface::construct(const std::vector<VertexAndNormal> &v, const std::vector<uint16_t> &f)
+void TriSurface::flatten(SceneStore &store, uint32_t parent)
+{
+    for(uint32_t i = 0; i < get_submesh_count(); i++) { store.add_geometry(parent, get_draw_geometry(i)); }
+}
+
+void TriSurface::gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix)
+{
+    gather.instances.push_back(SceneInstance(this, model_matrix, gather.material));
+}
+
+void TriSurface::construct(const std::vector<VertexAndNormal> &v, const std::vector<uint32_t> &f)
 {
     vertices_ = v;
     faces_ = f;
+    bvh_valid_ = false;
+    release_weld_hash();
 }
 
 void TriSurface::add_polygon(const std::vector<Point3> &vertex_list)
@@ -59,92 +214,469 @@ void TriSurface::add(const Point3 &v0, const Point3 &v1, const Point3 &v2)
     faces_.push_back(add_vertex(v2));
 }
 
+void TriSurface::set_weld_tolerance(float tolerance)
+{
+    // The hash depends on the tolerance so rebuild it on the next add
+    weld_tolerance_ = std::max(tolerance, 0.0f);
+    release_weld_hash();
+}
+
+float TriSurface::get_weld_tolerance() const { return weld_tolerance_; }
+
 void TriSurface::end(int32_t position_loc, int32_t normal_loc)
 {
-    // Iterate through the face list and calculate the normals for each
-    // face and add the normal to each vertex in the face list. This
-    // assumes the vertex normals are initilaized to 0 (in constructor
-    // of VertexAndNormal)
-    uint32_t v0, v1, v2;
-    Vector3  e1, e2, face_normal;
-    auto     face_vertex = faces_.begin();
-    while(face_vertex != faces_.end())
-    {
-        // Get the vertices of the face (assumes ccw order)
-        v0 = *face_vertex++;
-        v1 = *face_vertex++;
-        v2 = *face_vertex++;
-
-        // Calculate surface normal. Normalize it since cross products
-        // do not ensure unit length normals. We need to make sure normals
-        // are same length so averaging works properly
-        e1.set(vertices_[v0].vertex, vertices_[v1].vertex);
-        e2.set(vertices_[v0].vertex, vertices_[v2].vertex);
-        face_normal = (e1.cross(e2)).normalize();
-
-        // Add the face normal to the vertex normals of the triangle
-        vertices_[v0].normal += face_normal;
-        vertices_[v1].normal += face_normal;
-        vertices_[v2].normal += face_normal;
-    }
-
-    // Normalize the vertex normals - this essentially averages the
-    // adjoining face normals.
-    for(auto &v : vertices_) { v.normal.normalize(); }
+    CG_PROFILE_ZONE("TriSurface::end");
+
+    // Calculate the vertex normals from the face normals
+    compute_vertex_normals();
+
+    // The spatial hash is only needed while adding triangles. Release it (it
+    // is rebuilt if more triangles are added).
+    release_weld_hash();
 
     // Create the vertex and face buffers
     create_vertex_buffers(position_loc, normal_loc);
 }
 
+void TriSurface::set_normal_weighting(NormalWeighting weighting) { normal_weighting_ = weighting; }
+
+NormalWeighting TriSurface::get_normal_weighting() const { return normal_weighting_; }
+
+void TriSurface::compute_vertex_normals(bool allow_threads)
+{
+    CG_PROFILE_ZONE("TriSurface::compute_vertex_normals");
+    size_t face_count = faces_.size() / 3;
+    size_t blocks = allow_threads ? std::min<size_t>(get_thread_count(), face_count / NORMAL_MIN_BLOCK) : 1;
+    if(blocks < 2)
+    {
+        // Iterate through the face list and calculate the normals for each
+        // face and add the normal to each vertex in the face list. This
+        // assumes the vertex normals are initilaized to 0 (in constructor
+        // of VertexAndNormal)
+        for(size_t f = 0; f < face_count; f++)
+        {
+            FaceNormal face_normal = get_face_normal(&faces_[f * 3]);
+            for(uint32_t k = 0; k < 3; k++)
+            {
+                vertices_[faces_[f * 3 + k]].normal += face_normal.normal * face_normal.weight[k];
+            }
+        }
+
+        // Normalize the vertex normals - this essentially averages the
+        // adjoining face normals.
+        for(auto &v : vertices_) { v.normal.normalize(); }
+        return;
+    }
+
+    // Each thread adds the normals of one contiguous block of faces: block 0
+    // into the vertex normals, the others into their own partial sums. Then
+    // each thread adds the partial sums of a range of vertices in block order
+    // and normalizes. The sums are always formed in the same order, so the
+    // result does not change from run to run (it may differ from the single
+    // threaded result by rounding).
+    size_t               vertex_count = vertices_.size();
+    std::vector<Vector3> partial_normals((blocks - 1) * vertex_count);
+    parallel_for(blocks,
+                 1,
+                 [&](size_t first_block, size_t last_block)
+                 {
+                     for(size_t b = first_block; b < last_block; b++)
+                     {
+                         Vector3 *partial = (b == 0) ? nullptr : &partial_normals[(b - 1) * vertex_count];
+                         for(size_t f = b * face_count / blocks; f < (b + 1) * face_count / blocks; f++)
+                         {
+                             const uint32_t *face = &faces_[f * 3];
+                             FaceNormal      face_normal = get_face_normal(face);
+                             for(uint32_t k = 0; k < 3; k++)
+                             {
+                                 Vector3 &normal =
+                                     (partial == nullptr) ? vertices_[face[k]].normal : partial[face[k]];
+                                 normal += face_normal.normal * face_normal.weight[k];
+                             }
+                         }
+                     }
+                 });
+    parallel_for(vertex_count,
+                 NORMAL_MIN_BLOCK,
+                 [&](size_t begin, size_t end)
+                 {
+                     for(size_t v = begin; v < end; v++)
+                     {
+                         Vector3 &normal = vertices_[v].normal;
+                         for(size_t b = 1; b < blocks; b++) normal += partial_normals[(b - 1) * vertex_count + v];
+                         normal.normalize();
+                     }
+                 });
+}
+
+TriSurface::FaceNormal TriSurface::get_face_normal(const uint32_t *face) const
+{
+    // Get the vertices of the face (assumes ccw order)
+    const Point3 &p0 = vertices_[face[0]].vertex;
+    const Point3 &p1 = vertices_[face[1]].vertex;
+    const Point3 &p2 = vertices_[face[2]].vertex;
+
+    // Calculate surface normal. The cross product length is twice the area of
+    // the triangle, which is the weight used for area weighting. Otherwise
+    // normalize it since cross products do not ensure unit length normals.
+    FaceNormal face_normal;
+    Vector3    e1(p0, p1);
+    Vector3    e2(p0, p2);
+    face_normal.normal = e1.cross(e2);
+    face_normal.weight[0] = face_normal.weight[1] = face_normal.weight[2] = 1.0f;
+    if(normal_weighting_ == NormalWeighting::AREA) return face_normal;
+
+    face_normal.normal.normalize();
+    if(normal_weighting_ == NormalWeighting::ANGLE)
+    {
+        // Interior angle at each corner (0 for degenerate edges)
+        Vector3 e3(p1, p2);
+        face_normal.weight[0] = corner_angle(e1, e2);
+        face_normal.weight[1] = corner_angle(e1 * -1.0f, e3);
+        face_normal.weight[2] = corner_angle(e2, e3);
+    }
+    return face_normal;
+}
+
 void TriSurface::create_vertex_buffers(int32_t position_loc, int32_t normal_loc)
 {
+    CG_PROFILE_ZONE("TriSurface::create_vertex_buffers");
+    if(mesh_optimization_) optimize_mesh();
+    delete_vertex_buffers();
+
+    // Bound used for view frustum culling. New buffers also invalidate
+    // compiled render queues.
+    vertex_bound_ = AABB();
+    for(const auto &v : vertices_) { vertex_bound_.add(v.vertex); }
+    bvh_valid_ = false;
+    graph_changed();
+
+    // No OpenGL objects without a position attribute (no OpenGL context)
+    if(position_loc < 0) return;
+
     // Generate vertex buffers for the vertex list and the face list
     glGenBuffers(1, &vbo_);
     glGenBuffers(1, &facebuffer_);
 
-    // Bind the vertex list to the vertex buffer object
+    bool fits_uint16 = vertices_.size() <= MAX_UINT16_VERTICES;
+    if(index_format_ == IndexFormat::UINT32 || (index_format_ == IndexFormat::AUTO && !fits_uint16))
+    {
+        // Bind the vertex list and the face list (uint32_t indexes)
+        index_type_ = GL_UNSIGNED_INT;
+        upload_vertices(vertices_);
+        index_buffer_size_ = faces_.size() * sizeof(uint32_t);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, facebuffer_);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_size_, (void *)faces_.data(), GL_STATIC_DRAW);
+        submeshes_.push_back({create_vertex_array(position_loc, normal_loc, 0),
+                              static_cast<GLsizei>(faces_.size()),
+                              0,
+                              0});
+    }
+    else if(fits_uint16)
+    {
+        // Bind the vertex list and the face list (narrowed to uint16_t indexes)
+        index_type_ = GL_UNSIGNED_SHORT;
+        std::vector<uint16_t> indexes(faces_.begin(), faces_.end());
+        upload_vertices(vertices_);
+        index_buffer_size_ = indexes.size() * sizeof(uint16_t);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, facebuffer_);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_size_, (void *)indexes.data(), GL_STATIC_DRAW);
+        submeshes_.push_back({create_vertex_array(position_loc, normal_loc, 0),
+                              static_cast<GLsizei>(indexes.size()),
+                              0,
+                              0});
+    }
+    else
+    {
+        // Too many vertices for uint16_t indexes. Split into submeshes, each
+        // with its own range of the vertex buffer and its own VAO.
+        index_type_ = GL_UNSIGNED_SHORT;
+        std::vector<VertexAndNormal> split_vertices;
+        std::vector<uint16_t>        split_indexes;
+        std::vector<size_t>          vertex_starts;
+        std::vector<size_t>          index_starts;
+        split_faces(vertices_, faces_, split_vertices, split_indexes, vertex_starts, index_starts);
+
+        upload_vertices(split_vertices);
+        index_buffer_size_ = split_indexes.size() * sizeof(uint16_t);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, facebuffer_);
+        glBufferData(
+            GL_ELEMENT_ARRAY_BUFFER, index_buffer_size_, (void *)split_indexes.data(), GL_STATIC_DRAW);
+        for(size_t i = 0; i < index_starts.size(); i++)
+        {
+            size_t index_end =
+                (i + 1 < index_starts.size()) ? index_starts[i + 1] : split_indexes.size();
+            size_t vertex_offset = vertex_starts[i] * get_vertex_size();
+            submeshes_.push_back({create_vertex_array(position_loc, normal_loc, vertex_offset),
+                                  static_cast<GLsizei>(index_end - index_starts[i]),
+                                  index_starts[i] * sizeof(uint16_t),
+                                  vertex_offset});
+        }
+    }
+
+    // We could clear any local memory as it is now in the VBO. However there may be
+    // cases where we want to keep it (e.g. collision detection, picking) so I am not
+    // going to do that here.
+}
+
+void TriSurface::optimize_mesh()
+{
+    CG_PROFILE_ZONE("TriSurface::optimize_mesh");
+    bvh_valid_ = false;
+    optimize_vertex_cache(faces_, vertices_.size());
+    optimize_overdraw(faces_, vertices_);
+    optimize_vertex_fetch(faces_, vertices_);
+
+    // Vertex indexes changed so the spatial hash must be rebuilt
+    release_weld_hash();
+}
+
+void TriSurface::set_mesh_optimization(bool enable) { mesh_optimization_ = enable; }
+
+bool TriSurface::get_mesh_optimization() { return mesh_optimization_; }
+
+void TriSurface::set_index_format(IndexFormat format) { index_format_ = format; }
+
+IndexFormat TriSurface::get_index_format() const { return index_format_; }
+
+GLenum TriSurface::get_index_type() const { return index_type_; }
+
+uint32_t TriSurface::get_submesh_count() const { return static_cast<uint32_t>(submeshes_.size()); }
+
+DrawGeometry TriSurface::get_draw_geometry(uint32_t submesh) const
+{
+    const SubMesh &s = submeshes_[submesh];
+    return {s.vao,
+            vbo_,
+            facebuffer_,
+            s.index_count,
+            index_type_,
+            s.index_offset,
+            s.vertex_offset,
+            0,
+            vertex_format_,
+            quantization_,
+            vertex_bound_};
+}
+
+void TriSurface::set_vertex_format(VertexFormat format) { vertex_format_ = format; }
+
+VertexFormat TriSurface::get_vertex_format() const { return vertex_format_; }
+
+const VertexQuantization &TriSurface::get_vertex_quantization() const { return quantization_; }
+
+size_t TriSurface::get_vertex_size() const
+{
+    return (vertex_format_ == VertexFormat::PACKED) ? sizeof(PackedVertexAndNormal)
+                                                    : sizeof(VertexAndNormal);
+}
+
+size_t TriSurface::get_vertex_buffer_size() const { return vertex_buffer_size_; }
+
+size_t TriSurface::get_index_buffer_size() const { return index_buffer_size_; }
+
+void TriSurface::upload_vertices(const std::vector<VertexAndNormal> &vertices)
+{
     glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBufferData(GL_ARRAY_BUFFER,
-                 vertices_.size() * sizeof(VertexAndNormal),
-                 (void *)&vertices_[0],
-                 GL_STATIC_DRAW);
+    if(vertex_format_ == VertexFormat::PACKED)
+    {
+        // Quantize positions to the bounds of the whole mesh so all submeshes
+        // share the same dequantization
+        quantization_ = cg::get_vertex_quantization(vertices);
+        std::vector<PackedVertexAndNormal> packed;
+        pack_vertices(vertices, quantization_, packed);
+        vertex_buffer_size_ = packed.size() * sizeof(PackedVertexAndNormal);
+        glBufferData(GL_ARRAY_BUFFER, vertex_buffer_size_, (void *)packed.data(), GL_STATIC_DRAW);
+    }
+    else
+    {
+        quantization_ = {Vector3(1.0f, 1.0f, 1.0f), Vector3(0.0f, 0.0f, 0.0f)};
+        vertex_buffer_size_ = vertices.size() * sizeof(VertexAndNormal);
+        glBufferData(GL_ARRAY_BUFFER, vertex_buffer_size_, (void *)vertices.data(), GL_STATIC_DRAW);
+    }
+}
 
-    // Bind the face list to the vertex buffer object
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, facebuffer_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 faces_.size() * sizeof(uint16_t),
-                 (void *)&faces_[0],
-                 GL_STATIC_DRAW);
+void TriSurface::build_bvh()
+{
+    CG_PROFILE_ZONE("TriSurface::build_bvh");
+    std::vector<AABB> bounds(faces_.size() / 3);
+    for(size_t f = 0; f < bounds.size(); f++)
+    {
+        const uint32_t *face = &faces_[f * 3];
+        bounds[f] = AABB();
+        for(uint32_t k = 0; k < 3; k++) bounds[f].add(vertices_[face[k]].vertex);
+    }
+    bvh_.build(bounds);
+
+    const std::vector<uint32_t> &primitives = bvh_.get_primitives();
+    bvh_triangles_.resize(primitives.size());
+    for(size_t i = 0; i < primitives.size(); i++)
+    {
+        const uint32_t *face = &faces_[primitives[i] * 3];
+        bvh_triangles_.set(i, vertices_[face[0]].vertex, vertices_[face[1]].vertex, vertices_[face[2]].vertex);
+    }
+    bvh_valid_ = true;
+}
+
+const BVH &TriSurface::get_bvh()
+{
+    if(!bvh_valid_) build_bvh();
+    return bvh_;
+}
+
+RayMeshIntersectResult TriSurface::intersect(const Ray3 &ray, float t_max)
+{
+    const BVH             &bvh = get_bvh();
+    const TriangleKernels &kernels = get_triangle_kernels();
+    const size_t           stride = bvh_triangles_.get_stride();
+    const float            o[3] = {ray.o.x, ray.o.y, ray.o.z};
+    const float            d[3] = {ray.d.x, ray.d.y, ray.d.z};
+
+    // Each leaf (at most 8 triangles) is tested with one kernel call
+    RayMeshIntersectResult result = {false, 0.0f, 0.0f, 0.0f, 0};
+    bvh.intersect_leaves(ray,
+                         t_max,
+                         [&](uint32_t first, uint32_t count, float &t_leaf)
+                         {
+                             float    t[8], u[8], v[8];
+                             uint32_t mask = kernels.intersect_1x8(o,
+                                                                   d,
+                                                                   t_leaf,
+                                                                   bvh_triangles_.get_data(first),
+                                                                   stride,
+                                                                   count,
+                                                                   t,
+                                                                   u,
+                                                                   v);
+                             if(mask == 0) return false;
+                             for(uint32_t i = 0; mask != 0; i++, mask >>= 1)
+                             {
+                                 if((mask & 1) == 0 || t[i] >= t_leaf) continue;
+                                 t_leaf = t[i];
+                                 result = {true, t[i], u[i], v[i], bvh.get_primitives()[first + i]};
+                             }
+                             return true;
+                         });
+    return result;
+}
+
+void TriSurface::intersect(RayPacket8 &rays, RayMeshIntersectResult *results)
+{
+    for(uint32_t i = 0; i < 8; i++) results[i] = {false, 0.0f, 0.0f, 0.0f, 0};
+
+    const BVH             &bvh = get_bvh();
+    const TriangleKernels &kernels = get_triangle_kernels();
+    const size_t           stride = bvh_triangles_.get_stride();
+    bvh.intersect_leaves(rays,
+                         [&](uint32_t first, uint32_t count, RayPacket8 &packet)
+                         {
+                             // Each triangle of the leaf against the whole packet
+                             for(uint32_t j = 0; j < count; j++)
+                             {
+                                 float    t[8], u[8], v[8];
+                                 uint32_t mask =
+                                     kernels.intersect_8x1(packet, bvh_triangles_.get_data(first + j), stride, t, u, v);
+                                 for(uint32_t i = 0; mask != 0; i++, mask >>= 1)
+                                 {
+                                     if((mask & 1) == 0) continue;
+                                     packet.t_max[i] = t[i];
+                                     results[i] = {true, t[i], u[i], v[i], bvh.get_primitives()[first + j]};
+                                 }
+                             }
+                         });
+}
+
+Vector3 TriSurface::get_interpolated_normal(uint32_t face, float barycentric_u, float barycentric_v) const
+{
+    const uint32_t *f = &faces_[face * 3];
+    float           w = 1.0f - barycentric_u - barycentric_v;
+    return vertices_[f[0]].normal * w + vertices_[f[1]].normal * barycentric_u +
+           vertices_[f[2]].normal * barycentric_v;
+}
+
+const std::vector<VertexAndNormal> &TriSurface::get_vertices() const { return vertices_; }
+
+const std::vector<uint32_t> &TriSurface::get_faces() const { return faces_; }
+
+void TriSurface::update_bound()
+{
+    bound_ = vertex_bound_;
+    cullable_ = true;
+}
 
-    // Copy the face list count for use in Draw
-    face_count_ = static_cast<GLsizei>(faces_.size());
+void TriSurface::delete_vertex_buffers()
+{
+    // Surfaces built without OpenGL have nothing to delete (and may have no context)
+    if(vbo_ == 0 && submeshes_.empty()) return;
+    for(auto &submesh : submeshes_) { glDeleteVertexArrays(1, &submesh.vao); }
+    submeshes_.clear();
+    glDeleteBuffers(1, &vbo_);
+    glDeleteBuffers(1, &facebuffer_);
+    vbo_ = 0;
+    facebuffer_ = 0;
+    vertex_buffer_size_ = 0;
+    index_buffer_size_ = 0;
+}
 
+GLuint TriSurface::create_vertex_array(int32_t position_loc, int32_t normal_loc, size_t vertex_offset)
+{
     // Allocate a VAO, enable it and set the vertex attribute arrays and pointers
-    glGenVertexArrays(1, &vao_);
-    glBindVertexArray(vao_);
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
 
     // Bind the vertex buffer, set the vertex position attribute and the vertex normal attribute
     glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glVertexAttribPointer(position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(VertexAndNormal), (void *)0);
-    glVertexAttribPointer(
-        normal_loc, 3, GL_FLOAT, GL_FALSE, sizeof(VertexAndNormal), (void *)(sizeof(Point3)));
-    glEnableVertexAttribArray(position_loc);
-    glEnableVertexAttribArray(normal_loc);
+    set_vertex_attributes(vertex_format_, vertex_offset, position_loc, normal_loc);
 
     // Bind the face list buffer and draw.
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, facebuffer_);
 
     // Make sure changes to this VAO are local
     glBindVertexArray(0);
+    return vao;
+}
 
-    // We could clear any local memory as it is now in the VBO. However there may be
-    // cases where we want to keep it (e.g. collision detection, picking) so I am not
-    // going to do that here.
+void TriSurface::set_vertex_attributes(VertexFormat format,
+                                       size_t       vertex_offset,
+                                       int32_t      position_loc,
+                                       int32_t      normal_loc)
+{
+    if(format == VertexFormat::PACKED)
+    {
+        // Normalized 16 bit positions in [0, 1] and octahedral normals in [-1, 1].
+        // The vertex shader applies the position scale and offset and decodes the normal.
+        glVertexAttribPointer(position_loc,
+                              3,
+                              GL_UNSIGNED_SHORT,
+                              GL_TRUE,
+                              sizeof(PackedVertexAndNormal),
+                              (void *)(vertex_offset + offsetof(PackedVertexAndNormal, position)));
+        glVertexAttribPointer(normal_loc,
+                              2,
+                              GL_SHORT,
+                              GL_TRUE,
+                              sizeof(PackedVertexAndNormal),
+                              (void *)(vertex_offset + offsetof(PackedVertexAndNormal, normal)));
+    }
+    else
+    {
+        glVertexAttribPointer(
+            position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(VertexAndNormal), (void *)vertex_offset);
+        glVertexAttribPointer(normal_loc,
+                              3,
+                              GL_FLOAT,
+                              GL_FALSE,
+                              sizeof(VertexAndNormal),
+                              (void *)(vertex_offset + sizeof(Point3)));
+    }
+    glEnableVertexAttribArray(position_loc);
+    glEnableVertexAttribArray(normal_loc);
 }
 
 void TriSurface::construct_row_col_face_list(uint32_t num_rows, uint32_t num_cols)
 {
-
+    faces_.reserve(faces_.size() + 6 * static_cast<size_t>(num_rows - 1) * (num_cols - 1));
     for(uint32_t row = 0; row < num_rows - 1; row++)
     {
         for(uint32_t col = 0; col < num_cols - 1; col++)
@@ -162,28 +694,100 @@ void TriSurface::construct_row_col_face_list(uint32_t num_rows, uint32_t num_col
     }
 }
 
-uint16_t TriSurface::get_index(uint32_t row, uint32_t col, uint32_t num_cols) const
+uint32_t TriSurface::get_index(uint32_t row, uint32_t col, uint32_t num_cols) const
 {
 
-    return static_cast<uint16_t>((row * num_cols) + col);
+    return (row * num_cols) + col;
 }
 
-uint16_t TriSurface::add_vertex(const Point3 &vtx)
+uint32_t TriSurface::add_vertex(const Point3 &vtx)
 {
-    // Check if vertex is in the list. This is just a brute force method.
-    // Efficiency can be improved but we only use this at startup
-    uint16_t index = 0;
-    for(const auto &v : vertices_)
-    {
-        if(vtx == v.vertex) { return index; }
-        index++;
-    }
+    // Check if vertex is in the list using the spatial hash. Vertices added
+    // to the list by other means are hashed first so they are shared as well.
+    update_weld_hash();
+    uint32_t index = find_weld_vertex(vtx);
+    if(index < vertices_.size()) { return index; }
 
     // Not in the list, add it. Make sure the vertex normal is initialized
     // to (0,0,0)
     VertexAndNormal vertex_and_normal(vtx);
     vertices_.push_back(vertex_and_normal);
-    return static_cast<uint16_t>(vertices_.size() - 1);
+    weld_hash_.emplace(get_weld_key(vtx), index);
+    weld_count_ = vertices_.size();
+    return index;
+}
+
+void TriSurface::release_weld_hash()
+{
+    // Destroy the nodes before the arena memory is reused
+    weld_hash_ = WeldHash(WeldHash::allocator_type(weld_arena_));
+    weld_arena_.reset();
+    weld_count_ = 0;
+}
+
+void TriSurface::update_weld_hash()
+{
+    // Vertex list was replaced (e.g. by construct)
+    if(weld_count_ > vertices_.size()) { release_weld_hash(); }
+
+    if(weld_count_ == 0) { weld_hash_.reserve(vertices_.size()); }
+    for(; weld_count_ < vertices_.size(); weld_count_++)
+    {
+        weld_hash_.emplace(get_weld_key(vertices_[weld_count_].vertex),
+                           static_cast<uint32_t>(weld_count_));
+    }
+}
+
+uint32_t TriSurface::find_weld_vertex(const Point3 &vtx) const
+{
+    // Return the lowest matching index (the vertex the linear search would find)
+    uint32_t found = static_cast<uint32_t>(vertices_.size());
+    if(weld_tolerance_ == 0.0f)
+    {
+        auto range = weld_hash_.equal_range(get_weld_key(vtx));
+        for(auto it = range.first; it != range.second; ++it)
+        {
+            if(it->second < found && vertices_[it->second].vertex == vtx) { found = it->second; }
+        }
+        return found;
+    }
+
+    // Grid cells are the size of the tolerance, so a match lies in the cell
+    // containing the vertex or one of its 26 neighbors
+    int64_t cx = weld_cell(vtx.x, weld_tolerance_);
+    int64_t cy = weld_cell(vtx.y, weld_tolerance_);
+    int64_t cz = weld_cell(vtx.z, weld_tolerance_);
+    float   tolerance_squared = weld_tolerance_ * weld_tolerance_;
+    for(int64_t x = cx - 1; x <= cx + 1; x++)
+    {
+        for(int64_t y = cy - 1; y <= cy + 1; y++)
+        {
+            for(int64_t z = cz - 1; z <= cz + 1; z++)
+            {
+                auto range = weld_hash_.equal_range(hash_cell(x, y, z));
+                for(auto it = range.first; it != range.second; ++it)
+                {
+                    if(it->second < found &&
+                       (vertices_[it->second].vertex - vtx).norm_squared() <= tolerance_squared)
+                    {
+                        found = it->second;
+                    }
+                }
+            }
+        }
+    }
+    return found;
+}
+
+uint64_t TriSurface::get_weld_key(const Point3 &vtx) const
+{
+    if(weld_tolerance_ == 0.0f)
+    {
+        return hash_cell(float_bits(vtx.x), float_bits(vtx.y), float_bits(vtx.z));
+    }
+    return hash_cell(weld_cell(vtx.x, weld_tolerance_),
+                     weld_cell(vtx.y, weld_tolerance_),
+                     weld_cell(vtx.z, weld_tolerance_));
 }
 
 } // namespace cg
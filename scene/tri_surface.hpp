@@ -13,11 +13,39 @@
 #ifndef __SCENE_TRI_SURFACE_HPP__
 #define __SCENE_TRI_SURFACE_HPP__
 
+#include "geometry/arena.hpp"
+#include "geometry/bvh.hpp"
+#include "geometry/vertex_packing.hpp"
 #include "scene/geometry_node.hpp"
+#include "scene/render_queue.hpp"
+
+#include <cfloat>
+#include <unordered_map>
 
 namespace cg
 {
 
+/**
+ * Index format used for the element (face) buffer.
+ */
+enum class IndexFormat
+{
+    AUTO = 0, // Narrowest type that fits the vertex count (uint16 or uint32)
+    UINT16,   // uint16 only. Meshes with more than 65,536 vertices are split
+              // into submeshes (for targets without 32 bit index support)
+    UINT32    // Always uint32
+};
+
+/**
+ * Weighting of the face normals averaged to form vertex normals.
+ */
+enum class NormalWeighting
+{
+    UNIFORM = 0, // Each adjoining face has the same weight
+    AREA,        // Faces are weighted by their area
+    ANGLE        // Faces are weighted by their interior angle at the vertex
+};
+
 /**
  * Triangle mesh surface. Uses indexed vertex arrays. Stores
  * vertices as VertexAndNormal.
@@ -40,12 +68,27 @@ class TriSurface : public GeometryNode
      */
     void draw(SceneState &scene_state) override;
 
+    /**
+     * Add a draw record for this geometry node to the render queue.
+     */
+    void compile(RenderQueue &queue, SceneState &scene_state) override;
+
+    /**
+     * Add a geometry node for each submesh to the scene store.
+     */
+    void flatten(SceneStore &store, uint32_t parent) override;
+
+    /**
+     * Add this surface with the composite modeling matrix to the list.
+     */
+    void gather_instances(SceneGather &gather, const Matrix4x4 &model_matrix) override;
+
     /**
      * Construct triangle surface by passing in vertex list and face list
      * @param  v  List of vertices (position and normal)
      * @param  f    Index list for triangles
      */
-    void construct(const std::vector<VertexAndNormal> &v, const std::vector<uint16_t> &f);
+    void construct(const std::vector<VertexAndNormal> &v, const std::vector<uint32_t> &f);
 
     /**
      * Adds the vertices of the triangle to the vertex list. Accounts for
@@ -67,28 +110,281 @@ class TriSurface : public GeometryNode
      */
     void add_polygon(const std::vector<Point3> &vertex_list);
 
+    /**
+     * Set the tolerance used to find shared vertices when adding triangles.
+     * Vertices closer than the tolerance are merged. A tolerance of 0 (the
+     * default) only merges vertices with identical positions.
+     * @param  tolerance  Weld tolerance (distance).
+     */
+    void set_weld_tolerance(float tolerance);
+
+    /**
+     * Get the tolerance used to find shared vertices.
+     * @return  Returns the weld tolerance.
+     */
+    float get_weld_tolerance() const;
+
+    /**
+     * Set the weighting of face normals used to calculate vertex normals.
+     * Call before end().
+     * @param  weighting  Normal weighting.
+     */
+    void set_normal_weighting(NormalWeighting weighting);
+
+    /**
+     * Get the normal weighting.
+     * @return  Returns the normal weighting.
+     */
+    NormalWeighting get_normal_weighting() const;
+
     /**
      * Marks the end of a triangle mesh. Calculates the vertex normals.
      */
     void end(int32_t position_loc, int32_t normal_loc);
 
     /**
-     * Creates vertex buffers for this object.
+     * Creates vertex buffers for this object. Any existing buffers are
+     * replaced. The index type is selected using the index format. The mesh
+     * is optimized first if mesh optimization is enabled. A negative
+     * position_loc only updates the bound and creates no OpenGL objects (for
+     * surfaces drawn on the CPU without an OpenGL context).
      */
     void create_vertex_buffers(int32_t position_loc, int32_t normal_loc);
 
+    /**
+     * Reorder the faces for the post-transform vertex cache and to reduce
+     * overdraw, then reorder the vertices in order of use by the faces. Vertex
+     * indexes change.
+     */
+    void optimize_mesh();
+
+    /**
+     * Enable or disable mesh optimization in create_vertex_buffers (enabled
+     * by default). Applies to all surfaces.
+     * @param  enable  Optimize meshes if true.
+     */
+    static void set_mesh_optimization(bool enable);
+
+    /**
+     * Check whether mesh optimization is enabled.
+     * @return  Returns true if meshes are optimized when creating vertex buffers.
+     */
+    static bool get_mesh_optimization();
+
+    /**
+     * Set the index format used when the vertex buffers are created. Call
+     * before end() / create_vertex_buffers().
+     * @param  format  Index format.
+     */
+    void set_index_format(IndexFormat format);
+
+    /**
+     * Get the index format.
+     * @return  Returns the index format.
+     */
+    IndexFormat get_index_format() const;
+
+    /**
+     * Get the index type of the element buffer.
+     * @return  Returns GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+     */
+    GLenum get_index_type() const;
+
+    /**
+     * Get the number of submeshes (draw calls) used to draw the surface.
+     * @return  Returns the number of submeshes.
+     */
+    uint32_t get_submesh_count() const;
+
+    /**
+     * Set the vertex buffer layout used when the vertex buffers are created.
+     * The packed format quantizes positions to 16 bits within the mesh bounds
+     * and octahedral encodes normals (12 bytes per vertex instead of 24). It
+     * requires a shader that sets the vertex_format, position_scale and
+     * position_offset uniform locations in the scene state. Call before
+     * end() / create_vertex_buffers().
+     * @param  format  Vertex format.
+     */
+    void set_vertex_format(VertexFormat format);
+
+    /**
+     * Get the vertex format.
+     * @return  Returns the vertex format.
+     */
+    VertexFormat get_vertex_format() const;
+
+    /**
+     * Get the position dequantization of the vertex buffer (identity for the
+     * float vertex format).
+     * @return  Returns the position scale and offset.
+     */
+    const VertexQuantization &get_vertex_quantization() const;
+
+    /**
+     * Get the size of a vertex in the vertex buffer.
+     * @return  Returns the vertex size in bytes.
+     */
+    size_t get_vertex_size() const;
+
+    /**
+     * Get the memory used by the vertex buffer.
+     * @return  Returns the vertex buffer size in bytes.
+     */
+    size_t get_vertex_buffer_size() const;
+
+    /**
+     * Get the memory used by the element (index) buffer.
+     * @return  Returns the index buffer size in bytes.
+     */
+    size_t get_index_buffer_size() const;
+
+    /**
+     * Get the vertex array, buffers and index range used to draw a submesh.
+     * @param  submesh  Submesh index (less than get_submesh_count()).
+     * @return  Returns the draw geometry of the submesh (not instanced).
+     */
+    DrawGeometry get_draw_geometry(uint32_t submesh) const;
+
+    /**
+     * Set the vertex position and normal attribute pointers for a vertex
+     * format and enable them. The vertex buffer must be bound to
+     * GL_ARRAY_BUFFER.
+     * @param  format         Vertex format of the vertex buffer.
+     * @param  vertex_offset  Byte offset of the first vertex in the vertex buffer.
+     * @param  position_loc   Vertex position attribute location.
+     * @param  normal_loc     Vertex normal attribute location.
+     */
+    static void set_vertex_attributes(VertexFormat format,
+                                      size_t       vertex_offset,
+                                      int32_t      position_loc,
+                                      int32_t      normal_loc);
+
+    /**
+     * Build the bounding volume hierarchy over the triangles. It is built on
+     * first use after the vertex buffers are created; build it beforehand if
+     * several threads will intersect the surface.
+     */
+    void build_bvh();
+
+    /**
+     * Get the triangle BVH, building it if needed. Primitive i of the BVH is
+     * face i (vertex indexes 3i to 3i+2 of the face list).
+     * @return  Returns the BVH.
+     */
+    const BVH &get_bvh();
+
+    /**
+     * Find the nearest intersection of a ray with the triangles of the
+     * surface using the BVH.
+     * @param  ray    Ray in modeling coordinates (need not be unit length;
+     *                distances are in units of the ray direction).
+     * @param  t_max  Maximum distance along the ray.
+     * @return  Returns whether there is an intersection, its distance,
+     *          barycentric coordinates and face index.
+     */
+    RayMeshIntersectResult intersect(const Ray3 &ray, float t_max = FLT_MAX);
+
+    /**
+     * Find the nearest intersections of a packet of 8 rays with the triangles
+     * of the surface. Faster than 8 single rays when the rays are coherent.
+     * @param  rays     Ray packet in modeling coordinates. t_max of each ray
+     *                  is reduced to its nearest hit.
+     * @param  results  Filled with the nearest hit of each ray (8 results).
+     */
+    void intersect(RayPacket8 &rays, RayMeshIntersectResult *results);
+
+    /**
+     * Get the normal at a point of a face, interpolated from the vertex
+     * normals (as the shaders interpolate them).
+     * @param  face           Face index.
+     * @param  barycentric_u  Barycentric coordinates of the point (weights
+     * @param  barycentric_v  of the second and third vertices).
+     * @return  Returns the normal in modeling coordinates (not unit length).
+     */
+    Vector3 get_interpolated_normal(uint32_t face, float barycentric_u, float barycentric_v) const;
+
+    /**
+     * Get the vertex list (positions and normals in modeling coordinates).
+     * @return  Returns the vertex list.
+     */
+    const std::vector<VertexAndNormal> &get_vertices() const;
+
+    /**
+     * Get the face list (3 vertex indexes per triangle).
+     * @return  Returns the face list.
+     */
+    const std::vector<uint32_t> &get_faces() const;
+
   protected:
+    /**
+     * A range of the element buffer drawn with its own vertex array object.
+     * Meshes that fit the index type have a single submesh.
+     */
+    struct SubMesh
+    {
+        GLuint  vao;
+        GLsizei index_count;
+        size_t  index_offset;  // Byte offset into the element buffer
+        size_t  vertex_offset; // Byte offset into the vertex buffer
+    };
+
     // Vertex buffer support
-    GLsizei face_count_;
-    GLuint  vao_;
-    GLuint  vbo_;
-    GLuint  facebuffer_;
+    GLuint               vbo_;
+    GLuint               facebuffer_;
+    GLenum               index_type_;
+    IndexFormat          index_format_;
+    VertexFormat         vertex_format_;
+    VertexQuantization   quantization_;
+    size_t               vertex_buffer_size_;
+    size_t               index_buffer_size_;
+    std::vector<SubMesh> submeshes_;
 
     // Vertex and normal list
     std::vector<VertexAndNormal> vertices_;
 
-    // Use uint16_t for face list indexes (OpenGL ES compatible)
-    std::vector<uint16_t> faces_;
+    // Bounding box of the vertices (computed when the vertex buffers are created)
+    AABB vertex_bound_;
+
+    // Triangle BVH used for ray intersection and whether it matches the face
+    // list. The triangles are copied in BVH primitive order so each leaf is a
+    // contiguous range for the triangle kernels.
+    BVH         bvh_;
+    TriangleSoA bvh_triangles_;
+    bool        bvh_valid_;
+
+    // Face list indexes. The element buffer uses uint16_t indexes when they fit
+    // (see IndexFormat)
+    std::vector<uint32_t> faces_;
+
+    /**
+     * Face normal and the weight of the normal at each corner of the face.
+     */
+    struct FaceNormal
+    {
+        Vector3 normal;
+        float   weight[3];
+    };
+
+    // Optimize meshes in create_vertex_buffers
+    static bool mesh_optimization_;
+
+    // Weighting used to form vertex normals
+    NormalWeighting normal_weighting_;
+
+    // Spatial hash used to find shared vertices in add_vertex. Maps a hash of
+    // the position (or of the grid cell when welding with a tolerance) to the
+    // vertex index. Only the first weld_count_ vertices are in the hash. The
+    // hash only lives while the surface is built, so its nodes come from an
+    // arena that is reset when the hash is released.
+    using WeldHash = std::unordered_multimap<uint64_t,
+                                             uint32_t,
+                                             std::hash<uint64_t>,
+                                             std::equal_to<uint64_t>,
+                                             ArenaAllocator<std::pair<const uint64_t, uint32_t>>>;
+    float    weld_tolerance_;
+    size_t   weld_count_;
+    Arena    weld_arena_;
+    WeldHash weld_hash_;
 
     /**
      * Form triangle face indexes for a surface constructed using a double loop -
@@ -102,15 +398,82 @@ class TriSurface : public GeometryNode
 
     // Convenience method to get the index into the vertex list given the
     // "row" and "column" of the subdivision/grid
-    uint16_t get_index(uint32_t row, uint32_t col, uint32_t num_cols) const;
+    uint32_t get_index(uint32_t row, uint32_t col, uint32_t num_cols) const;
 
     /**
      * Adds a vertex to the surface vertex list.  Returns the index into the
-     * vertex list.  If the vertex is already in the list it does not
-     * replicate it.
+     * vertex list.  If the vertex is already in the list (within the weld
+     * tolerance) it does not replicate it. Uses a spatial hash so each call
+     * takes constant time on average.
      * @param  vtx  Vertex
      */
-    uint16_t add_vertex(const Point3 &vtx);
+    uint32_t add_vertex(const Point3 &vtx);
+
+    /**
+     * Release the spatial hash and its arena (the hash is rebuilt on the next
+     * add_vertex).
+     */
+    void release_weld_hash();
+
+    /**
+     * Add vertices appended to the vertex list without add_vertex (for
+     * example by add_polygon or construct) to the spatial hash.
+     */
+    void update_weld_hash();
+
+    /**
+     * Find a vertex in the spatial hash within the weld tolerance of vtx.
+     * @param  vtx  Vertex position.
+     * @return  Returns the lowest matching vertex index, or vertices_.size()
+     *          if there is no match.
+     */
+    uint32_t find_weld_vertex(const Point3 &vtx) const;
+
+    /**
+     * Get the spatial hash key for a vertex position.
+     * @param  vtx  Vertex position.
+     * @return  Returns the key (hash of the position or its grid cell).
+     */
+    uint64_t get_weld_key(const Point3 &vtx) const;
+
+    /**
+     * Calculate vertex normals by adding the weighted normals of the faces
+     * using each vertex, then normalizing. Large meshes use multiple threads:
+     * each sums a block of faces into its own partial normals, which are then
+     * added in a fixed order (the same result on every run).
+     * @param  allow_threads  Allow the calculation to use multiple threads.
+     */
+    void compute_vertex_normals(bool allow_threads = true);
+
+    /**
+     * Get the weighted normal of a face.
+     * @param  face  Vertex indexes of the face.
+     * @return  Returns the face normal and corner weights.
+     */
+    FaceNormal get_face_normal(const uint32_t *face) const;
+
+    /**
+     * Delete the vertex buffers and vertex array objects.
+     */
+    void delete_vertex_buffers();
+
+    /**
+     * Bound of the vertices when the vertex buffers were created.
+     */
+    void update_bound() override;
+
+    /**
+     * Fill the vertex buffer using the vertex format. Sets the position
+     * dequantization.
+     * @param  vertices  Vertex list.
+     */
+    void upload_vertices(const std::vector<VertexAndNormal> &vertices);
+
+    /**
+     * Create a vertex array object for a submesh.
+     * @param  vertex_offset  Byte offset of the submesh vertices in the vertex buffer.
+     */
+    GLuint create_vertex_array(int32_t position_loc, int32_t normal_loc, size_t vertex_offset);
 };
 
 } // namespace cg
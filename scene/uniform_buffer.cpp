@@ -0,0 +1,186 @@
+#include "scene/uniform_buffer.hpp"
+
+#include "scene/scene_bvh.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cg
+{
+
+namespace
+{
+
+// Invalid material index
+constexpr uint32_t NO_MATERIAL = 0xFFFFFFFF;
+
+// Size of the material block range bound for a draw (the std140 block size
+// is rounded up to a multiple of 16 bytes)
+constexpr size_t MATERIAL_RANGE_SIZE = (sizeof(MaterialBlock) + 15) / 16 * 16;
+
+} // namespace
+
+LightBlock make_light_block(const SceneLight &light)
+{
+    LightBlock block{};
+    block.enabled = light.enabled ? 1 : 0;
+    block.spotlight = light.spotlight ? 1 : 0;
+    block.position = light.position;
+    block.ambient = light.ambient;
+    block.diffuse = light.diffuse;
+    block.specular = light.specular;
+    block.spot_direction = light.spot_direction;
+    block.spot_cutoff = light.spot_cutoff;
+    block.spot_exponent = light.spot_exponent;
+    return block;
+}
+
+size_t get_uniform_buffer_alignment()
+{
+    // Only cached once there is a context to query
+    static size_t alignment = 0;
+    if(alignment == 0)
+    {
+        GLint value = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &value);
+        if(value <= 0) return 256;
+        alignment = static_cast<size_t>(value);
+    }
+    return alignment;
+}
+
+UniformBuffer::UniformBuffer() : buffer_(0), binding_(0), size_(0) {}
+
+UniformBuffer::~UniformBuffer()
+{
+    if(buffer_ != 0) glDeleteBuffers(1, &buffer_);
+}
+
+void UniformBuffer::create(GLuint binding, size_t size)
+{
+    if(buffer_ == 0) glGenBuffers(1, &buffer_);
+    binding_ = binding;
+    size_ = size;
+    contents_.assign(size, 0);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferData(GL_UNIFORM_BUFFER, size, contents_.data(), GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding_, buffer_);
+}
+
+bool UniformBuffer::update(size_t offset, const void *data, size_t size)
+{
+    // Static state (a camera or lights that did not move) is not uploaded again
+    if(memcmp(&contents_[offset], data, size) == 0) return false;
+    memcpy(&contents_[offset], data, size);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    return true;
+}
+
+void UniformBuffer::bind() const { glBindBufferBase(GL_UNIFORM_BUFFER, binding_, buffer_); }
+
+GLuint UniformBuffer::get_buffer() const { return buffer_; }
+
+MaterialBuffer::MaterialBuffer() : buffer_(0), stride_(0), capacity_(0), changed_(false), bound_(NO_MATERIAL) {}
+
+MaterialBuffer::~MaterialBuffer()
+{
+    if(buffer_ != 0) glDeleteBuffers(1, &buffer_);
+}
+
+void MaterialBuffer::clear()
+{
+    materials_.clear();
+    changed_ = false;
+    bound_ = NO_MATERIAL;
+}
+
+void MaterialBuffer::release()
+{
+    clear();
+    if(buffer_ != 0) glDeleteBuffers(1, &buffer_);
+    buffer_ = 0;
+    capacity_ = 0;
+}
+
+uint32_t MaterialBuffer::add(const MaterialBlock &material)
+{
+    materials_.push_back(material);
+    changed_ = true;
+    return static_cast<uint32_t>(materials_.size() - 1);
+}
+
+void MaterialBuffer::set(uint32_t index, const MaterialBlock &material)
+{
+    materials_[index] = material;
+    changed_ = true;
+}
+
+const MaterialBlock &MaterialBuffer::get(uint32_t index) const { return materials_[index]; }
+
+uint32_t MaterialBuffer::size() const { return static_cast<uint32_t>(materials_.size()); }
+
+void MaterialBuffer::upload()
+{
+    if(!changed_ || materials_.empty()) return;
+    create_buffer();
+
+    // Lay the materials out at their aligned offsets and replace the buffer
+    // storage with one call
+    staging_.assign(materials_.size() * stride_, 0);
+    for(size_t i = 0; i < materials_.size(); i++)
+    {
+        memcpy(&staging_[i * stride_], &materials_[i], sizeof(MaterialBlock));
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferData(GL_UNIFORM_BUFFER, staging_.size(), staging_.data(), GL_STATIC_DRAW);
+    capacity_ = materials_.size();
+    changed_ = false;
+}
+
+void MaterialBuffer::bind(uint32_t index)
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, buffer_, index * stride_, MATERIAL_RANGE_SIZE);
+    bound_ = index;
+}
+
+void MaterialBuffer::stream(const MaterialBlock &material)
+{
+    if(bound_ != NO_MATERIAL && memcmp(&materials_[bound_], &material, sizeof(MaterialBlock)) == 0) return;
+
+    // Draws already issued keep the storage they used, so growing the buffer
+    // (which discards its contents) only affects materials written after it
+    uint32_t index = add(material);
+    if(index >= capacity_) reserve_storage(std::max<size_t>(64, capacity_ * 2));
+    else glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferSubData(GL_UNIFORM_BUFFER, index * stride_, sizeof(MaterialBlock), &material);
+    changed_ = false;
+    bind(index);
+}
+
+MaterialBlock MaterialBuffer::get_bound() const
+{
+    if(bound_ != NO_MATERIAL) return materials_[bound_];
+    return MaterialBlock{Color4(), Color4(), Color4(), Color4(), 1.0f};
+}
+
+void MaterialBuffer::create_buffer()
+{
+    if(buffer_ != 0) return;
+    glGenBuffers(1, &buffer_);
+
+    // Each material starts on an aligned offset so its range can be bound.
+    // The alignment is known once there is a context.
+    size_t alignment = get_uniform_buffer_alignment();
+    stride_ = (MATERIAL_RANGE_SIZE + alignment - 1) / alignment * alignment;
+}
+
+void MaterialBuffer::reserve_storage(size_t count)
+{
+    create_buffer();
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferData(GL_UNIFORM_BUFFER, count * stride_, nullptr, GL_DYNAMIC_DRAW);
+    capacity_ = count;
+}
+
+} // namespace cg
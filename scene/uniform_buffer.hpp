@@ -0,0 +1,258 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.667 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	Brian Russin
+//
+//	Author:  David W. Nesbitt
+//	File:    uniform_buffer.hpp
+//	Purpose: Uniform buffer objects for per-frame state (camera and lights)
+//           and materials, with the std140 layouts of their uniform blocks.
+//
+//============================================================================
+
+#ifndef __SCENE_UNIFORM_BUFFER_HPP__
+#define __SCENE_UNIFORM_BUFFER_HPP__
+
+#include "geometry/hpoint3.hpp"
+#include "geometry/point3.hpp"
+#include "geometry/vector3.hpp"
+#include "scene/color4.hpp"
+#include "scene/graphics.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cg
+{
+
+struct SceneLight;
+
+// Uniform block binding points (set by the shader with glUniformBlockBinding)
+constexpr GLuint FRAME_BLOCK_BINDING = 0;
+constexpr GLuint MATERIAL_BLOCK_BINDING = 1;
+
+// Number of lights in the frame block
+constexpr uint32_t MAX_BLOCK_LIGHTS = 3;
+
+/**
+ * Material properties captured from a presentation node. Also the std140
+ * layout of the MaterialBlock uniform block.
+ */
+struct MaterialBlock
+{
+    Color4 ambient;
+    Color4 diffuse;
+    Color4 specular;
+    Color4 emission;
+    float  shininess;
+};
+
+/**
+ * Light source in the frame block (std140 layout of the LightSource struct).
+ */
+struct LightBlock
+{
+    int32_t enabled;
+    int32_t spotlight;
+    int32_t pad0[2];
+    HPoint3 position;
+    Color4  ambient;
+    Color4  diffuse;
+    Color4  specular;
+    Vector3 spot_direction;
+    float   spot_cutoff;
+    float   spot_exponent;
+    float   pad1[3];
+};
+
+/**
+ * Per-frame state: camera position, global ambient and lights (std140
+ * layout of the FrameBlock uniform block).
+ */
+struct FrameBlock
+{
+    Point3     camera_position;
+    int32_t    num_lights;
+    Color4     global_ambient;
+    LightBlock lights[MAX_BLOCK_LIGHTS];
+};
+
+static_assert(sizeof(MaterialBlock) == 68, "MaterialBlock must match the std140 layout");
+static_assert(sizeof(LightBlock) == 112, "LightBlock must match the std140 layout");
+static_assert(offsetof(FrameBlock, lights) == 32, "FrameBlock must match the std140 layout");
+
+/**
+ * Convert a light to its frame block layout.
+ * @param  light  Light (world coordinates).
+ * @return  Returns the light block.
+ */
+LightBlock make_light_block(const SceneLight &light);
+
+/**
+ * Get the alignment of uniform buffer ranges (GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT).
+ * @return  Returns the alignment in bytes (256 if there is no OpenGL context).
+ */
+size_t get_uniform_buffer_alignment();
+
+/**
+ * Uniform buffer object bound to a uniform block binding point.
+ */
+class UniformBuffer
+{
+  public:
+    /**
+     * Constructor. The buffer is created by create.
+     */
+    UniformBuffer();
+
+    /**
+     * Destructor. Deletes the buffer.
+     */
+    ~UniformBuffer();
+
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+    /**
+     * Create the buffer and bind it to a binding point.
+     * @param  binding  Uniform block binding point.
+     * @param  size     Size in bytes.
+     */
+    void create(GLuint binding, size_t size);
+
+    /**
+     * Replace part of the buffer contents. Nothing is uploaded if the data
+     * matches what the buffer already holds.
+     * @param  offset  Byte offset.
+     * @param  data    Data.
+     * @param  size    Size in bytes.
+     * @return  Returns true if the contents changed.
+     */
+    bool update(size_t offset, const void *data, size_t size);
+
+    /**
+     * Bind the buffer to its binding point.
+     */
+    void bind() const;
+
+    /**
+     * Get the buffer object.
+     * @return  Returns the buffer object (0 if not created).
+     */
+    GLuint get_buffer() const;
+
+  protected:
+    GLuint               buffer_;
+    GLuint               binding_;
+    size_t               size_;
+    std::vector<uint8_t> contents_; // Copy of the buffer contents
+};
+
+/**
+ * Array of materials in a uniform buffer. Each material is in its own
+ * aligned range of the buffer, and a draw selects its material by binding
+ * that range to the material block (one call instead of a uniform per
+ * material property).
+ *
+ * Materials are either added up front and uploaded with one call (render
+ * queue, scene store), or streamed: written and bound one at a time while
+ * drawing the scene graph.
+ */
+class MaterialBuffer
+{
+  public:
+    /**
+     * Constructor.
+     */
+    MaterialBuffer();
+
+    /**
+     * Destructor. Deletes the buffer.
+     */
+    ~MaterialBuffer();
+
+    MaterialBuffer(const MaterialBuffer &) = delete;
+    MaterialBuffer &operator=(const MaterialBuffer &) = delete;
+
+    /**
+     * Remove all materials (keeps the buffer).
+     */
+    void clear();
+
+    /**
+     * Remove all materials and delete the buffer (before the OpenGL context
+     * is destroyed). The buffer is created again on next use.
+     */
+    void release();
+
+    /**
+     * Add a material (uploaded by the next upload).
+     * @param  material  Material.
+     * @return  Returns the index of the material.
+     */
+    uint32_t add(const MaterialBlock &material);
+
+    /**
+     * Replace a material (uploaded by the next upload).
+     * @param  index     Index of the material.
+     * @param  material  Material.
+     */
+    void set(uint32_t index, const MaterialBlock &material);
+
+    /**
+     * Get a material.
+     * @param  index  Index of the material.
+     * @return  Returns the material.
+     */
+    const MaterialBlock &get(uint32_t index) const;
+
+    /**
+     * Get the number of materials.
+     * @return  Returns the number of materials.
+     */
+    uint32_t size() const;
+
+    /**
+     * Upload the materials if any were added or changed since the last upload.
+     */
+    void upload();
+
+    /**
+     * Bind a material to the material block.
+     * @param  index  Index of the material.
+     */
+    void bind(uint32_t index);
+
+    /**
+     * Add a material, write it to the buffer and bind it. Does nothing if
+     * the bound material is the same.
+     * @param  material  Material.
+     */
+    void stream(const MaterialBlock &material);
+
+    /**
+     * Get the material last bound.
+     * @return  Returns the bound material (default material if none).
+     */
+    MaterialBlock get_bound() const;
+
+  protected:
+    GLuint                     buffer_;
+    size_t                     stride_;   // Bytes between materials (aligned)
+    size_t                     capacity_; // Materials the buffer storage holds
+    bool                       changed_;
+    uint32_t                   bound_;
+    std::vector<MaterialBlock> materials_;
+    std::vector<uint8_t>       staging_;
+
+    // Create the buffer object and set the stride (on first use)
+    void create_buffer();
+
+    // Make the buffer storage hold at least count materials (contents are lost)
+    void reserve_storage(size_t count);
+};
+
+} // namespace cg
+
+#endif
@@ -1,6 +1,7 @@
 #include "scene/unit_square.hpp"
 
 #include "geometry/geometry.hpp"
+#include "geometry/profiler.hpp"
 
 #include <iostream>
 
@@ -11,20 +12,26 @@ UnitSquareSurface::UnitSquareSurface() {}
 
 UnitSquareSurface::UnitSquareSurface(uint32_t n, int32_t position_loc, int32_t normal_loc)
 {
-    // Only allow 250 subdivision (so it creates less that 65K vertices)
-    if(n > 250) n = 250;
+    CG_PROFILE_ZONE("UnitSquareSurface::UnitSquareSurface");
+
+    // More than 255 subdivisions uses 32 bit indexes (more than 65K vertices)
+    if(n < 1) n = 1;
 
     // Create VBOs and VAO
     // Normal is 0,0,1. z = 0 so all vertices lie in x,y plane.
-    // Having issues with roundoff when n = 40,50 - so compare with some tolerance
+    // Compute each coordinate from its row and column (accumulating the spacing
+    // has roundoff issues, which add or drop rows for large n)
     VertexAndNormal vtx;
     vtx.normal = {0.0f, 0.0f, 1.0f};
     vtx.vertex.z = 0.0f;
     float spacing = 1.0f / static_cast<float>(n);
-    for(vtx.vertex.y = -0.5f; vtx.vertex.y <= 0.5f + EPSILON; vtx.vertex.y += spacing)
+    vertices_.reserve((n + 1) * (n + 1));
+    for(uint32_t row = 0; row <= n; row++)
     {
-        for(vtx.vertex.x = -0.5f; vtx.vertex.x <= 0.5f + EPSILON; vtx.vertex.x += spacing)
+        vtx.vertex.y = -0.5f + static_cast<float>(row) * spacing;
+        for(uint32_t col = 0; col <= n; col++)
         {
+            vtx.vertex.x = -0.5f + static_cast<float>(col) * spacing;
             vertices_.push_back(vtx);
         }
     }
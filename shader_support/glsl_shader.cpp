@@ -1,6 +1,7 @@
 #include "shader_support/glsl_shader.hpp"
 
 #include "filesystem_support/file_locator.hpp"
+#include "geometry/profiler.hpp"
 
 #include <iostream>
 
@@ -15,6 +16,7 @@ GLSLShader::GLSLShader(const std::string &shader_str, GLenum shader_type)
 
 bool GLSLShader::create_from_source(const char *source)
 {
+    CG_PROFILE_ZONE("GLSLShader::create_from_source");
     bool success = true;
     gl_shader_ = glCreateShader(gl_shader_type_);
     glShaderSource(gl_shader_, 1, &source, NULL);
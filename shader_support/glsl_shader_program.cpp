@@ -1,5 +1,7 @@
 #include "shader_support/glsl_shader_program.hpp"
 
+#include "geometry/profiler.hpp"
+
 #include <iostream>
 
 namespace cg
@@ -12,6 +14,7 @@ void GLSLShaderProgram::create() { shader_program_ = glCreateProgram(); }
 
 bool GLSLShaderProgram::attach_shaders(GLuint vertex_shader, GLuint fragment_shader)
 {
+    CG_PROFILE_ZONE("GLSLShaderProgram::attach_shaders");
     glAttachShader(shader_program_, vertex_shader);
     glAttachShader(shader_program_, fragment_shader);
     glLinkProgram(shader_program_);